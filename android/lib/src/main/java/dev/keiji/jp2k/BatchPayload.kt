@@ -0,0 +1,117 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+import android.graphics.BitmapFactory
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * One entry of the packed output of a batch decode.
+ *
+ * @property errorCode [Jp2kError] code of the failure, 0 on success.
+ * @property offset Offset of the decoder output in the packed output.
+ * @property length Length of the decoder output in bytes, 0 on failure.
+ */
+internal data class BatchEntry(
+    val errorCode: Int,
+    val offset: Int,
+    val length: Int,
+)
+
+/**
+ * Packs the inputs of a batch decode into one payload.
+ *
+ * The payload is the image count and the length of each image (little-endian uint32), followed by
+ * the images back to back.
+ */
+internal fun packBatchInput(images: List<ByteArray>): ByteArray {
+    val headerSize = BATCH_LENGTH_SIZE_BYTES * (images.size + 1)
+    val totalSize = headerSize.toLong() + images.sumOf { it.size.toLong() }
+    require(totalSize <= Int.MAX_VALUE) { "Batch input is too large ($totalSize bytes)" }
+
+    val payload = ByteArray(totalSize.toInt())
+    val header = ByteBuffer.wrap(payload, 0, headerSize).order(ByteOrder.LITTLE_ENDIAN)
+    header.putInt(images.size)
+    var offset = headerSize
+    for (image in images) {
+        header.putInt(image.size)
+        System.arraycopy(image, 0, payload, offset, image.size)
+        offset += image.size
+    }
+    return payload
+}
+
+/**
+ * Parses the packed output of `decodeJ2KBatch`.
+ *
+ * The output is the entry count (little-endian uint32), followed by each entry: its error code
+ * (int32), its length (uint32) and the decoder output of that image. Entry offsets are relative to
+ * the start of [DecodeOutput.payload].
+ *
+ * @throws IllegalStateException If the output is malformed or does not hold [expectedCount] entries.
+ */
+internal fun unpackBatchOutput(output: DecodeOutput, expectedCount: Int): List<BatchEntry> {
+    val buffer = ByteBuffer.wrap(output.payload, output.offset, output.length).order(ByteOrder.LITTLE_ENDIAN)
+    check(output.length >= BATCH_LENGTH_SIZE_BYTES) { "Batch output is too short (${output.length} bytes)." }
+    val count = buffer.getInt()
+    check(count == expectedCount) { "Batch output holds $count entries, expected $expectedCount." }
+
+    return List(count) {
+        check(buffer.remaining() >= BATCH_LENGTH_SIZE_BYTES * 2) { "Batch output is truncated." }
+        val errorCode = buffer.getInt()
+        val length = buffer.getInt()
+        check(length >= 0 && buffer.remaining() >= length) { "Batch output is truncated." }
+        val entry = BatchEntry(errorCode, buffer.position(), length)
+        buffer.position(buffer.position() + length)
+        entry
+    }
+}
+
+/**
+ * Creates a [Bitmap] from one decoder output, either a BMP file or raw pixels when [isRaw] is set.
+ *
+ * The output is decoded into [target] if given, otherwise into a Bitmap taken from [pool] if given.
+ * A BMP is decoded with [BitmapFactory.Options.inBitmap] set to that Bitmap.
+ *
+ * @throws IllegalStateException If the output cannot be decoded.
+ * @throws IllegalArgumentException If [target] cannot hold the decoded image.
+ */
+internal fun createBitmapFromOutput(
+    payload: ByteArray,
+    offset: Int,
+    length: Int,
+    isRaw: Boolean,
+    colorFormat: ColorFormat,
+    target: Bitmap? = null,
+    pool: Jp2kBitmapPool? = null,
+): Bitmap {
+    if (isRaw) {
+        return createBitmapFromRawPixels(payload, offset, length, target, pool)
+    }
+    val options = BitmapFactory.Options().apply {
+        inPreferredConfig = when (colorFormat) {
+            ColorFormat.RGB565 -> Bitmap.Config.RGB_565
+            ColorFormat.ARGB8888 -> Bitmap.Config.ARGB_8888
+        }
+    }
+    if (target != null || pool != null) {
+        options.inJustDecodeBounds = true
+        BitmapFactory.decodeByteArray(payload, offset, length, options)
+        options.inJustDecodeBounds = false
+        if (target != null) {
+            requireCompatibleBitmap(target, options.outWidth, options.outHeight, options.inPreferredConfig)
+            options.inBitmap = target
+        } else if (pool != null && options.outWidth > 0 && options.outHeight > 0) {
+            options.inBitmap = pool.get(options.outWidth, options.outHeight, options.inPreferredConfig)
+        }
+        options.inMutable = true
+    }
+    return BitmapFactory.decodeByteArray(payload, offset, length, options) ?: run {
+        if (target == null) {
+            options.inBitmap?.let { pool?.put(it) }
+        }
+        throw IllegalStateException("Bitmap decoding failed (returned null).")
+    }
+}
+
+private const val BATCH_LENGTH_SIZE_BYTES = 4
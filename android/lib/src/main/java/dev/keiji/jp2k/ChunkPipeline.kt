@@ -0,0 +1,39 @@
+package dev.keiji.jp2k
+
+import com.google.common.util.concurrent.ListenableFuture
+
+/**
+ * Runs [count] chunk evaluations with up to [window] of them in flight, and hands each result to
+ * [onResult] in chunk order as soon as it is available.
+ *
+ * [await] waits for one evaluation: suspending in [Jp2kDecoder], blocking in [Jp2kDecoderAsync].
+ * The evaluations still in flight are cancelled when one of them fails.
+ */
+internal inline fun pipelineChunks(
+    count: Int,
+    window: Int,
+    evaluate: (index: Int) -> ListenableFuture<String>,
+    await: (ListenableFuture<String>) -> String,
+    onResult: (index: Int, result: String) -> Unit,
+) {
+    val inFlight = ArrayDeque<ListenableFuture<String>>()
+    val windowSize = window.coerceAtLeast(1)
+    var next = 0
+    try {
+        for (index in 0 until count) {
+            while (next < count && inFlight.size < windowSize) {
+                inFlight.addLast(evaluate(next++))
+            }
+            onResult(index, await(inFlight.removeFirst()))
+        }
+    } catch (e: Throwable) {
+        inFlight.forEach { it.cancel(false) }
+        throw e
+    }
+}
+
+/**
+ * Number of chunks of at most [chunkSize] characters a payload of [length] characters is split into.
+ */
+internal fun chunkCount(length: Int, chunkSize: Int): Int =
+    ((length.toLong() + chunkSize - 1) / chunkSize).toInt()
@@ -0,0 +1,16 @@
+package dev.keiji.jp2k
+
+/**
+ * Data class representing one component (color channel) of a JPEG 2000 image.
+ *
+ * @property precision The number of bits per sample.
+ * @property isSigned Whether the samples are signed.
+ * @property subsamplingX The horizontal subsampling factor on the reference grid. 1 for a full resolution component.
+ * @property subsamplingY The vertical subsampling factor on the reference grid. 1 for a full resolution component.
+ */
+data class ComponentInfo(
+    val precision: Int,
+    val isSigned: Boolean,
+    val subsamplingX: Int,
+    val subsamplingY: Int,
+)
@@ -15,6 +15,13 @@ package dev.keiji.jp2k
  * @param preferDirectBinaryTransfer Whether to prefer direct binary transfer via `JavaScriptIsolate.provideNamedData` when available. This enables more efficient data transfer; if false, string-mediated data transfer is used. Defaults to true.
  * @param binderTransactionMaxChunkSizeBytes The maximum chunk size in bytes for transfer across Android Binder transactions. Defaults to [JavaScriptEngineEnvironment.binderTransactionMaxChunkSizeBytes].
  * @param wasmMaxMemoryBytes The maximum allowable addressable memory size in bytes for WebAssembly execution. Defaults to [JavaScriptEngineEnvironment.wasmMaxMemoryBytes].
+ * @param decodeThreads The number of threads OpenJPEG uses to decode code-blocks. Only effective with a WASM build that has thread support and runs on shared memory; otherwise decoding falls back to one thread. Defaults to [DEFAULT_DECODE_THREADS].
+ * @param rawPixelOutput Whether the decoder returns raw pixels in Bitmap memory layout, which are copied into the Bitmap directly. If false, a BMP is returned and parsed by BitmapFactory. Defaults to true.
+ * @param chunkTransferWindow The number of chunk evaluations kept in flight when a payload exceeds [binderTransactionMaxChunkSizeBytes] and is transferred in chunks. Output chunks are decoded into the output as they arrive. Defaults to [DEFAULT_CHUNK_TRANSFER_WINDOW].
+ * @param bitmapPool The pool the decoders take the Bitmaps they return from. Hand the Bitmaps back to it with [Jp2kBitmapPool.put] once they are no longer used. If null, every decode allocates a new Bitmap. Defaults to null.
+ * @param regionCache The cache of decoded regions the decoders serve repeated region requests from without going to the sandbox. If null, every request is decoded. Defaults to null.
+ * @param decodeTimeoutMillis The time in milliseconds a decode may run before it fails with [Jp2kError.DeadlineExceeded]. The decoder checks the deadline between tiles and between strips of the conversion. It is the only way to stop a decode that is already running in the sandbox. A [Jp2kDeadline] in the coroutine context overrides it for [Jp2kDecoder]. 0 for no deadline. Defaults to [DEFAULT_DECODE_TIMEOUT_MILLIS].
+ * @param heapRecyclePolicy When the decoders recycle their WASM heap, which otherwise never shrinks. If null, the heap is kept for the lifetime of the decoder. Defaults to null.
  */
 data class Config(
     val maxPixels: Int = DEFAULT_MAX_PIXELS,
@@ -26,4 +33,11 @@ data class Config(
     val preferDirectBinaryTransfer: Boolean = true,
     val binderTransactionMaxChunkSizeBytes: Int = JavaScriptEngineEnvironment.binderTransactionMaxChunkSizeBytes,
     val wasmMaxMemoryBytes: Long = JavaScriptEngineEnvironment.wasmMaxMemoryBytes,
+    val decodeThreads: Int = DEFAULT_DECODE_THREADS,
+    val rawPixelOutput: Boolean = true,
+    val chunkTransferWindow: Int = DEFAULT_CHUNK_TRANSFER_WINDOW,
+    val bitmapPool: Jp2kBitmapPool? = null,
+    val regionCache: Jp2kRegionCache? = null,
+    val decodeTimeoutMillis: Long = DEFAULT_DECODE_TIMEOUT_MILLIS,
+    val heapRecyclePolicy: HeapRecyclePolicy? = null,
 )
@@ -21,6 +21,83 @@ const val DEFAULT_MAX_EVALUATION_RETURN_SIZE_BYTES = 256 * 1024 * 1024
  */
 const val DEFAULT_MAX_PIXELS = 16000000
 
+/**
+ * Default number of threads used to decode code-blocks.
+ */
+const val DEFAULT_DECODE_THREADS = 1
+
+/**
+ * Default number of chunk evaluations kept in flight when a payload is transferred in chunks.
+ */
+const val DEFAULT_CHUNK_TRANSFER_WINDOW = 4
+
+/**
+ * Default maximum number of decoders (isolates) kept by [Jp2kDecoderPool].
+ *
+ * 4: Each isolate holds its own WASM heap, so the pool is capped below the core count of most devices.
+ */
+const val DEFAULT_POOL_MAX_SIZE = 4
+
+/**
+ * Default time in milliseconds a decoder of [Jp2kDecoderPool] stays idle before it is released.
+ */
+const val DEFAULT_POOL_IDLE_TIMEOUT_MILLIS = 30_000L
+
+/**
+ * Default maximum total size in bytes of the Bitmaps kept by [Jp2kBitmapPool].
+ *
+ * 32MB: About four full HD ARGB_8888 frames.
+ */
+const val DEFAULT_BITMAP_POOL_MAX_SIZE_BYTES = 32L * 1024 * 1024
+
+/**
+ * Default time in milliseconds a decode may run before it fails with [Jp2kError.DeadlineExceeded].
+ *
+ * 0: No deadline.
+ */
+const val DEFAULT_DECODE_TIMEOUT_MILLIS = 0L
+
+/**
+ * Default WASM heap size in bytes at which [HeapRecyclePolicy] recycles the heap after a decode.
+ *
+ * 128MB: A quarter of [DEFAULT_MAX_HEAP_SIZE_BYTES], far above what screen-sized images leave behind.
+ */
+const val DEFAULT_HEAP_RECYCLE_HIGH_WATER_MARK_BYTES = 128L * 1024 * 1024
+
+/**
+ * Default time in milliseconds a decoder stays idle before [HeapRecyclePolicy] recycles a grown heap.
+ */
+const val DEFAULT_HEAP_RECYCLE_IDLE_TIMEOUT_MILLIS = 30_000L
+
+/**
+ * Default maximum total size in bytes of the decoded regions kept by [Jp2kRegionCache].
+ *
+ * 64MB: A screenful of regions at two zoom levels on a high-density display.
+ */
+const val DEFAULT_REGION_CACHE_MAX_SIZE_BYTES = 64L * 1024 * 1024
+
+/**
+ * Output format of the WASM decode functions: BMP file.
+ */
+internal const val OUTPUT_FORMAT_BMP = 0
+
+/**
+ * Output format of the WASM decode functions: a [RAW_HEADER_SIZE_BYTES] header followed by the pixels
+ * in Android Bitmap memory layout.
+ */
+internal const val OUTPUT_FORMAT_RAW = 1
+
+/**
+ * Size of the raw output header (width, height, stride and color format as little-endian uint32).
+ */
+internal const val RAW_HEADER_SIZE_BYTES = 16
+
+/**
+ * Number of resolution levels the first step of a progressive decode discards on top of the requested
+ * reduce level. Each level quarters the pixels to decode.
+ */
+internal const val PROGRESSIVE_PREVIEW_REDUCE_LEVELS = 2
+
 /**
  * Maximum chunk size in bytes / characters for safe transfer across Android Binder transactions.
  * 256KB: Safely below the 1MB shared Binder buffer limit.
@@ -38,6 +115,11 @@ const val WASM_MAX_MEMORY_BYTES = JavaScriptEngineEnvironment.DEFAULT_WASM_MAX_M
  */
 internal const val JS_FEATURE_PROVIDE_CONSUME_ARRAY_BUFFER = JavaScriptSandbox.JS_FEATURE_PROVIDE_CONSUME_ARRAY_BUFFER
 
+/**
+ * Asset path of the WASM binary.
+ */
+internal const val ASSET_PATH_WASM = "openjpeg_core.wasm"
+
 /**
  * Named data key for the WASM binary when using provideNamedData.
  */
@@ -50,6 +132,36 @@ internal const val PROVIDED_J2K_DATA = "j2kData"
 
 internal const val INTERNAL_RESULT_SUCCESS = "1"
 
+/**
+ * Evaluation result telling that the decode result was posted as a binary result frame.
+ */
+internal const val INTERNAL_RESULT_FRAME = "F"
+
+/**
+ * Magic number at the start of a binary result frame ("J2KR" in little-endian).
+ */
+internal const val RESULT_FRAME_MAGIC = 0x524B324A
+
+/**
+ * Size in bytes of the fixed header of a binary result frame.
+ */
+internal const val RESULT_FRAME_HEADER_SIZE_BYTES = 100
+
+/**
+ * Number of uint32 values returned by the getLastStats export of the WASM module.
+ */
+internal const val DECODE_STATS_COUNT = 7
+
+/**
+ * Number of uint32 values returned by the getLastMemoryStats export of the WASM module.
+ */
+internal const val MEMORY_STATS_COUNT = 4
+
+/**
+ * Longest deadline in milliseconds the sandbox takes (uint32). Longer timeouts are clamped.
+ */
+internal const val MAX_REQUEST_TIMEOUT_MILLIS = 0xFFFFFFFFL
+
 internal const val SCRIPT_IMPORT_OBJECT = """
 const wasiSnapshotPreview = {
     // 環境変数の数とサイズ
@@ -79,6 +191,14 @@ const wasiSnapshotPreview = {
     fd_close: (fd) => 0,
     fd_seek: (fd, offset_low, offset_high, whence, p_new_offset) => 0,
 
+    // 時刻（ナノ秒）。デコードの期限の判定に使用します。
+    clock_time_get: (id, precision, p_time) => {
+        const view = new DataView(wasmInstance.exports.memory.buffer);
+        const nowMs = (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
+        view.setBigUint64(p_time, BigInt(Math.round(nowMs * 1000000)), true);
+        return 0;
+    },
+
     // プログラム終了
     proc_exit: (code) => {
         console.log("WASM exited with code: " + code);
@@ -101,8 +221,13 @@ internal const val SCRIPT_DEFINE_INPUT_CHUNKS = """
                 globalThis.inputChunks = [];
                 return "$INTERNAL_RESULT_SUCCESS";
             };
-            globalThis.appendInputChunk = function(chunk) {
-                globalThis.inputChunks.push(chunk);
+            // Chunks are stored at their index, so that the evaluations of a window may complete in any order.
+            globalThis.appendInputChunk = function(chunk, index) {
+                if (index === undefined) {
+                    globalThis.inputChunks.push(chunk);
+                } else {
+                    globalThis.inputChunks[index] = chunk;
+                }
                 return "$INTERNAL_RESULT_SUCCESS";
             };
             globalThis.consumeInputChunks = function() {
@@ -124,10 +249,35 @@ internal const val SCRIPT_DEFINE_INPUT_CHUNKS = """
 
 internal val SCRIPT_DEFINE_SET_DATA = """
             globalThis.j2kData = null;
+
+            // Decode session opened on j2kData by the WithCache functions: { data, handle }
+            globalThis.j2kSession = null;
+            globalThis.closeJ2KSession = function() {
+                if (globalThis.j2kSession) {
+                    wasmInstance.exports.closeSession(globalThis.j2kSession.handle);
+                    globalThis.j2kSession = null;
+                }
+            };
+
+            globalThis.clearData = function() {
+                try {
+                    globalThis.j2kData = null;
+                    globalThis.closeJ2KSession();
+                    // Hands the scratch buffers of the last decodes back to the allocator
+                    if (typeof wasmInstance !== 'undefined' && wasmInstance) {
+                        wasmInstance.exports.resetScratchArena();
+                    }
+                    return "$INTERNAL_RESULT_SUCCESS";
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
             globalThis.setData = function(dataEncodedString) {
                 try {
                     const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
                     globalThis.j2kData = decodeFn(dataEncodedString);
+                    globalThis.closeJ2KSession();
                     return "$INTERNAL_RESULT_SUCCESS";
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
@@ -139,6 +289,7 @@ internal val SCRIPT_DEFINE_SET_DATA = """
                     const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
                     const joined = globalThis.consumeInputChunks();
                     globalThis.j2kData = decodeFn(joined);
+                    globalThis.closeJ2KSession();
                     return "$INTERNAL_RESULT_SUCCESS";
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
@@ -147,238 +298,727 @@ internal val SCRIPT_DEFINE_SET_DATA = """
 """
 
 internal val SCRIPT_DEFINE_DECODE_J2K = """
-            globalThis.commonDecodeJ2K = function(wasmFunctionName, encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput) {
+            // Requests a decode thread count and returns the effective one. Threads need a WASM build
+            // with thread support running on shared memory; other builds stay single-threaded.
+            globalThis.setDecodeThreads = function(threadCount) {
+                const exports = wasmInstance.exports;
+                const isSharedMemory = typeof SharedArrayBuffer !== 'undefined' && exports.memory.buffer instanceof SharedArrayBuffer;
+                const requested = isSharedMemory ? Math.max(1, threadCount | 0) : 1;
+                return exports.setDecodeThreads(requested);
+            };
+
+            // Selects the output of the decode exports: BMP or raw pixels in Bitmap memory layout.
+            globalThis.outputFormat = $OUTPUT_FORMAT_BMP;
+            globalThis.setOutputFormat = function(format) {
+                globalThis.outputFormat = wasmInstance.exports.setOutputFormat(format);
+                return globalThis.outputFormat;
+            };
+
+            // Starts a request: clears the cancellation flag and sets the deadline of the decodes that
+            // follow, in milliseconds from now (0 for none). The deadline is the only way to stop a
+            // running decode: evaluations are serialized, so nothing can set the flag while it runs.
+            globalThis.beginRequest = function(timeoutMillis) {
+                wasmInstance.exports.resetCancellation(timeoutMillis >>> 0);
+                return "$INTERNAL_RESULT_SUCCESS";
+            };
+
+            // Base64 payloads are encoded and decoded by the WASM kernels when the data channel declares its
+            // alphabet (0 standard, 1 URL-safe); JS only moves the characters between strings and the heap.
+            globalThis.hasWasmBase64 = function() {
+                return globalThis.payloadBase64Alphabet !== undefined && typeof wasmInstance.exports.base64Encode === 'function';
+            };
+
+            // Copies an ASCII string into a text buffer of the WASM heap, to be released with releaseBuffer().
+            // Base64 is ASCII, so its UTF-8 encoding is the text itself: TextEncoder copies it natively where the
+            // isolate provides it.
+            globalThis.textEncoder = typeof TextEncoder !== 'undefined' ? new TextEncoder() : null;
+            globalThis.copyTextToWasm = function(text) {
+                const exports = wasmInstance.exports;
+                const length = text.length;
+                const textPtr = exports.acquireTextBuffer(length);
+                if (textPtr === 0) throw new Error("Text buffer allocation failed");
+                const heap = new Uint8Array(exports.memory.buffer, textPtr, length);
+                const isSharedMemory = typeof SharedArrayBuffer !== 'undefined' && exports.memory.buffer instanceof SharedArrayBuffer;
+                if (globalThis.textEncoder && !isSharedMemory) {
+                    globalThis.textEncoder.encodeInto(text, heap);
+                } else {
+                    for (let i = 0; i < length; i++) {
+                        heap[i] = text.charCodeAt(i);
+                    }
+                }
+                return textPtr;
+            };
+
+            // Reads length ASCII characters of the WASM heap as a string, in chunks below the argument count limit.
+            globalThis.readTextFromWasm = function(textPtr, length) {
+                const heap = new Uint8Array(wasmInstance.exports.memory.buffer, textPtr, length);
+                let text = "";
+                for (let i = 0; i < length; i += 8192) {
+                    text += String.fromCharCode.apply(null, heap.subarray(i, Math.min(i + 8192, length)));
+                }
+                return text;
+            };
+
+            // Base64-encodes length bytes of the WASM heap at dataPtr.
+            globalThis.encodeBase64FromWasm = function(dataPtr, length) {
+                const exports = wasmInstance.exports;
+                const textPtr = exports.base64Encode(dataPtr, length, globalThis.payloadBase64Alphabet);
+                if (textPtr === 0) throw new Error("Base64 output allocation failed");
+                const text = globalThis.readTextFromWasm(textPtr, exports.base64EncodedSize(length));
+                exports.releaseBuffer(textPtr);
+                return text;
+            };
+
+            // Decodes a Base64 payload straight into a decode input buffer and returns { inputPtr, length }.
+            // commonDecodeJ2K takes over the buffer.
+            globalThis.decodeBase64ToWasm = function(encoded) {
+                const exports = wasmInstance.exports;
+                const textPtr = globalThis.copyTextToWasm(encoded);
+                const inputPtr = exports.acquireInputBuffer(Math.ceil(encoded.length * 3 / 4));
+                const length = inputPtr === 0 ? -1 : exports.base64Decode(textPtr, encoded.length, inputPtr);
+                exports.releaseBuffer(textPtr);
+                if (length < 0) {
+                    if (inputPtr !== 0) exports.releaseBuffer(inputPtr);
+                    throw new Error("Malformed Base64 payload");
+                }
+                return { inputPtr: inputPtr, length: length };
+            };
+
+            // Input of commonDecodeJ2K: decoded into the WASM heap for Base64 payloads, a byte array otherwise.
+            globalThis.decodeInputPayload = function(encoded) {
+                if (globalThis.hasWasmBase64()) {
+                    return globalThis.decodeBase64ToWasm(encoded);
+                }
+                const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                return decodeFn(encoded);
+            };
+
+            // The other payloads (cached data, sizes, batches) go through the same kernels. The JS converters
+            // stay available as jsEncodePayload / jsDecodePayload.
+            if (globalThis.hasWasmBase64() && !globalThis.jsEncodePayload) {
+                globalThis.jsEncodePayload = globalThis.encodePayload;
+                globalThis.jsDecodePayload = globalThis.decodePayload;
+                globalThis.encodePayload = function(bytes) {
+                    const exports = wasmInstance.exports;
+                    const dataPtr = exports.malloc(bytes.length || 1);
+                    if (dataPtr === 0) return globalThis.jsEncodePayload(bytes);
+                    new Uint8Array(exports.memory.buffer).set(bytes, dataPtr);
+                    try {
+                        return globalThis.encodeBase64FromWasm(dataPtr, bytes.length);
+                    } finally {
+                        exports.free(dataPtr);
+                    }
+                };
+                globalThis.decodePayload = function(encoded) {
+                    const input = globalThis.decodeBase64ToWasm(encoded);
+                    const exports = wasmInstance.exports;
+                    const bytes = new Uint8Array(exports.memory.buffer).slice(input.inputPtr, input.inputPtr + input.length);
+                    exports.releaseBuffer(input.inputPtr);
+                    return bytes;
+                };
+            }
+
+            globalThis.commonDecodeJ2K = function(wasmFunctionName, encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, wasmArgs, base64DecodeTime, inputTransferDelayMs, chunkedOutput) {
                 const now = function() {
                     return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
                 };
 
-                let timeStart, timeAfterPreProcess, timeAfterDecode, timeAfterPostProcess;
                 try {
+                    const timings = { base64DecodeTime: base64DecodeTime, inputTransferDelayMs: inputTransferDelayMs };
                     if (measureTimes) {
-                         timeStart = now();
+                         timings.start = now();
                     }
 
                     const exports = wasmInstance.exports;
 
+                    // Input decoded into the WASM heap by decodeInputPayload is already in an input buffer
+                    const residentPtr = encodedBuffer.inputPtr || 0;
                     const dataLength = encodedBuffer.length;
-                    if (dataLength === 0) return JSON.stringify({ errorCode: -1 });
+                    if (dataLength === 0) {
+                        if (residentPtr) exports.releaseBuffer(residentPtr);
+                        return JSON.stringify({ errorCode: -1 });
+                    }
 
                     if (dataLength > maxHeapSize || dataLength > 4294967296) {
+                        if (residentPtr) exports.releaseBuffer(residentPtr);
                         return JSON.stringify({ errorCode: ${Jp2kError.InputDataSize.code}, errorMessage: "Input data size (" + dataLength + " bytes) exceeds maximum allowable heap size" });
                     }
 
-                    const inputPtr = exports.malloc(dataLength);
-                    const heap = new Uint8Array(exports.memory.buffer);
-
-                    heap.set(encodedBuffer, inputPtr);
+                    // The input and output buffers come from the scratch arena and are reused by the next call
+                    const inputPtr = residentPtr || exports.acquireInputBuffer(dataLength);
+                    if (!residentPtr) {
+                        new Uint8Array(exports.memory.buffer).set(encodedBuffer, inputPtr);
+                    }
 
                     if (measureTimes) {
-                         timeAfterPreProcess = now();
+                         timings.afterPreProcess = now();
                     }
 
-                    // Call the specified WASM function
-                    const bmpPtr = exports[wasmFunctionName](inputPtr, encodedBuffer.length, maxPixels, maxHeapSize, colorFormat, x0, y0, x1, y1);
+                    // Call the specified WASM function. wasmArgs holds the function specific trailing arguments.
+                    const bmpPtr = exports[wasmFunctionName](inputPtr, dataLength, maxPixels, maxHeapSize, colorFormat, ...wasmArgs);
 
                     if (measureTimes) {
-                         timeAfterDecode = now();
+                         timings.afterDecode = now();
                     }
 
-                    if (bmpPtr === 0) {
-                        const errorCode = exports.getLastError();
-                        exports.free(inputPtr);
-                        return JSON.stringify({ errorCode: errorCode });
-                    }
+                    return globalThis.finishDecodeJ2K(bmpPtr, inputPtr, maxHeapSize, measureTimes, timings, chunkedOutput);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
 
-                    const view = new DataView(exports.memory.buffer);
-                    const bmpSize = view.getUint32(bmpPtr + 2, true);
+            // Same as commonDecodeJ2K, but decodes the cached data through its decode session.
+            // The session keeps the codestream and its parsed header in the WASM heap, so the input is
+            // not copied again while j2kData stays the same. Only single-tile codestreams skip parsing.
+            // qualityLayers limits the quality layers decoded, 0 or undefined decodes all of them.
+            globalThis.commonDecodeJ2KWithSession = function(wasmFunctionName, maxPixels, maxHeapSize, colorFormat, measureTimes, wasmArgs, inputTransferDelayMs, chunkedOutput, qualityLayers) {
+                const now = function() {
+                    return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
+                };
 
-                    if (bmpSize > maxHeapSize || bmpSize > 4294967296) {
-                        exports.free(bmpPtr);
-                        exports.free(inputPtr);
-                        return JSON.stringify({ errorCode: ${Jp2kError.PixelDataSize.code}, errorMessage: "Output BMP size (" + bmpSize + " bytes) exceeds maximum heap size" });
+                try {
+                    const timings = { base64DecodeTime: 0, inputTransferDelayMs: inputTransferDelayMs };
+                    if (measureTimes) {
+                         timings.start = now();
                     }
 
-                    const bmpBuffer = new Uint8Array(exports.memory.buffer, bmpPtr, bmpSize);
-                    let base64String = "";
-                    let base64EncodeTime = 0;
-                    if (typeof globalThis.outputMessagePort !== 'undefined' && globalThis.outputMessagePort) {
-                        const bufferCopy = new Uint8Array(bmpBuffer).slice().buffer;
-                        globalThis.outputMessagePort.postMessage(bufferCopy);
-                    } else {
-                        const encodeStart = measureTimes ? now() : 0;
-                        const encodeFn = globalThis.encodePayload || globalThis.bytesToBase64;
-                        base64String = encodeFn(bmpBuffer);
-                        if (measureTimes) {
-                            base64EncodeTime = now() - encodeStart;
-                        }
+                    const exports = wasmInstance.exports;
+
+                    const dataLength = globalThis.j2kData.length;
+                    if (dataLength > maxHeapSize || dataLength > 4294967296) {
+                        return JSON.stringify({ errorCode: ${Jp2kError.InputDataSize.code}, errorMessage: "Input data size (" + dataLength + " bytes) exceeds maximum allowable heap size" });
                     }
 
-                    exports.free(bmpPtr);
-                    exports.free(inputPtr);
+                    const session = globalThis.acquireJ2KSession();
+                    if (session.errorCode !== undefined) {
+                        return JSON.stringify(session);
+                    }
+                    exports.sessionSetQualityLayers(session.handle, qualityLayers || 0);
 
                     if (measureTimes) {
-                         timeAfterPostProcess = now();
+                         timings.afterPreProcess = now();
                     }
 
-                    let result;
-                    if (chunkedOutput && !(typeof globalThis.outputMessagePort !== 'undefined' && globalThis.outputMessagePort)) {
-                        globalThis.outputPayload = base64String;
-                        result = {
-                            outputSize: base64String.length,
-                            isChunked: true,
-                            bmp: ""
-                        };
-                    } else {
-                        result = {
-                            bmp: base64String
-                        };
-                    }
+                    const bmpPtr = exports[wasmFunctionName](session.handle, maxPixels, maxHeapSize, colorFormat, ...wasmArgs);
 
                     if (measureTimes) {
-                        result.inputTransferDelayMs = inputTransferDelayMs || 0;
-                        result.jsFinishTimeMs = Date.now();
-                        result.timeBase64Decode = base64DecodeTime || 0;
-                        result.timePreProcess = timeAfterPreProcess - timeStart;
-                        result.timeWasm = timeAfterDecode - timeAfterPreProcess;
-                        result.timePostProcess = timeAfterPostProcess - timeAfterDecode;
-                        result.timeBase64Encode = base64EncodeTime;
-                        result.wasmHeapSizeBytes = (exports && exports.memory && exports.memory.buffer) ? exports.memory.buffer.byteLength : 0;
+                         timings.afterDecode = now();
                     }
 
-                    return JSON.stringify(result);
+                    return globalThis.finishDecodeJ2K(bmpPtr, 0, maxHeapSize, measureTimes, timings, chunkedOutput);
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
                 }
             };
 
-            globalThis.internalDecodeJ2K = function(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput) {
-                return globalThis.commonDecodeJ2K('decodeToBmp', encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+            // Opens a decode session on j2kData, or reuses the open one while j2kData is unchanged.
+            // Data channels assign j2kData directly, so the session is matched by identity.
+            globalThis.acquireJ2KSession = function() {
+                const data = globalThis.j2kData;
+                if (globalThis.j2kSession && globalThis.j2kSession.data === data) {
+                    return globalThis.j2kSession;
+                }
+                if (data.length === 0) return { errorCode: -1 };
+                globalThis.closeJ2KSession();
+
+                const exports = wasmInstance.exports;
+                const inputPtr = exports.malloc(data.length);
+                const heap = new Uint8Array(exports.memory.buffer);
+                heap.set(data, inputPtr);
+
+                // On success the session owns inputPtr and frees it in closeSession.
+                const handle = exports.openSession(inputPtr, data.length);
+                if (handle === 0) {
+                    const errorCode = exports.getLastError();
+                    exports.free(inputPtr);
+                    return { errorCode: errorCode };
+                }
+
+                globalThis.j2kSession = { data: data, handle: handle };
+                return globalThis.j2kSession;
+            };
+
+            // Size in bytes of the decoder output at outputPtr.
+            globalThis.getOutputSize = function(outputPtr) {
+                const view = new DataView(wasmInstance.exports.memory.buffer);
+                // Raw header: width, height, stride, color format (uint32 each). BMP stores the file size at offset 2.
+                return globalThis.outputFormat === $OUTPUT_FORMAT_RAW
+                    ? $RAW_HEADER_SIZE_BYTES + view.getUint32(outputPtr + 8, true) * view.getUint32(outputPtr + 4, true)
+                    : view.getUint32(outputPtr + 2, true);
+            };
+
+            // Whether results are posted through the output MessagePort as binary result frames.
+            globalThis.hasOutputPort = function() {
+                return typeof globalThis.outputMessagePort !== 'undefined' && !!globalThis.outputMessagePort;
+            };
+
+            // Allocates a binary result frame: the fixed header followed by payloadLength bytes, in one ArrayBuffer.
+            globalThis.allocateResultFrame = function(payloadLength) {
+                return new Uint8Array($RESULT_FRAME_HEADER_SIZE_BYTES + payloadLength);
+            };
+
+            // Statistics of the last decode recorded by the WASM module ($DECODE_STATS_COUNT uint32s, times in
+            // microseconds), or null when the module was built without them.
+            globalThis.readDecodeStats = function() {
+                const exports = wasmInstance.exports;
+                const statsPtr = typeof exports.getLastStats === 'function' ? exports.getLastStats() : 0;
+                if (!statsPtr) return null;
+                return Array.from(new Uint32Array(exports.memory.buffer, statsPtr, $DECODE_STATS_COUNT));
+            };
+
+            // Fills the header of a result frame and posts the frame through the output MessagePort.
+            // Header (little-endian): magic, error code (int32), width, height, output format, stride (uint32 each),
+            // then pre-process, WASM and post-process times, input transfer delay, JS finish time and WASM heap size (float64 each),
+            // then the decode statistics (uint32 each, 0 when unknown).
+            // Width, height and stride are read from the image in the payload, or left 0 when hasImage is false.
+            globalThis.postResultFrame = function(frame, hasImage, timings) {
+                const view = new DataView(frame.buffer, frame.byteOffset, frame.byteLength);
+                const isRaw = globalThis.outputFormat === $OUTPUT_FORMAT_RAW;
+                const payload = $RESULT_FRAME_HEADER_SIZE_BYTES;
+                let width = 0;
+                let height = 0;
+                let stride = 0;
+                if (hasImage && isRaw) {
+                    width = view.getUint32(payload, true);
+                    height = view.getUint32(payload + 4, true);
+                    stride = view.getUint32(payload + 8, true);
+                } else if (hasImage) {
+                    // BITMAPINFOHEADER: width and height (int32, negative height for top-down rows), bits per pixel (uint16)
+                    width = Math.abs(view.getInt32(payload + 18, true));
+                    height = Math.abs(view.getInt32(payload + 22, true));
+                    stride = Math.floor((width * view.getUint16(payload + 28, true) + 31) / 32) * 4;
+                }
+
+                const exports = wasmInstance.exports;
+                view.setUint32(0, $RESULT_FRAME_MAGIC, true);
+                view.setInt32(4, 0, true);
+                view.setUint32(8, width, true);
+                view.setUint32(12, height, true);
+                view.setUint32(16, globalThis.outputFormat, true);
+                view.setUint32(20, stride, true);
+                // Always reported, for the heap recycle policy
+                view.setFloat64(64, exports.memory.buffer.byteLength, true);
+                if (timings) {
+                    view.setFloat64(24, timings.timePreProcess, true);
+                    view.setFloat64(32, timings.timeWasm, true);
+                    view.setFloat64(40, timings.timePostProcess, true);
+                    view.setFloat64(48, timings.inputTransferDelayMs, true);
+                    view.setFloat64(56, Date.now(), true);
+                    if (timings.stats) {
+                        for (let i = 0; i < $DECODE_STATS_COUNT; i++) {
+                            view.setUint32(72 + i * 4, timings.stats[i], true);
+                        }
+                    }
+                }
+
+                globalThis.outputMessagePort.postMessage(frame.buffer);
+                return "$INTERNAL_RESULT_FRAME";
+            };
+
+            // Returns the output at bmpPtr, as a result frame on the output MessagePort or in the result JSON,
+            // and releases the WASM buffers.
+            globalThis.finishDecodeJ2K = function(bmpPtr, inputPtr, maxHeapSize, measureTimes, timings, chunkedOutput) {
+                const now = function() {
+                    return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
+                };
+
+                const exports = wasmInstance.exports;
+
+                if (bmpPtr === 0) {
+                    const errorCode = exports.getLastError();
+                    if (inputPtr) exports.releaseBuffer(inputPtr);
+                    return JSON.stringify({ errorCode: errorCode });
+                }
+
+                const isRaw = globalThis.outputFormat === $OUTPUT_FORMAT_RAW;
+                const bmpSize = globalThis.getOutputSize(bmpPtr);
+
+                if (bmpSize > maxHeapSize || bmpSize > 4294967296) {
+                    exports.releaseBuffer(bmpPtr);
+                    if (inputPtr) exports.releaseBuffer(inputPtr);
+                    return JSON.stringify({ errorCode: ${Jp2kError.PixelDataSize.code}, errorMessage: "Output BMP size (" + bmpSize + " bytes) exceeds maximum heap size" });
+                }
+
+                const bmpBuffer = new Uint8Array(exports.memory.buffer, bmpPtr, bmpSize);
+                if (globalThis.hasOutputPort()) {
+                    // The only copy of the output: from the WASM heap straight into the frame that is posted
+                    const frame = globalThis.allocateResultFrame(bmpSize);
+                    frame.set(bmpBuffer, $RESULT_FRAME_HEADER_SIZE_BYTES);
+                    exports.releaseBuffer(bmpPtr);
+                    if (inputPtr) exports.releaseBuffer(inputPtr);
+
+                    let frameTimings = null;
+                    if (measureTimes) {
+                        frameTimings = {
+                            timePreProcess: timings.afterPreProcess - timings.start,
+                            timeWasm: timings.afterDecode - timings.afterPreProcess,
+                            timePostProcess: now() - timings.afterDecode,
+                            inputTransferDelayMs: timings.inputTransferDelayMs || 0,
+                            stats: globalThis.readDecodeStats(),
+                        };
+                    }
+                    return globalThis.postResultFrame(frame, true, frameTimings);
+                }
+
+                const encodeStart = measureTimes ? now() : 0;
+                const encodeFn = globalThis.encodePayload || globalThis.bytesToBase64;
+                const base64String = globalThis.hasWasmBase64() ? globalThis.encodeBase64FromWasm(bmpPtr, bmpSize) : encodeFn(bmpBuffer);
+                const base64EncodeTime = measureTimes ? now() - encodeStart : 0;
+
+                exports.releaseBuffer(bmpPtr);
+                if (inputPtr) exports.releaseBuffer(inputPtr);
+
+                let timeAfterPostProcess;
+                if (measureTimes) {
+                     timeAfterPostProcess = now();
+                }
+
+                let result;
+                if (chunkedOutput) {
+                    globalThis.outputPayload = base64String;
+                    result = {
+                        outputSize: base64String.length,
+                        isChunked: true,
+                        bmp: ""
+                    };
+                } else {
+                    result = {
+                        bmp: base64String
+                    };
+                }
+                if (isRaw) {
+                    result.raw = true;
+                }
+                result.wasmHeapSizeBytes = exports.memory.buffer.byteLength;
+
+                if (measureTimes) {
+                    result.inputTransferDelayMs = timings.inputTransferDelayMs || 0;
+                    result.jsFinishTimeMs = Date.now();
+                    result.timeBase64Decode = timings.base64DecodeTime || 0;
+                    result.timePreProcess = timings.afterPreProcess - timings.start;
+                    result.timeWasm = timings.afterDecode - timings.afterPreProcess;
+                    result.timePostProcess = timeAfterPostProcess - timings.afterDecode;
+                    result.timeBase64Encode = base64EncodeTime;
+                    const stats = globalThis.readDecodeStats();
+                    if (stats) result.stats = stats;
+                }
+
+                return JSON.stringify(result);
+            };
+
+            globalThis.internalDecodeJ2K = function(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel) {
+                return globalThis.commonDecodeJ2K('decodeToBmpReduced', encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, [x0, y0, x1, y1, reduceLevel || 0], base64DecodeTime, inputTransferDelayMs, chunkedOutput);
             };
 
-            globalThis.decodeJ2K = function(dataEncodedString, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput) {
+            globalThis.decodeJ2K = function(dataEncodedString, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput, reduceLevel) {
                 try {
                     const jsStartTime = Date.now();
                     const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
                     const now = function() {
                         return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
                     };
-                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const decodeFn = globalThis.decodeInputPayload;
                     if (measureTimes) {
                         const b64Start = now();
                         const encodedBuffer = decodeFn(dataEncodedString);
                         const base64DecodeTime = now() - b64Start;
-                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel);
                     } else {
                         const encodedBuffer = decodeFn(dataEncodedString);
-                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput);
+                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput, reduceLevel);
                     }
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
                 }
             };
 
-            globalThis.decodeJ2KFromChunks = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput) {
+            globalThis.decodeJ2KFromChunks = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput, reduceLevel) {
                 try {
                     const jsStartTime = Date.now();
                     const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
                     const now = function() {
                         return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
                     };
-                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const decodeFn = globalThis.decodeInputPayload;
                     const joined = globalThis.consumeInputChunks();
                     if (measureTimes) {
                         const b64Start = now();
                         const encodedBuffer = decodeFn(joined);
                         const base64DecodeTime = now() - b64Start;
-                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel);
                     } else {
                         const encodedBuffer = decodeFn(joined);
-                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput);
+                        return globalThis.internalDecodeJ2K(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput, reduceLevel);
                     }
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
                 }
             };
 
-            globalThis.decodeJ2KWithCache = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput) {
+            globalThis.decodeJ2KWithCache = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput, reduceLevel, qualityLayers) {
                 if (!globalThis.j2kData) {
                     return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
                 }
                 const jsStartTime = Date.now();
                 const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
-                return globalThis.internalDecodeJ2K(globalThis.j2kData, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, inputTransferDelayMs, chunkedOutput);
+                return globalThis.commonDecodeJ2KWithSession('sessionDecodeToBmp', maxPixels, maxHeapSize, colorFormat, measureTimes, [x0, y0, x1, y1, reduceLevel || 0], inputTransferDelayMs, chunkedOutput, qualityLayers);
             };
 
-            globalThis.internalDecodeJ2KRatio = function(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput) {
-                return globalThis.commonDecodeJ2K('decodeToBmpWithRatio', encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+            globalThis.internalDecodeJ2KRatio = function(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel) {
+                return globalThis.commonDecodeJ2K('decodeToBmpWithRatioReduced', encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, [x0, y0, x1, y1, reduceLevel || 0], base64DecodeTime, inputTransferDelayMs, chunkedOutput);
             };
 
-            globalThis.decodeJ2KRatio = function(dataEncodedString, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput) {
+            globalThis.decodeJ2KRatio = function(dataEncodedString, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput, reduceLevel) {
                 try {
                     const jsStartTime = Date.now();
                     const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
                     const now = function() {
                         return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
                     };
-                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const decodeFn = globalThis.decodeInputPayload;
                     if (measureTimes) {
                         const b64Start = now();
                         const encodedBuffer = decodeFn(dataEncodedString);
                         const base64DecodeTime = now() - b64Start;
-                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel);
                     } else {
                         const encodedBuffer = decodeFn(dataEncodedString);
-                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput);
+                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput, reduceLevel);
                     }
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
                 }
             };
 
-            globalThis.decodeJ2KRatioFromChunks = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput) {
+            globalThis.decodeJ2KRatioFromChunks = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput, reduceLevel) {
                 try {
                     const jsStartTime = Date.now();
                     const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
                     const now = function() {
                         return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
                     };
-                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const decodeFn = globalThis.decodeInputPayload;
                     const joined = globalThis.consumeInputChunks();
                     if (measureTimes) {
                         const b64Start = now();
                         const encodedBuffer = decodeFn(joined);
                         const base64DecodeTime = now() - b64Start;
-                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel);
                     } else {
                         const encodedBuffer = decodeFn(joined);
-                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput);
+                        return globalThis.internalDecodeJ2KRatio(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, 0, chunkedOutput, reduceLevel);
                     }
                 } catch (e) {
                     return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
                 }
             };
 
-            globalThis.decodeJ2KWithCacheRatio = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput) {
+            globalThis.decodeJ2KWithCacheRatio = function(maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, kotlinStartTime, chunkedOutput, reduceLevel, qualityLayers) {
                 if (!globalThis.j2kData) {
                     return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
                 }
                 const jsStartTime = Date.now();
                 const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
-                return globalThis.internalDecodeJ2KRatio(globalThis.j2kData, maxPixels, maxHeapSize, colorFormat, measureTimes, x0, y0, x1, y1, 0, inputTransferDelayMs, chunkedOutput);
+                return globalThis.commonDecodeJ2KWithSession('sessionDecodeToBmpWithRatio', maxPixels, maxHeapSize, colorFormat, measureTimes, [x0, y0, x1, y1, reduceLevel || 0], inputTransferDelayMs, chunkedOutput, qualityLayers);
+            };
+
+            // Decodes every image of a packed batch input in this one call.
+            // Input: image count, then the length of each image (uint32 each), then the images back to back.
+            // Output: image count (uint32), then per image its error code (int32, 0 on success), the
+            // output length (uint32) and the output. A failed image does not fail the batch.
+            globalThis.internalDecodeJ2KBatch = function(packed, maxPixels, maxHeapSize, colorFormat, reduceLevel, chunkedOutput) {
+                try {
+                    const exports = wasmInstance.exports;
+                    const input = new DataView(packed.buffer, packed.byteOffset, packed.byteLength);
+                    const count = packed.length >= 4 ? input.getUint32(0, true) : 0;
+                    let dataOffset = 4 + count * 4;
+                    if (count === 0 || dataOffset > packed.length) {
+                        return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: "Malformed batch input" });
+                    }
+
+                    // The output buffer is reused by the next decode, so each output is copied out first
+                    const entries = [];
+                    let outputSize = 4;
+                    for (let i = 0; i < count; i++) {
+                        const dataLength = input.getUint32(4 + i * 4, true);
+                        if (dataOffset + dataLength > packed.length) {
+                            return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: "Malformed batch input" });
+                        }
+                        const entry = globalThis.decodeJ2KBatchEntry(packed.subarray(dataOffset, dataOffset + dataLength), maxPixels, maxHeapSize, colorFormat, reduceLevel);
+                        dataOffset += dataLength;
+                        entries.push(entry);
+                        outputSize += 8 + (entry.bytes ? entry.bytes.length : 0);
+                    }
+
+                    // With an output MessagePort the output is written straight into the payload of a result frame
+                    const frame = globalThis.hasOutputPort() ? globalThis.allocateResultFrame(outputSize) : null;
+                    const output = frame ? frame.subarray($RESULT_FRAME_HEADER_SIZE_BYTES) : new Uint8Array(outputSize);
+                    const view = new DataView(output.buffer, output.byteOffset, output.byteLength);
+                    view.setUint32(0, count, true);
+                    let outputOffset = 4;
+                    for (const entry of entries) {
+                        const length = entry.bytes ? entry.bytes.length : 0;
+                        view.setInt32(outputOffset, entry.errorCode, true);
+                        view.setUint32(outputOffset + 4, length, true);
+                        if (entry.bytes) output.set(entry.bytes, outputOffset + 8);
+                        outputOffset += 8 + length;
+                    }
+
+                    if (frame) {
+                        return globalThis.postResultFrame(frame, false, null);
+                    }
+
+                    const result = { bmp: "" };
+                    const encodeFn = globalThis.encodePayload || globalThis.bytesToBase64;
+                    const encoded = encodeFn(output);
+                    if (chunkedOutput) {
+                        globalThis.outputPayload = encoded;
+                        result.outputSize = encoded.length;
+                        result.isChunked = true;
+                    } else {
+                        result.bmp = encoded;
+                    }
+                    if (globalThis.outputFormat === $OUTPUT_FORMAT_RAW) {
+                        result.raw = true;
+                    }
+                    return JSON.stringify(result);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            // Decodes one image of a batch and returns { errorCode, bytes } with a copy of the output.
+            globalThis.decodeJ2KBatchEntry = function(data, maxPixels, maxHeapSize, colorFormat, reduceLevel) {
+                const exports = wasmInstance.exports;
+                if (data.length === 0) return { errorCode: -1 };
+                if (data.length > maxHeapSize) return { errorCode: ${Jp2kError.InputDataSize.code} };
+
+                const inputPtr = exports.acquireInputBuffer(data.length);
+                new Uint8Array(exports.memory.buffer).set(data, inputPtr);
+
+                const outputPtr = exports.decodeToBmpReduced(inputPtr, data.length, maxPixels, maxHeapSize, colorFormat, 0, 0, 0, 0, reduceLevel);
+                if (outputPtr === 0) {
+                    const errorCode = exports.getLastError();
+                    exports.releaseBuffer(inputPtr);
+                    return { errorCode: errorCode };
+                }
+
+                const outputSize = globalThis.getOutputSize(outputPtr);
+                const entry = outputSize > maxHeapSize
+                    ? { errorCode: ${Jp2kError.PixelDataSize.code} }
+                    : { errorCode: 0, bytes: new Uint8Array(exports.memory.buffer).slice(outputPtr, outputPtr + outputSize) };
+                exports.releaseBuffer(outputPtr);
+                exports.releaseBuffer(inputPtr);
+                return entry;
+            };
+
+            globalThis.decodeJ2KBatch = function(dataEncodedString, maxPixels, maxHeapSize, colorFormat, reduceLevel, chunkedOutput) {
+                try {
+                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    return globalThis.internalDecodeJ2KBatch(decodeFn(dataEncodedString), maxPixels, maxHeapSize, colorFormat, reduceLevel, chunkedOutput);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.decodeJ2KBatchFromChunks = function(maxPixels, maxHeapSize, colorFormat, reduceLevel, chunkedOutput) {
+                try {
+                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const joined = globalThis.consumeInputChunks();
+                    return globalThis.internalDecodeJ2KBatch(decodeFn(joined), maxPixels, maxHeapSize, colorFormat, reduceLevel, chunkedOutput);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            // Plans a progressive decode of the cached data: a preview with one quality layer at a
+            // higher reduce level, then the requested reduce level with all layers. The preview is
+            // skipped when it would not be cheaper than the final step.
+            globalThis.getProgressivePlan = function(reduceLevel) {
+                if (!globalThis.j2kData) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
+                }
+                try {
+                    const exports = wasmInstance.exports;
+                    const session = globalThis.acquireJ2KSession();
+                    if (session.errorCode !== undefined) {
+                        return JSON.stringify(session);
+                    }
+
+                    const numLayers = exports.sessionGetQualityLayers(session.handle);
+                    const maxReduce = exports.sessionGetMaxReduce(session.handle);
+                    const finalReduce = Math.min(reduceLevel, maxReduce);
+                    const previewReduce = Math.min(finalReduce + $PROGRESSIVE_PREVIEW_REDUCE_LEVELS, maxReduce);
+
+                    const steps = [];
+                    if (previewReduce > finalReduce || numLayers > 1) {
+                        steps.push({ reduceLevel: previewReduce, qualityLayers: 1 });
+                    }
+                    steps.push({ reduceLevel: reduceLevel, qualityLayers: 0 });
+
+                    return JSON.stringify({ steps: steps });
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
             };
 
             globalThis.getMemoryUsage = function() {
                 let wasmHeap = 0;
+                let scratchHighWater = 0;
+                let memoryStats = null;
                 try {
                     if (typeof wasmInstance !== 'undefined' && wasmInstance.exports && wasmInstance.exports.memory) {
-                        wasmHeap = wasmInstance.exports.memory.buffer.byteLength;
+                        const exports = wasmInstance.exports;
+                        wasmHeap = exports.memory.buffer.byteLength;
+                        scratchHighWater = exports.getScratchHighWaterMark() >>> 0;
+                        // start, peak, current, estimate (uint32 each)
+                        const statsPtr = typeof exports.getLastMemoryStats === 'function' ? exports.getLastMemoryStats() : 0;
+                        if (statsPtr) {
+                            memoryStats = new Uint32Array(exports.memory.buffer, statsPtr, $MEMORY_STATS_COUNT);
+                        }
                     }
                 } catch (e) {}
 
                 return JSON.stringify({
                     wasmHeapSizeBytes: wasmHeap,
+                    scratchHighWaterMarkBytes: scratchHighWater,
+                    heapInUseBytes: memoryStats ? memoryStats[2] : 0,
+                    lastDecodePeakBytes: memoryStats ? Math.max(0, memoryStats[1] - memoryStats[0]) : 0,
+                    lastDecodeEstimatedPeakBytes: memoryStats ? memoryStats[3] : 0,
                 });
             };
+
+            // Replaces the WASM instance with a new one of the same module, so that the linear memory of the old
+            // one, which never shrinks, is garbage collected. The heap is kept while it is smaller than
+            // minHeapBytes or no larger than that of a fresh instance. j2kData lives outside the heap; its session
+            // belongs to the old instance and is opened again by the next request that needs it.
+            globalThis.recycleWasmInstance = async function(minHeapBytes) {
+                try {
+                    const heapBefore = wasmInstance.exports.memory.buffer.byteLength;
+                    if (heapBefore < minHeapBytes || heapBefore <= globalThis.initialWasmHeapBytes) {
+                        return JSON.stringify({ recycled: false, wasmHeapSizeBytes: heapBefore });
+                    }
+
+                    const previous = wasmInstance;
+                    wasmInstance = await WebAssembly.instantiate(wasmModule, importObject);
+                    try {
+                        globalThis.configureWasmInstance();
+                    } catch (e) {
+                        wasmInstance = previous;
+                        throw e;
+                    }
+                    globalThis.j2kSession = null;
+
+                    const heapAfter = wasmInstance.exports.memory.buffer.byteLength;
+                    return JSON.stringify({
+                        recycled: true,
+                        reclaimedBytes: Math.max(0, heapBefore - heapAfter),
+                        wasmHeapSizeBytes: heapAfter,
+                    });
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
         """
 
 internal val SCRIPT_DEFINE_GET_SIZE = """
@@ -393,7 +1033,7 @@ internal val SCRIPT_DEFINE_GET_SIZE = """
                         return JSON.stringify({ errorCode: ${Jp2kError.InputDataSize.code}, errorMessage: "Input data size exceeds maximum allowable memory" });
                     }
 
-                    const inputPtr = exports.malloc(dataLength);
+                    const inputPtr = exports.acquireInputBuffer(dataLength);
                     const heap = new Uint8Array(exports.memory.buffer);
 
                     heap.set(encodedBuffer, inputPtr);
@@ -403,7 +1043,7 @@ internal val SCRIPT_DEFINE_GET_SIZE = """
 
                     if (resultPtr === 0) {
                         const errorCode = exports.getLastError();
-                        exports.free(inputPtr);
+                        exports.releaseBuffer(inputPtr);
                         return JSON.stringify({ errorCode: errorCode });
                     }
 
@@ -412,7 +1052,7 @@ internal val SCRIPT_DEFINE_GET_SIZE = """
                     const height = view.getUint32(resultPtr + 4, true);
 
                     exports.free(resultPtr);
-                    exports.free(inputPtr);
+                    exports.releaseBuffer(inputPtr);
 
                     return JSON.stringify({
                         width: width,
@@ -448,7 +1088,288 @@ internal val SCRIPT_DEFINE_GET_SIZE = """
                 if (!globalThis.j2kData) {
                     return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
                 }
-                return globalThis.internalGetSize(globalThis.j2kData);
+                try {
+                    const exports = wasmInstance.exports;
+                    const session = globalThis.acquireJ2KSession();
+                    if (session.errorCode !== undefined) {
+                        return JSON.stringify(session);
+                    }
+
+                    const resultPtr = exports.sessionGetSize(session.handle);
+                    if (resultPtr === 0) {
+                        return JSON.stringify({ errorCode: exports.getLastError() });
+                    }
+
+                    const view = new DataView(exports.memory.buffer);
+                    const width = view.getUint32(resultPtr, true);
+                    const height = view.getUint32(resultPtr + 4, true);
+
+                    exports.free(resultPtr);
+
+                    return JSON.stringify({
+                        width: width,
+                        height: height
+                    });
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+          """
+
+internal val SCRIPT_DEFINE_TILE = """
+            globalThis.readTileInfo = function(resultPtr) {
+                const view = new DataView(wasmInstance.exports.memory.buffer);
+                return {
+                    imageX0: view.getUint32(resultPtr, true),
+                    imageY0: view.getUint32(resultPtr + 4, true),
+                    imageX1: view.getUint32(resultPtr + 8, true),
+                    imageY1: view.getUint32(resultPtr + 12, true),
+                    tileX0: view.getUint32(resultPtr + 16, true),
+                    tileY0: view.getUint32(resultPtr + 20, true),
+                    tileWidth: view.getUint32(resultPtr + 24, true),
+                    tileHeight: view.getUint32(resultPtr + 28, true),
+                    numTilesX: view.getUint32(resultPtr + 32, true),
+                    numTilesY: view.getUint32(resultPtr + 36, true)
+                };
+            };
+
+            globalThis.internalGetTileInfo = function(encodedBuffer) {
+                try {
+                    const exports = wasmInstance.exports;
+                    const dataLength = encodedBuffer.length;
+
+                    if (dataLength === 0) return JSON.stringify({ errorCode: -1 });
+
+                    if (dataLength > 4294967296) {
+                        return JSON.stringify({ errorCode: ${Jp2kError.InputDataSize.code}, errorMessage: "Input data size exceeds maximum allowable memory" });
+                    }
+
+                    const inputPtr = exports.acquireInputBuffer(dataLength);
+                    const heap = new Uint8Array(exports.memory.buffer);
+
+                    heap.set(encodedBuffer, inputPtr);
+
+                    const resultPtr = exports.getTileInfo(inputPtr, dataLength);
+
+                    if (resultPtr === 0) {
+                        const errorCode = exports.getLastError();
+                        exports.releaseBuffer(inputPtr);
+                        return JSON.stringify({ errorCode: errorCode });
+                    }
+
+                    const result = globalThis.readTileInfo(resultPtr);
+
+                    exports.free(resultPtr);
+                    exports.releaseBuffer(inputPtr);
+
+                    return JSON.stringify(result);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.getTileInfo = function(dataEncodedString) {
+                try {
+                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const encodedBuffer = decodeFn(dataEncodedString);
+                    return globalThis.internalGetTileInfo(encodedBuffer);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.getTileInfoFromChunks = function() {
+                try {
+                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const joined = globalThis.consumeInputChunks();
+                    const encodedBuffer = decodeFn(joined);
+                    return globalThis.internalGetTileInfo(encodedBuffer);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.getTileInfoWithCache = function() {
+                if (!globalThis.j2kData) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
+                }
+                try {
+                    const exports = wasmInstance.exports;
+                    const session = globalThis.acquireJ2KSession();
+                    if (session.errorCode !== undefined) {
+                        return JSON.stringify(session);
+                    }
+
+                    const resultPtr = exports.sessionGetTileInfo(session.handle);
+                    if (resultPtr === 0) {
+                        return JSON.stringify({ errorCode: exports.getLastError() });
+                    }
+
+                    const result = globalThis.readTileInfo(resultPtr);
+                    exports.free(resultPtr);
+
+                    return JSON.stringify(result);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.internalDecodeJ2KTile = function(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, tileIndex, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel) {
+                return globalThis.commonDecodeJ2K('decodeTileToBmp', encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, [tileIndex, reduceLevel || 0], base64DecodeTime, inputTransferDelayMs, chunkedOutput);
+            };
+
+            globalThis.decodeJ2KTile = function(dataEncodedString, maxPixels, maxHeapSize, colorFormat, measureTimes, tileIndex, kotlinStartTime, chunkedOutput, reduceLevel) {
+                try {
+                    const jsStartTime = Date.now();
+                    const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
+                    const now = function() {
+                        return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
+                    };
+                    const decodeFn = globalThis.decodeInputPayload;
+                    const b64Start = measureTimes ? now() : 0;
+                    const encodedBuffer = decodeFn(dataEncodedString);
+                    const base64DecodeTime = measureTimes ? now() - b64Start : 0;
+                    return globalThis.internalDecodeJ2KTile(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, tileIndex, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.decodeJ2KTileFromChunks = function(maxPixels, maxHeapSize, colorFormat, measureTimes, tileIndex, kotlinStartTime, chunkedOutput, reduceLevel) {
+                try {
+                    const jsStartTime = Date.now();
+                    const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
+                    const now = function() {
+                        return (typeof performance !== 'undefined' && performance.now) ? performance.now() : Date.now();
+                    };
+                    const decodeFn = globalThis.decodeInputPayload;
+                    const joined = globalThis.consumeInputChunks();
+                    const b64Start = measureTimes ? now() : 0;
+                    const encodedBuffer = decodeFn(joined);
+                    const base64DecodeTime = measureTimes ? now() - b64Start : 0;
+                    return globalThis.internalDecodeJ2KTile(encodedBuffer, maxPixels, maxHeapSize, colorFormat, measureTimes, tileIndex, base64DecodeTime, inputTransferDelayMs, chunkedOutput, reduceLevel);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.decodeJ2KTileWithCache = function(maxPixels, maxHeapSize, colorFormat, measureTimes, tileIndex, kotlinStartTime, chunkedOutput, reduceLevel) {
+                if (!globalThis.j2kData) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
+                }
+                const jsStartTime = Date.now();
+                const inputTransferDelayMs = (kotlinStartTime && kotlinStartTime > 0) ? Math.max(0, jsStartTime - kotlinStartTime) : 0;
+                return globalThis.commonDecodeJ2KWithSession('sessionDecodeTileToBmp', maxPixels, maxHeapSize, colorFormat, measureTimes, [tileIndex, reduceLevel || 0], inputTransferDelayMs, chunkedOutput);
+            };
+          """
+
+internal val SCRIPT_DEFINE_IMAGE_INFO = """
+            // Layout of the getImageInfo struct in wrapper.c: 17 uint32 fields (the first 10 as in
+            // getTileInfo), followed by precision, signed, dx and dy of every component
+            globalThis.readImageInfo = function(resultPtr) {
+                const view = new DataView(wasmInstance.exports.memory.buffer);
+                const result = globalThis.readTileInfo(resultPtr);
+                result.numResolutions = view.getUint32(resultPtr + 40, true);
+                result.numLayers = view.getUint32(resultPtr + 44, true);
+                result.progressionOrder = view.getInt32(resultPtr + 48, true);
+                result.codeBlockWidth = view.getUint32(resultPtr + 52, true);
+                result.codeBlockHeight = view.getUint32(resultPtr + 56, true);
+                const markers = view.getUint32(resultPtr + 60, true);
+                result.hasTlm = (markers & 1) !== 0;
+                result.hasPlt = (markers & 2) !== 0;
+                const numComponents = view.getUint32(resultPtr + 64, true);
+                result.components = [];
+                for (let i = 0; i < numComponents; i++) {
+                    const componentPtr = resultPtr + 68 + i * 16;
+                    result.components.push({
+                        precision: view.getUint32(componentPtr, true),
+                        signed: view.getUint32(componentPtr + 4, true) !== 0,
+                        dx: view.getUint32(componentPtr + 8, true),
+                        dy: view.getUint32(componentPtr + 12, true)
+                    });
+                }
+                return result;
+            };
+
+            globalThis.internalGetImageInfo = function(encodedBuffer) {
+                try {
+                    const exports = wasmInstance.exports;
+                    const dataLength = encodedBuffer.length;
+
+                    if (dataLength === 0) return JSON.stringify({ errorCode: -1 });
+
+                    if (dataLength > 4294967296) {
+                        return JSON.stringify({ errorCode: ${Jp2kError.InputDataSize.code}, errorMessage: "Input data size exceeds maximum allowable memory" });
+                    }
+
+                    const inputPtr = exports.acquireInputBuffer(dataLength);
+                    const heap = new Uint8Array(exports.memory.buffer);
+
+                    heap.set(encodedBuffer, inputPtr);
+
+                    const resultPtr = exports.getImageInfo(inputPtr, dataLength);
+
+                    if (resultPtr === 0) {
+                        const errorCode = exports.getLastError();
+                        exports.releaseBuffer(inputPtr);
+                        return JSON.stringify({ errorCode: errorCode });
+                    }
+
+                    const result = globalThis.readImageInfo(resultPtr);
+
+                    exports.free(resultPtr);
+                    exports.releaseBuffer(inputPtr);
+
+                    return JSON.stringify(result);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.getImageInfo = function(dataEncodedString) {
+                try {
+                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const encodedBuffer = decodeFn(dataEncodedString);
+                    return globalThis.internalGetImageInfo(encodedBuffer);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.getImageInfoFromChunks = function() {
+                try {
+                    const decodeFn = globalThis.decodePayload || globalThis.base64ToBytes;
+                    const joined = globalThis.consumeInputChunks();
+                    const encodedBuffer = decodeFn(joined);
+                    return globalThis.internalGetImageInfo(encodedBuffer);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
+            };
+
+            globalThis.getImageInfoWithCache = function() {
+                if (!globalThis.j2kData) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.CacheDataMissing.code}, errorMessage: "No data cached" });
+                }
+                try {
+                    const exports = wasmInstance.exports;
+                    const session = globalThis.acquireJ2KSession();
+                    if (session.errorCode !== undefined) {
+                        return JSON.stringify(session);
+                    }
+
+                    const resultPtr = exports.sessionGetImageInfo(session.handle);
+                    if (resultPtr === 0) {
+                        return JSON.stringify({ errorCode: exports.getLastError() });
+                    }
+
+                    const result = globalThis.readImageInfo(resultPtr);
+                    exports.free(resultPtr);
+
+                    return JSON.stringify(result);
+                } catch (e) {
+                    return JSON.stringify({ errorCode: ${Jp2kError.Unknown.code}, errorMessage: e.toString() });
+                }
             };
           """
 
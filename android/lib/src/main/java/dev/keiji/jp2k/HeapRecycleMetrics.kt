@@ -0,0 +1,19 @@
+package dev.keiji.jp2k
+
+/**
+ * Data class representing the WASM heap recycles of a decoder. See [HeapRecyclePolicy].
+ *
+ * @property recycleCount Number of times the heap was recycled.
+ * @property totalReclaimedBytes Total size in bytes of the WASM heaps handed back by the recycles.
+ * @property lastReclaimedBytes Size in bytes the last recycle handed back: the old heap less the fresh one.
+ * @property lastSwapLatencyMs Time in milliseconds the last recycle held the decoder, from the request
+ * to the swap of the new instance. Requests queued meanwhile were delayed by up to this time.
+ * @property lastTrigger What made the decoder recycle the heap last.
+ */
+data class HeapRecycleMetrics(
+    val recycleCount: Int,
+    val totalReclaimedBytes: Long,
+    val lastReclaimedBytes: Long,
+    val lastSwapLatencyMs: Double,
+    val lastTrigger: HeapRecycleTrigger,
+)
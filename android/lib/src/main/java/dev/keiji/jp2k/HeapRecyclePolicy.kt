@@ -0,0 +1,30 @@
+package dev.keiji.jp2k
+
+import android.content.ComponentCallbacks2
+
+/**
+ * When a decoder recycles its WASM heap.
+ *
+ * The linear memory of a WASM instance only grows: after one large image, the heap keeps its size for
+ * the rest of the session. Recycling instantiates the module again and swaps the new instance in between
+ * two requests, so that the old heap is garbage collected. Precached data is kept, and requests queued
+ * meanwhile wait for the swap instead of failing. A heap that has not grown past the size of a fresh
+ * instance is left alone.
+ *
+ * @property highWaterMarkBytes Recycle after a decode that leaves the WASM heap at this size or larger. 0 to disable.
+ * Defaults to [DEFAULT_HEAP_RECYCLE_HIGH_WATER_MARK_BYTES].
+ * @property idleTimeoutMillis Recycle once the decoder has been idle for this time. 0 to disable.
+ * Defaults to [DEFAULT_HEAP_RECYCLE_IDLE_TIMEOUT_MILLIS].
+ * @property trimMemoryLevel Recycle when the system calls `onTrimMemory` with this level or higher, and on
+ * `onLowMemory`. null to disable. Defaults to [ComponentCallbacks2.TRIM_MEMORY_BACKGROUND].
+ */
+data class HeapRecyclePolicy(
+    val highWaterMarkBytes: Long = DEFAULT_HEAP_RECYCLE_HIGH_WATER_MARK_BYTES,
+    val idleTimeoutMillis: Long = DEFAULT_HEAP_RECYCLE_IDLE_TIMEOUT_MILLIS,
+    val trimMemoryLevel: Int? = ComponentCallbacks2.TRIM_MEMORY_BACKGROUND,
+) {
+    init {
+        require(highWaterMarkBytes >= 0) { "highWaterMarkBytes must be 0 or greater" }
+        require(idleTimeoutMillis >= 0) { "idleTimeoutMillis must be 0 or greater" }
+    }
+}
@@ -0,0 +1,15 @@
+package dev.keiji.jp2k
+
+/**
+ * What made a decoder recycle its WASM heap. See [HeapRecyclePolicy].
+ */
+enum class HeapRecycleTrigger {
+    /** A decode left the heap at [HeapRecyclePolicy.highWaterMarkBytes] or larger. */
+    HighWaterMark,
+
+    /** The decoder was idle for [HeapRecyclePolicy.idleTimeoutMillis]. */
+    Idle,
+
+    /** The system asked the app to trim its memory. */
+    TrimMemory,
+}
@@ -0,0 +1,90 @@
+package dev.keiji.jp2k
+
+import org.json.JSONObject
+
+/**
+ * Data class describing a JPEG 2000 image as stated by its main header.
+ *
+ * It is read without decoding, so that a caller can pick the cheapest reduce level, region or tile
+ * before paying for a decode. For example, a codestream with [hasTlm] and many tiles is cheap to
+ * decode tile by tile, and [numResolutions] bounds the reduce level.
+ *
+ * @property tileInfo The image area and the tile grid.
+ * @property components The components of the image, in codestream order.
+ * @property numResolutions The number of resolution levels. The largest reduce level is one less.
+ * @property numQualityLayers The number of quality layers.
+ * @property progressionOrder The default packet order of the codestream.
+ * @property codeBlockWidth The nominal code-block width of the first component in samples.
+ * @property codeBlockHeight The nominal code-block height of the first component in samples.
+ * @property hasTlm Whether the main header has TLM markers, which locate the tile-parts without reading them.
+ * @property hasPlt Whether the tile-part headers have PLT markers, which locate the packets without reading them.
+ */
+data class ImageInfo(
+    val tileInfo: TileInfo,
+    val components: List<ComponentInfo>,
+    val numResolutions: Int,
+    val numQualityLayers: Int,
+    val progressionOrder: ProgressionOrder,
+    val codeBlockWidth: Int,
+    val codeBlockHeight: Int,
+    val hasTlm: Boolean,
+    val hasPlt: Boolean,
+) {
+    /**
+     * The width of the image.
+     */
+    val width: Int
+        get() = tileInfo.imageX1 - tileInfo.imageX0
+
+    /**
+     * The height of the image.
+     */
+    val height: Int
+        get() = tileInfo.imageY1 - tileInfo.imageY0
+
+    /**
+     * The number of components.
+     */
+    val numComponents: Int
+        get() = components.size
+
+    /**
+     * The largest reduce level that can be decoded.
+     */
+    val maxReduceLevel: Int
+        get() = (numResolutions - 1).coerceAtLeast(0)
+}
+
+internal fun parseImageInfo(root: JSONObject): ImageInfo {
+    val components = root.getJSONArray("components")
+    return ImageInfo(
+        tileInfo = TileInfo(
+            imageX0 = root.getInt("imageX0"),
+            imageY0 = root.getInt("imageY0"),
+            imageX1 = root.getInt("imageX1"),
+            imageY1 = root.getInt("imageY1"),
+            tileX0 = root.getInt("tileX0"),
+            tileY0 = root.getInt("tileY0"),
+            tileWidth = root.getInt("tileWidth"),
+            tileHeight = root.getInt("tileHeight"),
+            numTilesX = root.getInt("numTilesX"),
+            numTilesY = root.getInt("numTilesY"),
+        ),
+        components = List(components.length()) { i ->
+            val component = components.getJSONObject(i)
+            ComponentInfo(
+                precision = component.getInt("precision"),
+                isSigned = component.getBoolean("signed"),
+                subsamplingX = component.getInt("dx"),
+                subsamplingY = component.getInt("dy"),
+            )
+        },
+        numResolutions = root.getInt("numResolutions"),
+        numQualityLayers = root.getInt("numLayers"),
+        progressionOrder = ProgressionOrder.fromInt(root.getInt("progressionOrder")),
+        codeBlockWidth = root.getInt("codeBlockWidth"),
+        codeBlockHeight = root.getInt("codeBlockHeight"),
+        hasTlm = root.getBoolean("hasTlm"),
+        hasPlt = root.getBoolean("hasPlt"),
+    )
+}
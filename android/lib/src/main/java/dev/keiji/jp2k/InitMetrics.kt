@@ -0,0 +1,22 @@
+package dev.keiji.jp2k
+
+/**
+ * Data class representing the cold start cost of a decoder.
+ *
+ * @property sandboxConnectTimeMs Time spent waiting for the [androidx.javascriptengine.JavaScriptSandbox] connection in milliseconds.
+ * @property wasmLoadTimeMs Time spent reading the WebAssembly module from the assets in milliseconds.
+ * 0 when the module was already cached by [Jp2kSandbox.prewarm] or an earlier decoder.
+ * @property wasmInstantiateTimeMs Time spent transferring, compiling and instantiating the WebAssembly module in milliseconds.
+ * @property initTimeMs Total time taken by `init()` in milliseconds.
+ * @property isWasmCached `true` if the WebAssembly module binary was served from the process-wide cache.
+ * @property timeToFirstDecodeMs Time from the start of `init()` to the completion of the first successful decode
+ * in milliseconds, or `null` until then.
+ */
+data class InitMetrics(
+    val sandboxConnectTimeMs: Long,
+    val wasmLoadTimeMs: Long,
+    val wasmInstantiateTimeMs: Long,
+    val initTimeMs: Long,
+    val isWasmCached: Boolean,
+    val timeToFirstDecodeMs: Long? = null,
+)
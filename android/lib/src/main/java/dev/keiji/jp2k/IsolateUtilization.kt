@@ -0,0 +1,22 @@
+package dev.keiji.jp2k
+
+/**
+ * Data class representing the utilization of one decoder (isolate) of a [Jp2kDecoderPool].
+ *
+ * @property activeRequests The number of requests dispatched to the decoder that have not completed yet.
+ * @property completedRequests The number of requests the decoder has completed, successfully or not.
+ * @property busyTimeMs The time the decoder spent on completed requests in milliseconds.
+ * @property lifetimeMs The time since the decoder was added to the pool in milliseconds.
+ */
+data class IsolateUtilization(
+    val activeRequests: Int,
+    val completedRequests: Long,
+    val busyTimeMs: Long,
+    val lifetimeMs: Long,
+) {
+    /**
+     * The fraction of its lifetime the decoder spent on completed requests, from 0.0 to 1.0.
+     */
+    val utilization: Double
+        get() = if (lifetimeMs > 0) minOf(1.0, busyTimeMs.toDouble() / lifetimeMs) else 0.0
+}
@@ -0,0 +1,140 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+
+/**
+ * Pool of mutable [Bitmap]s the decoders draw their output Bitmaps from.
+ *
+ * Bitmaps are bucketed by width, height and config, and a Bitmap is only handed out for the exact size
+ * it was created with, so the decoded pixels fill it completely. Set the pool to [Config.bitmapPool] and
+ * hand each Bitmap back with [put] once it is no longer displayed; a viewer that decodes tiles of the
+ * same size then stops allocating a Bitmap per frame.
+ *
+ * When the pooled Bitmaps exceed [maxSizeBytes], the Bitmaps of the least recently used bucket are
+ * recycled first. The pool is thread-safe and can be shared by several decoders.
+ *
+ * @param maxSizeBytes The maximum total size of the pooled Bitmaps in bytes. Defaults to
+ * [DEFAULT_BITMAP_POOL_MAX_SIZE_BYTES].
+ */
+class Jp2kBitmapPool(
+    val maxSizeBytes: Long = DEFAULT_BITMAP_POOL_MAX_SIZE_BYTES,
+) {
+
+    init {
+        require(maxSizeBytes >= 0) { "maxSizeBytes must be 0 or greater" }
+    }
+
+    private data class Key(val width: Int, val height: Int, val config: Bitmap.Config)
+
+    private val lock = Any()
+
+    // Access order, so that the first bucket is the least recently used one
+    private val buckets = LinkedHashMap<Key, ArrayDeque<Bitmap>>(16, 0.75f, true)
+
+    private var _sizeBytes = 0L
+    private var _hitCount = 0L
+    private var _missCount = 0L
+    private var _evictionCount = 0L
+
+    /**
+     * The total size of the pooled Bitmaps in bytes.
+     */
+    val sizeBytes: Long
+        get() = synchronized(lock) { _sizeBytes }
+
+    /**
+     * The number of [get] calls served with a pooled Bitmap.
+     */
+    val hitCount: Long
+        get() = synchronized(lock) { _hitCount }
+
+    /**
+     * The number of [get] calls that had to allocate a new Bitmap.
+     */
+    val missCount: Long
+        get() = synchronized(lock) { _missCount }
+
+    /**
+     * The number of pooled Bitmaps recycled to stay within [maxSizeBytes].
+     */
+    val evictionCount: Long
+        get() = synchronized(lock) { _evictionCount }
+
+    /**
+     * Returns a mutable Bitmap of exactly [width] x [height] in [config], taken from the pool if one is
+     * available and allocated otherwise. The content of a pooled Bitmap is undefined.
+     */
+    fun get(width: Int, height: Int, config: Bitmap.Config): Bitmap {
+        val pooled = synchronized(lock) {
+            val key = Key(width, height, config)
+            val bucket = buckets[key]
+            val bitmap = bucket?.removeLastOrNull()
+            if (bucket != null && bucket.isEmpty()) {
+                buckets.remove(key)
+            }
+            if (bitmap != null) {
+                _sizeBytes -= bitmap.allocationByteCount
+                _hitCount++
+            } else {
+                _missCount++
+            }
+            bitmap
+        }
+        if (pooled != null) {
+            // The previous owner may have changed these
+            pooled.setHasAlpha(config != Bitmap.Config.RGB_565)
+            pooled.isPremultiplied = true
+            return pooled
+        }
+        return Bitmap.createBitmap(width, height, config)
+    }
+
+    /**
+     * Hands [bitmap] back to the pool. The caller must not use it afterwards.
+     *
+     * Immutable and recycled Bitmaps are not pooled, and a Bitmap larger than [maxSizeBytes] is
+     * recycled right away.
+     */
+    fun put(bitmap: Bitmap) {
+        if (bitmap.isRecycled || !bitmap.isMutable) {
+            return
+        }
+        val config = bitmap.config ?: return
+        val evicted = mutableListOf<Bitmap>()
+        synchronized(lock) {
+            buckets.getOrPut(Key(bitmap.width, bitmap.height, config)) { ArrayDeque() }.addLast(bitmap)
+            _sizeBytes += bitmap.allocationByteCount
+            trimTo(maxSizeBytes, evicted)
+        }
+        evicted.forEach { it.recycle() }
+    }
+
+    /**
+     * Recycles all pooled Bitmaps. The counters are kept.
+     */
+    fun clear() {
+        val evicted = mutableListOf<Bitmap>()
+        synchronized(lock) {
+            buckets.values.forEach { evicted.addAll(it) }
+            buckets.clear()
+            _sizeBytes = 0
+        }
+        evicted.forEach { it.recycle() }
+    }
+
+    private fun trimTo(sizeBytes: Long, evicted: MutableList<Bitmap>) {
+        val iterator = buckets.values.iterator()
+        while (_sizeBytes > sizeBytes && iterator.hasNext()) {
+            val bucket = iterator.next()
+            while (_sizeBytes > sizeBytes && bucket.isNotEmpty()) {
+                val bitmap = bucket.removeFirst()
+                _sizeBytes -= bitmap.allocationByteCount
+                _evictionCount++
+                evicted.add(bitmap)
+            }
+            if (bucket.isEmpty()) {
+                iterator.remove()
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+package dev.keiji.jp2k
+
+import kotlin.coroutines.AbstractCoroutineContextElement
+import kotlin.coroutines.CoroutineContext
+
+/**
+ * Deadline of the [Jp2kDecoder] decodes run in a coroutine context holding this element.
+ *
+ * Overrides [Config.decodeTimeoutMillis] for a single request:
+ *
+ * ```
+ * val bitmap = withContext(Jp2kDeadline(500)) {
+ *     decoder.decodeImage(j2kData)
+ * }
+ * ```
+ *
+ * A decode that does not finish in time fails with a [Jp2kException] of [Jp2kError.DeadlineExceeded].
+ *
+ * @param timeoutMillis The time in milliseconds each decode may run. 0 for no deadline.
+ */
+class Jp2kDeadline(
+    val timeoutMillis: Long,
+) : AbstractCoroutineContextElement(Key) {
+
+    init {
+        require(timeoutMillis >= 0) { "timeoutMillis must be 0 or greater" }
+    }
+
+    companion object Key : CoroutineContext.Key<Jp2kDeadline>
+}
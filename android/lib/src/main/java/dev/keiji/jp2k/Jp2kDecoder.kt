@@ -1,9 +1,10 @@
 package dev.keiji.jp2k
 
+import android.content.ComponentCallbacks2
 import android.content.Context
+import android.content.res.Configuration
 import android.content.res.AssetManager
 import android.graphics.Bitmap
-import android.graphics.BitmapFactory
 import android.graphics.Rect
 import android.graphics.RectF
 import android.util.Log
@@ -12,11 +13,23 @@ import androidx.javascriptengine.JavaScriptIsolate
 import androidx.javascriptengine.JavaScriptSandbox
 import com.google.common.util.concurrent.ListenableFuture
 import dev.keiji.jp2k.datachannel.Base64DataChannel
+import dev.keiji.jp2k.datachannel.ChunkDecoder
 import dev.keiji.jp2k.datachannel.JSDataChannel
+import dev.keiji.jp2k.datachannel.alignChunkSize
 import dev.keiji.jp2k.datachannel.createDataChannel
 import dev.keiji.jp2k.datachannel.escapeJs
 import kotlinx.coroutines.CoroutineDispatcher
+import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.cancel
+import kotlinx.coroutines.currentCoroutineContext
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.emitAll
+import kotlinx.coroutines.flow.flow
+import kotlinx.coroutines.launch
 import kotlinx.coroutines.suspendCancellableCoroutine
 import kotlinx.coroutines.sync.Mutex
 import kotlin.coroutines.resume
@@ -64,6 +77,54 @@ class Jp2kDecoder(
 
     private var isEvaluateWithoutTransactionLimitSupported: Boolean = true
 
+    @Volatile
+    private var _initMetrics: InitMetrics? = null
+
+    private var initStartTimeMs: Long = 0
+
+    // Identity of the precached image in config.regionCache, or null if nothing is precached
+    @Volatile
+    private var precachedInputKey: String? = null
+
+    // Set when the sandbox may hold a deadline or a decode left by the previous request, which
+    // beginRequest() clears or waits for before the next one. Guarded by mutex.
+    private var requestArmed = false
+
+    /**
+     * The cold start cost of this decoder, or `null` until [init] completes.
+     *
+     * [InitMetrics.timeToFirstDecodeMs] is filled in when the first decode succeeds.
+     */
+    val initMetrics: InitMetrics?
+        get() = _initMetrics
+
+    @Volatile
+    private var _lastPerformanceMetrics: PerformanceMetrics? = null
+
+    /**
+     * Metrics of the last decode, including the per-stage statistics of the WASM module. Recorded only while [Config.logLevel] is set.
+     */
+    val lastPerformanceMetrics: PerformanceMetrics?
+        get() = _lastPerformanceMetrics
+
+    // Runs the heap recycles of config.heapRecyclePolicy, which wait for the requests queued before them
+    private val recycleScope = CoroutineScope(SupervisorJob() + coroutineDispatcher)
+
+    // Pending recycle of HeapRecycleTrigger.Idle, restarted by each decode. Guarded by mutex.
+    private var idleRecycleJob: Job? = null
+
+    // Registered in init() when HeapRecyclePolicy.trimMemoryLevel is set
+    private var trimMemoryCallbacks: Pair<Context, ComponentCallbacks2>? = null
+
+    @Volatile
+    private var _heapRecycleMetrics: HeapRecycleMetrics? = null
+
+    /**
+     * The WASM heap recycles of this decoder, or `null` until the first one. See [Config.heapRecyclePolicy].
+     */
+    val heapRecycleMetrics: HeapRecycleMetrics?
+        get() = _heapRecycleMetrics
+
     private inline fun log(priority: Int, message: () -> String) {
         if (config.logLevel != null && priority >= config.logLevel) {
             val msg = message().trimLines(config.maxLogLines)
@@ -96,6 +157,7 @@ class Jp2kDecoder(
         val start = System.currentTimeMillis()
         try {
             val sandbox = sandboxFuture.await()
+            val sandboxConnectTimeMs = System.currentTimeMillis() - start
             isEvaluateWithoutTransactionLimitSupported =
                 JavaScriptEngineEnvironment.isFeatureSupported(sandbox, JavaScriptSandbox.JS_FEATURE_EVALUATE_WITHOUT_TRANSACTION_LIMIT)
             dataChannel = createDataChannel(sandbox, config.preferDirectBinaryTransfer)
@@ -117,15 +179,19 @@ class Jp2kDecoder(
             }
             jsIsolate = isolate
 
-            loadWasm(isolate, assetManager)
+            val wasmMetrics = loadWasm(isolate, assetManager)
 
             if (_state == State.Released || _state == State.Releasing) {
                 throw CancellationException("Jp2kDecoder was released during initialization.")
             }
             _state = State.Initialized
+            registerTrimMemoryCallbacks(context)
 
             val time = System.currentTimeMillis() - start
+            initStartTimeMs = start
+            _initMetrics = wasmMetrics.copy(sandboxConnectTimeMs = sandboxConnectTimeMs, initTimeMs = time)
             log(Log.INFO) { "init() finished in $time msec" }
+            log(Log.INFO) { "Init metrics: $_initMetrics" }
         } catch (e: Exception) {
             if (_state != State.Released && _state != State.Releasing) {
                 _state = State.Uninitialized
@@ -136,10 +202,12 @@ class Jp2kDecoder(
         }
     }
 
-    private suspend fun loadWasm(isolate: JavaScriptIsolate, assetManager: AssetManager) {
-        withContext(coroutineDispatcher) {
-            val wasmBytes = assetManager.open(ASSET_PATH_WASM)
-                .readBytes()
+    private suspend fun loadWasm(isolate: JavaScriptIsolate, assetManager: AssetManager): InitMetrics {
+        return withContext(coroutineDispatcher) {
+            val isWasmCached = WasmModuleCache.isLoaded
+            val loadStart = System.currentTimeMillis()
+            val wasmBytes = WasmModuleCache.get(assetManager)
+            val wasmLoadTimeMs = System.currentTimeMillis() - loadStart
             log(Log.INFO) { "DataChannel: ${dataChannel.name}" }
             log(Log.INFO) { "Input binary length: ${wasmBytes.size}" }
 
@@ -172,20 +240,35 @@ class Jp2kDecoder(
             }
 
             // Stage 2: Transmit WASM binary and instantiate the WebAssembly module.
+            val instantiateStart = System.currentTimeMillis()
             val wasmExpression = dataChannel.getWasmExpression(isolate, wasmBytes)
             log(Log.INFO) { "WASM expression: $wasmExpression" }
 
             val instantiateScript = """
                 var wasmInstance;
+                var wasmModule;
 
                 (async () => {
                     const wasmBuffer = await $wasmExpression;
 
                     const res = await WebAssembly.instantiate(wasmBuffer, importObject);
                     wasmInstance = res.instance;
+                    wasmModule = res.module;
+                    globalThis.initialWasmHeapBytes = wasmInstance.exports.memory.buffer.byteLength;
 
                     $SCRIPT_DEFINE_DECODE_J2K_LOCAL
                     $SCRIPT_DEFINE_GET_SIZE_LOCAL
+                    $SCRIPT_DEFINE_TILE_LOCAL
+                    $SCRIPT_DEFINE_IMAGE_INFO_LOCAL
+
+                    // Also applied to the instances swapped in by globalThis.recycleWasmInstance.
+                    globalThis.configureWasmInstance = function() {
+                        globalThis.setDecodeThreads(${config.decodeThreads});
+                        globalThis.setOutputFormat(${if (config.rawPixelOutput) OUTPUT_FORMAT_RAW else OUTPUT_FORMAT_BMP});
+                        wasmInstance.exports.setScratchArena(1);
+                        wasmInstance.exports.setTileStreaming(1);
+                    };
+                    globalThis.configureWasmInstance();
 
                     return "$INTERNAL_RESULT_SUCCESS";
                 })();
@@ -201,7 +284,25 @@ class Jp2kDecoder(
             } catch (e: ExecutionException) {
                 throw e.cause ?: e
             }
+
+            InitMetrics(
+                sandboxConnectTimeMs = 0,
+                wasmLoadTimeMs = wasmLoadTimeMs,
+                wasmInstantiateTimeMs = System.currentTimeMillis() - instantiateStart,
+                initTimeMs = 0,
+                isWasmCached = isWasmCached,
+            )
+        }
+    }
+
+    private fun recordFirstDecode() {
+        val metrics = _initMetrics ?: return
+        if (metrics.timeToFirstDecodeMs != null) {
+            return
         }
+        val timeToFirstDecodeMs = System.currentTimeMillis() - initStartTimeMs
+        _initMetrics = metrics.copy(timeToFirstDecodeMs = timeToFirstDecodeMs)
+        log(Log.INFO) { "Time to first decode: $timeToFirstDecodeMs msec" }
     }
 
     private fun validateInputSize(size: Int) {
@@ -216,13 +317,18 @@ class Jp2kDecoder(
 
     private suspend fun transferInputInChunks(isolate: JavaScriptIsolate, encoded: String) {
         isolate.evaluateJavaScriptAsync("globalThis.clearInputChunks();").await()
-        var offset = 0
-        while (offset < encoded.length) {
-            val end = minOf(offset + config.binderTransactionMaxChunkSizeBytes, encoded.length)
-            val chunk = encoded.substring(offset, end).escapeJs()
-            isolate.evaluateJavaScriptAsync("globalThis.appendInputChunk('$chunk');").await()
-            offset = end
-        }
+        val chunkSize = config.binderTransactionMaxChunkSizeBytes
+        pipelineChunks(
+            count = chunkCount(encoded.length, chunkSize),
+            window = config.chunkTransferWindow,
+            evaluate = { index ->
+                val start = index * chunkSize
+                val chunk = encoded.substring(start, minOf(start + chunkSize, encoded.length)).escapeJs()
+                isolate.evaluateJavaScriptAsync("globalThis.appendInputChunk('$chunk', $index);")
+            },
+            await = { it.await() },
+            onResult = { _, _ -> },
+        )
     }
 
     /**
@@ -231,10 +337,15 @@ class Jp2kDecoder(
      * This method must be called after [init]. It caches the provided image data
      * in the sandbox, allowing [getSize] and [decodeImage] to be called without arguments.
      *
+     * Decodes of a single-tile image reuse its parsed main header. A multi-tile image is parsed again
+     * on every decode, so precaching it only saves transferring the data.
+     *
      * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param cacheKey The identity of the image in [Config.regionCache], for example its file name. If
+     * null, a hash of [j2kData] is used. Defaults to null.
      * @throws Exception If precaching fails.
      */
-    suspend fun precache(j2kData: ByteArray) = mutex.withLock {
+    suspend fun precache(j2kData: ByteArray, cacheKey: String? = null) = mutex.withLock {
         if (_state == State.Released || _state == State.Releasing) {
             throw CancellationException("Decoder was released.")
         }
@@ -243,6 +354,7 @@ class Jp2kDecoder(
         }
         validateInputSize(j2kData.size)
         _state = State.Processing
+        precachedInputKey = null
 
         try {
             val isolate = checkNotNull(jsIsolate) { "Jp2kDecoder has not been initialized." }
@@ -275,6 +387,9 @@ class Jp2kDecoder(
                     throw IllegalStateException("Failed to set data: $result")
                 }
             }
+            if (config.regionCache != null) {
+                precachedInputKey = cacheKey ?: Jp2kRegionCache.keyOf(j2kData)
+            }
         } catch (e: Exception) {
             log(Log.ERROR) { "precache() failed. Error: ${e.message}" }
             throw e
@@ -283,6 +398,52 @@ class Jp2kDecoder(
         }
     }
 
+    /**
+     * Clears the image data cached by [precache].
+     *
+     * The decode session kept for the cached data is closed as well, releasing its memory
+     * in the sandbox.
+     *
+     * @throws Exception If clearing fails.
+     */
+    suspend fun clearCache() = mutex.withLock {
+        if (_state == State.Released || _state == State.Releasing) {
+            throw CancellationException("Decoder was released.")
+        }
+        if (_state != State.Initialized) {
+            throw IllegalStateException("Cannot clear cache while in state: $_state")
+        }
+        _state = State.Processing
+        precachedInputKey = null
+
+        try {
+            val isolate = checkNotNull(jsIsolate) { "Jp2kDecoder has not been initialized." }
+            withContext(coroutineDispatcher) {
+                val result = isolate.evaluateJavaScriptAsync("globalThis.clearData();").await()
+
+                if (result != INTERNAL_RESULT_SUCCESS) {
+                    ensureNotEmpty(result, "Success indicator or JSON error")
+
+                    val root = JSONObject(result)
+                    if (root.has("errorCode")) {
+                        val errorCode = root.getInt("errorCode")
+                        val error = Jp2kError.fromInt(errorCode)
+                        val errorMessage =
+                            if (root.has("errorMessage")) root.getString("errorMessage") else null
+                        log(Log.ERROR) { "Error: $error, Message: $errorMessage" }
+                        throw Jp2kException(error, errorMessage)
+                    }
+                    throw IllegalStateException("Failed to clear data: $result")
+                }
+            }
+        } catch (e: Exception) {
+            log(Log.ERROR) { "clearCache() failed. Error: ${e.message}" }
+            throw e
+        } finally {
+            restoreStateAfterDecode()
+        }
+    }
+
     /**
      * Retrieves the size of the JPEG 2000 image without fully decoding it.
      *
@@ -316,14 +477,99 @@ class Jp2kDecoder(
         }
     }
 
+    /**
+     * Retrieves the tile grid of the JPEG 2000 image without decoding it.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @return The [TileInfo] of the image.
+     */
+    suspend fun getTileInfo(j2kData: ByteArray): TileInfo {
+        validateInputSize(j2kData.size)
+        logInputDataInfo(j2kData)
+        val encoded = dataChannel.encodePayload(j2kData)
+        logEncodedInputInfo(encoded)
+
+        return executeHeaderQuery("getTileInfo", ::parseTileInfo) { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync("globalThis.getTileInfoFromChunks();").await()
+            } else {
+                isolate.evaluateJavaScriptAsync("globalThis.getTileInfo('$encoded');").await()
+            }
+        }
+    }
+
+    /**
+     * Retrieves the tile grid of the JPEG 2000 image using cached data.
+     *
+     * @return The [TileInfo] of the image.
+     */
+    suspend fun getTileInfo(): TileInfo {
+        return executeHeaderQuery("getTileInfo", ::parseTileInfo) { isolate ->
+            isolate.evaluateJavaScriptAsync("globalThis.getTileInfoWithCache();").await()
+        }
+    }
+
+    /**
+     * Retrieves the coding parameters of the JPEG 2000 image from its main header without decoding it.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @return The [ImageInfo] of the image.
+     */
+    suspend fun getImageInfo(j2kData: ByteArray): ImageInfo {
+        validateInputSize(j2kData.size)
+        logInputDataInfo(j2kData)
+        val encoded = dataChannel.encodePayload(j2kData)
+        logEncodedInputInfo(encoded)
+
+        return executeHeaderQuery("getImageInfo", ::parseImageInfo) { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync("globalThis.getImageInfoFromChunks();").await()
+            } else {
+                isolate.evaluateJavaScriptAsync("globalThis.getImageInfo('$encoded');").await()
+            }
+        }
+    }
+
+    /**
+     * Retrieves the coding parameters of the JPEG 2000 image using cached data.
+     *
+     * @return The [ImageInfo] of the image.
+     */
+    suspend fun getImageInfo(): ImageInfo {
+        return executeHeaderQuery("getImageInfo", ::parseImageInfo) { isolate ->
+            isolate.evaluateJavaScriptAsync("globalThis.getImageInfoWithCache();").await()
+        }
+    }
+
     private suspend fun executeGetSize(
         evaluate: suspend (JavaScriptIsolate) -> String,
-    ): Size = mutex.withLock {
+    ): Size = executeHeaderQuery("getSize", { root -> Size(root.getInt("width"), root.getInt("height")) }, evaluate)
+
+    private fun parseTileInfo(root: JSONObject): TileInfo = TileInfo(
+        imageX0 = root.getInt("imageX0"),
+        imageY0 = root.getInt("imageY0"),
+        imageX1 = root.getInt("imageX1"),
+        imageY1 = root.getInt("imageY1"),
+        tileX0 = root.getInt("tileX0"),
+        tileY0 = root.getInt("tileY0"),
+        tileWidth = root.getInt("tileWidth"),
+        tileHeight = root.getInt("tileHeight"),
+        numTilesX = root.getInt("numTilesX"),
+        numTilesY = root.getInt("numTilesY"),
+    )
+
+    private suspend fun <T> executeHeaderQuery(
+        operation: String,
+        parse: (JSONObject) -> T,
+        evaluate: suspend (JavaScriptIsolate) -> String,
+    ): T = mutex.withLock {
         if (_state == State.Released || _state == State.Releasing) {
             throw CancellationException("Decoder was released.")
         }
         if (_state != State.Initialized) {
-            throw IllegalStateException("Cannot getSize while in state: $_state")
+            throw IllegalStateException("Cannot $operation while in state: $_state")
         }
         _state = State.Processing
 
@@ -346,9 +592,7 @@ class Jp2kDecoder(
                     throw Jp2kException(error, errorMessage)
                 }
 
-                val width = root.getInt("width")
-                val height = root.getInt("height")
-                Size(width, height)
+                parse(root)
             }
 
             restoreStateAfterDecode()
@@ -379,12 +623,14 @@ class Jp2kDecoder(
      *
      * @param j2kData The raw byte array of the JPEG 2000 image.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
         j2kData: ByteArray,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
-    ): Bitmap = decodeImage(j2kData, 0, 0, 0, 0, colorFormat)
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeImage(j2kData, 0, 0, 0, 0, colorFormat, reduceLevel)
 
     /**
      * Decodes a specific region of a JPEG 2000 image.
@@ -395,6 +641,7 @@ class Jp2kDecoder(
      * @param right The right coordinate of the region.
      * @param bottom The bottom coordinate of the region.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
@@ -404,47 +651,159 @@ class Jp2kDecoder(
         right: Int,
         bottom: Int,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeRegion(j2kData, left, top, right, bottom, colorFormat, reduceLevel, null)
+
+    /**
+     * Decodes a JPEG 2000 image into [bitmap] instead of allocating a new [Bitmap].
+     *
+     * The image is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded image at [reduceLevel].
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return [bitmap], holding the decoded image.
+     * @throws IllegalArgumentException If [bitmap] cannot hold the decoded image.
+     */
+    suspend fun decodeImageInto(
+        j2kData: ByteArray,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeImageInto(j2kData, 0, 0, 0, 0, bitmap, reduceLevel)
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image into [bitmap] instead of allocating a new [Bitmap].
+     *
+     * The region is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded region at [reduceLevel].
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param left The left coordinate of the region.
+     * @param top The top coordinate of the region.
+     * @param right The right coordinate of the region.
+     * @param bottom The bottom coordinate of the region.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return [bitmap], holding the decoded region.
+     * @throws IllegalArgumentException If [bitmap] cannot hold the decoded region.
+     */
+    suspend fun decodeImageInto(
+        j2kData: ByteArray,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeRegion(j2kData, left, top, right, bottom, colorFormatOf(bitmap), reduceLevel, bitmap)
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image into [bitmap] instead of allocating a new [Bitmap].
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param region The region to decode.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return [bitmap], holding the decoded region.
+     * @throws IllegalArgumentException If [bitmap] cannot hold the decoded region.
+     */
+    suspend fun decodeImageInto(
+        j2kData: ByteArray,
+        region: Rect,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeImageInto(j2kData, region.left, region.top, region.right, region.bottom, bitmap, reduceLevel)
+
+    private suspend fun decodeRegion(
+        j2kData: ByteArray,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        target: Bitmap?,
     ): Bitmap {
         if (j2kData.size < MIN_INPUT_SIZE) {
             throw IllegalArgumentException("Input data is too short")
         }
         validateInputSize(j2kData.size)
-        logInputDataInfo(j2kData)
+        validateReduceLevel(reduceLevel)
 
-        val measureTimes = config.logLevel != null
-        val encoded = dataChannel.encodePayload(j2kData)
-        logEncodedInputInfo(encoded)
+        val inputKey = if (config.regionCache != null && target == null) Jp2kRegionCache.keyOf(j2kData) else null
+        return withRegionCache(inputKey, left, top, right, bottom, colorFormat, reduceLevel) {
+            logInputDataInfo(j2kData)
 
-        val kotlinStartTime = System.currentTimeMillis()
-        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+            val measureTimes = config.logLevel != null
+            val encoded = dataChannel.encodePayload(j2kData)
+            logEncodedInputInfo(encoded)
 
-        return executeDecodeImage(colorFormat, j2kData.size.toLong()) { isolate ->
-            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
-                transferInputInChunks(isolate, encoded)
-                isolate.evaluateJavaScriptAsync(
-                    "globalThis.decodeJ2KFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
-                ).await()
-            } else {
-                val script = "globalThis.decodeJ2K('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
-                isolate.evaluateJavaScriptAsync(script).await()
+            val kotlinStartTime = System.currentTimeMillis()
+            val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+
+            executeDecodeImage(colorFormat, j2kData.size.toLong(), target) { isolate ->
+                if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                    transferInputInChunks(isolate, encoded)
+                    isolate.evaluateJavaScriptAsync(
+                        "globalThis.decodeJ2KFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+                    ).await()
+                } else {
+                    val script = "globalThis.decodeJ2K('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+                    isolate.evaluateJavaScriptAsync(script).await()
+                }
             }
         }
     }
 
+    /**
+     * Serves the region from [Config.regionCache] if it holds it, and otherwise caches what [decode]
+     * returns under the key [decodedKey] returns, the identity of the image [decode] read. Without a
+     * cache or an [inputKey], the region is always decoded.
+     */
+    private suspend inline fun withRegionCache(
+        inputKey: String?,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        decodedKey: () -> String? = { inputKey },
+        decode: () -> Bitmap,
+    ): Bitmap {
+        val cache = config.regionCache
+        if (cache == null || inputKey == null) {
+            return decode()
+        }
+        if (_state == State.Released || _state == State.Releasing) {
+            throw CancellationException("Decoder was released.")
+        }
+        cache.get(inputKey, left, top, right, bottom, colorFormat, reduceLevel)?.let { bitmap ->
+            log(Log.INFO) { "Region cache hit: ($left, $top, $right, $bottom) reduceLevel=$reduceLevel, hit rate ${"%.2f".format(cache.hitRate)}" }
+            return bitmap
+        }
+        return decode().also { bitmap ->
+            decodedKey()?.let { key -> cache.put(key, left, top, right, bottom, colorFormat, reduceLevel, bitmap) }
+        }
+    }
+
     /**
      * Decodes a specific region of a JPEG 2000 image.
      *
      * @param j2kData The raw byte array of the JPEG 2000 image.
      * @param region The region to decode.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
         j2kData: ByteArray,
         region: Rect,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
     ): Bitmap {
-        return decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat)
+        return decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel)
     }
 
     /**
@@ -453,14 +812,16 @@ class Jp2kDecoder(
      * @param j2kData The raw byte array of the JPEG 2000 image.
      * @param region The region to decode.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
         j2kData: ByteArray,
         region: RectF,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
     ): Bitmap {
-        return decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat)
+        return decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel)
     }
 
     /**
@@ -472,6 +833,7 @@ class Jp2kDecoder(
      * @param right The right coordinate ratio (0.0 - 1.0).
      * @param bottom The bottom coordinate ratio (0.0 - 1.0).
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
@@ -481,12 +843,14 @@ class Jp2kDecoder(
         right: Float,
         bottom: Float,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
     ): Bitmap {
         if (j2kData.size < MIN_INPUT_SIZE) {
             throw IllegalArgumentException("Input data is too short")
         }
         validateInputSize(j2kData.size)
         validateRatio(left, top, right, bottom)
+        validateReduceLevel(reduceLevel)
 
         logInputDataInfo(j2kData)
 
@@ -501,10 +865,10 @@ class Jp2kDecoder(
             if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
                 transferInputInChunks(isolate, encoded)
                 isolate.evaluateJavaScriptAsync(
-                    "globalThis.decodeJ2KRatioFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+                    "globalThis.decodeJ2KRatioFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
                 ).await()
             } else {
-                val script = "globalThis.decodeJ2KRatio('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+                val script = "globalThis.decodeJ2KRatio('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
                 isolate.evaluateJavaScriptAsync(script).await()
             }
         }
@@ -514,11 +878,13 @@ class Jp2kDecoder(
      * Decodes a JPEG 2000 image using cached data.
      *
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
-    ): Bitmap = decodeImage(0, 0, 0, 0, colorFormat)
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeImage(0, 0, 0, 0, colorFormat, reduceLevel)
 
     /**
      * Decodes a specific region of a JPEG 2000 image using cached data.
@@ -528,6 +894,7 @@ class Jp2kDecoder(
      * @param right The right coordinate of the region.
      * @param bottom The bottom coordinate of the region.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
@@ -536,15 +903,92 @@ class Jp2kDecoder(
         right: Int,
         bottom: Int,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeCachedRegion(left, top, right, bottom, colorFormat, reduceLevel, null)
+
+    /**
+     * Decodes a JPEG 2000 image using cached data into [bitmap] instead of allocating a new [Bitmap].
+     *
+     * The image is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded image at [reduceLevel].
+     *
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return [bitmap], holding the decoded image.
+     * @throws IllegalArgumentException If [bitmap] cannot hold the decoded image.
+     */
+    suspend fun decodeImageInto(
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeImageInto(0, 0, 0, 0, bitmap, reduceLevel)
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image using cached data into [bitmap] instead of
+     * allocating a new [Bitmap].
+     *
+     * The region is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded region at [reduceLevel].
+     *
+     * @param left The left coordinate of the region.
+     * @param top The top coordinate of the region.
+     * @param right The right coordinate of the region.
+     * @param bottom The bottom coordinate of the region.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return [bitmap], holding the decoded region.
+     * @throws IllegalArgumentException If [bitmap] cannot hold the decoded region.
+     */
+    suspend fun decodeImageInto(
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeCachedRegion(left, top, right, bottom, colorFormatOf(bitmap), reduceLevel, bitmap)
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image using cached data into [bitmap] instead of
+     * allocating a new [Bitmap].
+     *
+     * @param region The region to decode.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return [bitmap], holding the decoded region.
+     * @throws IllegalArgumentException If [bitmap] cannot hold the decoded region.
+     */
+    suspend fun decodeImageInto(
+        region: Rect,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = decodeImageInto(region.left, region.top, region.right, region.bottom, bitmap, reduceLevel)
+
+    private suspend fun decodeCachedRegion(
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        target: Bitmap?,
     ): Bitmap {
+        validateReduceLevel(reduceLevel)
+
         val measureTimes = config.logLevel != null
         val kotlinStartTime = System.currentTimeMillis()
         val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
         val script =
-            "globalThis.decodeJ2KWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
-
-        return executeDecodeImage(colorFormat) { isolate ->
-            isolate.evaluateJavaScriptAsync(script).await()
+            "globalThis.decodeJ2KWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+
+        val inputKey = if (target == null) precachedInputKey else null
+        // Read again with the decode, under the mutex precache() writes it under, so that a precache()
+        // that ran while this request waited cannot pair its pixels with the key of the previous image
+        var decodedInputKey: String? = null
+        return withRegionCache(inputKey, left, top, right, bottom, colorFormat, reduceLevel, { decodedInputKey }) {
+            executeDecodeImage(colorFormat, target = target) { isolate ->
+                decodedInputKey = precachedInputKey
+                isolate.evaluateJavaScriptAsync(script).await()
+            }
         }
     }
 
@@ -553,13 +997,15 @@ class Jp2kDecoder(
      *
      * @param region The region to decode.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
         region: Rect,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
     ): Bitmap {
-        return decodeImage(region.left, region.top, region.right, region.bottom, colorFormat)
+        return decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel)
     }
 
     /**
@@ -567,13 +1013,15 @@ class Jp2kDecoder(
      *
      * @param region The region to decode.
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
         region: RectF,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
     ): Bitmap {
-        return decodeImage(region.left, region.top, region.right, region.bottom, colorFormat)
+        return decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel)
     }
 
     /**
@@ -584,6 +1032,7 @@ class Jp2kDecoder(
      * @param right The right coordinate ratio (0.0 - 1.0).
      * @param bottom The bottom coordinate ratio (0.0 - 1.0).
      * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
      * @return The decoded [Bitmap].
      */
     suspend fun decodeImage(
@@ -592,20 +1041,234 @@ class Jp2kDecoder(
         right: Float,
         bottom: Float,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
     ): Bitmap {
         validateRatio(left, top, right, bottom)
+        validateReduceLevel(reduceLevel)
+
+        val measureTimes = config.logLevel != null
+        val kotlinStartTime = System.currentTimeMillis()
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+        val script =
+            "globalThis.decodeJ2KWithCacheRatio(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+
+        return executeDecodeImage(colorFormat) { isolate ->
+            isolate.evaluateJavaScriptAsync(script).await()
+        }
+    }
+
+    /**
+     * Decodes several JPEG 2000 images in one call.
+     *
+     * The images are sent to the sandbox as one packed payload and decoded one after another by a single
+     * script evaluation, which also returns all outputs in one packed payload. The cost of a sandbox round
+     * trip is paid once per batch instead of once per image, which matters for many small images such
+     * as thumbnails. Keep batches small enough for all outputs to fit in
+     * [Config.maxEvaluationReturnSizeBytes].
+     *
+     * An image that fails to decode does not fail the others: its entry holds the error, a
+     * [Jp2kException] or an [IllegalArgumentException] if the input is too short.
+     *
+     * @param images The raw byte arrays of the JPEG 2000 images.
+     * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return One [Result] per image, in the order of [images].
+     */
+    suspend fun decodeImages(
+        images: List<ByteArray>,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): List<Result<Bitmap>> {
+        validateReduceLevel(reduceLevel)
+        if (images.isEmpty()) {
+            return emptyList()
+        }
+
+        // Inputs that are too short are not sent, their entries fail in the sandbox and are replaced below
+        val packed = packBatchInput(images.map { if (it.size < MIN_INPUT_SIZE) ByteArray(0) else it })
+        validateInputSize(packed.size)
+        log(Log.INFO) { "Batch of ${images.size} images, packed input length: ${packed.size}" }
+
+        val encoded = dataChannel.encodePayload(packed)
+        logEncodedInputInfo(encoded)
+
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+
+        return executeDecode("decodeImages", packed.size.toLong(), { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync(
+                    "globalThis.decodeJ2KBatchFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $reduceLevel, $chunkedOutput);"
+                ).await()
+            } else {
+                val script = "globalThis.decodeJ2KBatch('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $reduceLevel, $chunkedOutput);"
+                isolate.evaluateJavaScriptAsync(script).await()
+            }
+        }) { output ->
+            unpackBatchOutput(output, images.size).mapIndexed { index, entry ->
+                when {
+                    images[index].size < MIN_INPUT_SIZE ->
+                        Result.failure(IllegalArgumentException("Input data is too short"))
+                    entry.errorCode != 0 ->
+                        Result.failure(Jp2kException(Jp2kError.fromInt(entry.errorCode)))
+                    else -> runCatching {
+                        createBitmapFromOutput(output.payload, entry.offset, entry.length, output.isRaw, colorFormat, pool = config.bitmapPool)
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Decodes a JPEG 2000 image progressively.
+     *
+     * The image data is cached as with [precache], then decoded as with [decodeImageProgressive]
+     * using cached data.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard in the final image. Defaults to 0.
+     * @return A cold [Flow] emitting the preview and then the final [Bitmap].
+     */
+    fun decodeImageProgressive(
+        j2kData: ByteArray,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Flow<Bitmap> {
+        validateReduceLevel(reduceLevel)
+        return flow {
+            precache(j2kData)
+            emitAll(decodeImageProgressive(colorFormat, reduceLevel))
+        }
+    }
+
+    /**
+     * Decodes a JPEG 2000 image progressively using cached data.
+     *
+     * The first [Bitmap] is a preview decoded with one quality layer and
+     * [PROGRESSIVE_PREVIEW_REDUCE_LEVELS] more resolution levels discarded, so it is a fraction of the
+     * final size. The last [Bitmap] is the image at [reduceLevel] with all quality layers. The preview is
+     * skipped when the image has a single quality layer and cannot be reduced further.
+     *
+     * All steps decode from the decode session of the cached data, so the codestream is transferred once.
+     * Other calls on this decoder may run between the steps.
+     *
+     * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard in the final image. Defaults to 0.
+     * @return A cold [Flow] emitting the preview and then the final [Bitmap].
+     */
+    fun decodeImageProgressive(
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Flow<Bitmap> {
+        validateReduceLevel(reduceLevel)
+        return flow {
+            val steps = executeHeaderQuery("decodeImageProgressive", ::parseProgressiveSteps) { isolate ->
+                isolate.evaluateJavaScriptAsync("globalThis.getProgressivePlan($reduceLevel);").await()
+            }
+            for (step in steps) {
+                emit(decodeProgressiveStep(colorFormat, step))
+            }
+        }
+    }
+
+    private suspend fun decodeProgressiveStep(colorFormat: ColorFormat, step: ProgressiveStep): Bitmap {
+        val measureTimes = config.logLevel != null
+        val kotlinStartTime = System.currentTimeMillis()
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+        val script =
+            "globalThis.decodeJ2KWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, 0, 0, 0, 0, $kotlinStartTime, $chunkedOutput, ${step.reduceLevel}, ${step.qualityLayers});"
+
+        return executeDecodeImage(colorFormat) { isolate ->
+            isolate.evaluateJavaScriptAsync(script).await()
+        }
+    }
+
+    private fun validateReduceLevel(reduceLevel: Int) {
+        if (reduceLevel < 0) {
+            throw IllegalArgumentException("reduceLevel must be 0 or greater")
+        }
+    }
+
+    /**
+     * Decodes a single tile of a JPEG 2000 image.
+     *
+     * Only the codestream of the requested tile is decoded, so this is cheaper than a region decode
+     * of the same area. Use [getTileInfo] to obtain the tile grid.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param tileIndex The index of the tile in raster order.
+     * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return The decoded [Bitmap].
+     */
+    suspend fun decodeTile(
+        j2kData: ByteArray,
+        tileIndex: Int,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap {
+        if (j2kData.size < MIN_INPUT_SIZE) {
+            throw IllegalArgumentException("Input data is too short")
+        }
+        validateInputSize(j2kData.size)
+        validateTileIndex(tileIndex)
+        validateReduceLevel(reduceLevel)
+        logInputDataInfo(j2kData)
+
+        val measureTimes = config.logLevel != null
+        val encoded = dataChannel.encodePayload(j2kData)
+        logEncodedInputInfo(encoded)
+
+        val kotlinStartTime = System.currentTimeMillis()
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+
+        return executeDecodeImage(colorFormat, j2kData.size.toLong()) { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync(
+                    "globalThis.decodeJ2KTileFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $tileIndex, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+                ).await()
+            } else {
+                val script = "globalThis.decodeJ2KTile('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $tileIndex, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+                isolate.evaluateJavaScriptAsync(script).await()
+            }
+        }
+    }
+
+    /**
+     * Decodes a single tile of a JPEG 2000 image using cached data.
+     *
+     * @param tileIndex The index of the tile in raster order.
+     * @param colorFormat The desired output color format. Defaults to [ColorFormat.ARGB8888].
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size. Defaults to 0.
+     * @return The decoded [Bitmap].
+     */
+    suspend fun decodeTile(
+        tileIndex: Int,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap {
+        validateTileIndex(tileIndex)
+        validateReduceLevel(reduceLevel)
 
         val measureTimes = config.logLevel != null
         val kotlinStartTime = System.currentTimeMillis()
         val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
         val script =
-            "globalThis.decodeJ2KWithCacheRatio(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+            "globalThis.decodeJ2KTileWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $tileIndex, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
 
         return executeDecodeImage(colorFormat) { isolate ->
             isolate.evaluateJavaScriptAsync(script).await()
         }
     }
 
+    private fun validateTileIndex(tileIndex: Int) {
+        if (tileIndex < 0) {
+            throw IllegalArgumentException("tileIndex must be 0 or greater")
+        }
+    }
+
     private fun validateRatio(left: Float, top: Float, right: Float, bottom: Float) {
         if (left < 0.0f || left > 1.0f || top < 0.0f || top > 1.0f ||
             right < 0.0f || right > 1.0f || bottom < 0.0f || bottom > 1.0f
@@ -617,102 +1280,78 @@ class Jp2kDecoder(
     private suspend fun executeDecodeImage(
         colorFormat: ColorFormat,
         inputSize: Long = 0L,
+        target: Bitmap? = null,
+        evaluate: suspend (JavaScriptIsolate) -> String,
+    ): Bitmap = executeDecode("decodeImage", inputSize, evaluate) { output ->
+        createBitmapFromOutput(output.payload, output.offset, output.length, output.isRaw, colorFormat, target, config.bitmapPool)
+    }
+
+    /**
+     * Runs a decode script and converts the decoder output it returns with [createResult].
+     *
+     * The script either returns the result JSON, or [INTERNAL_RESULT_FRAME] after posting a binary
+     * result frame through the data channel.
+     */
+    private suspend fun <T> executeDecode(
+        operation: String,
+        inputSize: Long,
         evaluate: suspend (JavaScriptIsolate) -> String,
-    ): Bitmap = mutex.withLock {
+        createResult: (DecodeOutput) -> T,
+    ): T = mutex.withLock {
         if (_state == State.Released || _state == State.Releasing) {
             throw CancellationException("Decoder was released.")
         }
         if (_state != State.Initialized) {
-            throw IllegalStateException("Cannot decodeImage while in state: $_state")
+            throw IllegalStateException("Cannot $operation while in state: $_state")
         }
         _state = State.Processing
+        idleRecycleJob?.cancel()
 
         dataChannel.prepareForDecode()
 
         val start = System.currentTimeMillis()
+        var wasmHeapSizeBytes = 0L
 
         return try {
             val isolate = checkNotNull(jsIsolate) { "Jp2kDecoder has not been initialized." }
 
-            val bitmap = withContext(coroutineDispatcher) {
+            val timeoutMillis = currentCoroutineContext()[Jp2kDeadline]?.timeoutMillis ?: config.decodeTimeoutMillis
+            if (timeoutMillis > 0 || requestArmed) {
+                beginRequest(isolate, timeoutMillis)
+            }
+
+            val decoded = withContext(coroutineDispatcher) {
                 val measureTimes = config.logLevel != null
                 val transferStart = if (measureTimes) System.nanoTime() else 0L
 
-                val jsonResult = ensureNotEmpty(evaluate(isolate), "JSON")
+                val evaluated = ensureNotEmpty(evaluate(isolate), "JSON")
                 val kotlinReceiveTimeMs = System.currentTimeMillis()
                 val transferEnd = if (measureTimes) System.nanoTime() else 0L
 
-                val root = JSONObject(jsonResult)
-                if (root.has("errorCode")) {
-                    val errorCode = root.getInt("errorCode")
-                    if (errorCode == Jp2kError.CacheDataMissing.code) {
-                        throw IllegalStateException("No data cached")
-                    }
-                    val error = Jp2kError.fromInt(errorCode)
-                    val errorMessage =
-                        if (root.has("errorMessage")) root.getString("errorMessage") else null
-                    log(Log.ERROR) { "Error: $error, Message: $errorMessage" }
-
-                    if (error == Jp2kError.RegionOutOfBounds) {
-                        throw RegionOutOfBoundsException(errorMessage)
-                    }
-
-                    throw Jp2kException(error, errorMessage)
-                } else if (root.has("error")) {
-                    val errorMsg = root.getString("error")
-                    log(Log.ERROR) { "Error: $errorMsg" }
-                    throw Jp2kException(Jp2kError.Unknown, errorMsg)
-                }
-
-                val bmpBase64 = if (root.optBoolean("isChunked", false)) {
-                    val outputSize = root.getInt("outputSize")
-                    val sb = java.lang.StringBuilder(outputSize)
-                    var offset = 0
-                    while (offset < outputSize) {
-                        val length = minOf(config.binderTransactionMaxChunkSizeBytes, outputSize - offset)
-                        val chunk = isolate.evaluateJavaScriptAsync("globalThis.getOutputChunk($offset, $length);").await()
-                        sb.append(chunk)
-                        offset += length
-                    }
-                    isolate.evaluateJavaScriptAsync("globalThis.clearOutput();").await()
-                    sb.toString()
-                } else {
-                    root.optString("bmp", "")
-                }
-
-                if (dataChannel.isStringMediated) {
-                    log(Log.INFO) { "Output encoded content length: ${bmpBase64.length} chars" }
-                    log(Log.INFO) { "Output encoded content (64 chars per line):\n${bmpBase64.chunked64()}" }
-                }
-
                 val kotlinDecodeStart = System.nanoTime()
-                val bmpBytes = dataChannel.retrieveDecodedBytes(bmpBase64)
-
-                val options = BitmapFactory.Options().apply {
-                    inPreferredConfig = when (colorFormat) {
-                        ColorFormat.RGB565 -> Bitmap.Config.RGB_565
-                        ColorFormat.ARGB8888 -> Bitmap.Config.ARGB_8888
-                    }
+                val (output, timings) = if (evaluated == INTERNAL_RESULT_FRAME) {
+                    readResultFrame()
+                } else {
+                    readResultJson(isolate, evaluated)
                 }
 
-                val bmp = BitmapFactory.decodeByteArray(bmpBytes, 0, bmpBytes.size, options)
-                    ?: throw IllegalStateException("Bitmap decoding failed (returned null).")
+                val result = createResult(output)
                 val kotlinDecodeTimeMs = (System.nanoTime() - kotlinDecodeStart) / 1_000_000.0
 
-                log(Log.INFO) { "Output data length: ${bmpBytes.size} bytes" }
+                log(Log.INFO) { "Output data length: ${output.length} bytes" }
+                wasmHeapSizeBytes = timings.wasmHeapSizeBytes
 
                 if (measureTimes) {
-                    val timePreProcess = root.optDouble("timePreProcess", 0.0)
-                    val timeWasm = root.optDouble("timeWasm", 0.0)
-                    val timePostProcess = root.optDouble("timePostProcess", 0.0)
+                    val timePreProcess = timings.timePreProcess
+                    val timeWasm = timings.timeWasm
+                    val timePostProcess = timings.timePostProcess
                     val dataTransferTimeMs = (transferEnd - transferStart) / 1_000_000.0
-                    val jsDecodeTimeMs = root.optDouble("timeBase64Decode", 0.0)
-                    val jsEncodeTimeMs = root.optDouble("timeBase64Encode", 0.0)
-                    val wasmHeapSizeBytes = root.optLong("wasmHeapSizeBytes", 0)
+                    val jsDecodeTimeMs = timings.timeBase64Decode
+                    val jsEncodeTimeMs = timings.timeBase64Encode
                     val totalMs = (System.currentTimeMillis() - start).toDouble()
 
-                    val inputTransferDelayMs = root.optDouble("inputTransferDelayMs", 0.0)
-                    val jsFinishTimeMs = root.optLong("jsFinishTimeMs", 0L)
+                    val inputTransferDelayMs = timings.inputTransferDelayMs
+                    val jsFinishTimeMs = timings.jsFinishTimeMs
                     val outputTransferDelayMs = if (jsFinishTimeMs > 0) Math.max(0.0, (kotlinReceiveTimeMs - jsFinishTimeMs).toDouble()) else 0.0
 
                     log(Log.INFO) { "Input transfer start delay (Kotlin -> JS start): ${"%.2f".format(inputTransferDelayMs)} ms" }
@@ -728,10 +1367,18 @@ class Jp2kDecoder(
                         jsDecodeTimeMs = jsDecodeTimeMs,
                         wasmProcessingTimeMs = timeWasm,
                         jsEncodeTimeMs = jsEncodeTimeMs,
-                        outputDataSizeBytes = bmpBytes.size.toLong(),
+                        outputDataSizeBytes = output.length.toLong(),
                         wasmHeapSizeBytes = wasmHeapSizeBytes,
                         totalProcessingTimeMs = totalMs,
+                        headerTimeMs = timings.stats?.headerTimeMs ?: 0.0,
+                        codestreamDecodeTimeMs = timings.stats?.codestreamDecodeTimeMs ?: 0.0,
+                        conversionTimeMs = timings.stats?.conversionTimeMs ?: 0.0,
+                        tilesDecoded = timings.stats?.tilesDecoded ?: 0L,
+                        bytesRead = timings.stats?.bytesRead ?: 0L,
+                        wasmAllocationCount = timings.stats?.allocationCount ?: 0L,
+                        wasmAllocatedBytes = timings.stats?.allocatedBytes ?: 0L,
                     )
+                    _lastPerformanceMetrics = metrics
 
                     val inputStr = "%d".format(metrics.inputDataSizeBytes)
                     val outputStr = "%d".format(metrics.outputDataSizeBytes)
@@ -749,32 +1396,250 @@ class Jp2kDecoder(
                     log(Log.INFO) {
                         "Pre-process: $timePreProcess ms, WASM: $timeWasm ms, Post-process: $timePostProcess ms"
                     }
+                    if (timings.stats != null) {
+                        log(Log.INFO) {
+                            "WASM stages: header ${"%.2f".format(metrics.headerTimeMs)} ms, codestream ${"%.2f".format(metrics.codestreamDecodeTimeMs)} ms, " +
+                            "conversion ${"%.2f".format(metrics.conversionTimeMs)} ms, tiles=${metrics.tilesDecoded} bytesRead=${metrics.bytesRead}B " +
+                            "allocations=${metrics.wasmAllocationCount} (${metrics.wasmAllocatedBytes}B)"
+                        }
+                    }
                 }
 
-                bmp
+                result
             }
 
             val time = System.currentTimeMillis() - start
-            log(Log.INFO) { "decodeImage() finished in $time msec" }
+            log(Log.INFO) { "$operation() finished in $time msec" }
+            recordFirstDecode()
 
             restoreStateAfterDecode()
 
             if (_state == State.Released || _state == State.Releasing) {
                 throw CancellationException("Decoder was released.")
             }
-            bitmap
+            scheduleHeapRecycle(wasmHeapSizeBytes)
+            decoded
 
         } catch (e: Exception) {
             val time = System.currentTimeMillis() - start
-            log(Log.ERROR) { "decodeImage() failed in $time msec. Error: ${e.message}" }
+            log(Log.ERROR) { "$operation() failed in $time msec. Error: ${e.message}" }
             restoreStateAfterDecode()
             if (_state == State.Released || _state == State.Releasing) {
                 throw CancellationException("Decoder was released.")
             }
+            if (e is CancellationException) {
+                // The decode keeps running in the sandbox until it returns or hits its deadline
+                requestArmed = true
+            }
+            scheduleHeapRecycle(0L)
             throw e
         }
     }
 
+    /**
+     * Queues the recycles [Config.heapRecyclePolicy] asks for once a decode left the WASM heap at
+     * [wasmHeapSizeBytes], and restarts the idle timer. Called with the mutex held.
+     */
+    private fun scheduleHeapRecycle(wasmHeapSizeBytes: Long) {
+        val policy = config.heapRecyclePolicy ?: return
+        if (policy.highWaterMarkBytes > 0 && wasmHeapSizeBytes >= policy.highWaterMarkBytes) {
+            recycleScope.launch { recycleHeap(HeapRecycleTrigger.HighWaterMark) }
+        }
+        if (policy.idleTimeoutMillis > 0) {
+            idleRecycleJob?.cancel()
+            idleRecycleJob = recycleScope.launch {
+                delay(policy.idleTimeoutMillis)
+                recycleHeap(HeapRecycleTrigger.Idle)
+            }
+        }
+    }
+
+    /**
+     * Recycles the WASM heap if the system trims memory at [HeapRecyclePolicy.trimMemoryLevel] or
+     * higher. Called by the callbacks [init] registers; apps that dispatch `onTrimMemory` themselves
+     * may call it directly.
+     *
+     * @param level The level passed to `ComponentCallbacks2.onTrimMemory`.
+     */
+    fun onTrimMemory(level: Int) {
+        val trimMemoryLevel = config.heapRecyclePolicy?.trimMemoryLevel ?: return
+        if (level >= trimMemoryLevel) {
+            recycleOnTrimMemory()
+        }
+    }
+
+    private fun recycleOnTrimMemory() {
+        if (_state != State.Released && _state != State.Releasing) {
+            recycleScope.launch { recycleHeap(HeapRecycleTrigger.TrimMemory) }
+        }
+    }
+
+    private fun registerTrimMemoryCallbacks(context: Context) {
+        if (config.heapRecyclePolicy?.trimMemoryLevel == null || trimMemoryCallbacks != null) {
+            return
+        }
+        val appContext = context.applicationContext ?: context
+        val callbacks = object : ComponentCallbacks2 {
+            override fun onTrimMemory(level: Int) = this@Jp2kDecoder.onTrimMemory(level)
+            override fun onLowMemory() = recycleOnTrimMemory()
+            override fun onConfigurationChanged(newConfig: Configuration) {
+                // DO NOTHING
+            }
+        }
+        appContext.registerComponentCallbacks(callbacks)
+        trimMemoryCallbacks = appContext to callbacks
+    }
+
+    /**
+     * Swaps in a fresh WASM instance between two requests, handing the grown heap of the current one
+     * back to the garbage collector. Failures are logged and keep the current instance.
+     */
+    private suspend fun recycleHeap(trigger: HeapRecycleTrigger) {
+        val policy = config.heapRecyclePolicy ?: return
+        mutex.withLock {
+            if (_state != State.Initialized) {
+                return
+            }
+            val isolate = jsIsolate ?: return
+            _state = State.Processing
+
+            val start = System.nanoTime()
+            try {
+                val minHeapBytes = if (trigger == HeapRecycleTrigger.HighWaterMark) policy.highWaterMarkBytes else 0L
+                val jsonResult = withContext(coroutineDispatcher) {
+                    isolate.evaluateJavaScriptAsync("globalThis.recycleWasmInstance($minHeapBytes);").await()
+                }
+                val root = JSONObject(ensureNotEmpty(jsonResult, "JSON"))
+                if (root.has("errorCode")) {
+                    log(Log.ERROR) { "Heap recycle ($trigger) failed. Error: ${root.optString("errorMessage")}" }
+                    return
+                }
+                if (!root.optBoolean("recycled", false)) {
+                    log(Log.INFO) { "Heap recycle ($trigger) skipped: WASM heap ${root.optLong("wasmHeapSizeBytes", 0)} bytes" }
+                    return
+                }
+
+                val reclaimedBytes = root.optLong("reclaimedBytes", 0)
+                val swapLatencyMs = (System.nanoTime() - start) / 1_000_000.0
+                val previous = _heapRecycleMetrics
+                _heapRecycleMetrics = HeapRecycleMetrics(
+                    recycleCount = (previous?.recycleCount ?: 0) + 1,
+                    totalReclaimedBytes = (previous?.totalReclaimedBytes ?: 0L) + reclaimedBytes,
+                    lastReclaimedBytes = reclaimedBytes,
+                    lastSwapLatencyMs = swapLatencyMs,
+                    lastTrigger = trigger,
+                )
+                log(Log.INFO) { "Heap recycle ($trigger): reclaimed $reclaimedBytes bytes in ${"%.2f".format(swapLatencyMs)} ms" }
+            } catch (e: Exception) {
+                log(Log.ERROR) { "Heap recycle ($trigger) failed. Error: ${e.message}" }
+            } finally {
+                restoreStateAfterDecode()
+            }
+        }
+    }
+
+    /**
+     * Clears the deadline of the previous decode and sets the one of the next. Evaluations are
+     * serialized, so this also waits for a decode a cancelled coroutine left running.
+     */
+    private suspend fun beginRequest(isolate: JavaScriptIsolate, timeoutMillis: Long) {
+        withContext(coroutineDispatcher) {
+            val timeout = timeoutMillis.coerceIn(0L, MAX_REQUEST_TIMEOUT_MILLIS)
+            isolate.evaluateJavaScriptAsync("globalThis.beginRequest($timeout);").await()
+        }
+        requestArmed = timeoutMillis > 0
+        // Drops what the decode left running may have posted meanwhile
+        dataChannel.prepareForDecode()
+    }
+
+    /**
+     * Takes the binary result frame posted by the decode script from the data channel.
+     */
+    private fun readResultFrame(): Pair<DecodeOutput, DecodeTimings> {
+        val frame = parseResultFrame(dataChannel.retrieveDecodedBytes(""))
+        if (frame.errorCode != 0) {
+            throw Jp2kException(Jp2kError.fromInt(frame.errorCode))
+        }
+        log(Log.INFO) { "Result frame: ${frame.width}x${frame.height}, stride ${frame.stride}" }
+        return frame.output to frame.timings
+    }
+
+    /**
+     * Reads the result JSON returned by the decode script and the decoder output it refers to.
+     */
+    private suspend fun readResultJson(isolate: JavaScriptIsolate, jsonResult: String): Pair<DecodeOutput, DecodeTimings> {
+        val root = JSONObject(jsonResult)
+        if (root.has("errorCode")) {
+            val errorCode = root.getInt("errorCode")
+            if (errorCode == Jp2kError.CacheDataMissing.code) {
+                throw IllegalStateException("No data cached")
+            }
+            val error = Jp2kError.fromInt(errorCode)
+            val errorMessage =
+                if (root.has("errorMessage")) root.getString("errorMessage") else null
+            log(Log.ERROR) { "Error: $error, Message: $errorMessage" }
+
+            if (error == Jp2kError.RegionOutOfBounds) {
+                throw RegionOutOfBoundsException(errorMessage)
+            }
+
+            throw Jp2kException(error, errorMessage)
+        } else if (root.has("error")) {
+            val errorMsg = root.getString("error")
+            log(Log.ERROR) { "Error: $errorMsg" }
+            throw Jp2kException(Jp2kError.Unknown, errorMsg)
+        }
+
+        val isRaw = root.optBoolean("raw", false)
+        if (root.optBoolean("isChunked", false)) {
+            return readOutputChunks(isolate, root.getInt("outputSize"), isRaw) to DecodeTimings.fromJson(root)
+        }
+        val bmpBase64 = root.optString("bmp", "")
+
+        if (dataChannel.isStringMediated) {
+            log(Log.INFO) { "Output encoded content length: ${bmpBase64.length} chars" }
+            log(Log.INFO) { "Output encoded content (64 chars per line):\n${bmpBase64.chunked64()}" }
+        }
+
+        val bmpBytes = dataChannel.retrieveDecodedBytes(bmpBase64)
+        val output = DecodeOutput(bmpBytes, 0, bmpBytes.size, isRaw)
+        return output to DecodeTimings.fromJson(root)
+    }
+
+    /**
+     * Reads a chunked output of [outputSize] characters with up to [Config.chunkTransferWindow] chunks in
+     * flight. When the data channel has a [ChunkDecoder], each chunk is decoded into the output as it
+     * arrives, so the encoded output is never held as a whole.
+     */
+    private suspend fun readOutputChunks(isolate: JavaScriptIsolate, outputSize: Int, isRaw: Boolean): DecodeOutput {
+        val chunkDecoder = dataChannel.createChunkDecoder(outputSize)
+        val chunkSize = chunkDecoder?.alignChunkSize(config.binderTransactionMaxChunkSizeBytes)
+            ?: config.binderTransactionMaxChunkSizeBytes
+        val encoded = StringBuilder(if (chunkDecoder == null) outputSize else 0)
+
+        pipelineChunks(
+            count = chunkCount(outputSize, chunkSize),
+            window = config.chunkTransferWindow,
+            evaluate = { index ->
+                val offset = index * chunkSize
+                val length = minOf(chunkSize, outputSize - offset)
+                isolate.evaluateJavaScriptAsync("globalThis.getOutputChunk($offset, $length);")
+            },
+            await = { it.await() },
+            onResult = { _, chunk ->
+                if (chunkDecoder != null) chunkDecoder.decode(chunk) else encoded.append(chunk)
+            },
+        )
+        isolate.evaluateJavaScriptAsync("globalThis.clearOutput();").await()
+
+        log(Log.INFO) { "Output encoded content length: $outputSize chars" }
+        if (chunkDecoder != null) {
+            return DecodeOutput(chunkDecoder.output, 0, chunkDecoder.length, isRaw)
+        }
+        val bytes = dataChannel.retrieveDecodedBytes(encoded.toString())
+        return DecodeOutput(bytes, 0, bytes.size, isRaw)
+    }
+
     private fun restoreStateAfterDecode() {
         if (_state == State.Processing) {
             _state = State.Initialized
@@ -813,6 +1678,10 @@ class Jp2kDecoder(
 
                 MemoryUsage(
                     wasmHeapSizeBytes = root.optLong("wasmHeapSizeBytes", 0),
+                    scratchHighWaterMarkBytes = root.optLong("scratchHighWaterMarkBytes", 0),
+                    heapInUseBytes = root.optLong("heapInUseBytes", 0),
+                    lastDecodePeakBytes = root.optLong("lastDecodePeakBytes", 0),
+                    lastDecodeEstimatedPeakBytes = root.optLong("lastDecodeEstimatedPeakBytes", 0),
                 )
             }
         } finally {
@@ -841,6 +1710,10 @@ class Jp2kDecoder(
             jsIsolate = null
         }
 
+        recycleScope.cancel()
+        trimMemoryCallbacks?.let { (context, callbacks) -> context.unregisterComponentCallbacks(callbacks) }
+        trimMemoryCallbacks = null
+
         try {
             isolateToClose?.close()
         } catch (e: Exception) {
@@ -874,12 +1747,13 @@ class Jp2kDecoder(
     companion object {
         private const val TAG = "Jp2kDecoder"
         private const val MIN_INPUT_SIZE = 12 // Signature box length
-        private const val ASSET_PATH_WASM = "openjpeg_core.wasm"
 
         private val SCRIPT_DEFINE_INPUT_CHUNKS_LOCAL = SCRIPT_DEFINE_INPUT_CHUNKS
         private val SCRIPT_DEFINE_SET_DATA_LOCAL = SCRIPT_DEFINE_SET_DATA
         private const val SCRIPT_IMPORT_OBJECT_LOCAL = SCRIPT_IMPORT_OBJECT
         private val SCRIPT_DEFINE_DECODE_J2K_LOCAL = SCRIPT_DEFINE_DECODE_J2K
         private val SCRIPT_DEFINE_GET_SIZE_LOCAL = SCRIPT_DEFINE_GET_SIZE
+        private val SCRIPT_DEFINE_TILE_LOCAL = SCRIPT_DEFINE_TILE
+        private val SCRIPT_DEFINE_IMAGE_INFO_LOCAL = SCRIPT_DEFINE_IMAGE_INFO
     }
 }
@@ -1,9 +1,10 @@
 package dev.keiji.jp2k
 
+import android.content.ComponentCallbacks2
 import android.content.Context
+import android.content.res.Configuration
 import android.content.res.AssetManager
 import android.graphics.Bitmap
-import android.graphics.BitmapFactory
 import android.graphics.Rect
 import android.graphics.RectF
 import android.util.Log
@@ -11,7 +12,9 @@ import androidx.core.content.ContextCompat
 import androidx.javascriptengine.JavaScriptIsolate
 import androidx.javascriptengine.JavaScriptSandbox
 import dev.keiji.jp2k.datachannel.Base64DataChannel
+import dev.keiji.jp2k.datachannel.ChunkDecoder
 import dev.keiji.jp2k.datachannel.JSDataChannel
+import dev.keiji.jp2k.datachannel.alignChunkSize
 import dev.keiji.jp2k.datachannel.createDataChannel
 import dev.keiji.jp2k.datachannel.escapeJs
 import org.json.JSONObject
@@ -19,6 +22,9 @@ import java.util.concurrent.CancellationException
 import java.util.concurrent.ExecutionException
 import java.util.concurrent.Executor
 import java.util.concurrent.Executors
+import java.util.concurrent.ScheduledExecutorService
+import java.util.concurrent.ScheduledFuture
+import java.util.concurrent.TimeUnit
 
 /**
  * Asynchronous JPEG 2000 Decoder class using WebAssembly via Android JavaScriptEngine.
@@ -57,6 +63,51 @@ class Jp2kDecoderAsync(
 
     private var isEvaluateWithoutTransactionLimitSupported: Boolean = true
 
+    @Volatile
+    private var _initMetrics: InitMetrics? = null
+
+    private var initStartTimeMs: Long = 0
+
+    // Identity of the precached image in config.regionCache, or null if nothing is precached
+    @Volatile
+    private var precachedInputKey: String? = null
+
+    /**
+     * The cold start cost of this decoder, or `null` until [init] completes.
+     *
+     * [InitMetrics.timeToFirstDecodeMs] is filled in when the first decode succeeds.
+     */
+    val initMetrics: InitMetrics?
+        get() = _initMetrics
+
+    @Volatile
+    private var _lastPerformanceMetrics: PerformanceMetrics? = null
+
+    /**
+     * Metrics of the last decode, including the per-stage statistics of the WASM module. Recorded only while [Config.logLevel] is set.
+     */
+    val lastPerformanceMetrics: PerformanceMetrics?
+        get() = _lastPerformanceMetrics
+
+    // Timer of the HeapRecycleTrigger.Idle recycles, created on the first decode. Guarded by lock.
+    private var idleRecycleScheduler: ScheduledExecutorService? = null
+    private var idleRecycleFuture: ScheduledFuture<*>? = null
+
+    // Counts the decodes, so that an idle recycle queued behind a decode is dropped. Guarded by lock.
+    private var decodeGeneration = 0L
+
+    // Registered in init() when HeapRecyclePolicy.trimMemoryLevel is set
+    private var trimMemoryCallbacks: Pair<Context, ComponentCallbacks2>? = null
+
+    @Volatile
+    private var _heapRecycleMetrics: HeapRecycleMetrics? = null
+
+    /**
+     * The WASM heap recycles of this decoder, or `null` until the first one. See [Config.heapRecyclePolicy].
+     */
+    val heapRecycleMetrics: HeapRecycleMetrics?
+        get() = _heapRecycleMetrics
+
     private inline fun log(priority: Int, message: () -> String) {
         if (config.logLevel != null && priority >= config.logLevel) {
             val msg = message().trimLines(config.maxLogLines)
@@ -101,6 +152,7 @@ class Jp2kDecoderAsync(
                 try {
                     // Wait for sandbox connection on the background thread
                     val sandbox = sandboxFuture.get()
+                    val sandboxConnectTimeMs = System.currentTimeMillis() - start
                     isEvaluateWithoutTransactionLimitSupported =
                         JavaScriptEngineEnvironment.isFeatureSupported(sandbox, JavaScriptSandbox.JS_FEATURE_EVALUATE_WITHOUT_TRANSACTION_LIMIT)
                     dataChannel = createDataChannel(sandbox, config.preferDirectBinaryTransfer)
@@ -124,7 +176,7 @@ class Jp2kDecoderAsync(
                     }
 
                     // Load WASM
-                    loadWasm(isolate, assetManager)
+                    val wasmMetrics = loadWasm(isolate, assetManager)
 
                     synchronized(lock) {
                         if (_state == State.Released || _state == State.Releasing) {
@@ -132,9 +184,13 @@ class Jp2kDecoderAsync(
                         }
                         _state = State.Initialized
                     }
+                    registerTrimMemoryCallbacks(context)
 
                     val time = System.currentTimeMillis() - start
+                    initStartTimeMs = start
+                    _initMetrics = wasmMetrics.copy(sandboxConnectTimeMs = sandboxConnectTimeMs, initTimeMs = time)
                     log(Log.INFO) { "init() finished in $time msec" }
+                    log(Log.INFO) { "Init metrics: $_initMetrics" }
                     callback.onSuccess(Unit)
                 } catch (e: Exception) {
                     synchronized(lock) {
@@ -150,10 +206,12 @@ class Jp2kDecoderAsync(
         }
     }
 
-    private fun loadWasm(isolate: JavaScriptIsolate, assetManager: AssetManager) {
+    private fun loadWasm(isolate: JavaScriptIsolate, assetManager: AssetManager): InitMetrics {
         // This runs on backgroundExecutor
-        val wasmBytes = assetManager.open(ASSET_PATH_WASM)
-            .readBytes()
+        val isWasmCached = WasmModuleCache.isLoaded
+        val loadStart = System.currentTimeMillis()
+        val wasmBytes = WasmModuleCache.get(assetManager)
+        val wasmLoadTimeMs = System.currentTimeMillis() - loadStart
         log(Log.INFO) { "DataChannel: ${dataChannel.name}" }
         log(Log.INFO) { "Input binary length: ${wasmBytes.size}" }
 
@@ -186,20 +244,35 @@ class Jp2kDecoderAsync(
         }
 
         // Stage 2: Transmit WASM binary and instantiate the WebAssembly module.
+        val instantiateStart = System.currentTimeMillis()
         val wasmExpression = dataChannel.getWasmExpression(isolate, wasmBytes)
         log(Log.INFO) { "WASM expression: $wasmExpression" }
 
         val instantiateScript = """
             var wasmInstance;
+            var wasmModule;
 
             (async () => {
                 const wasmBuffer = await $wasmExpression;
 
                 const res = await WebAssembly.instantiate(wasmBuffer, importObject);
                 wasmInstance = res.instance;
+                wasmModule = res.module;
+                globalThis.initialWasmHeapBytes = wasmInstance.exports.memory.buffer.byteLength;
 
                 $SCRIPT_DEFINE_DECODE_J2K
                 $SCRIPT_DEFINE_GET_SIZE
+                $SCRIPT_DEFINE_TILE
+                $SCRIPT_DEFINE_IMAGE_INFO
+
+                // Also applied to the instances swapped in by globalThis.recycleWasmInstance.
+                globalThis.configureWasmInstance = function() {
+                    globalThis.setDecodeThreads(${config.decodeThreads});
+                    globalThis.setOutputFormat(${if (config.rawPixelOutput) OUTPUT_FORMAT_RAW else OUTPUT_FORMAT_BMP});
+                    wasmInstance.exports.setScratchArena(1);
+                    wasmInstance.exports.setTileStreaming(1);
+                };
+                globalThis.configureWasmInstance();
 
                 return "$INTERNAL_RESULT_SUCCESS";
             })();
@@ -218,6 +291,24 @@ class Jp2kDecoderAsync(
         } catch (e: ExecutionException) {
             throw e.cause ?: e
         }
+
+        return InitMetrics(
+            sandboxConnectTimeMs = 0,
+            wasmLoadTimeMs = wasmLoadTimeMs,
+            wasmInstantiateTimeMs = System.currentTimeMillis() - instantiateStart,
+            initTimeMs = 0,
+            isWasmCached = isWasmCached,
+        )
+    }
+
+    private fun recordFirstDecode() {
+        val metrics = _initMetrics ?: return
+        if (metrics.timeToFirstDecodeMs != null) {
+            return
+        }
+        val timeToFirstDecodeMs = System.currentTimeMillis() - initStartTimeMs
+        _initMetrics = metrics.copy(timeToFirstDecodeMs = timeToFirstDecodeMs)
+        log(Log.INFO) { "Time to first decode: $timeToFirstDecodeMs msec" }
     }
 
     private fun validateInputSize(size: Int): Exception? {
@@ -233,13 +324,18 @@ class Jp2kDecoderAsync(
 
     private fun transferInputInChunks(isolate: JavaScriptIsolate, encoded: String) {
         isolate.evaluateJavaScriptAsync("globalThis.clearInputChunks();").get()
-        var offset = 0
-        while (offset < encoded.length) {
-            val end = minOf(offset + config.binderTransactionMaxChunkSizeBytes, encoded.length)
-            val chunk = encoded.substring(offset, end).escapeJs()
-            isolate.evaluateJavaScriptAsync("globalThis.appendInputChunk('$chunk');").get()
-            offset = end
-        }
+        val chunkSize = config.binderTransactionMaxChunkSizeBytes
+        pipelineChunks(
+            count = chunkCount(encoded.length, chunkSize),
+            window = config.chunkTransferWindow,
+            evaluate = { index ->
+                val start = index * chunkSize
+                val chunk = encoded.substring(start, minOf(start + chunkSize, encoded.length)).escapeJs()
+                isolate.evaluateJavaScriptAsync("globalThis.appendInputChunk('$chunk', $index);")
+            },
+            await = { it.get() },
+            onResult = { _, _ -> },
+        )
     }
 
     /**
@@ -248,10 +344,31 @@ class Jp2kDecoderAsync(
      * This method must be called after [init]. It caches the provided image data
      * in the sandbox, allowing [getSize] and [decodeImage] to be called without arguments.
      *
+     * Decodes of a single-tile image reuse its parsed main header. A multi-tile image is parsed again
+     * on every decode, so precaching it only saves transferring the data.
+     *
      * @param j2kData The raw byte array of the JPEG 2000 image.
      * @param callback The callback to receive the precache result.
      */
     fun precache(j2kData: ByteArray, callback: Callback<Unit>) {
+        precache(j2kData, null, callback)
+    }
+
+    /**
+     * Precaches the image data in the JavaScript sandbox for subsequent operations.
+     *
+     * This method must be called after [init]. It caches the provided image data
+     * in the sandbox, allowing [getSize] and [decodeImage] to be called without arguments.
+     *
+     * Decodes of a single-tile image reuse its parsed main header. A multi-tile image is parsed again
+     * on every decode, so precaching it only saves transferring the data.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param cacheKey The identity of the image in [Config.regionCache], for example its file name. If
+     * null, a hash of [j2kData] is used.
+     * @param callback The callback to receive the precache result.
+     */
+    fun precache(j2kData: ByteArray, cacheKey: String?, callback: Callback<Unit>) {
         val validationError = validateInputSize(j2kData.size)
         if (validationError != null) {
             callback.onError(validationError)
@@ -267,6 +384,8 @@ class Jp2kDecoderAsync(
                 callback.onError(IllegalStateException("Cannot precache while in state: $_state"))
                 return
             }
+            // Decodes queued from now on must not be served for the previous image
+            precachedInputKey = null
         }
 
         backgroundExecutor.execute {
@@ -314,6 +433,9 @@ class Jp2kDecoderAsync(
                         }
                         throw IllegalStateException("Failed to set data: $result")
                     }
+                    if (config.regionCache != null) {
+                        precachedInputKey = cacheKey ?: Jp2kRegionCache.keyOf(j2kData)
+                    }
 
                     restoreStateAfterDecode()
                     synchronized(lock) {
@@ -338,6 +460,82 @@ class Jp2kDecoderAsync(
         }
     }
 
+    /**
+     * Clears the image data cached by [precache].
+     *
+     * The decode session kept for the cached data is closed as well, releasing its memory
+     * in the sandbox.
+     *
+     * @param callback The callback to receive the result.
+     */
+    fun clearCache(callback: Callback<Unit>) {
+        synchronized(lock) {
+            if (_state == State.Released || _state == State.Releasing) {
+                callback.onError(CancellationException("Decoder was released."))
+                return
+            }
+            if (_state != State.Initialized && _state != State.Processing) {
+                callback.onError(IllegalStateException("Cannot clear cache while in state: $_state"))
+                return
+            }
+            precachedInputKey = null
+        }
+
+        backgroundExecutor.execute {
+            synchronized(executionLock) {
+                synchronized(lock) {
+                    if (_state == State.Released || _state == State.Releasing) {
+                        callback.onError(CancellationException("Decoder was released."))
+                        return@execute
+                    }
+                    if (_state != State.Initialized && _state != State.Processing) {
+                        callback.onError(IllegalStateException("Decoder state invalid before execution: $_state"))
+                        return@execute
+                    }
+                    _state = State.Processing
+                }
+
+                try {
+                    val isolate = checkNotNull(jsIsolate) { "Jp2kDecoder has not been initialized." }
+                    val result = isolate.evaluateJavaScriptAsync("globalThis.clearData();").get()
+
+                    if (result != INTERNAL_RESULT_SUCCESS) {
+                        ensureNotEmpty(result, "Success indicator or JSON error")
+
+                        val root = JSONObject(result)
+                        if (root.has("errorCode")) {
+                            val errorCode = root.getInt("errorCode")
+                            val error = Jp2kError.fromInt(errorCode)
+                            val errorMessage = if (root.has("errorMessage")) root.getString("errorMessage") else null
+                            log(Log.ERROR) { "Error: $error, Message: $errorMessage" }
+                            throw Jp2kException(error, errorMessage)
+                        }
+                        throw IllegalStateException("Failed to clear data: $result")
+                    }
+
+                    restoreStateAfterDecode()
+                    synchronized(lock) {
+                        if (_state == State.Released || _state == State.Releasing) {
+                            callback.onError(CancellationException("Decoder was released."))
+                        } else {
+                            callback.onSuccess(Unit)
+                        }
+                    }
+                } catch (e: Exception) {
+                    log(Log.ERROR) { "clearCache() failed. Error: ${e.message}" }
+                    restoreStateAfterDecode()
+                    synchronized(lock) {
+                        if (_state == State.Released || _state == State.Releasing) {
+                            callback.onError(CancellationException("Decoder was released."))
+                        } else {
+                            callback.onError(e)
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     /**
      * Retrieves the size of the JPEG 2000 image asynchronously using cached data.
      *
@@ -382,9 +580,107 @@ class Jp2kDecoderAsync(
         }
     }
 
+    /**
+     * Retrieves the tile grid of the JPEG 2000 image asynchronously without decoding it.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param callback The callback to receive the [TileInfo] or error.
+     */
+    fun getTileInfo(j2kData: ByteArray, callback: Callback<TileInfo>) {
+        val validationError = validateInputSize(j2kData.size)
+        if (validationError != null) {
+            callback.onError(validationError)
+            return
+        }
+
+        logInputDataInfo(j2kData)
+        val encoded = dataChannel.encodePayload(j2kData)
+        logEncodedInputInfo(encoded)
+
+        executeHeaderQuery("getTileInfo", callback, ::parseTileInfo) { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync("globalThis.getTileInfoFromChunks();").get()
+            } else {
+                isolate.evaluateJavaScriptAsync("globalThis.getTileInfo('$encoded');").get()
+            }
+        }
+    }
+
+    /**
+     * Retrieves the tile grid of the JPEG 2000 image asynchronously using cached data.
+     *
+     * @param callback The callback to receive the [TileInfo] or error.
+     */
+    fun getTileInfo(callback: Callback<TileInfo>) {
+        executeHeaderQuery("getTileInfo", callback, ::parseTileInfo) { isolate ->
+            isolate.evaluateJavaScriptAsync("globalThis.getTileInfoWithCache();").get()
+        }
+    }
+
+    /**
+     * Retrieves the coding parameters of the JPEG 2000 image asynchronously from its main header without decoding it.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param callback The callback to receive the [ImageInfo] or error.
+     */
+    fun getImageInfo(j2kData: ByteArray, callback: Callback<ImageInfo>) {
+        val validationError = validateInputSize(j2kData.size)
+        if (validationError != null) {
+            callback.onError(validationError)
+            return
+        }
+
+        logInputDataInfo(j2kData)
+        val encoded = dataChannel.encodePayload(j2kData)
+        logEncodedInputInfo(encoded)
+
+        executeHeaderQuery("getImageInfo", callback, ::parseImageInfo) { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync("globalThis.getImageInfoFromChunks();").get()
+            } else {
+                isolate.evaluateJavaScriptAsync("globalThis.getImageInfo('$encoded');").get()
+            }
+        }
+    }
+
+    /**
+     * Retrieves the coding parameters of the JPEG 2000 image asynchronously using cached data.
+     *
+     * @param callback The callback to receive the [ImageInfo] or error.
+     */
+    fun getImageInfo(callback: Callback<ImageInfo>) {
+        executeHeaderQuery("getImageInfo", callback, ::parseImageInfo) { isolate ->
+            isolate.evaluateJavaScriptAsync("globalThis.getImageInfoWithCache();").get()
+        }
+    }
+
     private fun executeGetSize(
         callback: Callback<Size>,
         evaluate: (JavaScriptIsolate) -> String,
+    ) {
+        executeHeaderQuery("getSize", callback, { root -> Size(root.getInt("width"), root.getInt("height")) }, evaluate)
+    }
+
+    private fun parseTileInfo(root: JSONObject): TileInfo = TileInfo(
+        imageX0 = root.getInt("imageX0"),
+        imageY0 = root.getInt("imageY0"),
+        imageX1 = root.getInt("imageX1"),
+        imageY1 = root.getInt("imageY1"),
+        tileX0 = root.getInt("tileX0"),
+        tileY0 = root.getInt("tileY0"),
+        tileWidth = root.getInt("tileWidth"),
+        tileHeight = root.getInt("tileHeight"),
+        numTilesX = root.getInt("numTilesX"),
+        numTilesY = root.getInt("numTilesY"),
+    )
+
+    private fun <T> executeHeaderQuery(
+        operation: String,
+        callback: Callback<T>,
+        parse: (JSONObject) -> T,
+        evaluate: (JavaScriptIsolate) -> String,
     ) {
         synchronized(lock) {
             if (_state == State.Released || _state == State.Releasing) {
@@ -392,7 +688,7 @@ class Jp2kDecoderAsync(
                 return
             }
             if (_state != State.Initialized && _state != State.Processing) {
-                callback.onError(IllegalStateException("Cannot getSize while in state: $_state"))
+                callback.onError(IllegalStateException("Cannot $operation while in state: $_state"))
                 return
             }
         }
@@ -429,16 +725,14 @@ class Jp2kDecoderAsync(
                         throw Jp2kException(error, errorMessage)
                     }
 
-                    val width = root.getInt("width")
-                    val height = root.getInt("height")
-                    val size = Size(width, height)
+                    val value = parse(root)
 
                     restoreStateAfterDecode()
                     synchronized(lock) {
                         if (_state == State.Released || _state == State.Releasing) {
                             callback.onError(CancellationException("Decoder was released."))
                         } else {
-                            callback.onSuccess(size)
+                            callback.onSuccess(value)
                         }
                     }
 
@@ -463,7 +757,18 @@ class Jp2kDecoderAsync(
      * @param callback The callback to receive the decoded [Bitmap] or error.
      */
     fun decodeImage(colorFormat: ColorFormat = ColorFormat.ARGB8888, callback: Callback<Bitmap>) {
-        decodeImage(0, 0, 0, 0, colorFormat, callback)
+        decodeImage(0, 0, 0, 0, colorFormat, 0, callback)
+    }
+
+    /**
+     * Decodes a JPEG 2000 image asynchronously using cached data at a reduced resolution.
+     *
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeImage(colorFormat: ColorFormat, reduceLevel: Int, callback: Callback<Bitmap>) {
+        decodeImage(0, 0, 0, 0, colorFormat, reduceLevel, callback)
     }
 
     /**
@@ -484,12 +789,109 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
+        decodeImage(left, top, right, bottom, colorFormat, 0, callback)
+    }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image asynchronously using cached data at a reduced resolution.
+     *
+     * @param left The left coordinate of the region.
+     * @param top The top coordinate of the region.
+     * @param right The right coordinate of the region.
+     * @param bottom The bottom coordinate of the region.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeImage(
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeCachedRegion(left, top, right, bottom, colorFormat, reduceLevel, null, callback)
+    }
+
+    /**
+     * Decodes a JPEG 2000 image asynchronously using cached data into [bitmap] instead of allocating a
+     * new [Bitmap].
+     *
+     * The image is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded image at [reduceLevel]. Otherwise the callback receives an [IllegalArgumentException].
+     *
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive [bitmap] or error.
+     */
+    fun decodeImageInto(bitmap: Bitmap, reduceLevel: Int, callback: Callback<Bitmap>) {
+        decodeImageInto(0, 0, 0, 0, bitmap, reduceLevel, callback)
+    }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image asynchronously using cached data into [bitmap]
+     * instead of allocating a new [Bitmap].
+     *
+     * The region is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded region at [reduceLevel]. Otherwise the callback receives an [IllegalArgumentException].
+     *
+     * @param left The left coordinate of the region.
+     * @param top The top coordinate of the region.
+     * @param right The right coordinate of the region.
+     * @param bottom The bottom coordinate of the region.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive [bitmap] or error.
+     */
+    fun decodeImageInto(
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        bitmap: Bitmap,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        val colorFormat = try {
+            colorFormatOf(bitmap)
+        } catch (e: IllegalArgumentException) {
+            callback.onError(e)
+            return
+        }
+        decodeCachedRegion(left, top, right, bottom, colorFormat, reduceLevel, bitmap, callback)
+    }
+
+    private fun decodeCachedRegion(
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        target: Bitmap?,
+        callback: Callback<Bitmap>
+    ) {
+        if (!validateReduceLevel(reduceLevel, callback)) {
+            return
+        }
+
         val measureTimes = config.logLevel != null
         val kotlinStartTime = System.currentTimeMillis()
         val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
         val script =
-            "globalThis.decodeJ2KWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
-        executeDecodeImage(colorFormat, callback) { isolate ->
+            "globalThis.decodeJ2KWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+        val inputKey = if (target == null) precachedInputKey else null
+        // Read again with the decode, under the executionLock precache() writes it under, so that a
+        // precache() that ran while this request was queued cannot pair its pixels with the key of the
+        // previous image
+        var decodedInputKey: String? = null
+        val decodeCallback = withRegionCache(inputKey, left, top, right, bottom, colorFormat, reduceLevel, callback) {
+            decodedInputKey
+        } ?: return
+        executeDecodeImage(colorFormat, decodeCallback, target = target) { isolate ->
+            decodedInputKey = precachedInputKey
             isolate.evaluateJavaScriptAsync(script).get()
         }
     }
@@ -525,7 +927,24 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
-        decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, callback)
+        decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, 0, callback)
+    }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image asynchronously using cached data at a reduced resolution.
+     *
+     * @param region The region to decode.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeImage(
+        region: Rect,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel, callback)
     }
 
     /**
@@ -553,7 +972,24 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
-        decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, callback)
+        decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, 0, callback)
+    }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image asynchronously using cached data at a reduced resolution.
+     *
+     * @param region The region to decode.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeImage(
+        region: RectF,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeImage(region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel, callback)
     }
 
     /**
@@ -587,7 +1023,33 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
-        if (!validateRatio(left, top, right, bottom, callback)) {
+        decodeImage(left, top, right, bottom, colorFormat, 0, callback)
+    }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image asynchronously using cached data at a reduced resolution.
+     *
+     * @param left The left coordinate ratio (0.0 - 1.0).
+     * @param top The top coordinate ratio (0.0 - 1.0).
+     * @param right The right coordinate ratio (0.0 - 1.0).
+     * @param bottom The bottom coordinate ratio (0.0 - 1.0).
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeImage(
+        left: Float,
+        top: Float,
+        right: Float,
+        bottom: Float,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        if (!validateRatio(left, top, right, bottom, callback)) {
+            return
+        }
+        if (!validateReduceLevel(reduceLevel, callback)) {
             return
         }
 
@@ -595,7 +1057,7 @@ class Jp2kDecoderAsync(
         val kotlinStartTime = System.currentTimeMillis()
         val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
         val script =
-            "globalThis.decodeJ2KWithCacheRatio(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+            "globalThis.decodeJ2KWithCacheRatio(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
         executeDecodeImage(colorFormat, callback) { isolate ->
             isolate.evaluateJavaScriptAsync(script).get()
         }
@@ -632,7 +1094,24 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
-        decodeImage(j2kData, 0, 0, 0, 0, colorFormat, callback)
+        decodeImage(j2kData, 0, 0, 0, 0, colorFormat, 0, callback)
+    }
+
+    /**
+     * Decodes a JPEG 2000 image asynchronously at a reduced resolution.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeImage(
+        j2kData: ByteArray,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeImage(j2kData, 0, 0, 0, 0, colorFormat, reduceLevel, callback)
     }
 
     fun decodeImage(
@@ -643,6 +1122,83 @@ class Jp2kDecoderAsync(
         bottom: Int,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
+    ) {
+        decodeImage(j2kData, left, top, right, bottom, colorFormat, 0, callback)
+    }
+
+    fun decodeImage(
+        j2kData: ByteArray,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeRegion(j2kData, left, top, right, bottom, colorFormat, reduceLevel, null, callback)
+    }
+
+    /**
+     * Decodes a JPEG 2000 image asynchronously into [bitmap] instead of allocating a new [Bitmap].
+     *
+     * The image is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded image at [reduceLevel]. Otherwise the callback receives an [IllegalArgumentException].
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive [bitmap] or error.
+     */
+    fun decodeImageInto(j2kData: ByteArray, bitmap: Bitmap, reduceLevel: Int, callback: Callback<Bitmap>) {
+        decodeImageInto(j2kData, 0, 0, 0, 0, bitmap, reduceLevel, callback)
+    }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image asynchronously into [bitmap] instead of allocating
+     * a new [Bitmap].
+     *
+     * The region is decoded in the config of [bitmap], which must be mutable and exactly the size of the
+     * decoded region at [reduceLevel]. Otherwise the callback receives an [IllegalArgumentException].
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param left The left coordinate of the region.
+     * @param top The top coordinate of the region.
+     * @param right The right coordinate of the region.
+     * @param bottom The bottom coordinate of the region.
+     * @param bitmap The Bitmap to decode into. Its config must be ARGB_8888 or RGB_565.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive [bitmap] or error.
+     */
+    fun decodeImageInto(
+        j2kData: ByteArray,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        bitmap: Bitmap,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        val colorFormat = try {
+            colorFormatOf(bitmap)
+        } catch (e: IllegalArgumentException) {
+            callback.onError(e)
+            return
+        }
+        decodeRegion(j2kData, left, top, right, bottom, colorFormat, reduceLevel, bitmap, callback)
+    }
+
+    private fun decodeRegion(
+        j2kData: ByteArray,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        target: Bitmap?,
+        callback: Callback<Bitmap>
     ) {
         if (j2kData.size < MIN_INPUT_SIZE) {
             callback.onError(IllegalArgumentException("Input data is too short"))
@@ -653,6 +1209,11 @@ class Jp2kDecoderAsync(
             callback.onError(validationError)
             return
         }
+        if (!validateReduceLevel(reduceLevel, callback)) {
+            return
+        }
+        val inputKey = if (config.regionCache != null && target == null) Jp2kRegionCache.keyOf(j2kData) else null
+        val decodeCallback = withRegionCache(inputKey, left, top, right, bottom, colorFormat, reduceLevel, callback) ?: return
 
         logInputDataInfo(j2kData)
 
@@ -663,20 +1224,70 @@ class Jp2kDecoderAsync(
         val kotlinStartTime = System.currentTimeMillis()
         val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
 
-        executeDecodeImage(colorFormat, callback, j2kData.size.toLong()) { isolate ->
+        executeDecodeImage(colorFormat, decodeCallback, j2kData.size.toLong(), target) { isolate ->
             if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
                 transferInputInChunks(isolate, encoded)
                 isolate.evaluateJavaScriptAsync(
-                    "globalThis.decodeJ2KFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+                    "globalThis.decodeJ2KFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
                 ).get()
             } else {
                 val script =
-                    "globalThis.decodeJ2K('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+                    "globalThis.decodeJ2K('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
                 isolate.evaluateJavaScriptAsync(script).get()
             }
         }
     }
 
+    /**
+     * Serves the region from [Config.regionCache] if it holds it and returns null. Otherwise returns the
+     * callback to decode with, which caches the decoded region under the key [decodedKey] returns, the
+     * identity of the decoded image, before passing it on to [callback]. Without a cache or an
+     * [inputKey], [callback] itself is returned.
+     */
+    private fun withRegionCache(
+        inputKey: String?,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>,
+        decodedKey: () -> String? = { inputKey },
+    ): Callback<Bitmap>? {
+        val cache = config.regionCache
+        if (cache == null || inputKey == null) {
+            return callback
+        }
+        synchronized(lock) {
+            if (_state == State.Released || _state == State.Releasing) {
+                callback.onError(CancellationException("Decoder was released."))
+                return null
+            }
+        }
+        val cached = try {
+            cache.get(inputKey, left, top, right, bottom, colorFormat, reduceLevel)
+        } catch (e: Exception) {
+            callback.onError(e)
+            return null
+        }
+        if (cached != null) {
+            log(Log.INFO) { "Region cache hit: ($left, $top, $right, $bottom) reduceLevel=$reduceLevel, hit rate ${"%.2f".format(cache.hitRate)}" }
+            callback.onSuccess(cached)
+            return null
+        }
+        return object : Callback<Bitmap> {
+            override fun onSuccess(result: Bitmap) {
+                decodedKey()?.let { key -> cache.put(key, left, top, right, bottom, colorFormat, reduceLevel, result) }
+                callback.onSuccess(result)
+            }
+
+            override fun onError(error: Exception) {
+                callback.onError(error)
+            }
+        }
+    }
+
     fun decodeImage(
         j2kData: ByteArray,
         left: Int,
@@ -694,7 +1305,17 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
-        decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, callback)
+        decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, 0, callback)
+    }
+
+    fun decodeImage(
+        j2kData: ByteArray,
+        region: Rect,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel, callback)
     }
 
     fun decodeImage(
@@ -711,7 +1332,17 @@ class Jp2kDecoderAsync(
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
     ) {
-        decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, callback)
+        decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, 0, callback)
+    }
+
+    fun decodeImage(
+        j2kData: ByteArray,
+        region: RectF,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeImage(j2kData, region.left, region.top, region.right, region.bottom, colorFormat, reduceLevel, callback)
     }
 
     fun decodeImage(
@@ -730,6 +1361,19 @@ class Jp2kDecoderAsync(
         bottom: Float,
         colorFormat: ColorFormat = ColorFormat.ARGB8888,
         callback: Callback<Bitmap>
+    ) {
+        decodeImage(j2kData, left, top, right, bottom, colorFormat, 0, callback)
+    }
+
+    fun decodeImage(
+        j2kData: ByteArray,
+        left: Float,
+        top: Float,
+        right: Float,
+        bottom: Float,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
     ) {
         if (j2kData.size < MIN_INPUT_SIZE) {
             callback.onError(IllegalArgumentException("Input data is too short"))
@@ -743,6 +1387,9 @@ class Jp2kDecoderAsync(
         if (!validateRatio(left, top, right, bottom, callback)) {
             return
         }
+        if (!validateReduceLevel(reduceLevel, callback)) {
+            return
+        }
 
         logInputDataInfo(j2kData)
 
@@ -757,11 +1404,11 @@ class Jp2kDecoderAsync(
             if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
                 transferInputInChunks(isolate, encoded)
                 isolate.evaluateJavaScriptAsync(
-                    "globalThis.decodeJ2KRatioFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+                    "globalThis.decodeJ2KRatioFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
                 ).get()
             } else {
                 val script =
-                    "globalThis.decodeJ2KRatio('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput);"
+                    "globalThis.decodeJ2KRatio('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $left, $top, $right, $bottom, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
                 isolate.evaluateJavaScriptAsync(script).get()
             }
         }
@@ -794,15 +1441,376 @@ class Jp2kDecoderAsync(
         return true
     }
 
+    /**
+     * Decodes a single tile of a JPEG 2000 image asynchronously.
+     *
+     * Only the codestream of the requested tile is decoded, so this is cheaper than a region decode
+     * of the same area. Use [getTileInfo] to obtain the tile grid.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param tileIndex The index of the tile in raster order.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeTile(
+        j2kData: ByteArray,
+        tileIndex: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        if (j2kData.size < MIN_INPUT_SIZE) {
+            callback.onError(IllegalArgumentException("Input data is too short"))
+            return
+        }
+        val validationError = validateInputSize(j2kData.size)
+        if (validationError != null) {
+            callback.onError(validationError)
+            return
+        }
+        if (!validateTileIndex(tileIndex, callback)) {
+            return
+        }
+        if (!validateReduceLevel(reduceLevel, callback)) {
+            return
+        }
+
+        logInputDataInfo(j2kData)
+
+        val measureTimes = config.logLevel != null
+        val encoded = dataChannel.encodePayload(j2kData)
+        logEncodedInputInfo(encoded)
+
+        val kotlinStartTime = System.currentTimeMillis()
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+
+        executeDecodeImage(colorFormat, callback, j2kData.size.toLong()) { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync(
+                    "globalThis.decodeJ2KTileFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $tileIndex, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+                ).get()
+            } else {
+                val script =
+                    "globalThis.decodeJ2KTile('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $tileIndex, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+                isolate.evaluateJavaScriptAsync(script).get()
+            }
+        }
+    }
+
+    /**
+     * Decodes a single tile of a JPEG 2000 image asynchronously with default color format (ARGB 8888).
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param tileIndex The index of the tile in raster order.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeTile(
+        j2kData: ByteArray,
+        tileIndex: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeTile(j2kData, tileIndex, ColorFormat.ARGB8888, 0, callback)
+    }
+
+    /**
+     * Decodes a single tile of a JPEG 2000 image asynchronously using cached data.
+     *
+     * @param tileIndex The index of the tile in raster order.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeTile(
+        tileIndex: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ) {
+        if (!validateTileIndex(tileIndex, callback)) {
+            return
+        }
+        if (!validateReduceLevel(reduceLevel, callback)) {
+            return
+        }
+
+        val measureTimes = config.logLevel != null
+        val kotlinStartTime = System.currentTimeMillis()
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+        val script =
+            "globalThis.decodeJ2KTileWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, $tileIndex, $kotlinStartTime, $chunkedOutput, $reduceLevel);"
+        executeDecodeImage(colorFormat, callback) { isolate ->
+            isolate.evaluateJavaScriptAsync(script).get()
+        }
+    }
+
+    /**
+     * Decodes a single tile of a JPEG 2000 image asynchronously using cached data with default color format (ARGB 8888).
+     *
+     * @param tileIndex The index of the tile in raster order.
+     * @param callback The callback to receive the decoded [Bitmap] or error.
+     */
+    fun decodeTile(
+        tileIndex: Int,
+        callback: Callback<Bitmap>
+    ) {
+        decodeTile(tileIndex, ColorFormat.ARGB8888, 0, callback)
+    }
+
+    /**
+     * Decodes several JPEG 2000 images asynchronously in one call.
+     *
+     * The images are sent to the sandbox as one packed payload and decoded one after another by a single
+     * script evaluation, which also returns all outputs in one packed payload. The cost of a sandbox round
+     * trip is paid once per batch instead of once per image, which matters for many small images such
+     * as thumbnails. Keep batches small enough for all outputs to fit in
+     * [Config.maxEvaluationReturnSizeBytes].
+     *
+     * An image that fails to decode does not fail the others: its entry holds the error, a
+     * [Jp2kException] or an [IllegalArgumentException] if the input is too short. [Callback.onError] is
+     * only called when the batch as a whole fails.
+     *
+     * @param images The raw byte arrays of the JPEG 2000 images.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard. Each level halves the output size.
+     * @param callback The callback to receive one [Result] per image, in the order of [images], or error.
+     */
+    fun decodeImages(
+        images: List<ByteArray>,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: Callback<List<Result<Bitmap>>>
+    ) {
+        if (reduceLevel < 0) {
+            callback.onError(IllegalArgumentException("reduceLevel must be 0 or greater"))
+            return
+        }
+        if (images.isEmpty()) {
+            callback.onSuccess(emptyList())
+            return
+        }
+
+        // Inputs that are too short are not sent, their entries fail in the sandbox and are replaced below
+        val packed = try {
+            packBatchInput(images.map { if (it.size < MIN_INPUT_SIZE) ByteArray(0) else it })
+        } catch (e: IllegalArgumentException) {
+            callback.onError(e)
+            return
+        }
+        val validationError = validateInputSize(packed.size)
+        if (validationError != null) {
+            callback.onError(validationError)
+            return
+        }
+        log(Log.INFO) { "Batch of ${images.size} images, packed input length: ${packed.size}" }
+
+        val encoded = dataChannel.encodePayload(packed)
+        logEncodedInputInfo(encoded)
+
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+
+        executeDecode("decodeImages", callback, packed.size.toLong(), { isolate ->
+            if (!isEvaluateWithoutTransactionLimitSupported && dataChannel.isStringMediated) {
+                transferInputInChunks(isolate, encoded)
+                isolate.evaluateJavaScriptAsync(
+                    "globalThis.decodeJ2KBatchFromChunks(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $reduceLevel, $chunkedOutput);"
+                ).get()
+            } else {
+                val script =
+                    "globalThis.decodeJ2KBatch('$encoded', ${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $reduceLevel, $chunkedOutput);"
+                isolate.evaluateJavaScriptAsync(script).get()
+            }
+        }) { output ->
+            unpackBatchOutput(output, images.size).mapIndexed { index, entry ->
+                when {
+                    images[index].size < MIN_INPUT_SIZE ->
+                        Result.failure(IllegalArgumentException("Input data is too short"))
+                    entry.errorCode != 0 ->
+                        Result.failure(Jp2kException(Jp2kError.fromInt(entry.errorCode)))
+                    else -> runCatching {
+                        createBitmapFromOutput(output.payload, entry.offset, entry.length, output.isRaw, colorFormat, pool = config.bitmapPool)
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Decodes several JPEG 2000 images asynchronously in one call with default color format (ARGB 8888).
+     *
+     * @param images The raw byte arrays of the JPEG 2000 images.
+     * @param callback The callback to receive one [Result] per image, in the order of [images], or error.
+     */
+    fun decodeImages(
+        images: List<ByteArray>,
+        callback: Callback<List<Result<Bitmap>>>
+    ) {
+        decodeImages(images, ColorFormat.ARGB8888, 0, callback)
+    }
+
+    /**
+     * Decodes a JPEG 2000 image progressively and asynchronously.
+     *
+     * The image data is cached as with [precache], then decoded as with [decodeImageProgressive]
+     * using cached data.
+     *
+     * @param j2kData The raw byte array of the JPEG 2000 image.
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard in the final image.
+     * @param callback The callback to receive each decoded [Bitmap] or error.
+     */
+    fun decodeImageProgressive(
+        j2kData: ByteArray,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: ProgressiveCallback
+    ) {
+        if (reduceLevel < 0) {
+            callback.onError(IllegalArgumentException("reduceLevel must be 0 or greater"))
+            return
+        }
+        precache(j2kData, object : Callback<Unit> {
+            override fun onSuccess(result: Unit) {
+                decodeImageProgressive(colorFormat, reduceLevel, callback)
+            }
+
+            override fun onError(error: Exception) {
+                callback.onError(error)
+            }
+        })
+    }
+
+    /**
+     * Decodes a JPEG 2000 image progressively and asynchronously using cached data.
+     *
+     * [ProgressiveCallback.onProgress] first receives a preview decoded with one quality layer and
+     * [PROGRESSIVE_PREVIEW_REDUCE_LEVELS] more resolution levels discarded, then the image at [reduceLevel]
+     * with all quality layers. The preview is skipped when the image has a single quality layer and cannot
+     * be reduced further.
+     *
+     * All steps decode from the decode session of the cached data, so the codestream is transferred once.
+     * Other calls on this decoder may run between the steps.
+     *
+     * @param colorFormat The desired output color format.
+     * @param reduceLevel The number of resolution levels to discard in the final image.
+     * @param callback The callback to receive each decoded [Bitmap] or error.
+     */
+    fun decodeImageProgressive(
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        callback: ProgressiveCallback
+    ) {
+        if (reduceLevel < 0) {
+            callback.onError(IllegalArgumentException("reduceLevel must be 0 or greater"))
+            return
+        }
+        executeHeaderQuery("decodeImageProgressive", object : Callback<List<ProgressiveStep>> {
+            override fun onSuccess(result: List<ProgressiveStep>) {
+                decodeProgressiveStep(colorFormat, result, 0, callback)
+            }
+
+            override fun onError(error: Exception) {
+                callback.onError(error)
+            }
+        }, ::parseProgressiveSteps) { isolate ->
+            isolate.evaluateJavaScriptAsync("globalThis.getProgressivePlan($reduceLevel);").get()
+        }
+    }
+
+    /**
+     * Decodes a JPEG 2000 image progressively and asynchronously using cached data with default color format
+     * (ARGB 8888) and no resolution reduction.
+     *
+     * @param callback The callback to receive each decoded [Bitmap] or error.
+     */
+    fun decodeImageProgressive(callback: ProgressiveCallback) {
+        decodeImageProgressive(ColorFormat.ARGB8888, 0, callback)
+    }
+
+    // Each step is queued once the previous one has been delivered.
+    private fun decodeProgressiveStep(
+        colorFormat: ColorFormat,
+        steps: List<ProgressiveStep>,
+        index: Int,
+        callback: ProgressiveCallback
+    ) {
+        val step = steps[index]
+        val isFinal = index == steps.lastIndex
+
+        val measureTimes = config.logLevel != null
+        val kotlinStartTime = System.currentTimeMillis()
+        val chunkedOutput = !isEvaluateWithoutTransactionLimitSupported
+        val script =
+            "globalThis.decodeJ2KWithCache(${config.maxPixels}, ${config.maxHeapSizeBytes}, ${colorFormat.id}, $measureTimes, 0, 0, 0, 0, $kotlinStartTime, $chunkedOutput, ${step.reduceLevel}, ${step.qualityLayers});"
+
+        executeDecodeImage(colorFormat, object : Callback<Bitmap> {
+            override fun onSuccess(result: Bitmap) {
+                callback.onProgress(result, isFinal)
+                if (!isFinal) {
+                    decodeProgressiveStep(colorFormat, steps, index + 1, callback)
+                }
+            }
+
+            override fun onError(error: Exception) {
+                callback.onError(error)
+            }
+        }) { isolate ->
+            isolate.evaluateJavaScriptAsync(script).get()
+        }
+    }
+
+    private fun validateTileIndex(
+        tileIndex: Int,
+        callback: Callback<Bitmap>
+    ): Boolean {
+        if (tileIndex < 0) {
+            callback.onError(IllegalArgumentException("tileIndex must be 0 or greater"))
+            return false
+        }
+        return true
+    }
+
+    private fun validateReduceLevel(
+        reduceLevel: Int,
+        callback: Callback<Bitmap>
+    ): Boolean {
+        if (reduceLevel < 0) {
+            callback.onError(IllegalArgumentException("reduceLevel must be 0 or greater"))
+            return false
+        }
+        return true
+    }
+
     private fun executeDecodeImage(
         colorFormat: ColorFormat,
         callback: Callback<Bitmap>,
         inputSize: Long = 0L,
+        target: Bitmap? = null,
+        evaluate: (JavaScriptIsolate) -> String,
+    ) {
+        executeDecode("decodeImage", callback, inputSize, evaluate) { output ->
+            createBitmapFromOutput(output.payload, output.offset, output.length, output.isRaw, colorFormat, target, config.bitmapPool)
+        }
+    }
+
+    /**
+     * Runs a decode script on the background executor and converts the decoder output it returns with
+     * [createResult].
+     *
+     * The script either returns the result JSON, or [INTERNAL_RESULT_FRAME] after posting a binary
+     * result frame through the data channel.
+     */
+    private fun <T> executeDecode(
+        operation: String,
+        callback: Callback<T>,
+        inputSize: Long,
         evaluate: (JavaScriptIsolate) -> String,
+        createResult: (DecodeOutput) -> T,
     ) {
         synchronized(lock) {
             if (_state != State.Initialized && _state != State.Processing) {
-                callback.onError(IllegalStateException("Cannot decodeImage while in state: $_state"))
+                callback.onError(IllegalStateException("Cannot $operation while in state: $_state"))
                 return
             }
         }
@@ -819,94 +1827,56 @@ class Jp2kDecoderAsync(
                         return@execute
                     }
                     _state = State.Processing
+                    decodeGeneration++
+                    idleRecycleFuture?.cancel(false)
                 }
 
                 dataChannel.prepareForDecode()
 
                 val start = System.currentTimeMillis()
+                var wasmHeapSizeBytes = 0L
 
                 try {
                     val isolate = checkNotNull(jsIsolate) { "Jp2kDecoder has not been initialized." }
 
+                    // The deadline is the same for every request, so there is nothing to clear without one
+                    if (config.decodeTimeoutMillis > 0) {
+                        val timeout = config.decodeTimeoutMillis.coerceAtMost(MAX_REQUEST_TIMEOUT_MILLIS)
+                        isolate.evaluateJavaScriptAsync("globalThis.beginRequest($timeout);").get()
+                    }
+
                     val measureTimes = config.logLevel != null
                     val transferStart = if (measureTimes) System.nanoTime() else 0L
 
-                    val jsonResult = ensureNotEmpty(evaluate(isolate), "JSON")
+                    val evaluated = ensureNotEmpty(evaluate(isolate), "JSON")
                     val kotlinReceiveTimeMs = System.currentTimeMillis()
                     val transferEnd = if (measureTimes) System.nanoTime() else 0L
 
-                    val root = JSONObject(jsonResult)
-                    if (root.has("errorCode")) {
-                        val errorCode = root.getInt("errorCode")
-                        if (errorCode == Jp2kError.CacheDataMissing.code) {
-                            throw IllegalStateException("No data cached")
-                        }
-                        val error = Jp2kError.fromInt(errorCode)
-                        val errorMessage =
-                            if (root.has("errorMessage")) root.getString("errorMessage") else null
-                        log(Log.ERROR) { "Error: $error, Message: $errorMessage" }
-
-                        if (error == Jp2kError.RegionOutOfBounds) {
-                            throw RegionOutOfBoundsException(errorMessage)
-                        }
-
-                        throw Jp2kException(error, errorMessage)
-                    } else if (root.has("error")) {
-                        val errorMsg = root.getString("error")
-                        log(Log.ERROR) { "Error: $errorMsg" }
-                        throw Jp2kException(Jp2kError.Unknown, errorMsg)
-                    }
-
-                    val bmpBase64 = if (root.optBoolean("isChunked", false)) {
-                        val outputSize = root.getInt("outputSize")
-                        val sb = java.lang.StringBuilder(outputSize)
-                        var offset = 0
-                        while (offset < outputSize) {
-                            val length = minOf(config.binderTransactionMaxChunkSizeBytes, outputSize - offset)
-                            val chunk = isolate.evaluateJavaScriptAsync("globalThis.getOutputChunk($offset, $length);").get()
-                            sb.append(chunk)
-                            offset += length
-                        }
-                        isolate.evaluateJavaScriptAsync("globalThis.clearOutput();").get()
-                        sb.toString()
-                    } else {
-                        root.optString("bmp", "")
-                    }
-
-                    if (dataChannel.isStringMediated) {
-                        log(Log.INFO) { "Output encoded content length: ${bmpBase64.length} chars" }
-                        log(Log.INFO) { "Output encoded content (64 chars per line):\n${bmpBase64.chunked64()}" }
-                    }
-
                     val kotlinDecodeStart = System.nanoTime()
-                    val bmpBytes = dataChannel.retrieveDecodedBytes(bmpBase64)
-
-                    val options = BitmapFactory.Options().apply {
-                        inPreferredConfig = when (colorFormat) {
-                            ColorFormat.RGB565 -> Bitmap.Config.RGB_565
-                            ColorFormat.ARGB8888 -> Bitmap.Config.ARGB_8888
-                        }
+                    val (output, timings) = if (evaluated == INTERNAL_RESULT_FRAME) {
+                        readResultFrame()
+                    } else {
+                        readResultJson(isolate, evaluated)
                     }
 
-                    val bitmap =
-                        BitmapFactory.decodeByteArray(bmpBytes, 0, bmpBytes.size, options)
+                    val result = createResult(output)
 
                     val kotlinDecodeTimeMs = (System.nanoTime() - kotlinDecodeStart) / 1_000_000.0
 
-                    log(Log.INFO) { "Output data length: ${bmpBytes.size} bytes" }
+                    log(Log.INFO) { "Output data length: ${output.length} bytes" }
+                    wasmHeapSizeBytes = timings.wasmHeapSizeBytes
 
                     if (measureTimes) {
-                        val timePreProcess = root.optDouble("timePreProcess", 0.0)
-                        val timeWasm = root.optDouble("timeWasm", 0.0)
-                        val timePostProcess = root.optDouble("timePostProcess", 0.0)
+                        val timePreProcess = timings.timePreProcess
+                        val timeWasm = timings.timeWasm
+                        val timePostProcess = timings.timePostProcess
                         val dataTransferTimeMs = (transferEnd - transferStart) / 1_000_000.0
-                        val jsDecodeTimeMs = root.optDouble("timeBase64Decode", 0.0)
-                        val jsEncodeTimeMs = root.optDouble("timeBase64Encode", 0.0)
-                        val wasmHeapSizeBytes = root.optLong("wasmHeapSizeBytes", 0)
+                        val jsDecodeTimeMs = timings.timeBase64Decode
+                        val jsEncodeTimeMs = timings.timeBase64Encode
                         val totalMs = (System.currentTimeMillis() - start).toDouble()
 
-                        val inputTransferDelayMs = root.optDouble("inputTransferDelayMs", 0.0)
-                        val jsFinishTimeMs = root.optLong("jsFinishTimeMs", 0L)
+                        val inputTransferDelayMs = timings.inputTransferDelayMs
+                        val jsFinishTimeMs = timings.jsFinishTimeMs
                         val outputTransferDelayMs = if (jsFinishTimeMs > 0) Math.max(0.0, (kotlinReceiveTimeMs - jsFinishTimeMs).toDouble()) else 0.0
 
                         log(Log.INFO) { "Input transfer start delay (Kotlin -> JS start): ${"%.2f".format(inputTransferDelayMs)} ms" }
@@ -922,10 +1892,18 @@ class Jp2kDecoderAsync(
                             jsDecodeTimeMs = jsDecodeTimeMs,
                             wasmProcessingTimeMs = timeWasm,
                             jsEncodeTimeMs = jsEncodeTimeMs,
-                            outputDataSizeBytes = bmpBytes.size.toLong(),
+                            outputDataSizeBytes = output.length.toLong(),
                             wasmHeapSizeBytes = wasmHeapSizeBytes,
                             totalProcessingTimeMs = totalMs,
+                            headerTimeMs = timings.stats?.headerTimeMs ?: 0.0,
+                            codestreamDecodeTimeMs = timings.stats?.codestreamDecodeTimeMs ?: 0.0,
+                            conversionTimeMs = timings.stats?.conversionTimeMs ?: 0.0,
+                            tilesDecoded = timings.stats?.tilesDecoded ?: 0L,
+                            bytesRead = timings.stats?.bytesRead ?: 0L,
+                            wasmAllocationCount = timings.stats?.allocationCount ?: 0L,
+                            wasmAllocatedBytes = timings.stats?.allocatedBytes ?: 0L,
                         )
+                        _lastPerformanceMetrics = metrics
 
                         val inputStr = "%d".format(metrics.inputDataSizeBytes)
                         val outputStr = "%d".format(metrics.outputDataSizeBytes)
@@ -943,14 +1921,18 @@ class Jp2kDecoderAsync(
                         log(Log.INFO) {
                             "Pre-process: $timePreProcess ms, WASM: $timeWasm ms, Post-process: $timePostProcess ms"
                         }
-                    }
-
-                    if (bitmap == null) {
-                        throw IllegalStateException("Bitmap decoding failed (returned null).")
+                        if (timings.stats != null) {
+                            log(Log.INFO) {
+                                "WASM stages: header ${"%.2f".format(metrics.headerTimeMs)} ms, codestream ${"%.2f".format(metrics.codestreamDecodeTimeMs)} ms, " +
+                                "conversion ${"%.2f".format(metrics.conversionTimeMs)} ms, tiles=${metrics.tilesDecoded} bytesRead=${metrics.bytesRead}B " +
+                                "allocations=${metrics.wasmAllocationCount} (${metrics.wasmAllocatedBytes}B)"
+                            }
+                        }
                     }
 
                     val time = System.currentTimeMillis() - start
-                    log(Log.INFO) { "decodeImage() finished in $time msec" }
+                    log(Log.INFO) { "$operation() finished in $time msec" }
+                    recordFirstDecode()
 
                     restoreStateAfterDecode()
                     // Check if released during decode (unlikely due to lock, but good practice)
@@ -958,13 +1940,14 @@ class Jp2kDecoderAsync(
                         if (_state == State.Released || _state == State.Releasing) {
                             callback.onError(CancellationException("Decoder was released."))
                         } else {
-                            callback.onSuccess(bitmap)
+                            callback.onSuccess(result)
                         }
                     }
+                    scheduleHeapRecycle(wasmHeapSizeBytes)
 
                 } catch (e: Exception) {
                     val time = System.currentTimeMillis() - start
-                    log(Log.ERROR) { "decodeImage() failed in $time msec. Error: ${e.message}" }
+                    log(Log.ERROR) { "$operation() failed in $time msec. Error: ${e.message}" }
                     restoreStateAfterDecode()
                     synchronized(lock) {
                         if (_state == State.Released || _state == State.Releasing) {
@@ -973,9 +1956,224 @@ class Jp2kDecoderAsync(
                             callback.onError(e)
                         }
                     }
+                    scheduleHeapRecycle(0L)
+                }
+            }
+        }
+    }
+
+    /**
+     * Queues the recycles [Config.heapRecyclePolicy] asks for once a decode left the WASM heap at
+     * [wasmHeapSizeBytes], and restarts the idle timer.
+     */
+    private fun scheduleHeapRecycle(wasmHeapSizeBytes: Long) {
+        val policy = config.heapRecyclePolicy ?: return
+        if (policy.highWaterMarkBytes > 0 && wasmHeapSizeBytes >= policy.highWaterMarkBytes) {
+            queueHeapRecycle(HeapRecycleTrigger.HighWaterMark)
+        }
+        if (policy.idleTimeoutMillis <= 0) {
+            return
+        }
+        synchronized(lock) {
+            if (_state == State.Released || _state == State.Releasing) {
+                return
+            }
+            val scheduler = idleRecycleScheduler
+                ?: Executors.newSingleThreadScheduledExecutor().also { idleRecycleScheduler = it }
+            val generation = decodeGeneration
+            idleRecycleFuture?.cancel(false)
+            idleRecycleFuture = scheduler.schedule(
+                Runnable { queueHeapRecycle(HeapRecycleTrigger.Idle, generation) },
+                policy.idleTimeoutMillis,
+                TimeUnit.MILLISECONDS,
+            )
+        }
+    }
+
+    /**
+     * Recycles the WASM heap if the system trims memory at [HeapRecyclePolicy.trimMemoryLevel] or
+     * higher. Called by the callbacks [init] registers; apps that dispatch `onTrimMemory` themselves
+     * may call it directly.
+     *
+     * @param level The level passed to `ComponentCallbacks2.onTrimMemory`.
+     */
+    fun onTrimMemory(level: Int) {
+        val trimMemoryLevel = config.heapRecyclePolicy?.trimMemoryLevel ?: return
+        if (level >= trimMemoryLevel) {
+            queueHeapRecycle(HeapRecycleTrigger.TrimMemory)
+        }
+    }
+
+    private fun registerTrimMemoryCallbacks(context: Context) {
+        if (config.heapRecyclePolicy?.trimMemoryLevel == null || trimMemoryCallbacks != null) {
+            return
+        }
+        val appContext = context.applicationContext ?: context
+        val callbacks = object : ComponentCallbacks2 {
+            override fun onTrimMemory(level: Int) = this@Jp2kDecoderAsync.onTrimMemory(level)
+            override fun onLowMemory() = queueHeapRecycle(HeapRecycleTrigger.TrimMemory)
+            override fun onConfigurationChanged(newConfig: Configuration) {
+                // DO NOTHING
+            }
+        }
+        appContext.registerComponentCallbacks(callbacks)
+        trimMemoryCallbacks = appContext to callbacks
+    }
+
+    /**
+     * Queues a recycle of the WASM heap behind the requests already on [backgroundExecutor]. An idle
+     * recycle is dropped if a decode ran after [generation].
+     */
+    private fun queueHeapRecycle(trigger: HeapRecycleTrigger, generation: Long? = null) {
+        synchronized(lock) {
+            if (_state == State.Released || _state == State.Releasing) {
+                return
+            }
+        }
+        try {
+            backgroundExecutor.execute {
+                synchronized(executionLock) {
+                    recycleHeap(trigger, generation)
                 }
             }
+        } catch (e: Exception) {
+            log(Log.ERROR) { "Heap recycle ($trigger) could not be queued. Error: ${e.message}" }
+        }
+    }
+
+    /**
+     * Swaps in a fresh WASM instance between two requests, handing the grown heap of the current one
+     * back to the garbage collector. Failures are logged and keep the current instance.
+     */
+    private fun recycleHeap(trigger: HeapRecycleTrigger, generation: Long?) {
+        val policy = config.heapRecyclePolicy ?: return
+        val isolate: JavaScriptIsolate
+        synchronized(lock) {
+            if (_state != State.Initialized || (generation != null && generation != decodeGeneration)) {
+                return
+            }
+            isolate = jsIsolate ?: return
+            _state = State.Processing
+        }
+
+        val start = System.nanoTime()
+        try {
+            val minHeapBytes = if (trigger == HeapRecycleTrigger.HighWaterMark) policy.highWaterMarkBytes else 0L
+            val jsonResult = isolate.evaluateJavaScriptAsync("globalThis.recycleWasmInstance($minHeapBytes);").get()
+            val root = JSONObject(ensureNotEmpty(jsonResult, "JSON"))
+            if (root.has("errorCode")) {
+                log(Log.ERROR) { "Heap recycle ($trigger) failed. Error: ${root.optString("errorMessage")}" }
+                return
+            }
+            if (!root.optBoolean("recycled", false)) {
+                log(Log.INFO) { "Heap recycle ($trigger) skipped: WASM heap ${root.optLong("wasmHeapSizeBytes", 0)} bytes" }
+                return
+            }
+
+            val reclaimedBytes = root.optLong("reclaimedBytes", 0)
+            val swapLatencyMs = (System.nanoTime() - start) / 1_000_000.0
+            val previous = _heapRecycleMetrics
+            _heapRecycleMetrics = HeapRecycleMetrics(
+                recycleCount = (previous?.recycleCount ?: 0) + 1,
+                totalReclaimedBytes = (previous?.totalReclaimedBytes ?: 0L) + reclaimedBytes,
+                lastReclaimedBytes = reclaimedBytes,
+                lastSwapLatencyMs = swapLatencyMs,
+                lastTrigger = trigger,
+            )
+            log(Log.INFO) { "Heap recycle ($trigger): reclaimed $reclaimedBytes bytes in ${"%.2f".format(swapLatencyMs)} ms" }
+        } catch (e: Exception) {
+            log(Log.ERROR) { "Heap recycle ($trigger) failed. Error: ${e.message}" }
+        } finally {
+            restoreStateAfterDecode()
+        }
+    }
+
+    /**
+     * Takes the binary result frame posted by the decode script from the data channel.
+     */
+    private fun readResultFrame(): Pair<DecodeOutput, DecodeTimings> {
+        val frame = parseResultFrame(dataChannel.retrieveDecodedBytes(""))
+        if (frame.errorCode != 0) {
+            throw Jp2kException(Jp2kError.fromInt(frame.errorCode))
+        }
+        log(Log.INFO) { "Result frame: ${frame.width}x${frame.height}, stride ${frame.stride}" }
+        return frame.output to frame.timings
+    }
+
+    /**
+     * Reads the result JSON returned by the decode script and the decoder output it refers to.
+     */
+    private fun readResultJson(isolate: JavaScriptIsolate, jsonResult: String): Pair<DecodeOutput, DecodeTimings> {
+        val root = JSONObject(jsonResult)
+        if (root.has("errorCode")) {
+            val errorCode = root.getInt("errorCode")
+            if (errorCode == Jp2kError.CacheDataMissing.code) {
+                throw IllegalStateException("No data cached")
+            }
+            val error = Jp2kError.fromInt(errorCode)
+            val errorMessage =
+                if (root.has("errorMessage")) root.getString("errorMessage") else null
+            log(Log.ERROR) { "Error: $error, Message: $errorMessage" }
+
+            if (error == Jp2kError.RegionOutOfBounds) {
+                throw RegionOutOfBoundsException(errorMessage)
+            }
+
+            throw Jp2kException(error, errorMessage)
+        } else if (root.has("error")) {
+            val errorMsg = root.getString("error")
+            log(Log.ERROR) { "Error: $errorMsg" }
+            throw Jp2kException(Jp2kError.Unknown, errorMsg)
+        }
+
+        val isRaw = root.optBoolean("raw", false)
+        if (root.optBoolean("isChunked", false)) {
+            return readOutputChunks(isolate, root.getInt("outputSize"), isRaw) to DecodeTimings.fromJson(root)
+        }
+        val bmpBase64 = root.optString("bmp", "")
+
+        if (dataChannel.isStringMediated) {
+            log(Log.INFO) { "Output encoded content length: ${bmpBase64.length} chars" }
+            log(Log.INFO) { "Output encoded content (64 chars per line):\n${bmpBase64.chunked64()}" }
+        }
+
+        val bmpBytes = dataChannel.retrieveDecodedBytes(bmpBase64)
+        val output = DecodeOutput(bmpBytes, 0, bmpBytes.size, isRaw)
+        return output to DecodeTimings.fromJson(root)
+    }
+
+    /**
+     * Reads a chunked output of [outputSize] characters with up to [Config.chunkTransferWindow] chunks in
+     * flight. When the data channel has a [ChunkDecoder], each chunk is decoded into the output as it
+     * arrives, so the encoded output is never held as a whole.
+     */
+    private fun readOutputChunks(isolate: JavaScriptIsolate, outputSize: Int, isRaw: Boolean): DecodeOutput {
+        val chunkDecoder = dataChannel.createChunkDecoder(outputSize)
+        val chunkSize = chunkDecoder?.alignChunkSize(config.binderTransactionMaxChunkSizeBytes)
+            ?: config.binderTransactionMaxChunkSizeBytes
+        val encoded = StringBuilder(if (chunkDecoder == null) outputSize else 0)
+
+        pipelineChunks(
+            count = chunkCount(outputSize, chunkSize),
+            window = config.chunkTransferWindow,
+            evaluate = { index ->
+                val offset = index * chunkSize
+                val length = minOf(chunkSize, outputSize - offset)
+                isolate.evaluateJavaScriptAsync("globalThis.getOutputChunk($offset, $length);")
+            },
+            await = { it.get() },
+            onResult = { _, chunk ->
+                if (chunkDecoder != null) chunkDecoder.decode(chunk) else encoded.append(chunk)
+            },
+        )
+        isolate.evaluateJavaScriptAsync("globalThis.clearOutput();").get()
+
+        log(Log.INFO) { "Output encoded content length: $outputSize chars" }
+        if (chunkDecoder != null) {
+            return DecodeOutput(chunkDecoder.output, 0, chunkDecoder.length, isRaw)
         }
+        val bytes = dataChannel.retrieveDecodedBytes(encoded.toString())
+        return DecodeOutput(bytes, 0, bytes.size, isRaw)
     }
 
     private fun restoreStateAfterDecode() {
@@ -1046,6 +2244,10 @@ class Jp2kDecoderAsync(
 
                     val usage = MemoryUsage(
                         wasmHeapSizeBytes = root.optLong("wasmHeapSizeBytes", 0),
+                        scratchHighWaterMarkBytes = root.optLong("scratchHighWaterMarkBytes", 0),
+                        heapInUseBytes = root.optLong("heapInUseBytes", 0),
+                        lastDecodePeakBytes = root.optLong("lastDecodePeakBytes", 0),
+                        lastDecodeEstimatedPeakBytes = root.optLong("lastDecodeEstimatedPeakBytes", 0),
                     )
                     restoreStateAfterDecode()
                     callback.onSuccess(usage)
@@ -1079,7 +2281,12 @@ class Jp2kDecoderAsync(
             _state = State.Releasing
             isolateToClose = jsIsolate
             jsIsolate = null
+            idleRecycleFuture?.cancel(false)
+            idleRecycleScheduler?.shutdownNow()
+            idleRecycleScheduler = null
         }
+        trimMemoryCallbacks?.let { (context, callbacks) -> context.unregisterComponentCallbacks(callbacks) }
+        trimMemoryCallbacks = null
 
         try {
             isolateToClose?.close()
@@ -1097,6 +2304,5 @@ class Jp2kDecoderAsync(
     companion object {
         private const val TAG = "Jp2kDecoderAsync"
         private const val MIN_INPUT_SIZE = 12 // Signature box length
-        private const val ASSET_PATH_WASM = "openjpeg_core.wasm"
     }
 }
@@ -0,0 +1,461 @@
+package dev.keiji.jp2k
+
+import android.content.Context
+import android.graphics.Bitmap
+import android.graphics.Rect
+import android.util.Log
+import kotlinx.coroutines.CoroutineDispatcher
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.async
+import kotlinx.coroutines.awaitAll
+import kotlinx.coroutines.cancel
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.launch
+import java.util.concurrent.CancellationException
+
+/**
+ * Pool of [Jp2kDecoder]s for decoding images in parallel.
+ *
+ * A [Jp2kDecoder] runs one decode at a time on its own JavaScript isolate. The pool owns several
+ * initialized decoders, each with its own isolate and WASM module, and dispatches every request to an
+ * idle decoder, preferring the one that has been least busy. When all decoders are busy, a new one is
+ * added up to [maxSize]; at [maxSize] the request waits for the decoder with the fewest requests in
+ * flight. Decoders that stay idle for [idleTimeoutMillis] are released, down to [minSize], whether or
+ * not other requests arrive meanwhile.
+ *
+ * Each decoder holds its own WASM heap of up to [Config.maxHeapSizeBytes], so [maxSize] bounds the
+ * memory of the pool as well. The pool only offers the functions that take the image data; data
+ * cached with [Jp2kDecoder.precache] is bound to one isolate.
+ *
+ * @param config The configuration object used for every decoder of the pool.
+ * @param minSize The number of decoders created by [init] and kept while idle. Must be 1 or greater.
+ * @param maxSize The maximum number of decoders. Defaults to the number of available processors,
+ * capped at [DEFAULT_POOL_MAX_SIZE].
+ * @param idleTimeoutMillis The time a decoder stays idle before it is released. Defaults to
+ * [DEFAULT_POOL_IDLE_TIMEOUT_MILLIS].
+ * @param coroutineDispatcher The CoroutineDispatcher passed to every decoder. Defaults to [Dispatchers.Default].
+ */
+class Jp2kDecoderPool(
+    private val config: Config = Config(),
+    val minSize: Int = 1,
+    val maxSize: Int = maxOf(minSize, minOf(Runtime.getRuntime().availableProcessors(), DEFAULT_POOL_MAX_SIZE)),
+    private val idleTimeoutMillis: Long = DEFAULT_POOL_IDLE_TIMEOUT_MILLIS,
+    private val coroutineDispatcher: CoroutineDispatcher = Dispatchers.Default,
+) : AutoCloseable {
+
+    init {
+        require(minSize >= 1) { "minSize must be 1 or greater" }
+        require(maxSize >= minSize) { "maxSize must be minSize or greater" }
+        require(idleTimeoutMillis >= 0) { "idleTimeoutMillis must be 0 or greater" }
+    }
+
+    private class Member(val decoder: Jp2kDecoder, val createdAtNanos: Long) {
+        var activeRequests = 0
+        var completedRequests = 0L
+        var busyNanos = 0L
+        var busySinceNanos = 0L
+        var idleSinceNanos = createdAtNanos
+        // Releases the decoder once it has stayed idle for idleTimeoutMillis
+        var idleJob: Job? = null
+    }
+
+    private val lock = Any()
+    private val members = mutableListOf<Member>()
+    private var pendingCreations = 0
+    private var context: Context? = null
+
+    // Runs the idle timers of the decoders
+    private val idleScope = CoroutineScope(SupervisorJob() + coroutineDispatcher)
+
+    @Volatile
+    private var _state = State.Uninitialized
+
+    /**
+     * The current state of the pool.
+     */
+    val state: State
+        get() = _state
+
+    /**
+     * The current number of decoders in the pool.
+     */
+    val size: Int
+        get() = synchronized(lock) { members.size }
+
+    private inline fun log(priority: Int, message: () -> String) {
+        if (config.logLevel != null && priority >= config.logLevel) {
+            val msg = message().trimLines(config.maxLogLines)
+            config.logger.println(priority, TAG, msg)
+        }
+    }
+
+    /**
+     * Initializes the pool with [minSize] decoders.
+     *
+     * This method must be called before decoding. The decoders are initialized in parallel.
+     *
+     * @param context The Android Context. The application context is kept to create decoders later.
+     * @throws Exception If initialization fails.
+     */
+    suspend fun init(context: Context) {
+        synchronized(lock) {
+            if (_state == State.Initialized) {
+                return
+            }
+            if (_state != State.Uninitialized) {
+                throw IllegalStateException("Cannot initialize while in state: $_state")
+            }
+            _state = State.Initializing
+            this.context = context.applicationContext ?: context
+        }
+
+        val start = System.currentTimeMillis()
+        val results = coroutineScope {
+            List(minSize) { async { runCatching { createDecoder(context) } } }.awaitAll()
+        }
+        val failure = results.firstNotNullOfOrNull { it.exceptionOrNull() }
+        if (failure != null) {
+            results.forEach { result -> result.getOrNull()?.release() }
+            synchronized(lock) {
+                if (_state == State.Initializing) {
+                    _state = State.Uninitialized
+                }
+            }
+            log(Log.ERROR) { "init() failed. Error: ${failure.message}" }
+            throw failure
+        }
+        val decoders = results.map { it.getOrThrow() }
+
+        val released = synchronized(lock) {
+            if (_state == State.Initializing) {
+                val now = System.nanoTime()
+                decoders.forEach { members.add(Member(it, now)) }
+                _state = State.Initialized
+                false
+            } else {
+                true
+            }
+        }
+        if (released) {
+            decoders.forEach { it.release() }
+            throw CancellationException("Jp2kDecoderPool was released during initialization.")
+        }
+
+        val time = System.currentTimeMillis() - start
+        log(Log.INFO) { "init() finished in $time msec with $minSize decoders" }
+    }
+
+    private suspend fun createDecoder(context: Context): Jp2kDecoder {
+        val decoder = Jp2kDecoder(config, coroutineDispatcher)
+        try {
+            decoder.init(context)
+        } catch (e: Exception) {
+            decoder.release()
+            throw e
+        }
+        return decoder
+    }
+
+    /**
+     * Decodes a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeImage
+     */
+    suspend fun decodeImage(
+        j2kData: ByteArray,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap = withDecoder { it.decodeImage(j2kData, colorFormat, reduceLevel) }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeImage
+     */
+    suspend fun decodeImage(
+        j2kData: ByteArray,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap = withDecoder { it.decodeImage(j2kData, left, top, right, bottom, colorFormat, reduceLevel) }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeImage
+     */
+    suspend fun decodeImage(
+        j2kData: ByteArray,
+        region: Rect,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap = withDecoder { it.decodeImage(j2kData, region, colorFormat, reduceLevel) }
+
+    /**
+     * Decodes a JPEG 2000 image into [bitmap] on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeImageInto
+     */
+    suspend fun decodeImageInto(
+        j2kData: ByteArray,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = withDecoder { it.decodeImageInto(j2kData, bitmap, reduceLevel) }
+
+    /**
+     * Decodes a specific region of a JPEG 2000 image into [bitmap] on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeImageInto
+     */
+    suspend fun decodeImageInto(
+        j2kData: ByteArray,
+        region: Rect,
+        bitmap: Bitmap,
+        reduceLevel: Int = 0,
+    ): Bitmap = withDecoder { it.decodeImageInto(j2kData, region, bitmap, reduceLevel) }
+
+    /**
+     * Decodes several JPEG 2000 images in one call on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeImages
+     */
+    suspend fun decodeImages(
+        images: List<ByteArray>,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): List<Result<Bitmap>> = withDecoder { it.decodeImages(images, colorFormat, reduceLevel) }
+
+    /**
+     * Decodes a single tile of a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.decodeTile
+     */
+    suspend fun decodeTile(
+        j2kData: ByteArray,
+        tileIndex: Int,
+        colorFormat: ColorFormat = ColorFormat.ARGB8888,
+        reduceLevel: Int = 0,
+    ): Bitmap = withDecoder { it.decodeTile(j2kData, tileIndex, colorFormat, reduceLevel) }
+
+    /**
+     * Retrieves the size of a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.getSize
+     */
+    suspend fun getSize(j2kData: ByteArray): Size = withDecoder { it.getSize(j2kData) }
+
+    /**
+     * Retrieves the tile grid of a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.getTileInfo
+     */
+    suspend fun getTileInfo(j2kData: ByteArray): TileInfo = withDecoder { it.getTileInfo(j2kData) }
+
+    /**
+     * Retrieves the coding parameters of a JPEG 2000 image on an available decoder of the pool.
+     *
+     * @see Jp2kDecoder.getImageInfo
+     */
+    suspend fun getImageInfo(j2kData: ByteArray): ImageInfo = withDecoder { it.getImageInfo(j2kData) }
+
+    /**
+     * Returns the utilization of each decoder of the pool, in the order they were added.
+     *
+     * @return One [IsolateUtilization] per decoder.
+     */
+    fun getUtilization(): List<IsolateUtilization> {
+        val now = System.nanoTime()
+        return synchronized(lock) {
+            members.map { member ->
+                IsolateUtilization(
+                    activeRequests = member.activeRequests,
+                    completedRequests = member.completedRequests,
+                    busyTimeMs = member.busyNanos / 1_000_000,
+                    lifetimeMs = (now - member.createdAtNanos) / 1_000_000,
+                )
+            }
+        }
+    }
+
+    private suspend fun <T> withDecoder(block: suspend (Jp2kDecoder) -> T): T {
+        val member = acquire()
+        try {
+            return block(member.decoder)
+        } finally {
+            releaseMember(member)
+        }
+    }
+
+    // Picks the least busy idle decoder, otherwise grows the pool, otherwise queues on the decoder
+    // with the fewest requests in flight.
+    private suspend fun acquire(): Member {
+        val appContext = synchronized(lock) {
+            checkInitialized()
+            val idle = members.filter { it.activeRequests == 0 }.minByOrNull { it.busyNanos }
+            if (idle != null) {
+                return startRequest(idle)
+            }
+            if (members.size + pendingCreations >= maxSize) {
+                return startRequest(members.minBy { it.activeRequests })
+            }
+            pendingCreations++
+            checkNotNull(context)
+        }
+
+        val decoder = try {
+            createDecoder(appContext)
+        } catch (e: Exception) {
+            log(Log.ERROR) { "Failed to add a decoder to the pool. Error: ${e.message}" }
+            synchronized(lock) {
+                pendingCreations--
+                checkInitialized()
+                // The pool keeps working at its current size
+                if (members.isNotEmpty()) {
+                    return startRequest(members.minBy { it.activeRequests })
+                }
+            }
+            throw e
+        }
+
+        val member = synchronized(lock) {
+            pendingCreations--
+            if (_state == State.Initialized) {
+                val added = Member(decoder, System.nanoTime())
+                members.add(added)
+                startRequest(added)
+            } else {
+                null
+            }
+        }
+        if (member == null) {
+            decoder.release()
+            throw CancellationException("Jp2kDecoderPool was released.")
+        }
+        log(Log.INFO) { "Added a decoder to the pool, size: $size" }
+        return member
+    }
+
+    private fun checkInitialized() {
+        if (_state == State.Released || _state == State.Releasing) {
+            throw CancellationException("Jp2kDecoderPool was released.")
+        }
+        if (_state != State.Initialized) {
+            throw IllegalStateException("Cannot decode while in state: $_state")
+        }
+    }
+
+    private fun startRequest(member: Member): Member {
+        if (member.activeRequests == 0) {
+            member.busySinceNanos = System.nanoTime()
+            member.idleJob?.cancel()
+            member.idleJob = null
+        }
+        member.activeRequests++
+        return member
+    }
+
+    private fun releaseMember(member: Member) {
+        val idleDecoders = synchronized(lock) {
+            val now = System.nanoTime()
+            member.activeRequests--
+            member.completedRequests++
+            if (member.activeRequests == 0) {
+                member.busyNanos += now - member.busySinceNanos
+                member.idleSinceNanos = now
+            }
+            removeIdleMembers(now).also {
+                if (member.activeRequests == 0 && member in members) {
+                    scheduleIdleRelease(member)
+                }
+            }
+        }
+        releaseIdleDecoders(idleDecoders)
+    }
+
+    // Releases member once it has stayed idle for idleTimeoutMillis, even if no other request completes
+    // meanwhile. Called with the lock held.
+    private fun scheduleIdleRelease(member: Member) {
+        if (_state != State.Initialized || members.size <= minSize) {
+            return
+        }
+        val idleSinceNanos = member.idleSinceNanos
+        member.idleJob?.cancel()
+        member.idleJob = idleScope.launch {
+            delay(idleTimeoutMillis)
+            val idleDecoder = synchronized(lock) {
+                // A request may have taken the decoder after the timer fired
+                val stillIdle = member.activeRequests == 0 && member.idleSinceNanos == idleSinceNanos
+                if (_state == State.Initialized && stillIdle && members.size > minSize && members.remove(member)) {
+                    member.decoder
+                } else {
+                    null
+                }
+            }
+            releaseIdleDecoders(listOfNotNull(idleDecoder))
+        }
+    }
+
+    private fun releaseIdleDecoders(idleDecoders: List<Jp2kDecoder>) {
+        idleDecoders.forEach { it.release() }
+        if (idleDecoders.isNotEmpty()) {
+            log(Log.INFO) { "Released ${idleDecoders.size} idle decoders, size: $size" }
+        }
+    }
+
+    private fun removeIdleMembers(now: Long): List<Jp2kDecoder> {
+        if (_state != State.Initialized) {
+            return emptyList()
+        }
+        val timeoutNanos = idleTimeoutMillis * 1_000_000
+        val removed = mutableListOf<Jp2kDecoder>()
+        val iterator = members.iterator()
+        while (iterator.hasNext() && members.size > minSize) {
+            val candidate = iterator.next()
+            if (candidate.activeRequests == 0 && now - candidate.idleSinceNanos >= timeoutNanos) {
+                iterator.remove()
+                removed.add(candidate.decoder)
+            }
+        }
+        return removed
+    }
+
+    /**
+     * Releases all decoders of the pool.
+     *
+     * Requests in flight fail with a [CancellationException].
+     */
+    fun release() {
+        val decoders = synchronized(lock) {
+            if (_state == State.Released || _state == State.Releasing) {
+                return
+            }
+            _state = State.Releasing
+            idleScope.cancel()
+            val all = members.map { it.decoder }
+            members.clear()
+            context = null
+            all
+        }
+
+        try {
+            decoders.forEach { it.release() }
+        } finally {
+            _state = State.Released
+        }
+    }
+
+    override fun close() {
+        release()
+    }
+
+    companion object {
+        private const val TAG = "Jp2kDecoderPool"
+    }
+}
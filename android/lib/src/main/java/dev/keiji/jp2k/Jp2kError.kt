@@ -27,6 +27,15 @@ enum class Jp2kError(val code: Int) {
     /** Region out of bounds error. */
     RegionOutOfBounds(-6),
 
+    /** The decode was cancelled. */
+    Cancelled(-7),
+
+    /** The decode did not finish before its deadline. */
+    DeadlineExceeded(-8),
+
+    /** The WASM memory could not grow to make room for the decode. */
+    MemoryLimit(-9),
+
     /** Cache data missing error. */
     CacheDataMissing(-10),
 
@@ -0,0 +1,244 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+import java.security.MessageDigest
+
+/**
+ * In-process cache of decoded regions, so that a region decoded again does not go back to the sandbox.
+ *
+ * Entries are keyed by the identity of the input, the region, the color format and the reduce level.
+ * The identity is a hash of the image data, or the key given to [Jp2kDecoder.precache]. A request for a
+ * region inside a cached region of the same input, color format and reduce level is cropped from that
+ * region. Cached Bitmaps are never handed out: a hit returns a mutable copy or crop the caller owns,
+ * which [Jp2kBitmapPool] can take back.
+ *
+ * When the cached Bitmaps exceed [maxSizeBytes], the least recently used entries are dropped. Only the
+ * integer region decodes ([Jp2kDecoder.decodeImage] with or without a region) are cached; decodes into a
+ * caller-supplied Bitmap, ratio regions, tiles and batches always decode. The cache is thread-safe and
+ * can be shared by several decoders.
+ *
+ * @param maxSizeBytes The maximum total size of the cached Bitmaps in bytes. Defaults to
+ * [DEFAULT_REGION_CACHE_MAX_SIZE_BYTES].
+ */
+class Jp2kRegionCache(
+    val maxSizeBytes: Long = DEFAULT_REGION_CACHE_MAX_SIZE_BYTES,
+) {
+
+    init {
+        require(maxSizeBytes >= 0) { "maxSizeBytes must be 0 or greater" }
+    }
+
+    private data class Key(
+        val inputKey: String,
+        val left: Int,
+        val top: Int,
+        val right: Int,
+        val bottom: Int,
+        val colorFormat: ColorFormat,
+        val reduceLevel: Int,
+    ) {
+        // (0, 0, 0, 0) is the whole image, whose bounds on the reference grid are not known here
+        val isRegion: Boolean
+            get() = right != 0 || bottom != 0
+    }
+
+    private val lock = Any()
+
+    // Access order, so that the first entry is the least recently used one
+    private val entries = LinkedHashMap<Key, Bitmap>(16, 0.75f, true)
+
+    private var _sizeBytes = 0L
+    private var _hitCount = 0L
+    private var _partialHitCount = 0L
+    private var _missCount = 0L
+    private var _evictionCount = 0L
+
+    /**
+     * The total size of the cached Bitmaps in bytes.
+     */
+    val sizeBytes: Long
+        get() = synchronized(lock) { _sizeBytes }
+
+    /**
+     * The number of requests served from the cache, including [partialHitCount].
+     */
+    val hitCount: Long
+        get() = synchronized(lock) { _hitCount }
+
+    /**
+     * The number of requests served by cropping a larger cached region.
+     */
+    val partialHitCount: Long
+        get() = synchronized(lock) { _partialHitCount }
+
+    /**
+     * The number of requests that had to be decoded.
+     */
+    val missCount: Long
+        get() = synchronized(lock) { _missCount }
+
+    /**
+     * The number of entries dropped to stay within [maxSizeBytes].
+     */
+    val evictionCount: Long
+        get() = synchronized(lock) { _evictionCount }
+
+    /**
+     * The fraction of requests served from the cache, from 0.0 to 1.0.
+     */
+    val hitRate: Double
+        get() = synchronized(lock) {
+            val total = _hitCount + _missCount
+            if (total > 0) _hitCount.toDouble() / total else 0.0
+        }
+
+    /**
+     * Drops all entries of the input identified by [inputKey].
+     */
+    fun invalidate(inputKey: String) {
+        synchronized(lock) {
+            val iterator = entries.entries.iterator()
+            while (iterator.hasNext()) {
+                val entry = iterator.next()
+                if (entry.key.inputKey == inputKey) {
+                    _sizeBytes -= entry.value.allocationByteCount
+                    iterator.remove()
+                }
+            }
+        }
+    }
+
+    /**
+     * Drops all entries. The counters are kept.
+     */
+    fun clear() {
+        synchronized(lock) {
+            entries.clear()
+            _sizeBytes = 0
+        }
+    }
+
+    /**
+     * Returns a Bitmap of the region the caller owns, or null if neither the region nor a region
+     * containing it is cached.
+     */
+    internal fun get(
+        inputKey: String,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+    ): Bitmap? {
+        val key = Key(inputKey, left, top, right, bottom, colorFormat, reduceLevel)
+        val (cached, container) = synchronized(lock) {
+            val exact = entries[key]
+            val container = if (exact == null && key.isRegion) findContainer(key) else null
+            if (exact != null || container != null) {
+                _hitCount++
+                if (container != null) {
+                    _partialHitCount++
+                    // Marks the container as recently used
+                    entries[container.first]
+                }
+            } else {
+                _missCount++
+            }
+            exact to container
+        }
+
+        // Copied outside the lock. An entry dropped meanwhile is only recycled by the GC.
+        if (cached != null) {
+            return cached.copy(cached.config ?: colorFormat.bitmapConfig, true)
+        }
+        if (container != null) {
+            val (containerKey, bitmap) = container
+            val x = ceilDivPow2(left, reduceLevel) - ceilDivPow2(containerKey.left, reduceLevel)
+            val y = ceilDivPow2(top, reduceLevel) - ceilDivPow2(containerKey.top, reduceLevel)
+            val crop = Bitmap.createBitmap(bitmap, x, y, reducedSize(left, right, reduceLevel), reducedSize(top, bottom, reduceLevel))
+            // A crop covering the whole cached region is the cached Bitmap itself
+            if (crop === bitmap) {
+                return bitmap.copy(bitmap.config ?: colorFormat.bitmapConfig, true)
+            }
+            // Crops of an immutable Bitmap are immutable
+            if (crop.isMutable) {
+                return crop
+            }
+            return crop.copy(crop.config ?: colorFormat.bitmapConfig, true).also { crop.recycle() }
+        }
+        return null
+    }
+
+    /**
+     * Caches a snapshot of [bitmap], the decoded region. [bitmap] itself stays with the caller.
+     */
+    internal fun put(
+        inputKey: String,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        colorFormat: ColorFormat,
+        reduceLevel: Int,
+        bitmap: Bitmap,
+    ) {
+        if (bitmap.allocationByteCount > maxSizeBytes) {
+            return
+        }
+        val snapshot = bitmap.copy(bitmap.config ?: colorFormat.bitmapConfig, false) ?: return
+        synchronized(lock) {
+            val previous = entries.put(Key(inputKey, left, top, right, bottom, colorFormat, reduceLevel), snapshot)
+            if (previous != null) {
+                _sizeBytes -= previous.allocationByteCount
+            }
+            _sizeBytes += snapshot.allocationByteCount
+
+            val iterator = entries.values.iterator()
+            while (_sizeBytes > maxSizeBytes && iterator.hasNext()) {
+                _sizeBytes -= iterator.next().allocationByteCount
+                _evictionCount++
+                iterator.remove()
+            }
+        }
+    }
+
+    // The most recently used cached region that contains the region of key and has the expected size
+    private fun findContainer(key: Key): Pair<Key, Bitmap>? = entries.entries.lastOrNull { (candidate, bitmap) ->
+        candidate.isRegion &&
+            candidate.inputKey == key.inputKey &&
+            candidate.colorFormat == key.colorFormat &&
+            candidate.reduceLevel == key.reduceLevel &&
+            candidate.left <= key.left && candidate.top <= key.top &&
+            candidate.right >= key.right && candidate.bottom >= key.bottom &&
+            // The decoder clamps the reduce level to what the codestream allows, which changes the size
+            bitmap.width == reducedSize(candidate.left, candidate.right, candidate.reduceLevel) &&
+            bitmap.height == reducedSize(candidate.top, candidate.bottom, candidate.reduceLevel)
+    }?.let { it.key to it.value }
+
+    companion object {
+
+        /**
+         * Returns the identity of [j2kData] the cache uses when no key is given: a hash of its content.
+         */
+        @JvmStatic
+        fun keyOf(j2kData: ByteArray): String =
+            MessageDigest.getInstance("SHA-256").digest(j2kData).joinToString("") { "%02x".format(it) }
+
+        // Size of the span [start, end) of the reference grid after discarding reduceLevel levels, as
+        // OpenJPEG computes it
+        private fun reducedSize(start: Int, end: Int, reduceLevel: Int): Int =
+            ceilDivPow2(end, reduceLevel) - ceilDivPow2(start, reduceLevel)
+
+        private fun ceilDivPow2(value: Int, factor: Int): Int {
+            val shift = factor.coerceAtMost(32)
+            return ((value.toLong() + (1L shl shift) - 1) shr shift).toInt()
+        }
+    }
+}
+
+private val ColorFormat.bitmapConfig: Bitmap.Config
+    get() = when (this) {
+        ColorFormat.RGB565 -> Bitmap.Config.RGB_565
+        ColorFormat.ARGB8888 -> Bitmap.Config.ARGB_8888
+    }
@@ -8,6 +8,7 @@ import androidx.javascriptengine.IsolateStartupParameters
 import androidx.javascriptengine.JavaScriptIsolate
 import androidx.javascriptengine.JavaScriptSandbox
 import com.google.common.util.concurrent.ListenableFuture
+import java.io.IOException
 import java.util.concurrent.Executor
 
 /**
@@ -19,6 +20,9 @@ object Jp2kSandbox {
     private var sandboxFuture: ListenableFuture<JavaScriptSandbox>? = null
     private val lock = Any()
 
+    private const val TAG = "Jp2kSandbox"
+    private const val PREWARM_THREAD_NAME = "Jp2kSandbox-prewarm"
+
     /**
      * Retrieves the shared [JavaScriptSandbox] instance asynchronously.
      *
@@ -36,6 +40,36 @@ object Jp2kSandbox {
         }
     }
 
+    /**
+     * Starts connecting to the sandbox and loading the WebAssembly module in the background.
+     *
+     * Calling this early (e.g. in `Application.onCreate`) takes the sandbox connection and the asset read
+     * off the first `init()` of a decoder. Every decoder created afterwards reuses the loaded module binary.
+     *
+     * @param context The Android Context (will use Application Context internally).
+     * @param executor The executor on which the module is loaded. Defaults to a new background thread.
+     * @return A [ListenableFuture] that resolves to the [JavaScriptSandbox].
+     */
+    @JvmStatic
+    @JvmOverloads
+    fun prewarm(
+        context: Context,
+        executor: Executor = Executor { command -> Thread(command, PREWARM_THREAD_NAME).start() },
+    ): ListenableFuture<JavaScriptSandbox> {
+        val assetManager = context.applicationContext.assets
+        if (!WasmModuleCache.isLoaded) {
+            executor.execute {
+                try {
+                    WasmModuleCache.get(assetManager)
+                } catch (e: IOException) {
+                    // init() reads the module again and reports the failure
+                    Log.w(TAG, "Failed to prewarm the WebAssembly module.", e)
+                }
+            }
+        }
+        return get(context)
+    }
+
     /**
      * Creates a new [JavaScriptIsolate] with the specified configuration.
      *
@@ -4,7 +4,17 @@ package dev.keiji.jp2k
  * Data class representing memory usage statistics of the JavaScript/WASM environment.
  *
  * @property wasmHeapSizeBytes The size of the WASM memory buffer in bytes.
+ * @property scratchHighWaterMarkBytes The largest size the reusable input/output buffers inside the WASM
+ * module reached since the last [Jp2kDecoder.clearCache], in bytes.
+ * @property heapInUseBytes The bytes allocated on the WASM heap when the last decode returned, its output included.
+ * @property lastDecodePeakBytes The most the last decode added to the WASM heap, in bytes, as sampled between its stages.
+ * @property lastDecodeEstimatedPeakBytes The bytes the last decode was predicted to allocate from the image header.
+ * The prediction errs on the high side and only sizes the memory growth; it never rejects a decode.
  */
 data class MemoryUsage(
     val wasmHeapSizeBytes: Long,
+    val scratchHighWaterMarkBytes: Long = 0,
+    val heapInUseBytes: Long = 0,
+    val lastDecodePeakBytes: Long = 0,
+    val lastDecodeEstimatedPeakBytes: Long = 0,
 )
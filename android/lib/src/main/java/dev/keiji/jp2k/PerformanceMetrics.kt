@@ -11,6 +11,13 @@ package dev.keiji.jp2k
  * @property outputDataSizeBytes Size of output decoded bitmap bytes in bytes.
  * @property wasmHeapSizeBytes WASM memory buffer size in bytes after decoding.
  * @property totalProcessingTimeMs Total time taken for decoding operation from JVM start to end in milliseconds.
+ * @property headerTimeMs Time spent reading the main header inside WebAssembly in milliseconds. 0 if unknown.
+ * @property codestreamDecodeTimeMs Time spent in OpenJPEG decoding the codestream (tier-1, inverse DWT and MCT) in milliseconds. 0 if unknown.
+ * @property conversionTimeMs Time spent converting the decoded components into the output inside WebAssembly in milliseconds. 0 if unknown.
+ * @property tilesDecoded Number of tiles decoded. 0 if unknown.
+ * @property bytesRead Number of bytes of the input read by the decoder. 0 if unknown.
+ * @property wasmAllocationCount Number of buffers allocated by the WebAssembly wrapper around OpenJPEG. 0 if unknown.
+ * @property wasmAllocatedBytes Total size in bytes of the buffers allocated by the WebAssembly wrapper around OpenJPEG. 0 if unknown.
  */
 data class PerformanceMetrics(
     val inputDataSizeBytes: Long,
@@ -21,4 +28,11 @@ data class PerformanceMetrics(
     val outputDataSizeBytes: Long,
     val wasmHeapSizeBytes: Long,
     val totalProcessingTimeMs: Double,
+    val headerTimeMs: Double = 0.0,
+    val codestreamDecodeTimeMs: Double = 0.0,
+    val conversionTimeMs: Double = 0.0,
+    val tilesDecoded: Long = 0L,
+    val bytesRead: Long = 0L,
+    val wasmAllocationCount: Long = 0L,
+    val wasmAllocatedBytes: Long = 0L,
 )
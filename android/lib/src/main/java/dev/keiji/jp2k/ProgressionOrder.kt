@@ -0,0 +1,42 @@
+package dev.keiji.jp2k
+
+/**
+ * Enum representing the order in which the packets of a JPEG 2000 codestream are written.
+ *
+ * The letters name the nesting from outermost to innermost: Layer, Resolution, Component and
+ * Position (precinct). A resolution-first order lets a reduced decode stop reading early, a
+ * layer-first order does the same for a quality-limited one.
+ *
+ * @property id The integer identifier of the order in the codestream.
+ */
+enum class ProgressionOrder(val id: Int) {
+    /** The order could not be determined. */
+    Unknown(-1),
+
+    /** Layer, resolution, component, position. */
+    LRCP(0),
+
+    /** Resolution, layer, component, position. */
+    RLCP(1),
+
+    /** Resolution, position, component, layer. */
+    RPCL(2),
+
+    /** Position, component, resolution, layer. */
+    PCRL(3),
+
+    /** Component, position, resolution, layer. */
+    CPRL(4);
+
+    companion object {
+        /**
+         * Returns the [ProgressionOrder] corresponding to the given identifier.
+         *
+         * @param id The identifier of the order.
+         * @return The matching [ProgressionOrder], or [Unknown] if not found.
+         */
+        fun fromInt(id: Int): ProgressionOrder {
+            return entries.find { it.id == id } ?: Unknown
+        }
+    }
+}
@@ -0,0 +1,26 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+
+/**
+ * Interface definition for the callbacks of a progressive decode.
+ *
+ * [onProgress] is called once per step, from the coarsest preview to the final image, unless [onError]
+ * ends the series.
+ */
+interface ProgressiveCallback {
+    /**
+     * Called when a step has been decoded.
+     *
+     * @param bitmap The image decoded by this step. Previews are smaller than the final image.
+     * @param isFinal `true` for the last step, decoded at full quality.
+     */
+    fun onProgress(bitmap: Bitmap, isFinal: Boolean)
+
+    /**
+     * Called when a step fails. No further steps are decoded.
+     *
+     * @param error The exception that occurred.
+     */
+    fun onError(error: Exception)
+}
@@ -0,0 +1,28 @@
+package dev.keiji.jp2k
+
+import org.json.JSONObject
+
+/**
+ * One step of a progressive decode.
+ *
+ * @property reduceLevel The number of resolution levels to discard.
+ * @property qualityLayers The number of quality layers to decode, 0 for all of them.
+ */
+internal data class ProgressiveStep(
+    val reduceLevel: Int,
+    val qualityLayers: Int,
+)
+
+/**
+ * Parses the plan returned by `getProgressivePlan`.
+ */
+internal fun parseProgressiveSteps(root: JSONObject): List<ProgressiveStep> {
+    val steps = root.getJSONArray("steps")
+    return List(steps.length()) { index ->
+        val step = steps.getJSONObject(index)
+        ProgressiveStep(
+            reduceLevel = step.getInt("reduceLevel"),
+            qualityLayers = step.getInt("qualityLayers"),
+        )
+    }
+}
@@ -0,0 +1,84 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Creates a [Bitmap] from the raw output of the WASM decoder.
+ *
+ * The payload starts with a [RAW_HEADER_SIZE_BYTES] header (width, height, stride and color format as
+ * little-endian uint32) followed by the pixels already in Bitmap memory layout: premultiplied RGBA for
+ * ARGB_8888 and packed RGB_565. The pixels are copied into the Bitmap as they are.
+ *
+ * @param payload The raw output of the decoder.
+ * @param offset The offset of the output in [payload].
+ * @param length The length of the output in bytes.
+ * @param target The Bitmap to copy the pixels into instead of a new one.
+ * @param pool The pool the new Bitmap is taken from when there is no [target].
+ * @return The decoded [Bitmap], [target] if given.
+ * @throws IllegalStateException If the payload is malformed.
+ * @throws IllegalArgumentException If [target] cannot hold the decoded image.
+ */
+internal fun createBitmapFromRawPixels(
+    payload: ByteArray,
+    offset: Int = 0,
+    length: Int = payload.size - offset,
+    target: Bitmap? = null,
+    pool: Jp2kBitmapPool? = null,
+): Bitmap {
+    check(length >= RAW_HEADER_SIZE_BYTES) { "Raw pixel payload is too short ($length bytes)." }
+
+    val header = ByteBuffer.wrap(payload, offset, RAW_HEADER_SIZE_BYTES).order(ByteOrder.LITTLE_ENDIAN)
+    val width = header.getInt(offset)
+    val height = header.getInt(offset + 4)
+    val stride = header.getInt(offset + 8)
+    val config = when (val colorFormat = header.getInt(offset + 12)) {
+        ColorFormat.RGB565.id -> Bitmap.Config.RGB_565
+        ColorFormat.ARGB8888.id -> Bitmap.Config.ARGB_8888
+        else -> throw IllegalStateException("Unknown color format in raw pixel header: $colorFormat")
+    }
+
+    val pixelBytes = stride.toLong() * height
+    check(width > 0 && height > 0 && length - RAW_HEADER_SIZE_BYTES >= pixelBytes) {
+        "Raw pixel payload does not match its header (${width}x$height, stride $stride, $length bytes)."
+    }
+
+    if (target != null) {
+        requireCompatibleBitmap(target, width, height, config)
+    }
+    val bitmap = target ?: pool?.get(width, height, config) ?: Bitmap.createBitmap(width, height, config)
+    if (bitmap.rowBytes != stride) {
+        when {
+            target != null -> {}
+            pool != null -> pool.put(bitmap)
+            else -> bitmap.recycle()
+        }
+        throw IllegalStateException("Raw pixel stride $stride does not match Bitmap row bytes.")
+    }
+    bitmap.copyPixelsFromBuffer(ByteBuffer.wrap(payload, offset + RAW_HEADER_SIZE_BYTES, pixelBytes.toInt()))
+    return bitmap
+}
+
+/**
+ * Checks that the caller-supplied [bitmap] can receive a decoded image of [width] x [height] in [config].
+ *
+ * @throws IllegalArgumentException If it cannot.
+ */
+internal fun requireCompatibleBitmap(bitmap: Bitmap, width: Int, height: Int, config: Bitmap.Config) {
+    require(!bitmap.isRecycled && bitmap.isMutable) { "Bitmap must be mutable and not recycled." }
+    require(bitmap.width == width && bitmap.height == height && bitmap.config == config) {
+        "Bitmap ${bitmap.width}x${bitmap.height} ${bitmap.config} cannot hold the decoded ${width}x$height $config image."
+    }
+}
+
+/**
+ * The Bitmap config a decode into [bitmap] requests.
+ *
+ * @throws IllegalArgumentException If the config of [bitmap] is not one of [ColorFormat].
+ */
+internal fun colorFormatOf(bitmap: Bitmap): ColorFormat = when (bitmap.config) {
+    Bitmap.Config.ARGB_8888 -> ColorFormat.ARGB8888
+    Bitmap.Config.RGB_565 -> ColorFormat.RGB565
+    else -> throw IllegalArgumentException("Unsupported Bitmap config: ${bitmap.config}")
+}
@@ -0,0 +1,164 @@
+package dev.keiji.jp2k
+
+import org.json.JSONObject
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Decoder output of one decode, handed to the result factory of the decode function.
+ *
+ * @property payload The buffer holding the output.
+ * @property offset Offset of the output in [payload].
+ * @property length Length of the output in bytes.
+ * @property isRaw `true` if the output is raw pixels, `false` if it is a BMP file.
+ */
+internal class DecodeOutput(
+    val payload: ByteArray,
+    val offset: Int,
+    val length: Int,
+    val isRaw: Boolean,
+)
+
+/**
+ * Timings the sandbox reports for one decode. Times are in milliseconds.
+ *
+ * @property timePreProcess Time spent copying the input into the WASM heap.
+ * @property timeWasm Time spent in the WASM decode function.
+ * @property timePostProcess Time spent copying and encoding the output.
+ * @property timeBase64Decode Time spent decoding the string encoded input.
+ * @property timeBase64Encode Time spent encoding the output to a string.
+ * @property inputTransferDelayMs Delay between the start of the request on the JVM and the start of the script.
+ * @property jsFinishTimeMs Wall clock time the script finished at, 0 if unknown.
+ * @property wasmHeapSizeBytes WASM memory buffer size in bytes after decoding.
+ * @property stats Statistics the WASM module recorded for the decode, or null if unknown.
+ */
+internal data class DecodeTimings(
+    val timePreProcess: Double = 0.0,
+    val timeWasm: Double = 0.0,
+    val timePostProcess: Double = 0.0,
+    val timeBase64Decode: Double = 0.0,
+    val timeBase64Encode: Double = 0.0,
+    val inputTransferDelayMs: Double = 0.0,
+    val jsFinishTimeMs: Long = 0L,
+    val wasmHeapSizeBytes: Long = 0L,
+    val stats: DecodeStats? = null,
+) {
+    companion object {
+        /**
+         * Reads the timing fields of a JSON decode result.
+         */
+        fun fromJson(root: JSONObject): DecodeTimings = DecodeTimings(
+            timePreProcess = root.optDouble("timePreProcess", 0.0),
+            timeWasm = root.optDouble("timeWasm", 0.0),
+            timePostProcess = root.optDouble("timePostProcess", 0.0),
+            timeBase64Decode = root.optDouble("timeBase64Decode", 0.0),
+            timeBase64Encode = root.optDouble("timeBase64Encode", 0.0),
+            inputTransferDelayMs = root.optDouble("inputTransferDelayMs", 0.0),
+            jsFinishTimeMs = root.optLong("jsFinishTimeMs", 0L),
+            wasmHeapSizeBytes = root.optLong("wasmHeapSizeBytes", 0L),
+            stats = root.optJSONArray("stats")?.let { array ->
+                DecodeStats.fromValues(LongArray(array.length()) { array.optLong(it) })
+            },
+        )
+    }
+}
+
+/**
+ * Per-stage statistics the WASM module records for one decode (getLastStats). Times are in milliseconds.
+ *
+ * @property headerTimeMs Time spent reading the main header.
+ * @property codestreamDecodeTimeMs Time spent in OpenJPEG decoding the codestream: tier-1, inverse DWT and MCT.
+ * @property conversionTimeMs Time spent converting the components into the output.
+ * @property tilesDecoded Number of tiles decoded.
+ * @property bytesRead Number of bytes read from the input stream.
+ * @property allocationCount Number of buffers the wrapper allocated.
+ * @property allocatedBytes Total size in bytes of the buffers the wrapper allocated.
+ */
+internal data class DecodeStats(
+    val headerTimeMs: Double,
+    val codestreamDecodeTimeMs: Double,
+    val conversionTimeMs: Double,
+    val tilesDecoded: Long,
+    val bytesRead: Long,
+    val allocationCount: Long,
+    val allocatedBytes: Long,
+) {
+    companion object {
+        /**
+         * Reads the [DECODE_STATS_COUNT] uint32 values of getLastStats, in their order. Returns null if
+         * [values] is too short.
+         */
+        fun fromValues(values: LongArray): DecodeStats? {
+            if (values.size < DECODE_STATS_COUNT) return null
+            return DecodeStats(
+                headerTimeMs = values[0] / 1000.0,
+                codestreamDecodeTimeMs = values[1] / 1000.0,
+                conversionTimeMs = values[2] / 1000.0,
+                tilesDecoded = values[3],
+                bytesRead = values[4],
+                allocationCount = values[5],
+                allocatedBytes = values[6],
+            )
+        }
+    }
+}
+
+/**
+ * Binary result of a decode, posted through the output MessagePort instead of a JSON result.
+ *
+ * @property errorCode [Jp2kError] code of the failure, 0 on success.
+ * @property width Width of the decoded image, 0 if the payload is not a single image.
+ * @property height Height of the decoded image, 0 if the payload is not a single image.
+ * @property stride Bytes per row of the decoded image, 0 if the payload is not a single image.
+ * @property timings Timings of the decode.
+ * @property output The payload of the frame.
+ */
+internal class ResultFrame(
+    val errorCode: Int,
+    val width: Int,
+    val height: Int,
+    val stride: Int,
+    val timings: DecodeTimings,
+    val output: DecodeOutput,
+)
+
+/**
+ * Parses a binary result frame without copying its payload.
+ *
+ * The frame is a [RESULT_FRAME_HEADER_SIZE_BYTES] header followed by the payload. The header holds
+ * (little-endian) the magic number, the error code (int32), width, height, output format and stride
+ * (uint32 each), then the pre-process, WASM and post-process times, the input transfer delay, the JS
+ * finish time and the WASM heap size (float64 each), then the [DecodeStats] values (uint32 each, all 0
+ * when unknown).
+ *
+ * @throws IllegalStateException If the frame is malformed.
+ */
+internal fun parseResultFrame(frame: ByteArray): ResultFrame {
+    check(frame.size >= RESULT_FRAME_HEADER_SIZE_BYTES) { "Result frame is too short (${frame.size} bytes)." }
+    val header = ByteBuffer.wrap(frame, 0, RESULT_FRAME_HEADER_SIZE_BYTES).order(ByteOrder.LITTLE_ENDIAN)
+    check(header.getInt() == RESULT_FRAME_MAGIC) { "Result frame has an unknown magic number." }
+
+    val errorCode = header.getInt()
+    val width = header.getInt()
+    val height = header.getInt()
+    val format = header.getInt()
+    val stride = header.getInt()
+    val timings = DecodeTimings(
+        timePreProcess = header.getDouble(),
+        timeWasm = header.getDouble(),
+        timePostProcess = header.getDouble(),
+        inputTransferDelayMs = header.getDouble(),
+        jsFinishTimeMs = header.getDouble().toLong(),
+        wasmHeapSizeBytes = header.getDouble().toLong(),
+        stats = LongArray(DECODE_STATS_COUNT) { header.getInt().toLong() and 0xFFFFFFFFL }
+            .takeIf { values -> values.any { it != 0L } }
+            ?.let { DecodeStats.fromValues(it) },
+    )
+    val output = DecodeOutput(
+        payload = frame,
+        offset = RESULT_FRAME_HEADER_SIZE_BYTES,
+        length = frame.size - RESULT_FRAME_HEADER_SIZE_BYTES,
+        isRaw = format == OUTPUT_FORMAT_RAW,
+    )
+    return ResultFrame(errorCode, width, height, stride, timings, output)
+}
@@ -0,0 +1,38 @@
+package dev.keiji.jp2k
+
+/**
+ * Data class representing the tile grid of a JPEG 2000 image.
+ *
+ * All coordinates are on the full resolution reference grid. Tiles are numbered in raster order,
+ * so the tile at column `x` and row `y` has the index `y * numTilesX + x` and covers
+ * `tileX0 + x * tileWidth` to `tileX0 + (x + 1) * tileWidth` horizontally, clipped to the image area.
+ *
+ * @property imageX0 The left edge of the image area.
+ * @property imageY0 The top edge of the image area.
+ * @property imageX1 The right edge (exclusive) of the image area.
+ * @property imageY1 The bottom edge (exclusive) of the image area.
+ * @property tileX0 The horizontal offset of the tile grid.
+ * @property tileY0 The vertical offset of the tile grid.
+ * @property tileWidth The nominal width of a tile.
+ * @property tileHeight The nominal height of a tile.
+ * @property numTilesX The number of tile columns.
+ * @property numTilesY The number of tile rows.
+ */
+data class TileInfo(
+    val imageX0: Int,
+    val imageY0: Int,
+    val imageX1: Int,
+    val imageY1: Int,
+    val tileX0: Int,
+    val tileY0: Int,
+    val tileWidth: Int,
+    val tileHeight: Int,
+    val numTilesX: Int,
+    val numTilesY: Int,
+) {
+    /**
+     * The total number of tiles.
+     */
+    val numTiles: Int
+        get() = numTilesX * numTilesY
+}
@@ -0,0 +1,40 @@
+package dev.keiji.jp2k
+
+import android.content.res.AssetManager
+import androidx.annotation.VisibleForTesting
+
+/**
+ * Process-wide cache of the WebAssembly module binary.
+ *
+ * Every isolate has to compile the module on its own, but the binary is read from the assets
+ * only once and then handed to each isolate as is.
+ */
+internal object WasmModuleCache {
+    @Volatile
+    private var wasmBytes: ByteArray? = null
+    private val lock = Any()
+
+    /**
+     * `true` if the module binary has been loaded.
+     */
+    val isLoaded: Boolean
+        get() = wasmBytes != null
+
+    /**
+     * Returns the module binary, reading it from [assetManager] on the first call.
+     */
+    fun get(assetManager: AssetManager): ByteArray {
+        wasmBytes?.let { return it }
+        synchronized(lock) {
+            wasmBytes?.let { return it }
+            val bytes = assetManager.open(ASSET_PATH_WASM).use { it.readBytes() }
+            wasmBytes = bytes
+            return bytes
+        }
+    }
+
+    @VisibleForTesting
+    fun clearForTesting() {
+        wasmBytes = null
+    }
+}
@@ -70,6 +70,8 @@ private const val SCRIPT_CONVERTER = """
 
                 globalThis.encodePayload = globalThis.bytesToBase64;
                 globalThis.decodePayload = globalThis.base64ToBytes;
+                // Lets the glue swap in the WASM Base64 kernels once the module is instantiated
+                globalThis.payloadBase64Alphabet = 0;
             })();
 """
 
@@ -109,6 +111,8 @@ internal class Base64DataChannel : JSDataChannel {
         return Base64.getDecoder().decode(encoded)
     }
 
+    override fun createChunkDecoder(encodedLength: Int): ChunkDecoder = Base64ChunkDecoder(encodedLength)
+
     override val jsConverterScript: String
         get() = SCRIPT_CONVERTER
 
@@ -0,0 +1,97 @@
+package dev.keiji.jp2k.datachannel
+
+/**
+ * Decodes a string payload that arrives in chunks into one preallocated array, so that neither the
+ * whole encoded payload nor a second copy of the decoded bytes is held.
+ *
+ * Chunks must be passed in order, and every chunk but the last must be a multiple of [alignment]
+ * characters long.
+ */
+internal interface ChunkDecoder {
+
+    /**
+     * Number of characters the chunk lengths must be a multiple of.
+     */
+    val alignment: Int
+
+    /**
+     * The decoded bytes. Only the first [length] bytes are valid.
+     */
+    val output: ByteArray
+
+    /**
+     * Number of bytes decoded so far.
+     */
+    val length: Int
+
+    /**
+     * Decodes the next chunk.
+     *
+     * @throws IllegalArgumentException If the chunk is malformed.
+     */
+    fun decode(chunk: String)
+}
+
+/**
+ * Rounds [chunkSize] down to a multiple of [ChunkDecoder.alignment], and to at least one alignment.
+ */
+internal fun ChunkDecoder.alignChunkSize(chunkSize: Int): Int =
+    maxOf(alignment, chunkSize - chunkSize % alignment)
+
+/**
+ * [ChunkDecoder] for padded Base64 of [encodedLength] characters, in the standard or URL-safe alphabet.
+ */
+internal class Base64ChunkDecoder(encodedLength: Int) : ChunkDecoder {
+    override val alignment: Int = 4
+
+    // The padding is only known with the last chunk, so the output may end up 1 or 2 bytes shorter
+    override val output: ByteArray = ByteArray(encodedLength / 4 * 3 + maxOf(0, encodedLength % 4 - 1))
+
+    override var length: Int = 0
+        private set
+
+    override fun decode(chunk: String) {
+        var end = chunk.length
+        while (end > 0 && chunk[end - 1] == '=') end--
+        require(length + end / 4 * 3 + maxOf(0, end % 4 - 1) <= output.size) { "Base64 payload is longer than announced" }
+
+        var i = 0
+        while (i + 4 <= end) {
+            val v = (value(chunk, i) shl 18) or (value(chunk, i + 1) shl 12) or
+                (value(chunk, i + 2) shl 6) or value(chunk, i + 3)
+            output[length++] = (v shr 16).toByte()
+            output[length++] = (v shr 8).toByte()
+            output[length++] = v.toByte()
+            i += 4
+        }
+
+        val rest = end - i
+        require(rest != 1) { "Invalid Base64 length" }
+        if (rest > 0) {
+            val c = if (rest > 2) value(chunk, i + 2) else 0
+            val v = (value(chunk, i) shl 18) or (value(chunk, i + 1) shl 12) or (c shl 6)
+            output[length++] = (v shr 16).toByte()
+            if (rest > 2) output[length++] = (v shr 8).toByte()
+        }
+    }
+
+    private fun value(chunk: String, index: Int): Int {
+        val c = chunk[index].code
+        val v = if (c < VALUES.size) VALUES[c].toInt() else -1
+        require(v >= 0) { "Invalid Base64 character at $index" }
+        return v
+    }
+
+    private companion object {
+        // Values of the characters of both alphabets, -1 for anything else
+        val VALUES = ByteArray(128) { -1 }.also { values ->
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789".forEachIndexed { i, c ->
+                values[c.code] = i.toByte()
+            }
+            values['+'.code] = 62
+            values['-'.code] = 62
+            values['/'.code] = 63
+            values['_'.code] = 63
+        }
+    }
+}
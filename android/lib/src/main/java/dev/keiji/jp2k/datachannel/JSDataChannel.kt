@@ -73,6 +73,12 @@ internal interface JSDataChannel {
      */
     fun retrieveDecodedBytes(encodedPayload: String): ByteArray = decodePayload(encodedPayload)
 
+    /**
+     * Creates a [ChunkDecoder] for an encoded payload of [encodedLength] characters that is read in
+     * chunks, or null if the payload can only be decoded as a whole.
+     */
+    fun createChunkDecoder(encodedLength: Int): ChunkDecoder? = null
+
     /**
      * JS script block providing the encoder/decoder converter functions for this channel.
      */
@@ -106,6 +106,8 @@ internal class MessagePortDataChannel : JSDataChannel {
 
     override fun decodePayload(encoded: String): ByteArray = fallbackChannel.decodePayload(encoded)
 
+    override fun createChunkDecoder(encodedLength: Int): ChunkDecoder? = fallbackChannel.createChunkDecoder(encodedLength)
+
     override fun retrieveDecodedBytes(encodedPayload: String): ByteArray {
         if (encodedPayload.isNotEmpty()) {
             return fallbackChannel.decodePayload(encodedPayload)
@@ -94,6 +94,8 @@ internal class ProvidedNamedDataChannel : JSDataChannel {
 
     override fun decodePayload(encoded: String): ByteArray = fallbackChannel.decodePayload(encoded)
 
+    override fun createChunkDecoder(encodedLength: Int): ChunkDecoder? = fallbackChannel.createChunkDecoder(encodedLength)
+
     override val jsConverterScript: String
         get() = fallbackChannel.jsConverterScript
 
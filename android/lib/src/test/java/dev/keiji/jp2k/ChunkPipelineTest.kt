@@ -0,0 +1,108 @@
+package dev.keiji.jp2k
+
+import com.google.common.util.concurrent.ListenableFuture
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Assert.fail
+import org.junit.Test
+import java.util.concurrent.Executor
+import java.util.concurrent.TimeUnit
+
+class ChunkPipelineTest {
+
+    private class RecordingFuture(private val result: String) : ListenableFuture<String> {
+        var isCancelCalled = false
+
+        override fun cancel(mayInterruptIfRunning: Boolean): Boolean {
+            isCancelCalled = true
+            return true
+        }
+        override fun isCancelled(): Boolean = isCancelCalled
+        override fun isDone(): Boolean = true
+        override fun get(): String = result
+        override fun get(timeout: Long, unit: TimeUnit?): String = result
+        override fun addListener(listener: Runnable, executor: Executor) = listener.run()
+    }
+
+    @Test
+    fun testPipelineChunks_KeepsWindowInFlight() {
+        val events = mutableListOf<String>()
+        val results = mutableListOf<String>()
+
+        pipelineChunks(
+            count = 5,
+            window = 3,
+            evaluate = { index ->
+                events.add("evaluate $index")
+                TestListenableFuture("chunk $index")
+            },
+            await = { future ->
+                future.get().also { events.add("await ${it.removePrefix("chunk ")}") }
+            },
+            onResult = { index, result ->
+                assertEquals("chunk $index", result)
+                results.add(result)
+            },
+        )
+
+        assertEquals(
+            listOf(
+                "evaluate 0", "evaluate 1", "evaluate 2", "await 0",
+                "evaluate 3", "await 1",
+                "evaluate 4", "await 2",
+                "await 3",
+                "await 4",
+            ),
+            events,
+        )
+        assertEquals(List(5) { "chunk $it" }, results)
+    }
+
+    @Test
+    fun testPipelineChunks_WindowBelowOne_RunsOneAtATime() {
+        val events = mutableListOf<String>()
+
+        pipelineChunks(
+            count = 2,
+            window = 0,
+            evaluate = { index ->
+                events.add("evaluate $index")
+                TestListenableFuture("")
+            },
+            await = { it.get() },
+            onResult = { index, _ -> events.add("result $index") },
+        )
+
+        assertEquals(listOf("evaluate 0", "result 0", "evaluate 1", "result 1"), events)
+    }
+
+    @Test
+    fun testPipelineChunks_Failure_CancelsChunksInFlight() {
+        val futures = mutableListOf<RecordingFuture>()
+
+        try {
+            pipelineChunks(
+                count = 4,
+                window = 3,
+                evaluate = { index -> RecordingFuture("$index").also { futures.add(it) } },
+                await = { it.get() },
+                onResult = { index, _ -> if (index == 0) throw IllegalStateException("Malformed chunk") },
+            )
+            fail("Should throw IllegalStateException")
+        } catch (e: IllegalStateException) {
+            assertEquals("Malformed chunk", e.message)
+        }
+
+        assertEquals(3, futures.size)
+        assertTrue(futures[1].isCancelCalled)
+        assertTrue(futures[2].isCancelCalled)
+    }
+
+    @Test
+    fun testChunkCount() {
+        assertEquals(0, chunkCount(0, 8))
+        assertEquals(1, chunkCount(8, 8))
+        assertEquals(2, chunkCount(9, 8))
+        assertEquals(2, chunkCount(Int.MAX_VALUE, Int.MAX_VALUE - 1))
+    }
+}
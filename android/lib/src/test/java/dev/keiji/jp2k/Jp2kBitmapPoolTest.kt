@@ -0,0 +1,132 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertSame
+import org.junit.Assert.fail
+import org.junit.Test
+import org.mockito.Mockito
+import org.mockito.Mockito.mockStatic
+import org.mockito.Mockito.never
+import org.mockito.Mockito.verify
+import org.mockito.kotlin.whenever
+
+class Jp2kBitmapPoolTest {
+
+    private fun mockBitmap(
+        width: Int,
+        height: Int,
+        config: Bitmap.Config = Bitmap.Config.ARGB_8888,
+        isMutable: Boolean = true,
+    ): Bitmap {
+        val bitmap = Mockito.mock(Bitmap::class.java)
+        whenever(bitmap.width).thenReturn(width)
+        whenever(bitmap.height).thenReturn(height)
+        whenever(bitmap.config).thenReturn(config)
+        whenever(bitmap.isMutable).thenReturn(isMutable)
+        whenever(bitmap.allocationByteCount).thenReturn(width * height * 4)
+        return bitmap
+    }
+
+    @Test
+    fun testGet_Empty_AllocatesAndCountsMiss() {
+        val pool = Jp2kBitmapPool()
+        val allocated = mockBitmap(2, 2)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> { Bitmap.createBitmap(2, 2, Bitmap.Config.ARGB_8888) }.thenReturn(allocated)
+
+            assertSame(allocated, pool.get(2, 2, Bitmap.Config.ARGB_8888))
+        }
+        assertEquals(0, pool.hitCount)
+        assertEquals(1, pool.missCount)
+    }
+
+    @Test
+    fun testGet_ReturnsPooledBitmapOfSameSizeOnly() {
+        val pool = Jp2kBitmapPool()
+        val bitmap = mockBitmap(4, 2)
+        pool.put(bitmap)
+        assertEquals(32, pool.sizeBytes)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> { Bitmap.createBitmap(2, 4, Bitmap.Config.ARGB_8888) }.thenReturn(mockBitmap(2, 4))
+            mockedBitmap.`when`<Bitmap> { Bitmap.createBitmap(4, 2, Bitmap.Config.RGB_565) }.thenReturn(mockBitmap(4, 2))
+
+            // Same pixel count, different bucket
+            pool.get(2, 4, Bitmap.Config.ARGB_8888)
+            pool.get(4, 2, Bitmap.Config.RGB_565)
+            assertEquals(2, pool.missCount)
+
+            assertSame(bitmap, pool.get(4, 2, Bitmap.Config.ARGB_8888))
+        }
+        assertEquals(1, pool.hitCount)
+        assertEquals(0, pool.sizeBytes)
+        verify(bitmap).isPremultiplied = true
+    }
+
+    @Test
+    fun testPut_ImmutableOrRecycled_NotPooled() {
+        val pool = Jp2kBitmapPool()
+        val recycled = mockBitmap(2, 2)
+        whenever(recycled.isRecycled).thenReturn(true)
+
+        pool.put(mockBitmap(2, 2, isMutable = false))
+        pool.put(recycled)
+
+        assertEquals(0, pool.sizeBytes)
+    }
+
+    @Test
+    fun testPut_OverMaxSize_RecyclesLeastRecentlyUsedBucket() {
+        val pool = Jp2kBitmapPool(maxSizeBytes = 48)
+        val old = mockBitmap(2, 2)
+        val recent = mockBitmap(2, 2)
+        val other = mockBitmap(4, 2)
+
+        pool.put(old)
+        pool.put(recent)
+        assertEquals(32, pool.sizeBytes)
+
+        pool.put(other)
+
+        assertEquals(48, pool.sizeBytes)
+        assertEquals(1, pool.evictionCount)
+        verify(old).recycle()
+        verify(recent, never()).recycle()
+        verify(other, never()).recycle()
+    }
+
+    @Test
+    fun testPut_LargerThanMaxSize_RecyclesBitmap() {
+        val pool = Jp2kBitmapPool(maxSizeBytes = 8)
+        val bitmap = mockBitmap(2, 2)
+
+        pool.put(bitmap)
+
+        assertEquals(0, pool.sizeBytes)
+        verify(bitmap).recycle()
+    }
+
+    @Test
+    fun testClear_RecyclesPooledBitmaps() {
+        val pool = Jp2kBitmapPool()
+        val bitmap = mockBitmap(2, 2)
+        pool.put(bitmap)
+
+        pool.clear()
+
+        assertEquals(0, pool.sizeBytes)
+        verify(bitmap).recycle()
+    }
+
+    @Test
+    fun testConstructor_NegativeMaxSize_ThrowsException() {
+        try {
+            Jp2kBitmapPool(maxSizeBytes = -1)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("maxSizeBytes must be 0 or greater", e.message)
+        }
+    }
+}
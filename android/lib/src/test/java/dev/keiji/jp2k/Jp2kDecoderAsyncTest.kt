@@ -17,6 +17,8 @@ import kotlinx.coroutines.test.setMain
 import org.json.JSONObject
 import org.junit.After
 import org.junit.Assert.assertEquals
+import org.junit.Assert.assertNotNull
+import org.junit.Assert.assertNull
 import org.junit.Assert.assertTrue
 import org.junit.Assert.fail
 import org.junit.Before
@@ -140,6 +142,33 @@ class Jp2kDecoderAsyncTest {
         verify(callbackPrecache).onSuccess(any())
     }
 
+    @Test
+    fun testDecodeImage_RecordsTimeToFirstDecode() {
+        val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+        doAnswer { invocation ->
+            val script = invocation.arguments[0] as String
+            if (script.contains("decodeJ2K(")) {
+                TestListenableFuture(jsonBmp)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }.whenever(isolate).evaluateJavaScriptAsync(any<String>())
+
+        val directExecutor = Executor { it.run() }
+        val decoder = Jp2kDecoderAsync(backgroundExecutor = directExecutor)
+        assertNull(decoder.initMetrics)
+
+        val callbackInit = org.mockito.kotlin.mock<Callback<Unit>>()
+        decoder.init(context, callbackInit)
+        verify(callbackInit).onSuccess(any())
+        assertNull(decoder.initMetrics!!.timeToFirstDecodeMs)
+
+        val callbackDecode = org.mockito.kotlin.mock<Callback<Bitmap>>()
+        decoder.decodeImage(ByteArray(20), callbackDecode)
+        verify(callbackDecode).onSuccess(any())
+        assertNotNull(decoder.initMetrics!!.timeToFirstDecodeMs)
+    }
+
     @Test
     fun testGetSize_Success() {
         val jsonSize = """{"width": 100, "height": 200}"""
@@ -174,6 +203,61 @@ class Jp2kDecoderAsyncTest {
         })
     }
 
+    @Test
+    fun testClearCache_Success() {
+        doAnswer { TestListenableFuture(INTERNAL_RESULT_SUCCESS) }
+            .whenever(isolate).evaluateJavaScriptAsync(any<String>())
+
+        val directExecutor = Executor { it.run() }
+        val decoder = Jp2kDecoderAsync(backgroundExecutor = directExecutor)
+
+        val callbackInit = org.mockito.kotlin.mock<Callback<Unit>>()
+        decoder.init(context, callbackInit)
+        verify(callbackInit).onSuccess(any())
+
+        val callbackClear = org.mockito.kotlin.mock<Callback<Unit>>()
+        decoder.clearCache(callbackClear)
+        verify(callbackClear).onSuccess(any())
+        verify(isolate).evaluateJavaScriptAsync("globalThis.clearData();")
+    }
+
+    @Test
+    fun testGetTileInfo_Success() {
+        val jsonTileInfo = """{"imageX0": 0, "imageY0": 0, "imageX1": 250, "imageY1": 130, "tileX0": 0, "tileY0": 0, "tileWidth": 100, "tileHeight": 100, "numTilesX": 3, "numTilesY": 2}"""
+
+        doAnswer { invocation ->
+            val script = invocation.arguments[0] as String
+            if (script.startsWith("globalThis.getTileInfoWithCache")) {
+                TestListenableFuture(jsonTileInfo)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }.whenever(isolate).evaluateJavaScriptAsync(any<String>())
+
+        val directExecutor = Executor { it.run() }
+        val decoder = Jp2kDecoderAsync(backgroundExecutor = directExecutor)
+        val data = ByteArray(10)
+
+        val callbackInit = org.mockito.kotlin.mock<Callback<Unit>>()
+        decoder.init(context, callbackInit)
+        verify(callbackInit).onSuccess(any())
+
+        val callbackPrecache = org.mockito.kotlin.mock<Callback<Unit>>()
+        decoder.precache(data, callbackPrecache)
+        verify(callbackPrecache).onSuccess(any())
+
+        val callbackTileInfo = org.mockito.kotlin.mock<Callback<TileInfo>>()
+        decoder.getTileInfo(callbackTileInfo)
+
+        verify(callbackTileInfo).onSuccess(org.mockito.kotlin.check {
+            assertEquals(250, it.imageX1)
+            assertEquals(100, it.tileWidth)
+            assertEquals(3, it.numTilesX)
+            assertEquals(2, it.numTilesY)
+            assertEquals(6, it.numTiles)
+        })
+    }
+
     @Test
     fun testGetSize_NoDataCached() {
         val jsonError = """{"errorCode": ${Jp2kError.CacheDataMissing.code}, "errorMessage": "No data cached"}"""
@@ -348,6 +432,31 @@ class Jp2kDecoderAsyncTest {
         })
     }
 
+    @Test
+    fun testDecodeImage_HeapAboveHighWaterMark_RecyclesHeap() {
+        val policy = HeapRecyclePolicy(highWaterMarkBytes = 64L * 1024 * 1024, idleTimeoutMillis = 0, trimMemoryLevel = null)
+        val decoder = createInitializedDecoder(config = Config(heapRecyclePolicy = policy)) { script ->
+            when {
+                script.startsWith("globalThis.recycleWasmInstance(") ->
+                    TestListenableFuture("""{"recycled": true, "reclaimedBytes": 50331648, "wasmHeapSizeBytes": 16777216}""")
+                script.contains("decodeJ2K(") ->
+                    TestListenableFuture("""{"bmp": "AQID", "wasmHeapSizeBytes": 67108864}""")
+                else -> TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val callback = org.mockito.kotlin.mock<Callback<Bitmap>>()
+        decoder.decodeImage(ByteArray(20), callback)
+
+        verify(callback).onSuccess(any())
+        verify(isolate).evaluateJavaScriptAsync("globalThis.recycleWasmInstance(67108864);")
+        val metrics = checkNotNull(decoder.heapRecycleMetrics)
+        assertEquals(1, metrics.recycleCount)
+        assertEquals(50331648L, metrics.lastReclaimedBytes)
+        assertEquals(HeapRecycleTrigger.HighWaterMark, metrics.lastTrigger)
+        assertEquals(State.Initialized, decoder.state)
+    }
+
     @Test
     fun testRelease_StateAndCancellation() {
         val decoder = createInitializedDecoder()
@@ -848,5 +957,87 @@ class Jp2kDecoderAsyncTest {
         verify(callback).onSuccess(any())
         assertTrue(appendChunkCalled)
     }
-}
 
+    @Test
+    fun testDecodeImageProgressive_CallsOnProgressForEachStep() {
+        val jsonPlan = """{"steps": [{"reduceLevel": 2, "qualityLayers": 1}, {"reduceLevel": 0, "qualityLayers": 0}]}"""
+        val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("getProgressivePlan(")) {
+                TestListenableFuture(jsonPlan)
+            } else if (script.contains("decodeJ2KWithCache(")) {
+                TestListenableFuture(jsonBmp)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val callback = org.mockito.kotlin.mock<ProgressiveCallback>()
+        decoder.decodeImageProgressive(ByteArray(20), ColorFormat.ARGB8888, 0, callback)
+
+        val order = Mockito.inOrder(callback)
+        order.verify(callback).onProgress(any(), org.mockito.kotlin.eq(false))
+        order.verify(callback).onProgress(any(), org.mockito.kotlin.eq(true))
+        verify(callback, Mockito.never()).onError(any())
+        verify(isolate).evaluateJavaScriptAsync(contains(", 2, 1);"))
+        verify(isolate).evaluateJavaScriptAsync(contains(", 0, 0);"))
+    }
+
+    @Test
+    fun testDecodeImageProgressive_NegativeReduceLevel_CallsOnError() {
+        val decoder = createInitializedDecoder()
+
+        val callback = org.mockito.kotlin.mock<ProgressiveCallback>()
+        decoder.decodeImageProgressive(ByteArray(20), ColorFormat.ARGB8888, -1, callback)
+
+        verify(callback).onError(org.mockito.kotlin.check {
+            assertTrue(it is IllegalArgumentException)
+            assertEquals("reduceLevel must be 0 or greater", it.message)
+        })
+        verify(callback, Mockito.never()).onProgress(any(), any())
+    }
+
+    @Test
+    fun testDecodeImages_CallsOnSuccessWithResultPerImage() {
+        val output = java.nio.ByteBuffer.allocate(4 + 8 + 3 + 8).order(java.nio.ByteOrder.LITTLE_ENDIAN)
+            .putInt(2)
+            .putInt(0).putInt(3).put(byteArrayOf(1, 2, 3))
+            .putInt(Jp2kError.Header.code).putInt(0)
+            .array()
+        val jsonResult = """{"bmp": "${java.util.Base64.getUrlEncoder().encodeToString(output)}"}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KBatch(")) {
+                TestListenableFuture(jsonResult)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val callback = org.mockito.kotlin.mock<Callback<List<Result<Bitmap>>>>()
+        decoder.decodeImages(listOf(ByteArray(20), ByteArray(20)), callback)
+
+        verify(callback).onSuccess(org.mockito.kotlin.check {
+            assertEquals(2, it.size)
+            assertTrue(it[0].isSuccess)
+            assertEquals(Jp2kError.Header, (it[1].exceptionOrNull() as Jp2kException).error)
+        })
+        verify(callback, Mockito.never()).onError(any())
+        verify(isolate, Mockito.times(1)).evaluateJavaScriptAsync(contains("decodeJ2KBatch("))
+    }
+
+    @Test
+    fun testDecodeImages_NegativeReduceLevel_CallsOnError() {
+        val decoder = createInitializedDecoder()
+
+        val callback = org.mockito.kotlin.mock<Callback<List<Result<Bitmap>>>>()
+        decoder.decodeImages(listOf(ByteArray(20)), ColorFormat.ARGB8888, -1, callback)
+
+        verify(callback).onError(org.mockito.kotlin.check {
+            assertTrue(it is IllegalArgumentException)
+            assertEquals("reduceLevel must be 0 or greater", it.message)
+        })
+        verify(isolate, Mockito.never()).evaluateJavaScriptAsync(contains("decodeJ2KBatch("))
+    }
+}
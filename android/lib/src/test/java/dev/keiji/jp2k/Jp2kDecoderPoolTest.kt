@@ -0,0 +1,325 @@
+package dev.keiji.jp2k
+
+import android.content.Context
+import android.content.res.AssetManager
+import android.graphics.Bitmap
+import android.graphics.BitmapFactory
+import androidx.javascriptengine.JavaScriptIsolate
+import androidx.javascriptengine.JavaScriptSandbox
+import com.google.common.util.concurrent.ListenableFuture
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.ExperimentalCoroutinesApi
+import kotlinx.coroutines.async
+import kotlinx.coroutines.test.StandardTestDispatcher
+import kotlinx.coroutines.test.advanceTimeBy
+import kotlinx.coroutines.test.advanceUntilIdle
+import kotlinx.coroutines.test.resetMain
+import kotlinx.coroutines.test.runTest
+import kotlinx.coroutines.test.setMain
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Assert.fail
+import org.junit.Before
+import org.junit.Test
+import org.mockito.Mock
+import org.mockito.MockedStatic
+import org.mockito.Mockito
+import org.mockito.Mockito.mockStatic
+import org.mockito.Mockito.verify
+import org.mockito.MockitoAnnotations
+import org.mockito.kotlin.any
+import org.mockito.kotlin.doAnswer
+import org.mockito.kotlin.whenever
+import java.io.ByteArrayInputStream
+import java.util.concurrent.CancellationException
+import java.util.concurrent.Executor
+import java.util.concurrent.TimeUnit
+
+@ExperimentalCoroutinesApi
+class Jp2kDecoderPoolTest {
+
+    @Mock
+    lateinit var context: Context
+
+    @Mock
+    lateinit var assetManager: AssetManager
+
+    @Mock
+    lateinit var sandbox: JavaScriptSandbox
+
+    @Mock
+    lateinit var isolate: JavaScriptIsolate
+
+    private lateinit var mockJp2kSandbox: MockedStatic<Jp2kSandbox>
+    private lateinit var mockBitmapFactory: MockedStatic<BitmapFactory>
+    private lateinit var mockLog: MockedStatic<android.util.Log>
+
+    private val testDispatcher = StandardTestDispatcher()
+
+    private val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+
+    // Completes when complete() is called, so a decode can be held in flight
+    private class PendingListenableFuture<T> : ListenableFuture<T> {
+        private var result: T? = null
+        private val listeners = mutableListOf<Runnable>()
+
+        fun complete(value: T) {
+            result = value
+            listeners.forEach { it.run() }
+            listeners.clear()
+        }
+
+        override fun cancel(mayInterruptIfRunning: Boolean): Boolean = false
+        override fun isCancelled(): Boolean = false
+        override fun isDone(): Boolean = result != null
+        override fun get(): T = checkNotNull(result)
+        override fun get(timeout: Long, unit: TimeUnit?): T = get()
+        override fun addListener(listener: Runnable, executor: Executor) {
+            if (result != null) listener.run() else listeners.add(listener)
+        }
+    }
+
+    @Before
+    fun setUp() {
+        MockitoAnnotations.openMocks(this)
+        Dispatchers.setMain(testDispatcher)
+
+        whenever(context.assets).thenReturn(assetManager)
+        whenever(assetManager.open(any<String>())).thenAnswer { ByteArrayInputStream(ByteArray(0)) }
+
+        mockJp2kSandbox = mockStatic(Jp2kSandbox::class.java)
+
+        mockJp2kSandbox.`when`<ListenableFuture<JavaScriptSandbox>> {
+            Jp2kSandbox.get(any<Context>())
+        }.thenReturn(TestListenableFuture(sandbox))
+
+        mockJp2kSandbox.`when`<JavaScriptIsolate> {
+            Jp2kSandbox.createIsolate(any(), any(), any())
+        }.thenReturn(isolate)
+
+        whenever(sandbox.isFeatureSupported(any<String>())).thenReturn(true)
+        Mockito.doNothing().whenever(isolate).provideNamedData(any(), any())
+
+        mockBitmapFactory = mockStatic(BitmapFactory::class.java)
+        mockBitmapFactory.`when`<Bitmap> {
+            BitmapFactory.decodeByteArray(any(), any(), any(), any())
+        }.thenReturn(Mockito.mock(Bitmap::class.java))
+
+        mockLog = mockStatic(android.util.Log::class.java)
+    }
+
+    @After
+    fun tearDown() {
+        JavaScriptEngineEnvironment.resetForTesting()
+        mockJp2kSandbox.close()
+        mockBitmapFactory.close()
+        mockLog.close()
+        Dispatchers.resetMain()
+    }
+
+    private fun mockScripts(scriptHandler: (String) -> ListenableFuture<String>) {
+        doAnswer { invocation ->
+            scriptHandler(invocation.arguments[0] as String)
+        }.whenever(isolate).evaluateJavaScriptAsync(any<String>())
+    }
+
+    private fun decodeScripts(script: String): ListenableFuture<String> =
+        if (script.contains("decodeJ2K(")) TestListenableFuture(jsonBmp) else TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+
+    @Test
+    fun testConstructor_InvalidSizes_ThrowsException() {
+        try {
+            Jp2kDecoderPool(minSize = 0)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("minSize must be 1 or greater", e.message)
+        }
+        try {
+            Jp2kDecoderPool(minSize = 3, maxSize = 2)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("maxSize must be minSize or greater", e.message)
+        }
+    }
+
+    @Test
+    fun testInit_CreatesMinSizeDecoders() = runTest {
+        mockScripts(::decodeScripts)
+        val pool = Jp2kDecoderPool(minSize = 2, maxSize = 4, coroutineDispatcher = testDispatcher)
+
+        pool.init(context)
+
+        assertEquals(State.Initialized, pool.state)
+        assertEquals(2, pool.size)
+        mockJp2kSandbox.verify({ Jp2kSandbox.createIsolate(any(), any(), any()) }, Mockito.times(2))
+    }
+
+    @Test
+    fun testDecodeImage_BeforeInit_ThrowsException() = runTest {
+        val pool = Jp2kDecoderPool(coroutineDispatcher = testDispatcher)
+
+        try {
+            pool.decodeImage(ByteArray(20))
+            fail("Should throw IllegalStateException")
+        } catch (e: IllegalStateException) {
+            assertEquals("Cannot decode while in state: Uninitialized", e.message)
+        }
+    }
+
+    @Test
+    fun testDecodeImage_ReusesIdleDecoder() = runTest {
+        mockScripts(::decodeScripts)
+        val pool = Jp2kDecoderPool(minSize = 1, maxSize = 4, coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        pool.decodeImage(ByteArray(20))
+        pool.decodeImage(ByteArray(20))
+
+        assertEquals(1, pool.size)
+        val utilization = pool.getUtilization().single()
+        assertEquals(0, utilization.activeRequests)
+        assertEquals(2L, utilization.completedRequests)
+    }
+
+    @Test
+    fun testDecodeImage_GrowsWhenAllDecodersAreBusy() = runTest {
+        val pending = PendingListenableFuture<String>()
+        var decodeCount = 0
+        mockScripts { script ->
+            if (script.contains("decodeJ2K(") && decodeCount++ == 0) pending else decodeScripts(script)
+        }
+        val pool = Jp2kDecoderPool(minSize = 1, maxSize = 2, coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        val first = async { pool.decodeImage(ByteArray(20)) }
+        advanceUntilIdle()
+        assertEquals(1, pool.getUtilization().single().activeRequests)
+
+        pool.decodeImage(ByteArray(20))
+        assertEquals(2, pool.size)
+
+        pending.complete(jsonBmp)
+        first.await()
+        assertEquals(listOf(1L, 1L), pool.getUtilization().map { it.completedRequests })
+    }
+
+    @Test
+    fun testDecodeImage_QueuesAtMaxSize() = runTest {
+        val pending = PendingListenableFuture<String>()
+        var decodeCount = 0
+        mockScripts { script ->
+            if (script.contains("decodeJ2K(") && decodeCount++ == 0) pending else decodeScripts(script)
+        }
+        val pool = Jp2kDecoderPool(minSize = 1, maxSize = 1, coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        val first = async { pool.decodeImage(ByteArray(20)) }
+        val second = async { pool.decodeImage(ByteArray(20)) }
+        advanceUntilIdle()
+        assertEquals(1, pool.size)
+        assertEquals(2, pool.getUtilization().single().activeRequests)
+
+        pending.complete(jsonBmp)
+        first.await()
+        second.await()
+        assertEquals(2L, pool.getUtilization().single().completedRequests)
+    }
+
+    @Test
+    fun testDecodeImage_ReleasesIdleDecodersAboveMinSize() = runTest {
+        val pending = PendingListenableFuture<String>()
+        var decodeCount = 0
+        mockScripts { script ->
+            if (script.contains("decodeJ2K(") && decodeCount++ == 0) pending else decodeScripts(script)
+        }
+        val pool = Jp2kDecoderPool(minSize = 1, maxSize = 2, idleTimeoutMillis = 0, coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        val first = async { pool.decodeImage(ByteArray(20)) }
+        advanceUntilIdle()
+        pool.decodeImage(ByteArray(20))
+
+        // The decoder added for the second request was idle on completion and has been released
+        assertEquals(1, pool.size)
+
+        pending.complete(jsonBmp)
+        first.await()
+        assertEquals(1, pool.size)
+    }
+
+    @Test
+    fun testDecodeImage_ReleasesIdleDecoderAfterTimeoutWithoutFurtherRequests() = runTest {
+        val pending = PendingListenableFuture<String>()
+        var decodeCount = 0
+        mockScripts { script ->
+            if (script.contains("decodeJ2K(") && decodeCount++ == 0) pending else decodeScripts(script)
+        }
+        val pool = Jp2kDecoderPool(minSize = 1, maxSize = 2, idleTimeoutMillis = 1000, coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        val first = async { pool.decodeImage(ByteArray(20)) }
+        advanceUntilIdle()
+        pool.decodeImage(ByteArray(20))
+        pending.complete(jsonBmp)
+        first.await()
+        assertEquals(2, pool.size)
+
+        advanceTimeBy(900)
+        assertEquals(2, pool.size)
+
+        // No request completes, yet the pool shrinks back to minSize
+        advanceTimeBy(200)
+        assertEquals(1, pool.size)
+        verify(isolate).close()
+    }
+
+    @Test
+    fun testDecodeImage_ErrorIsCountedAsCompleted() = runTest {
+        mockScripts { script ->
+            if (script.contains("decodeJ2K(")) {
+                TestListenableFuture("""{"errorCode": ${Jp2kError.Decode.code}}""")
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        val pool = Jp2kDecoderPool(coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        try {
+            pool.decodeImage(ByteArray(20))
+            fail("Should throw Jp2kException")
+        } catch (e: Jp2kException) {
+            assertEquals(Jp2kError.Decode, e.error)
+        }
+
+        val utilization = pool.getUtilization().single()
+        assertEquals(0, utilization.activeRequests)
+        assertEquals(1L, utilization.completedRequests)
+    }
+
+    @Test
+    fun testRelease_ClosesAllIsolates() = runTest {
+        mockScripts(::decodeScripts)
+        val pool = Jp2kDecoderPool(minSize = 2, maxSize = 2, coroutineDispatcher = testDispatcher)
+        pool.init(context)
+
+        pool.release()
+
+        assertEquals(State.Released, pool.state)
+        assertEquals(0, pool.size)
+        verify(isolate, Mockito.times(2)).close()
+        try {
+            pool.decodeImage(ByteArray(20))
+            fail("Should throw CancellationException")
+        } catch (e: CancellationException) {
+            assertTrue(e.message!!.contains("released"))
+        }
+    }
+
+    @Test
+    fun testIsolateUtilization_Ratio() {
+        assertEquals(0.25, IsolateUtilization(0, 1, 250, 1000).utilization, 0.0)
+        assertEquals(0.0, IsolateUtilization(0, 0, 0, 0).utilization, 0.0)
+    }
+}
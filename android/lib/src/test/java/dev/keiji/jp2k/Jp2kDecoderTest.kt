@@ -1,5 +1,6 @@
 package dev.keiji.jp2k
 
+import android.content.ComponentCallbacks2
 import android.content.Context
 import android.content.res.AssetManager
 import android.graphics.Bitmap
@@ -7,22 +8,34 @@ import android.graphics.BitmapFactory
 import android.graphics.RectF
 import androidx.javascriptengine.JavaScriptIsolate
 import androidx.javascriptengine.JavaScriptSandbox
+import androidx.javascriptengine.Message
+import androidx.javascriptengine.MessagePortClient
 import com.google.common.util.concurrent.ListenableFuture
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.ExperimentalCoroutinesApi
+import kotlinx.coroutines.cancelAndJoin
+import kotlinx.coroutines.flow.toList
+import kotlinx.coroutines.async
+import kotlinx.coroutines.launch
 import kotlinx.coroutines.test.StandardTestDispatcher
+import kotlinx.coroutines.test.advanceTimeBy
+import kotlinx.coroutines.test.advanceUntilIdle
 import kotlinx.coroutines.test.resetMain
 import kotlinx.coroutines.test.runTest
 import kotlinx.coroutines.test.setMain
+import kotlinx.coroutines.withContext
 import org.json.JSONObject
 import org.junit.After
 import org.junit.Assert.assertEquals
+import org.junit.Assert.assertFalse
 import org.junit.Assert.assertNotNull
+import org.junit.Assert.assertNull
 import org.junit.Assert.assertTrue
 import org.junit.Assert.fail
 import org.junit.Before
 import org.junit.Test
 import org.mockito.ArgumentMatchers.contains
+import org.mockito.ArgumentCaptor
 import org.mockito.Mock
 import org.mockito.MockedStatic
 import org.mockito.Mockito
@@ -34,6 +47,8 @@ import org.mockito.kotlin.any
 import org.mockito.kotlin.doAnswer
 import org.mockito.kotlin.whenever
 import java.io.ByteArrayInputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.util.concurrent.Executor
 import java.util.concurrent.TimeUnit
 
@@ -132,6 +147,424 @@ class Jp2kDecoderTest {
         verify(isolate, Mockito.atLeastOnce()).evaluateJavaScriptAsync(contains("globalThis.j2kData"))
     }
 
+    @Test
+    fun testInit_DecodeThreads_PassedToScript() = runTest {
+        createInitializedDecoder(config = Config(decodeThreads = 4))
+
+        verify(isolate).evaluateJavaScriptAsync(contains("globalThis.setDecodeThreads(4);"))
+    }
+
+    @Test
+    fun testInit_RawPixelOutput_PassedToScript() = runTest {
+        createInitializedDecoder()
+        verify(isolate).evaluateJavaScriptAsync(contains("globalThis.setOutputFormat($OUTPUT_FORMAT_RAW);"))
+    }
+
+    @Test
+    fun testInit_EnablesScratchArena() = runTest {
+        createInitializedDecoder()
+        verify(isolate).evaluateJavaScriptAsync(contains("wasmInstance.exports.setScratchArena(1);"))
+    }
+
+    @Test
+    fun testInit_EnablesTileStreaming() = runTest {
+        createInitializedDecoder()
+        verify(isolate).evaluateJavaScriptAsync(contains("wasmInstance.exports.setTileStreaming(1);"))
+    }
+
+    @Test
+    fun testInit_ReusesCachedWasmBinary() = runTest {
+        WasmModuleCache.clearForTesting()
+
+        val first = createInitializedDecoder()
+        val second = createInitializedDecoder()
+
+        verify(assetManager, Mockito.times(1)).open(any<String>())
+        assertFalse(first.initMetrics!!.isWasmCached)
+        assertTrue(second.initMetrics!!.isWasmCached)
+    }
+
+    @Test
+    fun testDecodeImage_RecordsTimeToFirstDecode() = runTest {
+        val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2K(")) {
+                TestListenableFuture(jsonBmp)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        assertNull(decoder.initMetrics!!.timeToFirstDecodeMs)
+
+        decoder.decodeImage(ByteArray(20))
+        val timeToFirstDecodeMs = decoder.initMetrics!!.timeToFirstDecodeMs
+        assertNotNull(timeToFirstDecodeMs)
+        assertTrue(timeToFirstDecodeMs!! >= decoder.initMetrics!!.initTimeMs)
+
+        // Later decodes leave the value alone
+        decoder.decodeImage(ByteArray(20))
+        assertEquals(timeToFirstDecodeMs, decoder.initMetrics!!.timeToFirstDecodeMs)
+    }
+
+    @Test
+    fun testDecodeImage_RawOutput_CopiesPixelsIntoBitmap() = runTest {
+        val payload = ByteBuffer.allocate(RAW_HEADER_SIZE_BYTES + 8).order(ByteOrder.LITTLE_ENDIAN)
+            .putInt(2).putInt(1).putInt(8).putInt(ColorFormat.ARGB8888.id)
+            .put(byteArrayOf(1, 2, 3, 4, 5, 6, 7, 8))
+            .array()
+        val encoded = java.util.Base64.getEncoder().encodeToString(payload)
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KWithCache(")) {
+                TestListenableFuture("""{"bmp": "$encoded", "raw": true}""")
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        decoder.precache(ByteArray(10))
+
+        val bitmap = Mockito.mock(Bitmap::class.java)
+        whenever(bitmap.rowBytes).thenReturn(8)
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> {
+                Bitmap.createBitmap(2, 1, Bitmap.Config.ARGB_8888)
+            }.thenReturn(bitmap)
+
+            assertEquals(bitmap, decoder.decodeImage())
+        }
+
+        verify(bitmap).copyPixelsFromBuffer(org.mockito.kotlin.check<ByteBuffer> {
+            assertEquals(8, it.remaining())
+            assertEquals(1.toByte(), it.get(it.position()))
+        })
+        mockBitmapFactory.verify({ BitmapFactory.decodeByteArray(any(), any(), any(), any()) }, Mockito.never())
+    }
+
+    // Initializes a decoder whose cached decodes return a 2x1 ARGB_8888 raw output
+    private suspend fun createDecoderReturningRawPixels(
+        config: Config = Config(),
+        otherScriptHandler: (String) -> ListenableFuture<String> = { TestListenableFuture(INTERNAL_RESULT_SUCCESS) },
+    ): Jp2kDecoder {
+        val payload = ByteBuffer.allocate(RAW_HEADER_SIZE_BYTES + 8).order(ByteOrder.LITTLE_ENDIAN)
+            .putInt(2).putInt(1).putInt(8).putInt(ColorFormat.ARGB8888.id)
+            .put(byteArrayOf(1, 2, 3, 4, 5, 6, 7, 8))
+            .array()
+        val encoded = java.util.Base64.getEncoder().encodeToString(payload)
+
+        val decoder = createInitializedDecoder(config = config) { script ->
+            if (script.contains("decodeJ2KWithCache(")) {
+                TestListenableFuture("""{"bmp": "$encoded", "raw": true}""")
+            } else {
+                otherScriptHandler(script)
+            }
+        }
+        decoder.precache(ByteArray(10))
+        return decoder
+    }
+
+    private fun mockMutableBitmap(width: Int, height: Int, config: Bitmap.Config = Bitmap.Config.ARGB_8888): Bitmap {
+        val bitmap = Mockito.mock(Bitmap::class.java)
+        whenever(bitmap.width).thenReturn(width)
+        whenever(bitmap.height).thenReturn(height)
+        whenever(bitmap.config).thenReturn(config)
+        whenever(bitmap.isMutable).thenReturn(true)
+        whenever(bitmap.rowBytes).thenReturn(width * 4)
+        whenever(bitmap.allocationByteCount).thenReturn(width * height * 4)
+        return bitmap
+    }
+
+    @Test
+    fun testDecodeImageInto_RawOutput_CopiesPixelsIntoSuppliedBitmap() = runTest {
+        val decoder = createDecoderReturningRawPixels()
+        val bitmap = mockMutableBitmap(2, 1)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            assertEquals(bitmap, decoder.decodeImageInto(bitmap))
+            mockedBitmap.verify({ Bitmap.createBitmap(any<Int>(), any<Int>(), any<Bitmap.Config>()) }, Mockito.never())
+        }
+
+        verify(isolate).evaluateJavaScriptAsync(contains(", ${ColorFormat.ARGB8888.id}, "))
+        verify(bitmap).copyPixelsFromBuffer(org.mockito.kotlin.check<ByteBuffer> {
+            assertEquals(8, it.remaining())
+        })
+    }
+
+    @Test
+    fun testDecodeImageInto_SizeMismatch_ThrowsException() = runTest {
+        val decoder = createDecoderReturningRawPixels()
+        val bitmap = mockMutableBitmap(1, 2)
+
+        try {
+            decoder.decodeImageInto(bitmap)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("Bitmap 1x2 ARGB_8888 cannot hold the decoded 2x1 ARGB_8888 image.", e.message)
+        }
+        verify(bitmap, Mockito.never()).copyPixelsFromBuffer(any())
+        assertEquals(State.Initialized, decoder.state)
+    }
+
+    @Test
+    fun testDecodeImageInto_UnsupportedConfig_ThrowsException() = runTest {
+        val decoder = createDecoderReturningRawPixels()
+
+        try {
+            decoder.decodeImageInto(mockMutableBitmap(2, 1, Bitmap.Config.ALPHA_8))
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("Unsupported Bitmap config: ALPHA_8", e.message)
+        }
+    }
+
+    @Test
+    fun testDecodeImage_BitmapPool_ReusesReturnedBitmap() = runTest {
+        val pool = Jp2kBitmapPool()
+        val decoder = createDecoderReturningRawPixels(Config(bitmapPool = pool))
+        val bitmap = mockMutableBitmap(2, 1)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> {
+                Bitmap.createBitmap(2, 1, Bitmap.Config.ARGB_8888)
+            }.thenReturn(bitmap)
+
+            val first = decoder.decodeImage()
+            pool.put(first)
+            assertEquals(bitmap, decoder.decodeImage())
+
+            mockedBitmap.verify({ Bitmap.createBitmap(2, 1, Bitmap.Config.ARGB_8888) }, Mockito.times(1))
+        }
+        assertEquals(1, pool.hitCount)
+        assertEquals(1, pool.missCount)
+        verify(bitmap, Mockito.times(2)).copyPixelsFromBuffer(any())
+    }
+
+    @Test
+    fun testDecodeImage_RegionCache_ServesRepeatedRegionWithoutDecoding() = runTest {
+        val regionCache = Jp2kRegionCache()
+        val decoder = createDecoderReturningRawPixels(Config(regionCache = regionCache))
+        val bitmap = mockMutableBitmap(2, 1)
+        val snapshot = mockMutableBitmap(2, 1)
+        val copy = mockMutableBitmap(2, 1)
+        whenever(bitmap.copy(Bitmap.Config.ARGB_8888, false)).thenReturn(snapshot)
+        whenever(snapshot.copy(Bitmap.Config.ARGB_8888, true)).thenReturn(copy)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> {
+                Bitmap.createBitmap(2, 1, Bitmap.Config.ARGB_8888)
+            }.thenReturn(bitmap)
+
+            assertEquals(bitmap, decoder.decodeImage(0, 0, 2, 1))
+            assertEquals(copy, decoder.decodeImage(0, 0, 2, 1))
+        }
+
+        verify(isolate, Mockito.times(1)).evaluateJavaScriptAsync(contains("decodeJ2KWithCache("))
+        assertEquals(1, regionCache.hitCount)
+        assertEquals(1, regionCache.missCount)
+
+        // Another image is not served from the entries of the previous one
+        decoder.clearCache()
+        decoder.precache(ByteArray(10), cacheKey = "other")
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> {
+                Bitmap.createBitmap(2, 1, Bitmap.Config.ARGB_8888)
+            }.thenReturn(bitmap)
+
+            decoder.decodeImage(0, 0, 2, 1)
+        }
+        verify(isolate, Mockito.times(2)).evaluateJavaScriptAsync(contains("decodeJ2KWithCache("))
+    }
+
+    @Test
+    fun testDecodeImage_RegionCache_PrecacheWhileQueued_CachesUnderNewImage() = runTest {
+        val regionCache = Jp2kRegionCache()
+        var setDataResult: ListenableFuture<String> = TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+        val decoder = createDecoderReturningRawPixels(Config(regionCache = regionCache)) { script ->
+            if (script.contains("globalThis.j2kData = ")) setDataResult else TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+        }
+        decoder.precache(ByteArray(10), cacheKey = "first")
+        val bitmap = mockMutableBitmap(2, 1)
+        val snapshot = mockMutableBitmap(2, 1)
+        val copy = mockMutableBitmap(2, 1)
+        whenever(bitmap.copy(Bitmap.Config.ARGB_8888, false)).thenReturn(snapshot)
+        whenever(snapshot.copy(Bitmap.Config.ARGB_8888, true)).thenReturn(copy)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> {
+                Bitmap.createBitmap(2, 1, Bitmap.Config.ARGB_8888)
+            }.thenReturn(bitmap)
+
+            // The decode is queued while the precache of another image holds the decoder
+            val pendingSetData = DeferredListenableFuture<String>()
+            setDataResult = pendingSetData
+            launch { decoder.precache(ByteArray(10), cacheKey = "second") }
+            advanceUntilIdle()
+            val decoded = async { decoder.decodeImage(0, 0, 2, 1) }
+            advanceUntilIdle()
+            pendingSetData.complete(INTERNAL_RESULT_SUCCESS)
+            advanceUntilIdle()
+
+            assertEquals(bitmap, decoded.await())
+        }
+
+        // The pixels belong to the second image
+        assertNull(regionCache.get("first", 0, 0, 2, 1, ColorFormat.ARGB8888, 0))
+        assertEquals(copy, regionCache.get("second", 0, 0, 2, 1, ColorFormat.ARGB8888, 0))
+    }
+
+    @Test
+    fun testDecodeImage_CoroutineCancelled_StaysUsable() = runTest {
+        var decodeResult: () -> ListenableFuture<String> = { PendingListenableFuture() }
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KWithCache(")) decodeResult() else TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+        }
+        decoder.precache(ByteArray(10))
+
+        val job = launch { decoder.decodeImage() }
+        advanceUntilIdle()
+        assertEquals(State.Processing, decoder.state)
+
+        job.cancelAndJoin()
+
+        assertEquals(State.Initialized, decoder.state)
+
+        // The next decode waits for the abandoned one first
+        decodeResult = { TestListenableFuture("""{"errorCode": ${Jp2kError.Decode.code}}""") }
+        try {
+            decoder.decodeImage()
+            fail("Should throw Jp2kException")
+        } catch (e: Jp2kException) {
+            assertEquals(Jp2kError.Decode, e.error)
+        }
+        verify(isolate).evaluateJavaScriptAsync("globalThis.beginRequest(0);")
+    }
+
+    @Test
+    fun testDecodeImage_Deadline_BeginsRequestWithTimeout() = runTest {
+        val decoder = createInitializedDecoder(config = Config(decodeTimeoutMillis = 250)) { script ->
+            if (script.contains("decodeJ2KWithCache(")) {
+                TestListenableFuture("""{"errorCode": ${Jp2kError.DeadlineExceeded.code}}""")
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        decoder.precache(ByteArray(10))
+
+        try {
+            decoder.decodeImage()
+            fail("Should throw Jp2kException")
+        } catch (e: Jp2kException) {
+            assertEquals(Jp2kError.DeadlineExceeded, e.error)
+        }
+        verify(isolate).evaluateJavaScriptAsync("globalThis.beginRequest(250);")
+        assertEquals(State.Initialized, decoder.state)
+
+        // A deadline in the coroutine context overrides the one of the config
+        withContext(Jp2kDeadline(40)) {
+            try {
+                decoder.decodeImage()
+                fail("Should throw Jp2kException")
+            } catch (e: Jp2kException) {
+                assertEquals(Jp2kError.DeadlineExceeded, e.error)
+            }
+        }
+        verify(isolate).evaluateJavaScriptAsync("globalThis.beginRequest(40);")
+    }
+
+    private fun resultFrame(payload: ByteArray, format: Int = OUTPUT_FORMAT_BMP, magic: Int = RESULT_FRAME_MAGIC): ByteArray =
+        ByteBuffer.allocate(RESULT_FRAME_HEADER_SIZE_BYTES + payload.size).order(ByteOrder.LITTLE_ENDIAN)
+            .putInt(magic).putInt(0).putInt(1).putInt(1).putInt(format).putInt(4)
+            .putDouble(1.0).putDouble(2.0).putDouble(3.0).putDouble(0.0).putDouble(0.0).putDouble(65536.0)
+            .putInt(1500).putInt(12000).putInt(2500).putInt(4).putInt(8192).putInt(3).putInt(4096)
+            .put(payload)
+            .array()
+
+    // Initializes a decoder whose decode scripts post frame through the output MessagePort
+    private suspend fun createDecoderPostingFrame(frame: ByteArray, config: Config = Config()): Jp2kDecoder {
+        var client: MessagePortClient? = null
+        val decoder = createInitializedDecoder(config = config) { script ->
+            if (script.contains("decodeJ2K(")) {
+                checkNotNull(client).onMessage(Message.createArrayBufferMessage(frame))
+                TestListenableFuture(INTERNAL_RESULT_FRAME)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        val captor = ArgumentCaptor.forClass(MessagePortClient::class.java)
+        verify(isolate).createMessageChannel(any(), any(), captor.capture())
+        client = captor.value
+        return decoder
+    }
+
+    @Test
+    fun testDecodeImage_ResultFrame_DecodesPayloadInPlace() = runTest {
+        val frame = resultFrame(byteArrayOf(1, 2, 3))
+        val decoder = createDecoderPostingFrame(frame, Config(logLevel = android.util.Log.INFO))
+
+        decoder.decodeImage(ByteArray(20))
+
+        // The BMP is decoded straight from the frame, after its header
+        mockBitmapFactory.verify({
+            BitmapFactory.decodeByteArray(
+                org.mockito.kotlin.eq(frame),
+                org.mockito.kotlin.eq(RESULT_FRAME_HEADER_SIZE_BYTES),
+                org.mockito.kotlin.eq(3),
+                any(),
+            )
+        })
+    }
+
+    @Test
+    fun testDecodeImage_ResultFrame_ReportsDecodeStats() = runTest {
+        val frame = resultFrame(byteArrayOf(1, 2, 3))
+        val decoder = createDecoderPostingFrame(frame, Config(logLevel = android.util.Log.INFO))
+
+        decoder.decodeImage(ByteArray(20))
+
+        val metrics = checkNotNull(decoder.lastPerformanceMetrics)
+        assertEquals(1.5, metrics.headerTimeMs, 0.001)
+        assertEquals(12.0, metrics.codestreamDecodeTimeMs, 0.001)
+        assertEquals(2.5, metrics.conversionTimeMs, 0.001)
+        assertEquals(4L, metrics.tilesDecoded)
+        assertEquals(8192L, metrics.bytesRead)
+        assertEquals(3L, metrics.wasmAllocationCount)
+        assertEquals(4096L, metrics.wasmAllocatedBytes)
+    }
+
+    @Test
+    fun testDecodeImage_ResultFrame_UnknownMagic_ThrowsException() = runTest {
+        val frame = resultFrame(byteArrayOf(1, 2, 3), magic = 0)
+        val decoder = createDecoderPostingFrame(frame)
+
+        try {
+            decoder.decodeImage(ByteArray(20))
+            fail("Should throw IllegalStateException")
+        } catch (e: IllegalStateException) {
+            assertEquals("Result frame has an unknown magic number.", e.message)
+        }
+        assertEquals(State.Initialized, decoder.state)
+    }
+
+    @Test
+    fun testClearCache_Success() = runTest {
+        val decoder = createInitializedDecoder()
+        decoder.precache(ByteArray(10))
+        decoder.clearCache()
+
+        verify(isolate).evaluateJavaScriptAsync("globalThis.clearData();")
+        assertEquals(State.Initialized, decoder.state)
+    }
+
+    @Test
+    fun testClearCache_Uninitialized() = runTest {
+        val decoder = Jp2kDecoder(coroutineDispatcher = testDispatcher)
+        try {
+            decoder.clearCache()
+            fail("Should throw IllegalStateException")
+        } catch (e: IllegalStateException) {
+            assertEquals("Cannot clear cache while in state: Uninitialized", e.message)
+        }
+    }
+
     @Test
     fun testGetSize_Success() = runTest {
         val jsonSize = """{"width": 100, "height": 200}"""
@@ -303,7 +736,7 @@ class Jp2kDecoderTest {
 
     @Test
     fun testGetMemoryUsage_Success() = runTest {
-        val jsonUsage = """{"wasmHeapSizeBytes": 2048}"""
+        val jsonUsage = """{"wasmHeapSizeBytes": 2048, "scratchHighWaterMarkBytes": 1024}"""
 
         val decoder = createInitializedDecoder { script ->
             if (script.contains("getMemoryUsage()")) {
@@ -315,6 +748,102 @@ class Jp2kDecoderTest {
 
         val memoryUsage = decoder.getMemoryUsage()
         assertEquals(2048L, memoryUsage.wasmHeapSizeBytes)
+        assertEquals(1024L, memoryUsage.scratchHighWaterMarkBytes)
+    }
+
+    @Test
+    fun testGetMemoryUsage_LastDecode() = runTest {
+        val jsonUsage = """{"wasmHeapSizeBytes": 8388608, "scratchHighWaterMarkBytes": 0,
+            |"heapInUseBytes": 1500000, "lastDecodePeakBytes": 4200000, "lastDecodeEstimatedPeakBytes": 4800000}""".trimMargin()
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("getMemoryUsage()")) {
+                TestListenableFuture(jsonUsage)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val memoryUsage = decoder.getMemoryUsage()
+        assertEquals(1500000L, memoryUsage.heapInUseBytes)
+        assertEquals(4200000L, memoryUsage.lastDecodePeakBytes)
+        assertEquals(4800000L, memoryUsage.lastDecodeEstimatedPeakBytes)
+    }
+
+    // Initializes a decoder whose decodes leave the WASM heap at heapSizeBytes and whose recycles hand 48 MiB back
+    private suspend fun createDecoderWithHeapRecycle(policy: HeapRecyclePolicy, heapSizeBytes: Long): Jp2kDecoder =
+        createInitializedDecoder(config = Config(heapRecyclePolicy = policy)) { script ->
+            when {
+                script.startsWith("globalThis.recycleWasmInstance(") ->
+                    TestListenableFuture("""{"recycled": true, "reclaimedBytes": 50331648, "wasmHeapSizeBytes": 16777216}""")
+                script.contains("decodeJ2K(") ->
+                    TestListenableFuture("""{"bmp": "AQID", "wasmHeapSizeBytes": $heapSizeBytes}""")
+                else -> TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+    @Test
+    fun testDecodeImage_HeapAboveHighWaterMark_RecyclesHeap() = runTest {
+        val policy = HeapRecyclePolicy(highWaterMarkBytes = 64L * 1024 * 1024, idleTimeoutMillis = 0, trimMemoryLevel = null)
+        val decoder = createDecoderWithHeapRecycle(policy, heapSizeBytes = 32L * 1024 * 1024)
+
+        // Below the high-water mark the heap is kept
+        decoder.decodeImage(ByteArray(20))
+        advanceUntilIdle()
+        verify(isolate, Mockito.never()).evaluateJavaScriptAsync(contains("recycleWasmInstance("))
+        assertNull(decoder.heapRecycleMetrics)
+
+        val growingDecoder = createDecoderWithHeapRecycle(policy, heapSizeBytes = 64L * 1024 * 1024)
+        growingDecoder.decodeImage(ByteArray(20))
+        advanceUntilIdle()
+
+        verify(isolate).evaluateJavaScriptAsync("globalThis.recycleWasmInstance(67108864);")
+        val metrics = checkNotNull(growingDecoder.heapRecycleMetrics)
+        assertEquals(1, metrics.recycleCount)
+        assertEquals(50331648L, metrics.lastReclaimedBytes)
+        assertEquals(50331648L, metrics.totalReclaimedBytes)
+        assertEquals(HeapRecycleTrigger.HighWaterMark, metrics.lastTrigger)
+        assertEquals(State.Initialized, growingDecoder.state)
+
+        // The decoder keeps decoding on the new instance
+        assertNotNull(growingDecoder.decodeImage(ByteArray(20)))
+    }
+
+    @Test
+    fun testDecodeImage_IdleTimeout_RecyclesHeap() = runTest {
+        val policy = HeapRecyclePolicy(highWaterMarkBytes = 0, idleTimeoutMillis = 1000, trimMemoryLevel = null)
+        val decoder = createDecoderWithHeapRecycle(policy, heapSizeBytes = 64L * 1024 * 1024)
+
+        decoder.decodeImage(ByteArray(20))
+        advanceTimeBy(600)
+        // A decode restarts the idle timer
+        decoder.decodeImage(ByteArray(20))
+        advanceTimeBy(600)
+        verify(isolate, Mockito.never()).evaluateJavaScriptAsync(contains("recycleWasmInstance("))
+
+        advanceTimeBy(500)
+        verify(isolate).evaluateJavaScriptAsync("globalThis.recycleWasmInstance(0);")
+        assertEquals(HeapRecycleTrigger.Idle, checkNotNull(decoder.heapRecycleMetrics).lastTrigger)
+    }
+
+    @Test
+    fun testOnTrimMemory_RecyclesHeapFromTrimMemoryLevel() = runTest {
+        val policy = HeapRecyclePolicy(highWaterMarkBytes = 0, idleTimeoutMillis = 0)
+        val decoder = createDecoderWithHeapRecycle(policy, heapSizeBytes = 64L * 1024 * 1024)
+        val captor = ArgumentCaptor.forClass(ComponentCallbacks2::class.java)
+        verify(context).registerComponentCallbacks(captor.capture())
+
+        decoder.onTrimMemory(ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN)
+        advanceUntilIdle()
+        verify(isolate, Mockito.never()).evaluateJavaScriptAsync(contains("recycleWasmInstance("))
+
+        captor.value.onTrimMemory(ComponentCallbacks2.TRIM_MEMORY_BACKGROUND)
+        advanceUntilIdle()
+        verify(isolate).evaluateJavaScriptAsync("globalThis.recycleWasmInstance(0);")
+        assertEquals(HeapRecycleTrigger.TrimMemory, checkNotNull(decoder.heapRecycleMetrics).lastTrigger)
+
+        decoder.release()
+        verify(context).unregisterComponentCallbacks(captor.value)
     }
 
 
@@ -1101,6 +1630,44 @@ class Jp2kDecoderTest {
         assertNotNull(bitmap)
         // With 30 bytes Base64-encoded (~40 chars) and chunk size 8, there should be > 1 chunks
         assertTrue(appendChunkCalls.size > 1)
+        assertTrue(appendChunkCalls.last().endsWith(", ${appendChunkCalls.size - 1});"))
+    }
+
+    @Test
+    fun testChunkedOutput_SplitsIntoAlignedChunks() = runTest {
+        whenever(sandbox.isFeatureSupported(JavaScriptSandbox.JS_FEATURE_EVALUATE_WITHOUT_TRANSACTION_LIMIT)).thenReturn(false)
+        whenever(sandbox.isFeatureSupported(JavaScriptSandbox.JS_FEATURE_PROVIDE_CONSUME_ARRAY_BUFFER)).thenReturn(false)
+        whenever(sandbox.isFeatureSupported(JavaScriptSandbox.JS_FEATURE_MESSAGE_PORTS)).thenReturn(false)
+
+        val encodedOutput = "AQIDBAUGBwgJCgsMDQ4P"
+        val getOutputChunkCalls = mutableListOf<String>()
+        val decoder = createInitializedDecoder(
+            config = Config(binderTransactionMaxChunkSizeBytes = 10, preferDirectBinaryTransfer = false),
+        ) { script ->
+            when {
+                script.startsWith("globalThis.decodeJ2KFromChunks") -> {
+                    TestListenableFuture("""{"outputSize": ${encodedOutput.length}, "isChunked": true}""")
+                }
+                script.startsWith("globalThis.getOutputChunk") -> {
+                    getOutputChunkCalls.add(script)
+                    val (offset, length) = script.substringAfter('(').substringBefore(')').split(", ").map { it.toInt() }
+                    TestListenableFuture(encodedOutput.substring(offset, offset + length))
+                }
+                else -> TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val bitmap = decoder.decodeImage(ByteArray(30))
+        assertNotNull(bitmap)
+        // The chunk size is rounded down to a multiple of 4 Base64 characters
+        assertEquals(
+            listOf(
+                "globalThis.getOutputChunk(0, 8);",
+                "globalThis.getOutputChunk(8, 8);",
+                "globalThis.getOutputChunk(16, 4);",
+            ),
+            getOutputChunkCalls,
+        )
     }
 
     @Test
@@ -1149,6 +1716,277 @@ class Jp2kDecoderTest {
         assertNotNull(bitmap)
         assertTrue(appendChunkCalled)
     }
-}
 
+    @Test
+    fun testDecodeImage_ReduceLevel_PassedToScript() = runTest {
+        val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KRatio(")) {
+                TestListenableFuture(jsonBmp)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val data = ByteArray(20)
+        decoder.decodeImage(data, 0.0f, 0.0f, 0.5f, 0.5f, ColorFormat.RGB565, reduceLevel = 2)
+
+        verify(isolate).evaluateJavaScriptAsync(contains(", 0.5, 0.5, "))
+        verify(isolate).evaluateJavaScriptAsync(contains(", 2);"))
+    }
+
+    @Test
+    fun testDecodeImage_NegativeReduceLevel_ThrowsException() = runTest {
+        val decoder = createInitializedDecoder()
+
+        try {
+            decoder.decodeImage(ByteArray(20), reduceLevel = -1)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("reduceLevel must be 0 or greater", e.message)
+        }
+    }
+
+    @Test
+    fun testGetTileInfo_Success() = runTest {
+        val jsonTileInfo = """{"imageX0": 0, "imageY0": 0, "imageX1": 250, "imageY1": 130, "tileX0": 0, "tileY0": 0, "tileWidth": 100, "tileHeight": 100, "numTilesX": 3, "numTilesY": 2}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("getTileInfo(")) {
+                TestListenableFuture(jsonTileInfo)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val tileInfo = decoder.getTileInfo(ByteArray(20))
+        assertEquals(TileInfo(0, 0, 250, 130, 0, 0, 100, 100, 3, 2), tileInfo)
+        assertEquals(6, tileInfo.numTiles)
+    }
+
+    @Test
+    fun testGetImageInfo_Success() = runTest {
+        val jsonImageInfo = """{"imageX0": 0, "imageY0": 0, "imageX1": 250, "imageY1": 130, "tileX0": 0, "tileY0": 0, "tileWidth": 100, "tileHeight": 100, "numTilesX": 3, "numTilesY": 2,""" +
+            """ "numResolutions": 6, "numLayers": 5, "progressionOrder": 2, "codeBlockWidth": 64, "codeBlockHeight": 32, "hasTlm": true, "hasPlt": false,""" +
+            """ "components": [{"precision": 8, "signed": false, "dx": 1, "dy": 1}, {"precision": 12, "signed": true, "dx": 2, "dy": 2}]}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("getImageInfoWithCache(")) {
+                TestListenableFuture(jsonImageInfo)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        decoder.precache(ByteArray(20))
+
+        val imageInfo = decoder.getImageInfo()
+        assertEquals(TileInfo(0, 0, 250, 130, 0, 0, 100, 100, 3, 2), imageInfo.tileInfo)
+        assertEquals(250, imageInfo.width)
+        assertEquals(130, imageInfo.height)
+        assertEquals(listOf(ComponentInfo(8, false, 1, 1), ComponentInfo(12, true, 2, 2)), imageInfo.components)
+        assertEquals(5, imageInfo.maxReduceLevel)
+        assertEquals(5, imageInfo.numQualityLayers)
+        assertEquals(ProgressionOrder.RPCL, imageInfo.progressionOrder)
+        assertEquals(64, imageInfo.codeBlockWidth)
+        assertEquals(32, imageInfo.codeBlockHeight)
+        assertTrue(imageInfo.hasTlm)
+        assertFalse(imageInfo.hasPlt)
+        assertEquals(State.Initialized, decoder.state)
+    }
+
+    @Test
+    fun testDecodeTile_WithCache() = runTest {
+        val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KTileWithCache(")) {
+                TestListenableFuture(jsonBmp)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+        decoder.precache(ByteArray(20))
+
+        decoder.decodeTile(5, ColorFormat.ARGB8888, reduceLevel = 1)
+
+        verify(isolate).evaluateJavaScriptAsync(contains("decodeJ2KTileWithCache("))
+        verify(isolate).evaluateJavaScriptAsync(contains(", 5, "))
+    }
+
+    @Test
+    fun testDecodeTile_NegativeTileIndex_ThrowsException() = runTest {
+        val decoder = createInitializedDecoder()
+
+        try {
+            decoder.decodeTile(ByteArray(20), -1)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("tileIndex must be 0 or greater", e.message)
+        }
+    }
+
+    @Test
+    fun testDecodeImageProgressive_EmitsEachStep() = runTest {
+        val jsonPlan = """{"steps": [{"reduceLevel": 2, "qualityLayers": 1}, {"reduceLevel": 0, "qualityLayers": 0}]}"""
+        val jsonBmp = """{"bmp": "AQID", "timePreProcess": 0, "timeWasm": 0, "timePostProcess": 0}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("getProgressivePlan(")) {
+                TestListenableFuture(jsonPlan)
+            } else if (script.contains("decodeJ2KWithCache(")) {
+                TestListenableFuture(jsonBmp)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val bitmaps = decoder.decodeImageProgressive(ByteArray(20)).toList()
+
+        assertEquals(2, bitmaps.size)
+        verify(isolate).evaluateJavaScriptAsync(contains("getProgressivePlan(0)"))
+        verify(isolate).evaluateJavaScriptAsync(contains(", 2, 1);"))
+        verify(isolate).evaluateJavaScriptAsync(contains(", 0, 0);"))
+    }
+
+    @Test
+    fun testDecodeImageProgressive_NoDataCached() = runTest {
+        val jsonError = """{"errorCode": ${Jp2kError.CacheDataMissing.code}, "errorMessage": "No data cached"}"""
+
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("getProgressivePlan(")) {
+                TestListenableFuture(jsonError)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        try {
+            decoder.decodeImageProgressive().toList()
+            fail("Should throw IllegalStateException")
+        } catch (e: IllegalStateException) {
+            assertEquals("No data cached", e.message)
+        }
+    }
+
+    @Test
+    fun testDecodeImageProgressive_NegativeReduceLevel_ThrowsException() = runTest {
+        val decoder = createInitializedDecoder()
 
+        try {
+            decoder.decodeImageProgressive(ByteArray(20), reduceLevel = -1)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("reduceLevel must be 0 or greater", e.message)
+        }
+    }
+
+    private fun jsonBatch(vararg entries: Pair<Int, ByteArray>): String {
+        val size = 4 + entries.sumOf { 8 + it.second.size }
+        val buffer = ByteBuffer.allocate(size).order(ByteOrder.LITTLE_ENDIAN)
+        buffer.putInt(entries.size)
+        for ((errorCode, bytes) in entries) {
+            buffer.putInt(errorCode)
+            buffer.putInt(bytes.size)
+            buffer.put(bytes)
+        }
+        val encoded = java.util.Base64.getUrlEncoder().encodeToString(buffer.array())
+        return """{"bmp": "$encoded"}"""
+    }
+
+    @Test
+    fun testDecodeImages_ReturnsResultPerImage() = runTest {
+        val jsonResult = jsonBatch(
+            0 to byteArrayOf(1, 2, 3),
+            Jp2kError.Decode.code to ByteArray(0),
+            -1 to ByteArray(0),
+        )
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KBatch(")) {
+                TestListenableFuture(jsonResult)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val results = decoder.decodeImages(listOf(ByteArray(20), ByteArray(20), ByteArray(4)), reduceLevel = 1)
+
+        assertEquals(3, results.size)
+        assertTrue(results[0].isSuccess)
+        assertEquals(Jp2kError.Decode, (results[1].exceptionOrNull() as Jp2kException).error)
+        assertTrue(results[2].exceptionOrNull() is IllegalArgumentException)
+        verify(isolate).evaluateJavaScriptAsync(contains(", 1, false);"))
+        mockBitmapFactory.verify { BitmapFactory.decodeByteArray(any(), Mockito.eq(12), Mockito.eq(3), any()) }
+    }
+
+    @Test
+    fun testDecodeImages_PacksInputsIntoOneCall() = runTest {
+        val jsonResult = jsonBatch(0 to byteArrayOf(1), 0 to byteArrayOf(2))
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KBatch(")) {
+                TestListenableFuture(jsonResult)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        val results = decoder.decodeImages(listOf(ByteArray(20) { 1 }, ByteArray(30) { 2 }))
+
+        assertEquals(2, results.size)
+        verify(isolate, Mockito.times(1)).evaluateJavaScriptAsync(contains("decodeJ2KBatch("))
+
+        val packed = packBatchInput(listOf(ByteArray(20) { 1 }, ByteArray(30) { 2 }))
+        assertEquals(4 + 2 * 4 + 50, packed.size)
+        val header = ByteBuffer.wrap(packed).order(ByteOrder.LITTLE_ENDIAN)
+        assertEquals(2, header.getInt(0))
+        assertEquals(20, header.getInt(4))
+        assertEquals(30, header.getInt(8))
+        assertEquals(2.toByte(), packed[12 + 20])
+    }
+
+    @Test
+    fun testDecodeImages_EmptyList_SkipsSandbox() = runTest {
+        val decoder = createInitializedDecoder()
+
+        assertTrue(decoder.decodeImages(emptyList()).isEmpty())
+        verify(isolate, Mockito.never()).evaluateJavaScriptAsync(contains("decodeJ2KBatch("))
+    }
+
+    @Test
+    fun testDecodeImages_BatchError_ThrowsException() = runTest {
+        val jsonError = """{"errorCode": ${Jp2kError.Unknown.code}, "errorMessage": "Malformed batch input"}"""
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KBatch(")) {
+                TestListenableFuture(jsonError)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        try {
+            decoder.decodeImages(listOf(ByteArray(20)))
+            fail("Should throw Jp2kException")
+        } catch (e: Jp2kException) {
+            assertEquals("Malformed batch input", e.message)
+        }
+    }
+
+    @Test
+    fun testDecodeImages_EntryCountMismatch_ThrowsException() = runTest {
+        val jsonResult = jsonBatch(0 to byteArrayOf(1))
+        val decoder = createInitializedDecoder { script ->
+            if (script.contains("decodeJ2KBatch(")) {
+                TestListenableFuture(jsonResult)
+            } else {
+                TestListenableFuture(INTERNAL_RESULT_SUCCESS)
+            }
+        }
+
+        try {
+            decoder.decodeImages(listOf(ByteArray(20), ByteArray(20)))
+            fail("Should throw IllegalStateException")
+        } catch (e: IllegalStateException) {
+            assertEquals("Batch output holds 1 entries, expected 2.", e.message)
+        }
+    }
+}
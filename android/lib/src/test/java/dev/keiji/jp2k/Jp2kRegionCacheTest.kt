@@ -0,0 +1,179 @@
+package dev.keiji.jp2k
+
+import android.graphics.Bitmap
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertNotEquals
+import org.junit.Assert.assertNull
+import org.junit.Assert.assertSame
+import org.junit.Assert.fail
+import org.junit.Test
+import org.mockito.Mockito
+import org.mockito.Mockito.mockStatic
+import org.mockito.Mockito.never
+import org.mockito.Mockito.verify
+import org.mockito.kotlin.any
+import org.mockito.kotlin.whenever
+
+class Jp2kRegionCacheTest {
+
+    // A decoded Bitmap whose snapshot in the cache hands out copy
+    private fun mockDecoded(width: Int, height: Int, copy: Bitmap? = null): Pair<Bitmap, Bitmap> {
+        val bitmap = mockBitmap(width, height)
+        val snapshot = mockBitmap(width, height)
+        whenever(bitmap.copy(Bitmap.Config.ARGB_8888, false)).thenReturn(snapshot)
+        whenever(snapshot.copy(Bitmap.Config.ARGB_8888, true)).thenReturn(copy)
+        return bitmap to snapshot
+    }
+
+    private fun mockBitmap(width: Int, height: Int): Bitmap {
+        val bitmap = Mockito.mock(Bitmap::class.java)
+        whenever(bitmap.width).thenReturn(width)
+        whenever(bitmap.height).thenReturn(height)
+        whenever(bitmap.config).thenReturn(Bitmap.Config.ARGB_8888)
+        whenever(bitmap.allocationByteCount).thenReturn(width * height * 4)
+        return bitmap
+    }
+
+    @Test
+    fun testGet_SameRegion_ReturnsCopyOfCachedRegion() {
+        val cache = Jp2kRegionCache()
+        val copy = mockBitmap(4, 2)
+        val (bitmap, _) = mockDecoded(4, 2, copy)
+
+        cache.put("a", 0, 0, 4, 2, ColorFormat.ARGB8888, 0, bitmap)
+
+        assertSame(copy, cache.get("a", 0, 0, 4, 2, ColorFormat.ARGB8888, 0))
+        assertEquals(32, cache.sizeBytes)
+        assertEquals(1, cache.hitCount)
+        assertEquals(0, cache.partialHitCount)
+    }
+
+    @Test
+    fun testGet_DifferentInputFormatOrReduceLevel_CountsMiss() {
+        val cache = Jp2kRegionCache()
+        val (bitmap, _) = mockDecoded(4, 2, mockBitmap(4, 2))
+        cache.put("a", 0, 0, 4, 2, ColorFormat.ARGB8888, 0, bitmap)
+
+        assertNull(cache.get("b", 0, 0, 4, 2, ColorFormat.ARGB8888, 0))
+        assertNull(cache.get("a", 0, 0, 4, 2, ColorFormat.RGB565, 0))
+        assertNull(cache.get("a", 0, 0, 4, 2, ColorFormat.ARGB8888, 1))
+
+        assertEquals(0, cache.hitCount)
+        assertEquals(3, cache.missCount)
+        assertEquals(0.0, cache.hitRate, 0.0)
+    }
+
+    @Test
+    fun testGet_RegionInsideCachedRegion_CropsCachedRegion() {
+        val cache = Jp2kRegionCache()
+        // (2, 2, 10, 10) at reduce level 1 is decoded to 4x4
+        val (bitmap, snapshot) = mockDecoded(4, 4)
+        val crop = mockBitmap(2, 2)
+        val mutableCrop = mockBitmap(2, 2)
+        whenever(crop.copy(Bitmap.Config.ARGB_8888, true)).thenReturn(mutableCrop)
+        cache.put("a", 2, 2, 10, 10, ColorFormat.ARGB8888, 1, bitmap)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            mockedBitmap.`when`<Bitmap> { Bitmap.createBitmap(snapshot, 1, 2, 2, 2) }.thenReturn(crop)
+
+            // (3, 5, 7, 9) at reduce level 1 is 2x2, at (1, 2) in the cached region
+            assertSame(mutableCrop, cache.get("a", 3, 5, 7, 9, ColorFormat.ARGB8888, 1))
+        }
+        // Handed out mutable, like an exact hit
+        verify(crop).recycle()
+        assertEquals(1, cache.hitCount)
+        assertEquals(1, cache.partialHitCount)
+    }
+
+    @Test
+    fun testGet_RegionCoveringCachedRegion_ReturnsCopyOfCachedRegion() {
+        val cache = Jp2kRegionCache()
+        val copy = mockBitmap(5, 5)
+        // (0, 0, 10, 10) and (0, 0, 9, 9) are both 5x5 at reduce level 1
+        val (bitmap, snapshot) = mockDecoded(5, 5, copy)
+        cache.put("a", 0, 0, 10, 10, ColorFormat.ARGB8888, 1, bitmap)
+
+        mockStatic(Bitmap::class.java).use { mockedBitmap ->
+            // Android returns an immutable source itself for a crop covering all of it
+            mockedBitmap.`when`<Bitmap> { Bitmap.createBitmap(snapshot, 0, 0, 5, 5) }.thenReturn(snapshot)
+
+            assertSame(copy, cache.get("a", 0, 0, 9, 9, ColorFormat.ARGB8888, 1))
+        }
+        verify(snapshot, never()).recycle()
+        assertEquals(1, cache.partialHitCount)
+    }
+
+    @Test
+    fun testGet_CachedRegionOfUnexpectedSize_NotCropped() {
+        val cache = Jp2kRegionCache()
+        // Decoded at a lower reduce level than requested
+        val (bitmap, _) = mockDecoded(8, 8)
+        cache.put("a", 0, 0, 16, 16, ColorFormat.ARGB8888, 2, bitmap)
+
+        assertNull(cache.get("a", 0, 0, 8, 8, ColorFormat.ARGB8888, 2))
+        assertEquals(1, cache.missCount)
+    }
+
+    @Test
+    fun testPut_OverMaxSize_DropsLeastRecentlyUsedEntry() {
+        val cache = Jp2kRegionCache(maxSizeBytes = 48)
+        val (old, _) = mockDecoded(2, 2, mockBitmap(2, 2))
+        val recent = mockDecoded(2, 2, mockBitmap(2, 2)).first
+        val other = mockDecoded(4, 2, mockBitmap(4, 2)).first
+
+        cache.put("a", 0, 0, 2, 2, ColorFormat.ARGB8888, 0, old)
+        cache.put("a", 2, 0, 4, 2, ColorFormat.ARGB8888, 0, recent)
+        // Marks the first region as recently used
+        cache.get("a", 0, 0, 2, 2, ColorFormat.ARGB8888, 0)
+        cache.put("a", 0, 2, 4, 4, ColorFormat.ARGB8888, 0, other)
+
+        assertEquals(48, cache.sizeBytes)
+        assertEquals(1, cache.evictionCount)
+        assertNull(cache.get("a", 2, 0, 4, 2, ColorFormat.ARGB8888, 0))
+        assertNotEquals(null, cache.get("a", 0, 0, 2, 2, ColorFormat.ARGB8888, 0))
+    }
+
+    @Test
+    fun testPut_LargerThanMaxSize_NotCached() {
+        val cache = Jp2kRegionCache(maxSizeBytes = 8)
+        val (bitmap, _) = mockDecoded(2, 2)
+
+        cache.put("a", 0, 0, 2, 2, ColorFormat.ARGB8888, 0, bitmap)
+
+        assertEquals(0, cache.sizeBytes)
+        verify(bitmap, never()).copy(any(), any())
+    }
+
+    @Test
+    fun testInvalidate_DropsEntriesOfInputOnly() {
+        val cache = Jp2kRegionCache()
+        cache.put("a", 0, 0, 2, 2, ColorFormat.ARGB8888, 0, mockDecoded(2, 2, mockBitmap(2, 2)).first)
+        cache.put("b", 0, 0, 2, 2, ColorFormat.ARGB8888, 0, mockDecoded(2, 2, mockBitmap(2, 2)).first)
+
+        cache.invalidate("a")
+
+        assertEquals(16, cache.sizeBytes)
+        assertNull(cache.get("a", 0, 0, 2, 2, ColorFormat.ARGB8888, 0))
+        assertNotEquals(null, cache.get("b", 0, 0, 2, 2, ColorFormat.ARGB8888, 0))
+        assertEquals(0.5, cache.hitRate, 0.0)
+
+        cache.clear()
+        assertEquals(0, cache.sizeBytes)
+    }
+
+    @Test
+    fun testKeyOf_DependsOnContentOnly() {
+        assertEquals(Jp2kRegionCache.keyOf(byteArrayOf(1, 2, 3)), Jp2kRegionCache.keyOf(byteArrayOf(1, 2, 3)))
+        assertNotEquals(Jp2kRegionCache.keyOf(byteArrayOf(1, 2, 3)), Jp2kRegionCache.keyOf(byteArrayOf(1, 2, 4)))
+    }
+
+    @Test
+    fun testConstructor_NegativeMaxSize_ThrowsException() {
+        try {
+            Jp2kRegionCache(maxSizeBytes = -1)
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("maxSizeBytes must be 0 or greater", e.message)
+        }
+    }
+}
@@ -1,6 +1,7 @@
 package dev.keiji.jp2k
 
 import android.content.Context
+import android.content.res.AssetManager
 import androidx.javascriptengine.IsolateStartupParameters
 import androidx.javascriptengine.JavaScriptIsolate
 import androidx.javascriptengine.JavaScriptSandbox
@@ -21,6 +22,7 @@ import org.mockito.Mockito.verify
 import org.mockito.MockitoAnnotations
 import org.mockito.kotlin.any
 import org.mockito.kotlin.whenever
+import java.io.ByteArrayInputStream
 import java.util.concurrent.Executor
 import java.util.concurrent.TimeUnit
 
@@ -90,6 +92,22 @@ class Jp2kSandboxTest {
         }, Mockito.atLeastOnce())
     }
 
+    @Test
+    fun testPrewarm_LoadsWasmBinaryOnce() {
+        WasmModuleCache.clearForTesting()
+        val assetManager = Mockito.mock(AssetManager::class.java)
+        whenever(context.assets).thenReturn(assetManager)
+        whenever(assetManager.open(any<String>())).thenAnswer { ByteArrayInputStream(ByteArray(4)) }
+        val executor = Executor { it.run() }
+
+        assertNotNull(Jp2kSandbox.prewarm(context, executor).get())
+        Jp2kSandbox.prewarm(context, executor)
+
+        assertTrue(WasmModuleCache.isLoaded)
+        verify(assetManager, Mockito.times(1)).open(any<String>())
+        WasmModuleCache.clearForTesting()
+    }
+
     @Test
     fun testCreateIsolate_FeaturesSupported() {
         whenever(sandbox.isFeatureSupported(JavaScriptSandbox.JS_FEATURE_ISOLATE_MAX_HEAP_SIZE)).thenReturn(true)
@@ -4,6 +4,7 @@ import org.junit.Assert.assertEquals
 import org.junit.Assert.assertFalse
 import org.junit.Assert.assertNotNull
 import org.junit.Assert.assertNull
+import org.junit.Assert.assertThrows
 import org.junit.Assert.assertTrue
 import org.junit.Test
 
@@ -46,6 +47,11 @@ class ModelAndEnumTest {
         assertTrue(defaultConfig.preferDirectBinaryTransfer)
         assertEquals(JavaScriptEngineEnvironment.DEFAULT_BINDER_TRANSACTION_MAX_CHUNK_SIZE_BYTES, defaultConfig.binderTransactionMaxChunkSizeBytes)
         assertEquals(JavaScriptEngineEnvironment.DEFAULT_WASM_MAX_MEMORY_BYTES, defaultConfig.wasmMaxMemoryBytes)
+        assertEquals(DEFAULT_DECODE_THREADS, defaultConfig.decodeThreads)
+        assertTrue(defaultConfig.rawPixelOutput)
+        assertEquals(DEFAULT_CHUNK_TRANSFER_WINDOW, defaultConfig.chunkTransferWindow)
+        assertEquals(DEFAULT_DECODE_TIMEOUT_MILLIS, defaultConfig.decodeTimeoutMillis)
+        assertNull(defaultConfig.heapRecyclePolicy)
 
         val customConfig = Config(
             maxPixels = 1000,
@@ -54,7 +60,10 @@ class ModelAndEnumTest {
             logLevel = 3,
             preferDirectBinaryTransfer = false,
             binderTransactionMaxChunkSizeBytes = 512,
-            wasmMaxMemoryBytes = 1024L * 1024L
+            wasmMaxMemoryBytes = 1024L * 1024L,
+            decodeThreads = 4,
+            rawPixelOutput = false,
+            chunkTransferWindow = 2
         )
         assertEquals(1000, customConfig.maxPixels)
         assertEquals(1024L, customConfig.maxHeapSizeBytes)
@@ -63,6 +72,9 @@ class ModelAndEnumTest {
         assertFalse(customConfig.preferDirectBinaryTransfer)
         assertEquals(512, customConfig.binderTransactionMaxChunkSizeBytes)
         assertEquals(1024L * 1024L, customConfig.wasmMaxMemoryBytes)
+        assertEquals(4, customConfig.decodeThreads)
+        assertFalse(customConfig.rawPixelOutput)
+        assertEquals(2, customConfig.chunkTransferWindow)
 
         val copyConfig = defaultConfig.copy(maxPixels = 500)
         assertEquals(500, copyConfig.maxPixels)
@@ -77,6 +89,10 @@ class ModelAndEnumTest {
     fun testMemoryUsage() {
         val memoryUsage = MemoryUsage(1024L)
         assertEquals(1024L, memoryUsage.wasmHeapSizeBytes)
+        assertEquals(0L, memoryUsage.scratchHighWaterMarkBytes)
+        assertEquals(0L, memoryUsage.heapInUseBytes)
+        assertEquals(0L, memoryUsage.lastDecodePeakBytes)
+        assertEquals(0L, memoryUsage.lastDecodeEstimatedPeakBytes)
 
         val copyUsage = memoryUsage.copy(wasmHeapSizeBytes = 2048L)
         assertEquals(2048L, copyUsage.wasmHeapSizeBytes)
@@ -107,6 +123,13 @@ class ModelAndEnumTest {
         assertEquals(500L, metrics.outputDataSizeBytes)
         assertEquals(1024L, metrics.wasmHeapSizeBytes)
         assertEquals(10.0, metrics.totalProcessingTimeMs, 0.001)
+        assertEquals(0.0, metrics.headerTimeMs, 0.001)
+        assertEquals(0.0, metrics.codestreamDecodeTimeMs, 0.001)
+        assertEquals(0.0, metrics.conversionTimeMs, 0.001)
+        assertEquals(0L, metrics.tilesDecoded)
+        assertEquals(0L, metrics.bytesRead)
+        assertEquals(0L, metrics.wasmAllocationCount)
+        assertEquals(0L, metrics.wasmAllocatedBytes)
 
         val copyMetrics = metrics.copy(wasmProcessingTimeMs = 5.0)
         assertEquals(5.0, copyMetrics.wasmProcessingTimeMs, 0.001)
@@ -116,6 +139,45 @@ class ModelAndEnumTest {
         assertNotNull(metrics.toString())
     }
 
+    @Test
+    fun testHeapRecyclePolicy() {
+        val policy = HeapRecyclePolicy()
+        assertEquals(DEFAULT_HEAP_RECYCLE_HIGH_WATER_MARK_BYTES, policy.highWaterMarkBytes)
+        assertEquals(DEFAULT_HEAP_RECYCLE_IDLE_TIMEOUT_MILLIS, policy.idleTimeoutMillis)
+        assertEquals(Integer.valueOf(android.content.ComponentCallbacks2.TRIM_MEMORY_BACKGROUND), policy.trimMemoryLevel)
+
+        val disabled = HeapRecyclePolicy(highWaterMarkBytes = 0, idleTimeoutMillis = 0, trimMemoryLevel = null)
+        assertEquals(0L, disabled.highWaterMarkBytes)
+        assertEquals(0L, disabled.idleTimeoutMillis)
+        assertNull(disabled.trimMemoryLevel)
+
+        assertThrows(IllegalArgumentException::class.java) { HeapRecyclePolicy(highWaterMarkBytes = -1) }
+        assertThrows(IllegalArgumentException::class.java) { HeapRecyclePolicy(idleTimeoutMillis = -1) }
+
+        assertEquals(policy, policy.copy())
+        assertNotNull(policy.toString())
+    }
+
+    @Test
+    fun testHeapRecycleMetrics() {
+        val metrics = HeapRecycleMetrics(
+            recycleCount = 2,
+            totalReclaimedBytes = 3072L,
+            lastReclaimedBytes = 1024L,
+            lastSwapLatencyMs = 4.5,
+            lastTrigger = HeapRecycleTrigger.Idle,
+        )
+        assertEquals(2, metrics.recycleCount)
+        assertEquals(3072L, metrics.totalReclaimedBytes)
+        assertEquals(1024L, metrics.lastReclaimedBytes)
+        assertEquals(4.5, metrics.lastSwapLatencyMs, 0.001)
+        assertEquals(HeapRecycleTrigger.Idle, metrics.lastTrigger)
+
+        assertEquals(3, HeapRecycleTrigger.entries.size)
+        assertEquals(metrics, metrics.copy())
+        assertNotNull(metrics.toString())
+    }
+
     @Test
     fun testSize() {
         val size = Size(640, 480)
@@ -142,9 +204,22 @@ class ModelAndEnumTest {
             val resolved = Jp2kError.fromInt(entry.code)
             assertEquals(entry, resolved)
         }
+        assertEquals(Jp2kError.Cancelled, Jp2kError.fromInt(-7))
+        assertEquals(Jp2kError.DeadlineExceeded, Jp2kError.fromInt(-8))
+        assertEquals(Jp2kError.MemoryLimit, Jp2kError.fromInt(-9))
         assertEquals(Jp2kError.Unknown, Jp2kError.fromInt(99999))
     }
 
+    @Test
+    fun testProgressionOrderAllEntries() {
+        for (entry in ProgressionOrder.entries) {
+            assertEquals(entry, ProgressionOrder.fromInt(entry.id))
+        }
+        assertEquals(ProgressionOrder.LRCP, ProgressionOrder.fromInt(0))
+        assertEquals(ProgressionOrder.CPRL, ProgressionOrder.fromInt(4))
+        assertEquals(ProgressionOrder.Unknown, ProgressionOrder.fromInt(5))
+    }
+
     @Test
     fun testCallbackImplementation() {
         var successResult: String? = null
@@ -23,3 +23,37 @@ class FailingListenableFuture<T>(private val exception: Throwable) : ListenableF
     override fun get(timeout: Long, unit: TimeUnit?): T { throw java.util.concurrent.ExecutionException(exception) }
     override fun addListener(listener: Runnable, executor: Executor) { listener.run() }
 }
+
+// Never completes, like an evaluation stuck behind a long decode
+class PendingListenableFuture<T> : ListenableFuture<T> {
+    override fun cancel(mayInterruptIfRunning: Boolean) = false
+    override fun isCancelled() = false
+    override fun isDone() = false
+    override fun get(): T = throw UnsupportedOperationException("Pending")
+    override fun get(timeout: Long, unit: TimeUnit?): T = throw java.util.concurrent.TimeoutException()
+    override fun addListener(listener: Runnable, executor: Executor) {}
+}
+
+// Completes when complete() is called, like an evaluation that finishes after other requests were queued
+class DeferredListenableFuture<T> : ListenableFuture<T> {
+    private var result: T? = null
+    private var done = false
+    private val listeners = mutableListOf<Runnable>()
+
+    fun complete(value: T) {
+        result = value
+        done = true
+        listeners.forEach { it.run() }
+        listeners.clear()
+    }
+
+    override fun cancel(mayInterruptIfRunning: Boolean) = false
+    override fun isCancelled() = false
+    override fun isDone() = done
+    @Suppress("UNCHECKED_CAST")
+    override fun get(): T = if (done) result as T else throw IllegalStateException("Not completed")
+    override fun get(timeout: Long, unit: TimeUnit?): T = if (done) get() else throw java.util.concurrent.TimeoutException()
+    override fun addListener(listener: Runnable, executor: Executor) {
+        if (done) executor.execute(listener) else listeners.add(Runnable { executor.execute(listener) })
+    }
+}
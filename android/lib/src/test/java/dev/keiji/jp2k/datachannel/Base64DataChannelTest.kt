@@ -29,6 +29,13 @@ class Base64DataChannelTest {
         assertTrue(channel.jsConverterScript.contains("base64ToBytes"))
     }
 
+    @Test
+    fun jsConverterScript_declaresBase64Alphabet() {
+        // Selects the standard alphabet of the WASM Base64 kernels
+        assertTrue(Base64DataChannel().jsConverterScript.contains("globalThis.payloadBase64Alphabet = 0;"))
+        assertTrue(Base64UrlDataChannel().jsConverterScript.contains("globalThis.payloadBase64Alphabet = 1;"))
+    }
+
     @Test
     fun getWasmExpression_encodesBase64() {
         val isolate = mock<JavaScriptIsolate>()
@@ -0,0 +1,77 @@
+package dev.keiji.jp2k.datachannel
+
+import org.junit.Assert.assertArrayEquals
+import org.junit.Assert.assertEquals
+import org.junit.Assert.fail
+import org.junit.Test
+import java.util.Base64
+
+class ChunkDecoderTest {
+
+    private fun decodeInChunks(encoded: String, chunkSize: Int): ByteArray {
+        val decoder = Base64ChunkDecoder(encoded.length)
+        val alignedSize = decoder.alignChunkSize(chunkSize)
+        encoded.chunked(alignedSize).forEach { decoder.decode(it) }
+        return decoder.output.copyOf(decoder.length)
+    }
+
+    @Test
+    fun testDecode_MatchesWholeDecode() {
+        for (size in 0..40) {
+            val data = ByteArray(size) { (it * 167 + 13).toByte() }
+            for (chunkSize in listOf(1, 4, 7, 8, 64)) {
+                assertArrayEquals(data, decodeInChunks(Base64.getEncoder().encodeToString(data), chunkSize))
+                assertArrayEquals(data, decodeInChunks(Base64.getUrlEncoder().encodeToString(data), chunkSize))
+            }
+        }
+    }
+
+    @Test
+    fun testDecode_Unpadded() {
+        val data = byteArrayOf(1, 2, 3, 4, 5)
+        val encoded = Base64.getUrlEncoder().withoutPadding().encodeToString(data)
+
+        val decoder = Base64ChunkDecoder(encoded.length)
+        decoder.decode(encoded)
+
+        assertEquals(data.size, decoder.output.size)
+        assertArrayEquals(data, decoder.output.copyOf(decoder.length))
+    }
+
+    @Test
+    fun testDecode_InvalidCharacter_ThrowsException() {
+        try {
+            Base64ChunkDecoder(8).decode("AQID*AUG")
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("Invalid Base64 character at 4", e.message)
+        }
+    }
+
+    @Test
+    fun testDecode_LongerThanAnnounced_ThrowsException() {
+        val decoder = Base64ChunkDecoder(4)
+        decoder.decode("AQID")
+        try {
+            decoder.decode("BAUG")
+            fail("Should throw IllegalArgumentException")
+        } catch (e: IllegalArgumentException) {
+            assertEquals("Base64 payload is longer than announced", e.message)
+        }
+    }
+
+    @Test
+    fun testAlignChunkSize() {
+        val decoder = Base64ChunkDecoder(0)
+        assertEquals(4, decoder.alignChunkSize(1))
+        assertEquals(8, decoder.alignChunkSize(11))
+        assertEquals(12, decoder.alignChunkSize(12))
+    }
+
+    @Test
+    fun testCreateChunkDecoder_StringChannels() {
+        assertEquals(true, Base64DataChannel().createChunkDecoder(8) is Base64ChunkDecoder)
+        assertEquals(true, Base64UrlDataChannel().createChunkDecoder(8) is Base64ChunkDecoder)
+        assertEquals(null, HexDataChannel().createChunkDecoder(8))
+    }
+}
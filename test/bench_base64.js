@@ -0,0 +1,115 @@
+// Compares the Base64 converters of the string data channels (interpreted JS) with the WASM kernels
+// (base64Encode / base64Decode) on output-sized buffers. Run by test/run_base64_benchmark.sh.
+//
+// Usage: node test/bench_base64.js <openjpeg_core.wasm> [iterations] [sizes in KiB...]
+
+const fs = require('fs');
+const path = require('path');
+
+const CHANNEL_DIR = path.join(__dirname, '../android/lib/src/main/java/dev/keiji/jp2k');
+
+// Evaluates a script of the library as the sandbox does, so the measured JS is the shipped JS.
+// Returns the value of resultExpression evaluated after the script.
+function loadScript(file, name, resultExpression) {
+    const source = fs.readFileSync(path.join(CHANNEL_DIR, file), 'utf8');
+    const match = source.match(new RegExp(name + ' = """([\\s\\S]*?)"""'));
+    if (!match) throw new Error(name + ' not found in ' + file);
+    return (0, eval)(match[1] + '\n' + (resultExpression || ''));
+}
+
+function median(samples) {
+    const sorted = samples.slice().sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+function measure(iterations, fn) {
+    const samples = [];
+    let result;
+    for (let i = 0; i < iterations; i++) {
+        const start = process.hrtime.bigint();
+        result = fn();
+        samples.push(Number(process.hrtime.bigint() - start) / 1e6);
+    }
+    return { ms: median(samples), result: result };
+}
+
+async function main() {
+    const wasmPath = process.argv[2];
+    const iterations = parseInt(process.argv[3] || '10', 10);
+    const sizesKiB = process.argv.length > 4 ? process.argv.slice(4).map(Number) : [64, 1024, 4096, 16384];
+    if (!wasmPath) {
+        console.error('Usage: node test/bench_base64.js <openjpeg_core.wasm> [iterations] [sizes in KiB...]');
+        process.exit(1);
+    }
+
+    const importObject = loadScript('Constants.kt', 'SCRIPT_IMPORT_OBJECT', 'importObject');
+    const res = await WebAssembly.instantiate(fs.readFileSync(wasmPath), importObject);
+    globalThis.wasmInstance = res.instance;
+    const exports = wasmInstance.exports;
+    exports.setScratchArena(1);
+
+    // The glue copies the text with TextEncoder where the isolate provides it; BENCH_NO_TEXT_ENCODER=1
+    // measures the fallback loop of isolates without it.
+    const encoder = process.env.BENCH_NO_TEXT_ENCODER ? null : new TextEncoder();
+
+    console.log('alphabet  KiB       js enc ms  wasm enc ms  speedup  js dec ms  wasm dec ms  speedup');
+    for (const [file, encodeName, decodeName] of [
+        ['datachannel/Base64DataChannel.kt', 'bytesToBase64', 'base64ToBytes'],
+        ['datachannel/Base64UrlDataChannel.kt', 'bytesToBase64Url', 'base64UrlToBytes'],
+    ]) {
+        loadScript(file, 'SCRIPT_CONVERTER');
+        const alphabet = globalThis.payloadBase64Alphabet;
+
+        for (const kib of sizesKiB) {
+            const size = kib * 1024;
+            const dataPtr = exports.malloc(size);
+            const data = new Uint8Array(exports.memory.buffer, dataPtr, size);
+            for (let i = 0; i < size; i++) data[i] = (i * 167 + 13) & 0xFF;
+
+            // Encode: the decoder output is already in the heap, the string is read out of it
+            const jsEncode = measure(iterations, () => globalThis[encodeName](new Uint8Array(exports.memory.buffer, dataPtr, size)));
+            const wasmEncode = measure(iterations, () => {
+                const textPtr = exports.base64Encode(dataPtr, size, alphabet);
+                const length = exports.base64EncodedSize(size);
+                const heap = new Uint8Array(exports.memory.buffer, textPtr, length);
+                let text = '';
+                for (let i = 0; i < length; i += 8192) {
+                    text += String.fromCharCode.apply(null, heap.subarray(i, Math.min(i + 8192, length)));
+                }
+                exports.releaseBuffer(textPtr);
+                return text;
+            });
+            if (jsEncode.result !== wasmEncode.result) throw new Error('Encoded text differs at ' + kib + ' KiB');
+
+            // Decode: the text is written into the heap and decoded straight into the input buffer
+            const text = jsEncode.result;
+            const jsDecode = measure(iterations, () => globalThis[decodeName](text));
+            const wasmDecode = measure(iterations, () => {
+                const textPtr = exports.acquireTextBuffer(text.length);
+                const heap = new Uint8Array(exports.memory.buffer, textPtr, text.length);
+                if (encoder) {
+                    encoder.encodeInto(text, heap);
+                } else {
+                    for (let i = 0; i < text.length; i++) heap[i] = text.charCodeAt(i);
+                }
+                const inputPtr = exports.acquireInputBuffer(Math.ceil(text.length * 3 / 4));
+                const length = exports.base64Decode(textPtr, text.length, inputPtr);
+                exports.releaseBuffer(textPtr);
+                exports.releaseBuffer(inputPtr);
+                return length;
+            });
+            if (wasmDecode.result !== size) throw new Error('Decoded length differs at ' + kib + ' KiB');
+
+            console.log(
+                (alphabet ? 'url' : 'standard').padEnd(10) + String(kib).padEnd(10) +
+                jsEncode.ms.toFixed(2).padStart(9) + wasmEncode.ms.toFixed(2).padStart(13) + (jsEncode.ms / wasmEncode.ms).toFixed(1).padStart(8) + 'x' +
+                jsDecode.ms.toFixed(2).padStart(11) + wasmDecode.ms.toFixed(2).padStart(13) + (jsDecode.ms / wasmDecode.ms).toFixed(1).padStart(8) + 'x');
+            exports.free(dataPtr);
+        }
+    }
+}
+
+main().catch((e) => {
+    console.error(e);
+    process.exit(1);
+});
@@ -0,0 +1,183 @@
+// Synthetic JPEG 2000 corpus for the native benchmark.
+// Built natively against OpenJPEG by test/run_benchmark.sh.
+
+#include "bench_corpus.h"
+
+#include <openjpeg.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The cases cover the codestream features that change the decode path: size, tiling, quality
+// layers, precincts, the wavelet (lossless/lossy) and the component count.
+const bench_case_t bench_cases[] = {
+    // name                         w     h     comps tile  layers prec  lossless large
+    { "gray_256_lossless",          256,  256,  1,    0,    1,     0,    1,       0 },
+    { "rgb_256_lossy",              256,  256,  3,    0,    1,     0,    0,       0 },
+    { "rgb_1024_lossless",          1024, 1024, 3,    0,    1,     0,    1,       0 },
+    { "rgb_1024_lossy_layers",      1024, 1024, 3,    0,    5,     0,    0,       0 },
+    { "rgb_1024_lossy_precincts",   1024, 1024, 3,    0,    3,     128,  0,       0 },
+    { "rgb_1024_tiled_lossless",    1024, 1024, 3,    256,  1,     0,    1,       0 },
+    { "rgba_1024_lossy",            1024, 1024, 4,    0,    1,     0,    0,       0 },
+    { "rgb_4096_tiled_lossy",       4096, 4096, 3,    512,  3,     0,    0,       1 },
+    { "rgb_4096_lossless",          4096, 4096, 3,    0,    1,     0,    1,       1 },
+};
+
+const uint32_t bench_case_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
+
+#define CORPUS_STREAM_BUFFER_SIZE (1024 * 1024)
+
+typedef struct {
+    uint8_t* data;
+    OPJ_SIZE_T size;
+    OPJ_SIZE_T capacity;
+    OPJ_SIZE_T offset;
+    int failed;
+} corpus_buffer_t;
+
+static int corpus_buffer_reserve(corpus_buffer_t* buf, OPJ_SIZE_T needed) {
+    if (needed <= buf->capacity) return 1;
+
+    OPJ_SIZE_T capacity = buf->capacity ? buf->capacity : CORPUS_STREAM_BUFFER_SIZE;
+    while (capacity < needed) capacity *= 2;
+
+    uint8_t* data = (uint8_t*)realloc(buf->data, capacity);
+    if (!data) {
+        buf->failed = 1;
+        return 0;
+    }
+    memset(data + buf->capacity, 0, capacity - buf->capacity);
+    buf->data = data;
+    buf->capacity = capacity;
+    return 1;
+}
+
+static OPJ_SIZE_T corpus_write(void* p_buffer, OPJ_SIZE_T p_nb_bytes, void* p_user_data) {
+    corpus_buffer_t* buf = (corpus_buffer_t*)p_user_data;
+    if (!corpus_buffer_reserve(buf, buf->offset + p_nb_bytes)) return (OPJ_SIZE_T)-1;
+
+    memcpy(buf->data + buf->offset, p_buffer, p_nb_bytes);
+    buf->offset += p_nb_bytes;
+    if (buf->offset > buf->size) buf->size = buf->offset;
+    return p_nb_bytes;
+}
+
+static OPJ_OFF_T corpus_skip(OPJ_OFF_T p_nb_bytes, void* p_user_data) {
+    corpus_buffer_t* buf = (corpus_buffer_t*)p_user_data;
+    if (p_nb_bytes < 0 && (OPJ_SIZE_T)-p_nb_bytes > buf->offset) return (OPJ_OFF_T)-1;
+    if (p_nb_bytes > 0 && !corpus_buffer_reserve(buf, buf->offset + (OPJ_SIZE_T)p_nb_bytes)) return (OPJ_OFF_T)-1;
+
+    buf->offset = (OPJ_SIZE_T)((OPJ_OFF_T)buf->offset + p_nb_bytes);
+    if (buf->offset > buf->size) buf->size = buf->offset;
+    return p_nb_bytes;
+}
+
+static OPJ_BOOL corpus_seek(OPJ_OFF_T p_nb_bytes, void* p_user_data) {
+    corpus_buffer_t* buf = (corpus_buffer_t*)p_user_data;
+    if (p_nb_bytes < 0 || !corpus_buffer_reserve(buf, (OPJ_SIZE_T)p_nb_bytes)) return OPJ_FALSE;
+
+    buf->offset = (OPJ_SIZE_T)p_nb_bytes;
+    if (buf->offset > buf->size) buf->size = buf->offset;
+    return OPJ_TRUE;
+}
+
+// Smooth gradients with edges and low-amplitude noise, so the code-blocks are neither trivially
+// compressible nor pure noise. The pattern is deterministic for comparable runs.
+static void fill_image(opj_image_t* image, const bench_case_t* c) {
+    uint32_t seed = 0x9E3779B9u;
+
+    for (uint32_t compno = 0; compno < c->num_comps; compno++) {
+        OPJ_INT32* plane = image->comps[compno].data;
+        for (uint32_t y = 0; y < c->height; y++) {
+            for (uint32_t x = 0; x < c->width; x++) {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+
+                uint32_t gradient = (x * 255 / c->width + y * 255 / c->height * (compno + 1)) / (compno + 2);
+                uint32_t edge = (((x >> 6) ^ (y >> 6)) & 1) ? 48 : 0;
+                uint32_t noise = seed & 0x0F;
+                uint32_t value = (compno == 3) ? 255 - ((x + y) & 0x3F) : gradient + edge + noise;
+                plane[(size_t)y * c->width + x] = (OPJ_INT32)(value > 255 ? 255 : value);
+            }
+        }
+    }
+}
+
+uint8_t* bench_corpus_generate(const bench_case_t* c, uint32_t* out_size) {
+    opj_image_cmptparm_t cmptparms[4];
+    memset(cmptparms, 0, sizeof(cmptparms));
+    for (uint32_t i = 0; i < c->num_comps; i++) {
+        cmptparms[i].dx = 1;
+        cmptparms[i].dy = 1;
+        cmptparms[i].w = c->width;
+        cmptparms[i].h = c->height;
+        cmptparms[i].prec = 8;
+        cmptparms[i].sgnd = 0;
+    }
+
+    OPJ_COLOR_SPACE color_space = (c->num_comps == 1) ? OPJ_CLRSPC_GRAY : OPJ_CLRSPC_SRGB;
+    opj_image_t* image = opj_image_create(c->num_comps, cmptparms, color_space);
+    if (!image) return NULL;
+
+    image->x0 = 0;
+    image->y0 = 0;
+    image->x1 = c->width;
+    image->y1 = c->height;
+    if (c->num_comps == 4) image->comps[3].alpha = 1;
+    fill_image(image, c);
+
+    opj_cparameters_t params;
+    opj_set_default_encoder_parameters(&params);
+    params.tcp_mct = (c->num_comps >= 3) ? 1 : 0;
+    params.irreversible = c->lossless ? 0 : 1;
+
+    // Compression ratio per layer, halving up to 10:1 for the last one (lossless: rate 0)
+    params.tcp_numlayers = (int)c->num_layers;
+    for (uint32_t i = 0; i < c->num_layers; i++) {
+        params.tcp_rates[i] = (float)(10u << (c->num_layers - 1 - i));
+    }
+    if (c->lossless) params.tcp_rates[c->num_layers - 1] = 0;
+    params.cp_disto_alloc = 1;
+
+    if (c->tile_size) {
+        params.tile_size_on = OPJ_TRUE;
+        params.cp_tdx = (int)c->tile_size;
+        params.cp_tdy = (int)c->tile_size;
+    }
+
+    if (c->precinct_size) {
+        params.csty |= 0x01;
+        params.res_spec = 1;
+        params.prcw_init[0] = (int)c->precinct_size;
+        params.prch_init[0] = (int)c->precinct_size;
+    }
+
+    corpus_buffer_t buf;
+    memset(&buf, 0, sizeof(buf));
+
+    opj_codec_t* codec = opj_create_compress(OPJ_CODEC_J2K);
+    opj_stream_t* stream = opj_stream_create(CORPUS_STREAM_BUFFER_SIZE, OPJ_FALSE);
+    OPJ_BOOL ok = codec && stream && opj_setup_encoder(codec, &params, image);
+    if (ok) {
+        opj_stream_set_write_function(stream, corpus_write);
+        opj_stream_set_skip_function(stream, corpus_skip);
+        opj_stream_set_seek_function(stream, corpus_seek);
+        opj_stream_set_user_data(stream, &buf, NULL);
+
+        ok = opj_start_compress(codec, image, stream) &&
+             opj_encode(codec, stream) &&
+             opj_end_compress(codec, stream);
+    }
+
+    if (stream) opj_stream_destroy(stream);
+    if (codec) opj_destroy_codec(codec);
+    opj_image_destroy(image);
+
+    if (!ok || buf.failed || buf.size > UINT32_MAX) {
+        free(buf.data);
+        return NULL;
+    }
+
+    *out_size = (uint32_t)buf.size;
+    return buf.data;
+}
@@ -0,0 +1,27 @@
+// Synthetic JPEG 2000 corpus for the native benchmark (test/bench_decode.c).
+// Each case is encoded in memory with the real OpenJPEG encoder.
+
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <stdint.h>
+
+typedef struct {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_comps;     // 1 (gray), 3 (RGB) or 4 (RGBA)
+    uint32_t tile_size;     // 0 for a single tile
+    uint32_t num_layers;    // quality layers
+    uint32_t precinct_size; // 0 for the default (maximal) precincts
+    int lossless;           // reversible 5/3 wavelet, otherwise irreversible 9/7
+    int large;              // skipped with --quick
+} bench_case_t;
+
+extern const bench_case_t bench_cases[];
+extern const uint32_t bench_case_count;
+
+// Encodes the case as a J2K codestream. Returns a malloc'ed buffer, or NULL on failure.
+uint8_t* bench_corpus_generate(const bench_case_t* c, uint32_t* out_size);
+
+#endif
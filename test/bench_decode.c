@@ -0,0 +1,639 @@
+// End-to-end benchmark of the wrapper.c exports against the real OpenJPEG.
+// Built natively by test/run_benchmark.sh, which links with -Wl,--wrap for the allocator so that
+// the heap used by wrapper.c and OpenJPEG together can be measured.
+//
+// For each corpus case (test/bench_corpus.c) and export it reports the median latency per call,
+// the output throughput in MPix/s and the peak heap above the heap in use before the call, as JSON.
+// With --baseline the results are compared against a previous report and the exit status is 2 when
+// an entry regressed beyond the tolerance.
+//
+// Usage: bench_decode [--iterations N] [--min-time-ms N] [--threads N] [--quick] [--case NAME]
+//                     [--output report.json] [--baseline baseline.json]
+//                     [--latency-tolerance PCT] [--heap-tolerance PCT] [--corpus-dir DIR]
+
+#include <openjpeg.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench_corpus.h"
+
+#define COLOR_FORMAT_RGB565 565
+#define COLOR_FORMAT_ARGB8888 8888
+#define OUTPUT_FORMAT_BMP 0
+#define OUTPUT_FORMAT_RAW 1
+
+#define MAX_SAMPLES 10000
+#define MAX_RESULTS 256
+#define MAX_NAME 64
+// Latency differences below this are treated as noise whatever the relative change
+#define LATENCY_NOISE_FLOOR_MS 0.05
+
+int getLastError();
+int setOutputFormat(int format);
+int setDecodeThreads(int thread_count);
+int setTileStreaming(int enabled);
+uint32_t* getSize(uint8_t* data, uint32_t data_len);
+uint32_t* getTileInfo(uint8_t* data, uint32_t data_len);
+uint8_t* decodeToBmp(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+uint8_t* decodeToBmpReduced(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t reduce);
+uint8_t* decodeToBmpWithRatio(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1);
+uint8_t* decodeTileToBmp(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t tile_index, uint32_t reduce);
+void* openSession(uint8_t* data, uint32_t data_len);
+void closeSession(void* session);
+uint32_t sessionSetQualityLayers(void* session, uint32_t layers);
+uint8_t* sessionDecodeToBmp(void* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t reduce);
+uint8_t* sessionDecodeTileToBmp(void* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t tile_index, uint32_t reduce);
+
+// --- Heap tracking (linked with -Wl,--wrap=malloc,...) ---
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+void* __real_memalign(size_t alignment, size_t size);
+
+// OpenJPEG allocates from its worker threads when built with thread support
+static size_t heap_live = 0;
+static size_t heap_peak = 0;
+
+static void heap_add(void* ptr) {
+    if (!ptr) return;
+    size_t live = __atomic_add_fetch(&heap_live, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&heap_peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&heap_peak, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void heap_remove(void* ptr) {
+    if (!ptr) return;
+    __atomic_sub_fetch(&heap_live, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    heap_add(ptr);
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    heap_add(ptr);
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void* new_ptr = __real_realloc(ptr, size);
+    if (new_ptr || size == 0) {
+        __atomic_sub_fetch(&heap_live, old_size, __ATOMIC_RELAXED);
+        heap_add(new_ptr);
+    }
+    return new_ptr;
+}
+
+void __wrap_free(void* ptr) {
+    heap_remove(ptr);
+    __real_free(ptr);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size) {
+    int result = __real_posix_memalign(ptr, alignment, size);
+    if (result == 0) heap_add(*ptr);
+    return result;
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    void* ptr = __real_aligned_alloc(alignment, size);
+    heap_add(ptr);
+    return ptr;
+}
+
+void* __wrap_memalign(size_t alignment, size_t size) {
+    void* ptr = __real_memalign(alignment, size);
+    heap_add(ptr);
+    return ptr;
+}
+
+// --- Exports under test ---
+
+typedef struct {
+    const bench_case_t* c;
+    uint8_t* data;
+    uint32_t data_len;
+    uint32_t num_tiles;
+    void* session;
+} bench_ctx_t;
+
+typedef struct {
+    const char* name;
+    // Returns the export's result, NULL on failure
+    void* (*run)(bench_ctx_t* ctx);
+    // Releases the result, free() when NULL
+    void (*release)(void* result);
+    // Output pixels per call, 0 for header queries
+    uint64_t (*pixels)(const bench_ctx_t* ctx);
+    // Whether the export needs an open session in ctx->session
+    int needs_session;
+} bench_export_t;
+
+static uint64_t pixels_full(const bench_ctx_t* ctx) {
+    return (uint64_t)ctx->c->width * ctx->c->height;
+}
+
+static uint64_t pixels_reduced2(const bench_ctx_t* ctx) {
+    return (uint64_t)((ctx->c->width + 3) / 4) * ((ctx->c->height + 3) / 4);
+}
+
+static uint64_t pixels_center(const bench_ctx_t* ctx) {
+    return (uint64_t)(ctx->c->width / 2) * (ctx->c->height / 2);
+}
+
+static uint64_t pixels_tile0(const bench_ctx_t* ctx) {
+    uint32_t tile = ctx->c->tile_size;
+    if (!tile) return pixels_full(ctx);
+    uint64_t w = tile < ctx->c->width ? tile : ctx->c->width;
+    uint64_t h = tile < ctx->c->height ? tile : ctx->c->height;
+    return w * h;
+}
+
+static void* run_get_size(bench_ctx_t* ctx) {
+    return getSize(ctx->data, ctx->data_len);
+}
+
+static void* run_get_tile_info(bench_ctx_t* ctx) {
+    return getTileInfo(ctx->data, ctx->data_len);
+}
+
+static void* run_decode(bench_ctx_t* ctx) {
+    return decodeToBmp(ctx->data, ctx->data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+}
+
+static void* run_decode_rgb565(bench_ctx_t* ctx) {
+    return decodeToBmp(ctx->data, ctx->data_len, 0, UINT32_MAX, COLOR_FORMAT_RGB565, 0, 0, 0, 0);
+}
+
+static void* run_decode_raw(bench_ctx_t* ctx) {
+    setOutputFormat(OUTPUT_FORMAT_RAW);
+    void* result = decodeToBmp(ctx->data, ctx->data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    setOutputFormat(OUTPUT_FORMAT_BMP);
+    return result;
+}
+
+static void* run_decode_reduced(bench_ctx_t* ctx) {
+    return decodeToBmpReduced(ctx->data, ctx->data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 2);
+}
+
+static void* run_decode_center(bench_ctx_t* ctx) {
+    return decodeToBmpWithRatio(ctx->data, ctx->data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0.25, 0.25, 0.75, 0.75);
+}
+
+static void* run_decode_tile(bench_ctx_t* ctx) {
+    return decodeTileToBmp(ctx->data, ctx->data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0);
+}
+
+// Tile streaming only changes multi-tile images; the others measure the same path as without it
+static void* run_decode_streamed(bench_ctx_t* ctx) {
+    setTileStreaming(1);
+    void* result = run_decode(ctx);
+    setTileStreaming(0);
+    return result;
+}
+
+static void* run_decode_raw_streamed(bench_ctx_t* ctx) {
+    setTileStreaming(1);
+    void* result = run_decode_raw(ctx);
+    setTileStreaming(0);
+    return result;
+}
+
+static void* run_decode_center_streamed(bench_ctx_t* ctx) {
+    setTileStreaming(1);
+    void* result = run_decode_center(ctx);
+    setTileStreaming(0);
+    return result;
+}
+
+// Includes copying the codestream into the heap, as precache does
+static void* run_open_session(bench_ctx_t* ctx) {
+    uint8_t* copy = (uint8_t*)malloc(ctx->data_len);
+    if (!copy) return NULL;
+    memcpy(copy, ctx->data, ctx->data_len);
+
+    void* session = openSession(copy, ctx->data_len);
+    if (!session) free(copy);
+    return session;
+}
+
+static void* run_session_decode(bench_ctx_t* ctx) {
+    sessionSetQualityLayers(ctx->session, 0);
+    return sessionDecodeToBmp(ctx->session, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+}
+
+static void* run_session_decode_layer1(bench_ctx_t* ctx) {
+    sessionSetQualityLayers(ctx->session, 1);
+    void* result = sessionDecodeToBmp(ctx->session, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    sessionSetQualityLayers(ctx->session, 0);
+    return result;
+}
+
+static void* run_session_decode_tile(bench_ctx_t* ctx) {
+    return sessionDecodeTileToBmp(ctx->session, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0);
+}
+
+static void* run_session_decode_streamed(bench_ctx_t* ctx) {
+    setTileStreaming(1);
+    void* result = run_session_decode(ctx);
+    setTileStreaming(0);
+    return result;
+}
+
+static const bench_export_t bench_exports[] = {
+    { "getSize",                              run_get_size,                NULL,         NULL,            0 },
+    { "getTileInfo",                          run_get_tile_info,           NULL,         NULL,            0 },
+    { "decodeToBmp",                          run_decode,                  NULL,         pixels_full,     0 },
+    { "decodeToBmp/rgb565",                   run_decode_rgb565,           NULL,         pixels_full,     0 },
+    { "decodeToBmp/raw",                      run_decode_raw,              NULL,         pixels_full,     0 },
+    { "decodeToBmpReduced/2",                 run_decode_reduced,          NULL,         pixels_reduced2, 0 },
+    { "decodeToBmpWithRatio/center",          run_decode_center,           NULL,         pixels_center,   0 },
+    { "decodeTileToBmp/0",                    run_decode_tile,             NULL,         pixels_tile0,    0 },
+    { "decodeToBmp/streamed",                 run_decode_streamed,         NULL,         pixels_full,     0 },
+    { "decodeToBmp/raw/streamed",             run_decode_raw_streamed,     NULL,         pixels_full,     0 },
+    { "decodeToBmpWithRatio/center/streamed", run_decode_center_streamed,  NULL,         pixels_center,   0 },
+    { "openSession",                          run_open_session,            closeSession, NULL,            0 },
+    { "sessionDecodeToBmp",                   run_session_decode,          NULL,         pixels_full,     1 },
+    { "sessionDecodeToBmp/layers1",           run_session_decode_layer1,   NULL,         pixels_full,     1 },
+    { "sessionDecodeTileToBmp/0",             run_session_decode_tile,     NULL,         pixels_tile0,    1 },
+    { "sessionDecodeToBmp/streamed",          run_session_decode_streamed, NULL,         pixels_full,     1 },
+};
+
+#define BENCH_EXPORT_COUNT (sizeof(bench_exports) / sizeof(bench_exports[0]))
+
+// --- Measurement ---
+
+typedef struct {
+    char case_name[MAX_NAME];
+    char export_name[MAX_NAME];
+    double ms_per_call;
+    double ms_min;
+    double mpix_per_s;
+    uint64_t peak_heap_bytes;
+    uint32_t samples;
+} bench_result_t;
+
+typedef struct {
+    int iterations;
+    double min_time_ms;
+    int threads;
+    int quick;
+    const char* only_case;
+    const char* output_path;
+    const char* baseline_path;
+    double latency_tolerance;
+    double heap_tolerance;
+    const char* corpus_dir;
+} bench_options_t;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static void release_result(const bench_export_t* e, void* result) {
+    if (e->release) {
+        e->release(result);
+    } else {
+        free(result);
+    }
+}
+
+// Runs one warm-up call, then at least `iterations` calls and at least `min_time_ms` in total.
+static int measure(const bench_export_t* e, bench_ctx_t* ctx, const bench_options_t* opt, double* samples, bench_result_t* out) {
+    void* result = e->run(ctx);
+    if (!result) {
+        fprintf(stderr, "%s / %s failed: %d\n", ctx->c->name, e->name, getLastError());
+        return 0;
+    }
+    release_result(e, result);
+
+    uint32_t count = 0;
+    uint64_t peak = 0;
+    double total = 0;
+    while (count < MAX_SAMPLES && (count < (uint32_t)opt->iterations || total < opt->min_time_ms)) {
+        size_t live_before = __atomic_load_n(&heap_live, __ATOMIC_RELAXED);
+        __atomic_store_n(&heap_peak, live_before, __ATOMIC_RELAXED);
+
+        double start = now_ms();
+        result = e->run(ctx);
+        double elapsed = now_ms() - start;
+
+        size_t call_peak = __atomic_load_n(&heap_peak, __ATOMIC_RELAXED) - live_before;
+        if (call_peak > peak) peak = call_peak;
+
+        if (!result) {
+            fprintf(stderr, "%s / %s failed: %d\n", ctx->c->name, e->name, getLastError());
+            return 0;
+        }
+        release_result(e, result);
+
+        samples[count++] = elapsed;
+        total += elapsed;
+    }
+
+    qsort(samples, count, sizeof(double), compare_double);
+    out->ms_per_call = (count % 2) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    out->ms_min = samples[0];
+    out->peak_heap_bytes = peak;
+    out->samples = count;
+
+    uint64_t pixels = e->pixels ? e->pixels(ctx) : 0;
+    out->mpix_per_s = (pixels > 0 && out->ms_per_call > 0) ? pixels / (out->ms_per_call * 1000.0) : 0;
+    return 1;
+}
+
+// --- Report ---
+
+static int write_report(const char* path, const bench_options_t* opt, const bench_result_t* results, uint32_t count) {
+    FILE* fp = path ? fopen(path, "w") : stdout;
+    if (!fp) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return 0;
+    }
+
+    // One result per line, read back by load_baseline()
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"openjpeg\": \"%s\",\n", opj_version());
+    fprintf(fp, "  \"threads\": %d,\n", opt->threads);
+    fprintf(fp, "  \"results\": [\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const bench_result_t* r = &results[i];
+        fprintf(fp, "    {\"case\": \"%s\", \"export\": \"%s\", \"ms_per_call\": %.4f, \"ms_min\": %.4f, ",
+                r->case_name, r->export_name, r->ms_per_call, r->ms_min);
+        if (r->mpix_per_s > 0) {
+            fprintf(fp, "\"mpix_per_s\": %.3f, ", r->mpix_per_s);
+        } else {
+            fprintf(fp, "\"mpix_per_s\": null, ");
+        }
+        fprintf(fp, "\"peak_heap_bytes\": %llu, \"samples\": %u}%s\n",
+                (unsigned long long)r->peak_heap_bytes, r->samples, (i + 1 < count) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+
+    if (path) fclose(fp);
+    return 1;
+}
+
+static int load_baseline(const char* path, bench_result_t* results, uint32_t* count) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Failed to read baseline %s\n", path);
+        return 0;
+    }
+
+    char line[1024];
+    *count = 0;
+    while (*count < MAX_RESULTS && fgets(line, sizeof(line), fp)) {
+        bench_result_t* r = &results[*count];
+        const char* ms = strstr(line, "\"ms_per_call\": ");
+        const char* heap = strstr(line, "\"peak_heap_bytes\": ");
+        unsigned long long peak = 0;
+        if (sscanf(line, " {\"case\": \"%63[^\"]\", \"export\": \"%63[^\"]\"", r->case_name, r->export_name) != 2 ||
+            !ms || sscanf(ms, "\"ms_per_call\": %lf", &r->ms_per_call) != 1 ||
+            !heap || sscanf(heap, "\"peak_heap_bytes\": %llu", &peak) != 1) {
+            continue;
+        }
+        r->peak_heap_bytes = peak;
+        (*count)++;
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+// Prints the comparison and returns the number of regressions.
+static int compare_baseline(const bench_options_t* opt, const bench_result_t* results, uint32_t count,
+                            const bench_result_t* baseline, uint32_t baseline_count) {
+    int regressions = 0;
+
+    printf("\n%-28s %-36s %10s %10s %8s %12s %12s %8s  %s\n",
+           "case", "export", "base ms", "ms", "delta", "base heap", "heap", "delta", "status");
+    for (uint32_t i = 0; i < count; i++) {
+        const bench_result_t* r = &results[i];
+        const bench_result_t* b = NULL;
+        for (uint32_t j = 0; j < baseline_count; j++) {
+            if (strcmp(baseline[j].case_name, r->case_name) == 0 && strcmp(baseline[j].export_name, r->export_name) == 0) {
+                b = &baseline[j];
+                break;
+            }
+        }
+
+        if (!b) {
+            printf("%-28s %-36s %10s %10.3f %8s %12s %12llu %8s  new\n", r->case_name, r->export_name,
+                   "-", r->ms_per_call, "-", "-", (unsigned long long)r->peak_heap_bytes, "-");
+            continue;
+        }
+
+        double ms_delta = b->ms_per_call > 0 ? (r->ms_per_call / b->ms_per_call - 1.0) * 100.0 : 0;
+        double heap_delta = b->peak_heap_bytes > 0 ? ((double)r->peak_heap_bytes / b->peak_heap_bytes - 1.0) * 100.0 : 0;
+
+        int slower = ms_delta > opt->latency_tolerance && r->ms_per_call - b->ms_per_call > LATENCY_NOISE_FLOOR_MS;
+        int bigger = r->peak_heap_bytes > b->peak_heap_bytes && heap_delta > opt->heap_tolerance;
+        const char* status = "ok";
+        if (slower && bigger) {
+            status = "REGRESSED (latency, heap)";
+        } else if (slower) {
+            status = "REGRESSED (latency)";
+        } else if (bigger) {
+            status = "REGRESSED (heap)";
+        }
+        if (slower || bigger) regressions++;
+
+        printf("%-28s %-36s %10.3f %10.3f %+7.1f%% %12llu %12llu %+7.1f%%  %s\n", r->case_name, r->export_name,
+               b->ms_per_call, r->ms_per_call, ms_delta,
+               (unsigned long long)b->peak_heap_bytes, (unsigned long long)r->peak_heap_bytes, heap_delta, status);
+    }
+
+    printf("\n%d regression(s) (latency tolerance %.1f%%, heap tolerance %.1f%%)\n",
+           regressions, opt->latency_tolerance, opt->heap_tolerance);
+    return regressions;
+}
+
+static const bench_result_t* find_result(const bench_result_t* results, uint32_t count, const char* case_name, const char* export_name) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(results[i].case_name, case_name) == 0 && strcmp(results[i].export_name, export_name) == 0) return &results[i];
+    }
+    return NULL;
+}
+
+// Prints the peak heap of each streamed export next to the same export without tile streaming.
+static void print_streaming_summary(const bench_result_t* results, uint32_t count) {
+    printf("\n%-28s %-36s %12s %12s %8s %10s %10s\n", "case", "export", "heap", "streamed", "delta", "ms", "streamed");
+    for (uint32_t i = 0; i < count; i++) {
+        const bench_result_t* s = &results[i];
+        const char* suffix = strstr(s->export_name, "/streamed");
+        if (!suffix || suffix[9] != '\0') continue;
+
+        char export_name[MAX_NAME];
+        snprintf(export_name, sizeof(export_name), "%.*s", (int)(suffix - s->export_name), s->export_name);
+        const bench_result_t* r = find_result(results, count, s->case_name, export_name);
+        if (!r) continue;
+
+        double heap_delta = r->peak_heap_bytes > 0 ? ((double)s->peak_heap_bytes / r->peak_heap_bytes - 1.0) * 100.0 : 0;
+        printf("%-28s %-36s %12llu %12llu %+7.1f%% %10.3f %10.3f\n", s->case_name, export_name,
+               (unsigned long long)r->peak_heap_bytes, (unsigned long long)s->peak_heap_bytes, heap_delta,
+               r->ms_per_call, s->ms_per_call);
+    }
+}
+
+static void write_corpus_file(const char* dir, const bench_case_t* c, const uint8_t* data, uint32_t data_len) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.j2k", dir, c->name);
+    FILE* fp = fopen(path, "wb");
+    if (!fp || fwrite(data, 1, data_len, fp) != data_len) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    if (fp) fclose(fp);
+}
+
+static int parse_options(int argc, char** argv, bench_options_t* opt) {
+    opt->iterations = 5;
+    opt->min_time_ms = 200;
+    opt->threads = 1;
+    opt->quick = 0;
+    opt->only_case = NULL;
+    opt->output_path = NULL;
+    opt->baseline_path = NULL;
+    opt->latency_tolerance = 10.0;
+    opt->heap_tolerance = 2.0;
+    opt->corpus_dir = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--quick") == 0) {
+            opt->quick = 1;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 0;
+        }
+        i++;
+        if (strcmp(arg, "--iterations") == 0) {
+            opt->iterations = atoi(value);
+        } else if (strcmp(arg, "--min-time-ms") == 0) {
+            opt->min_time_ms = atof(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            opt->threads = atoi(value);
+        } else if (strcmp(arg, "--case") == 0) {
+            opt->only_case = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            opt->output_path = value;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            opt->baseline_path = value;
+        } else if (strcmp(arg, "--latency-tolerance") == 0) {
+            opt->latency_tolerance = atof(value);
+        } else if (strcmp(arg, "--heap-tolerance") == 0) {
+            opt->heap_tolerance = atof(value);
+        } else if (strcmp(arg, "--corpus-dir") == 0) {
+            opt->corpus_dir = value;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 0;
+        }
+    }
+
+    if (opt->iterations < 1) opt->iterations = 1;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    bench_options_t opt;
+    if (!parse_options(argc, argv, &opt)) return 1;
+
+    opt.threads = setDecodeThreads(opt.threads);
+
+    static bench_result_t results[MAX_RESULTS];
+    static bench_result_t baseline[MAX_RESULTS];
+    uint32_t result_count = 0;
+    uint32_t baseline_count = 0;
+
+    if (opt.baseline_path && !load_baseline(opt.baseline_path, baseline, &baseline_count)) return 1;
+
+    double* samples = (double*)malloc(MAX_SAMPLES * sizeof(double));
+    if (!samples) return 1;
+
+    fprintf(stderr, "OpenJPEG %s, %d thread(s)\n", opj_version(), opt.threads);
+
+    int failed = 0;
+    for (uint32_t i = 0; i < bench_case_count; i++) {
+        const bench_case_t* c = &bench_cases[i];
+        if (opt.quick && c->large) continue;
+        if (opt.only_case && strcmp(opt.only_case, c->name) != 0) continue;
+
+        bench_ctx_t ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.c = c;
+        ctx.data = bench_corpus_generate(c, &ctx.data_len);
+        if (!ctx.data) {
+            fprintf(stderr, "Failed to generate %s\n", c->name);
+            failed = 1;
+            continue;
+        }
+        fprintf(stderr, "%s: %ux%u, %u bytes\n", c->name, c->width, c->height, ctx.data_len);
+        if (opt.corpus_dir) write_corpus_file(opt.corpus_dir, c, ctx.data, ctx.data_len);
+
+        for (uint32_t j = 0; j < BENCH_EXPORT_COUNT && result_count < MAX_RESULTS; j++) {
+            const bench_export_t* e = &bench_exports[j];
+
+            if (e->needs_session) {
+                ctx.session = run_open_session(&ctx);
+                if (!ctx.session) {
+                    fprintf(stderr, "%s / openSession failed: %d\n", c->name, getLastError());
+                    failed = 1;
+                    continue;
+                }
+            }
+
+            bench_result_t* r = &results[result_count];
+            memset(r, 0, sizeof(*r));
+            snprintf(r->case_name, sizeof(r->case_name), "%s", c->name);
+            snprintf(r->export_name, sizeof(r->export_name), "%s", e->name);
+            if (measure(e, &ctx, &opt, samples, r)) {
+                result_count++;
+            } else {
+                failed = 1;
+            }
+
+            if (ctx.session) {
+                closeSession(ctx.session);
+                ctx.session = NULL;
+            }
+        }
+
+        free(ctx.data);
+    }
+    free(samples);
+
+    if (!write_report(opt.output_path, &opt, results, result_count)) return 1;
+    if (failed) return 1;
+
+    print_streaming_summary(results, result_count);
+
+    if (opt.baseline_path && compare_baseline(&opt, results, result_count, baseline, baseline_count) > 0) {
+        return 2;
+    }
+    return 0;
+}
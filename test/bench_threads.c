@@ -0,0 +1,87 @@
+// Measures decode time against the OpenJPEG thread count.
+// Built natively against OpenJPEG with thread support by test/run_thread_benchmark.sh.
+//
+// Usage: bench_threads <image.jp2> <iterations> <threads>...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#define COLOR_FORMAT_ARGB8888 8888
+
+int setDecodeThreads(int thread_count);
+int getLastError();
+uint8_t* decodeToBmp(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static uint8_t* read_file(const char* path, uint32_t* size) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t* data = (uint8_t*)malloc(length);
+    if (data && fread(data, 1, length, fp) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+
+    *size = (uint32_t)length;
+    return data;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <image.jp2> <iterations> <threads>...\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t data_len = 0;
+    uint8_t* data = read_file(argv[1], &data_len);
+    if (!data) {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return 1;
+    }
+
+    int iterations = atoi(argv[2]);
+    if (iterations < 1) iterations = 1;
+
+    printf("%-10s %-10s %-14s %-8s\n", "threads", "effective", "ms/decode", "speedup");
+
+    double baseline_ms = 0;
+    for (int i = 3; i < argc; i++) {
+        int requested = atoi(argv[i]);
+        int effective = setDecodeThreads(requested);
+
+        // Warm-up decode, not measured
+        uint8_t* bmp = decodeToBmp(data, data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+        if (!bmp) {
+            fprintf(stderr, "Decode failed: %d\n", getLastError());
+            free(data);
+            return 1;
+        }
+        free(bmp);
+
+        double start = now_ms();
+        for (int n = 0; n < iterations; n++) {
+            bmp = decodeToBmp(data, data_len, 0, UINT32_MAX, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+            free(bmp);
+        }
+        double elapsed = (now_ms() - start) / iterations;
+
+        if (baseline_ms == 0) baseline_ms = elapsed;
+        printf("%-10d %-10d %-14.2f %-8.2f\n", requested, effective, elapsed, baseline_ms / elapsed);
+    }
+
+    free(data);
+    return 0;
+}
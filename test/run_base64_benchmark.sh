@@ -0,0 +1,20 @@
+#!/bin/bash
+set -e
+
+# Compares the Base64 converters of the string data channels (interpreted JS) with the WASM Base64
+# kernels of wrapper.c under Node.js, on buffers of the decoder output size.
+#
+# Usage: bash test/run_base64_benchmark.sh [openjpeg_core.wasm] [iterations] [sizes in KiB...]
+#
+# The WASM module defaults to the one shipped in the library assets; build it with -msimd128 (see
+# README) to measure the SIMD kernels. BENCH_NO_TEXT_ENCODER=1 measures the glue without TextEncoder.
+
+WASM=${1:-android/lib/src/main/assets/openjpeg_core.wasm}
+shift $(( $# > 0 ? 1 : 0 ))
+
+if [ ! -f "$WASM" ]; then
+  echo "WASM module not found: $WASM"
+  exit 1
+fi
+
+node test/bench_base64.js "$WASM" "$@"
@@ -0,0 +1,61 @@
+#!/bin/bash
+set -e
+
+# Builds OpenJPEG and wrapper.c natively and benchmarks every export on a synthetic corpus.
+# The JSON report is written to benchmark_report.json and compared against the stored baseline
+# (test/benchmark_baseline.json) when it exists; the script fails if an entry regressed.
+#
+# Usage: bash test/run_benchmark.sh [--update-baseline] [bench_decode options...]
+#   --update-baseline  Store this run as the new baseline instead of comparing against it.
+#
+# Other options are passed to bench_decode, e.g. --quick, --iterations N, --threads N,
+# --case NAME, --latency-tolerance PCT, --heap-tolerance PCT, --corpus-dir DIR.
+# Baselines are only comparable on the same machine and OpenJPEG version.
+
+BASELINE=${BENCH_BASELINE:-test/benchmark_baseline.json}
+REPORT=${BENCH_REPORT:-benchmark_report.json}
+
+UPDATE_BASELINE=0
+if [ "$1" = "--update-baseline" ]; then
+  UPDATE_BASELINE=1
+  shift
+fi
+
+BUILD_DIR=openjpeg/build-native
+
+cleanup() {
+  rm -f bench_decode
+}
+trap cleanup EXIT
+
+# Build OpenJPEG (the same build as test/run_thread_benchmark.sh)
+if [ ! -f "$BUILD_DIR/bin/libopenjp2.a" ]; then
+  cmake -S openjpeg -B "$BUILD_DIR" \
+      -DCMAKE_BUILD_TYPE=Release \
+      -DBUILD_SHARED_LIBS=OFF \
+      -DBUILD_CODEC=OFF \
+      -DOPJ_USE_THREAD=ON
+  cmake --build "$BUILD_DIR" -j"$(nproc)"
+fi
+
+# The allocator is wrapped so that allocations inside libopenjp2.a are measured as well
+gcc -O3 -o bench_decode test/bench_decode.c test/bench_corpus.c wrapper.c \
+    -I. \
+    -I"$BUILD_DIR/src/lib/openjp2" \
+    -Iopenjpeg/src/lib/openjp2 \
+    -Itest \
+    -DOPJ_STATIC \
+    -L"$BUILD_DIR/bin" \
+    -lopenjp2 -pthread -lm \
+    -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free \
+    -Wl,--wrap=posix_memalign,--wrap=aligned_alloc,--wrap=memalign
+
+if [ "$UPDATE_BASELINE" = "1" ]; then
+  ./bench_decode --output "$BASELINE" "$@"
+  echo "Baseline written to $BASELINE"
+elif [ -f "$BASELINE" ]; then
+  ./bench_decode --output "$REPORT" --baseline "$BASELINE" "$@"
+else
+  ./bench_decode --output "$REPORT" "$@"
+  echo "No baseline at $BASELINE, run with --update-baseline to store one."
+fi
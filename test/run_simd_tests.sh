@@ -0,0 +1,24 @@
+#!/bin/bash
+set -eo pipefail
+
+# Runs the C wrapper tests on the WebAssembly SIMD kernels: builds test/test_wrapper.c with
+# emcc -msimd128, as the shipped module is built, and runs it under Node.js. The native build of
+# run_tests.sh only reaches the scalar kernels. The pixel packing and Base64 tests compare the SIMD
+# kernels with their scalar counterparts.
+
+# Compile the test
+emcc -O2 -msimd128 test/test_wrapper.c test/stubs.c \
+    -I. \
+    -Iopenjpeg/src/lib/openjp2 \
+    -Itest \
+    -DOPJ_STATIC \
+    -s ALLOW_MEMORY_GROWTH=1 \
+    -s TOTAL_STACK=1048576 \
+    -o test_wrapper_simd.js
+
+# Run the test, and check that the SIMD kernels were compared with the scalar reference
+node test_wrapper_simd.js | tee test_wrapper_simd.log
+grep -q "SIMD=1" test_wrapper_simd.log
+
+# Clean up
+rm test_wrapper_simd.js test_wrapper_simd.wasm test_wrapper_simd.log
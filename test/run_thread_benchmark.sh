@@ -0,0 +1,41 @@
+#!/bin/bash
+set -e
+
+# Builds OpenJPEG and wrapper.c natively with thread support and measures the decode time
+# for each thread count.
+#
+# Usage: bash test/run_thread_benchmark.sh [image] [iterations] [threads...]
+
+IMAGE=${1:-android/lib/src/androidTest/assets/karin.jp2}
+ITERATIONS=${2:-10}
+shift $(( $# > 2 ? 2 : $# ))
+THREADS=${@:-1 2 4 8}
+
+BUILD_DIR=openjpeg/build-native
+
+cleanup() {
+  rm -f bench_threads
+}
+trap cleanup EXIT
+
+# Build OpenJPEG (thread support is enabled by OPJ_USE_THREAD)
+if [ ! -f "$BUILD_DIR/bin/libopenjp2.a" ]; then
+  cmake -S openjpeg -B "$BUILD_DIR" \
+      -DCMAKE_BUILD_TYPE=Release \
+      -DBUILD_SHARED_LIBS=OFF \
+      -DBUILD_CODEC=OFF \
+      -DOPJ_USE_THREAD=ON
+  cmake --build "$BUILD_DIR" -j"$(nproc)"
+fi
+
+# test/ only provides the emscripten.h shim, the real opj_config.h comes from the build directory
+gcc -O3 -o bench_threads test/bench_threads.c wrapper.c \
+    -I. \
+    -I"$BUILD_DIR/src/lib/openjp2" \
+    -Iopenjpeg/src/lib/openjp2 \
+    -Itest \
+    -DOPJ_STATIC \
+    -L"$BUILD_DIR/bin" \
+    -lopenjp2 -pthread -lm
+
+./bench_threads "$IMAGE" "$ITERATIONS" $THREADS
@@ -14,6 +14,74 @@ int stub_should_decompress_create_succeed = 1;
 int stub_should_set_decode_area_succeed = 1;
 int stub_should_setup_succeed = 1;
 int stub_should_decode_succeed = 0;
+uint32_t stub_num_resolutions = 6;
+int stub_should_set_resolution_succeed = 1;
+uint32_t stub_last_resolution_factor = 0;
+uint32_t stub_tile_width = 0;  // 0 means a single tile covering the image
+uint32_t stub_tile_height = 0;
+int stub_last_decoded_tile = -1;
+int stub_read_header_count = 0;
+int stub_has_thread_support = 1;
+int stub_last_codec_threads = 0;
+uint32_t stub_num_layers = 1;
+// Main header coding style reported by opj_get_cstr_info(), and the component precision (0 leaves it unset)
+int stub_prog_order = 0;
+uint32_t stub_code_block_exp = 6;
+uint32_t stub_precision = 0;
+uint32_t stub_last_cp_layer = 0;
+// Byte layout the stubs walk through the stream callbacks: a main header followed by one tile-part
+// per tile in raster order. 0 disables stream access.
+uint32_t stub_main_header_size = 0;
+uint32_t stub_tile_part_size = 0;
+// Fills the samples with stub_sample() of their position instead of 255
+int stub_fill_pattern = 0;
+int stub_read_tile_header_count = 0;
+// Calls requestCancel() after opj_decode_tile_data() decoded that many tiles, 0 for never
+int stub_cancel_after_tiles = 0;
+void requestCancel(void);
+// Decode area and reduction set with opj_set_decode_area(), and the next tile opj_read_tile_header() visits
+static opj_image_t stub_area;
+static uint32_t stub_area_factor = 0;
+static uint32_t stub_next_tile = 0;
+
+typedef struct {
+    opj_stream_read_fn read_fn;
+    opj_stream_skip_fn skip_fn;
+    opj_stream_seek_fn seek_fn;
+    void* user_data;
+} stub_stream_t;
+
+static OPJ_BOOL stub_stream_read(opj_stream_t* p_stream, OPJ_SIZE_T size) {
+    stub_stream_t* stream = (stub_stream_t*)p_stream;
+    if (!stream->read_fn) return OPJ_FALSE;
+    OPJ_BYTE* buffer = (OPJ_BYTE*)malloc(size);
+    if (!buffer) return OPJ_FALSE;
+    OPJ_SIZE_T read = stream->read_fn(buffer, size, stream->user_data);
+    free(buffer);
+    return read == size;
+}
+
+// Without a skip function OpenJPEG treats the skip as end of stream
+static OPJ_BOOL stub_stream_skip(opj_stream_t* p_stream, OPJ_OFF_T size) {
+    stub_stream_t* stream = (stub_stream_t*)p_stream;
+    if (!stream->skip_fn) return OPJ_FALSE;
+    return stream->skip_fn(size, stream->user_data) == size;
+}
+
+static OPJ_BOOL stub_stream_seek(opj_stream_t* p_stream, OPJ_OFF_T offset) {
+    stub_stream_t* stream = (stub_stream_t*)p_stream;
+    if (!stream->seek_fn) return OPJ_FALSE;
+    return stream->seek_fn(offset, stream->user_data);
+}
+
+static uint32_t stub_ceil_div_pow2(uint32_t a, uint32_t b) {
+    return (uint32_t)(((uint64_t)a + ((uint64_t)1 << b) - 1) >> b);
+}
+
+// Sample of a component at a position of the decoded resolution
+static OPJ_INT32 stub_sample(uint32_t compno, uint32_t x, uint32_t y) {
+    return (OPJ_INT32)((x * 7 + y * 13 + compno * 61) & 0xFF);
+}
 
 opj_codec_t* opj_create_decompress(OPJ_CODEC_FORMAT format) {
     if (stub_should_decompress_create_succeed) {
@@ -23,15 +91,31 @@ opj_codec_t* opj_create_decompress(OPJ_CODEC_FORMAT format) {
     return NULL;
 }
 void opj_set_default_decoder_parameters(opj_dparameters_t *parameters) {}
+OPJ_BOOL opj_has_thread_support(void) { return stub_has_thread_support ? OPJ_TRUE : OPJ_FALSE; }
+OPJ_BOOL opj_codec_set_threads(opj_codec_t *p_codec, int num_threads) {
+    stub_last_codec_threads = num_threads;
+    return OPJ_TRUE;
+}
 OPJ_BOOL opj_setup_decoder(opj_codec_t *p_codec, opj_dparameters_t *parameters) {
+    stub_last_cp_layer = parameters->cp_layer;
     if (stub_should_setup_succeed) return OPJ_TRUE;
     return OPJ_FALSE;
 }
-opj_stream_t* opj_stream_default_create(OPJ_BOOL p_is_input) { return (opj_stream_t*)malloc(1); }
-void opj_stream_set_read_function(opj_stream_t* p_stream, opj_stream_read_fn p_function) {}
-void opj_stream_set_user_data(opj_stream_t* p_stream, void * p_data, opj_stream_free_user_data_fn p_function) {}
+opj_stream_t* opj_stream_default_create(OPJ_BOOL p_is_input) { return (opj_stream_t*)calloc(1, sizeof(stub_stream_t)); }
+opj_stream_t* opj_stream_create(OPJ_SIZE_T p_buffer_size, OPJ_BOOL p_is_input) { return (opj_stream_t*)calloc(1, sizeof(stub_stream_t)); }
+void opj_stream_set_read_function(opj_stream_t* p_stream, opj_stream_read_fn p_function) { ((stub_stream_t*)p_stream)->read_fn = p_function; }
+void opj_stream_set_skip_function(opj_stream_t* p_stream, opj_stream_skip_fn p_function) { ((stub_stream_t*)p_stream)->skip_fn = p_function; }
+void opj_stream_set_seek_function(opj_stream_t* p_stream, opj_stream_seek_fn p_function) { ((stub_stream_t*)p_stream)->seek_fn = p_function; }
+void opj_stream_set_user_data(opj_stream_t* p_stream, void * p_data, opj_stream_free_user_data_fn p_function) { ((stub_stream_t*)p_stream)->user_data = p_data; }
 void opj_stream_set_user_data_length(opj_stream_t* p_stream, OPJ_UINT64 data_length) {}
 OPJ_BOOL opj_read_header(opj_stream_t *p_stream, opj_codec_t *p_codec, opj_image_t **p_image) {
+    stub_read_header_count++;
+    if (stub_main_header_size > 0 && !stub_stream_read(p_stream, stub_main_header_size)) return OPJ_FALSE;
+    memset(&stub_area, 0, sizeof(stub_area));
+    stub_area.x1 = stub_width;
+    stub_area.y1 = stub_height;
+    stub_area_factor = 0;
+    stub_next_tile = 0;
     if (stub_should_header_succeed) {
         *p_image = (opj_image_t*)calloc(1, sizeof(opj_image_t));
         (*p_image)->x0 = 0;
@@ -41,6 +125,15 @@ OPJ_BOOL opj_read_header(opj_stream_t *p_stream, opj_codec_t *p_codec, opj_image
         (*p_image)->numcomps = stub_num_comps;
         if (stub_num_comps > 0) {
             (*p_image)->comps = (opj_image_comp_t*)calloc(stub_num_comps, sizeof(opj_image_comp_t));
+            for (int i = 0; i < stub_num_comps; i++) {
+                (*p_image)->comps[i].w = stub_width;
+                (*p_image)->comps[i].h = stub_height;
+                if (stub_precision > 0) {
+                    (*p_image)->comps[i].prec = stub_precision;
+                    (*p_image)->comps[i].dx = 1;
+                    (*p_image)->comps[i].dy = i > 0 ? 2 : 1;
+                }
+            }
         } else {
             (*p_image)->comps = NULL;
         }
@@ -49,9 +142,55 @@ OPJ_BOOL opj_read_header(opj_stream_t *p_stream, opj_codec_t *p_codec, opj_image
     return OPJ_FALSE;
 }
 OPJ_BOOL opj_set_decode_area(opj_codec_t *p_codec, opj_image_t* p_image, OPJ_INT32 p_start_x, OPJ_INT32 p_start_y, OPJ_INT32 p_end_x, OPJ_INT32 p_end_y) {
-    if (stub_should_set_decode_area_succeed) return OPJ_TRUE;
+    if (stub_should_set_decode_area_succeed) {
+        p_image->x0 = (OPJ_UINT32)p_start_x;
+        p_image->y0 = (OPJ_UINT32)p_start_y;
+        p_image->x1 = (OPJ_UINT32)p_end_x;
+        p_image->y1 = (OPJ_UINT32)p_end_y;
+        stub_area.x0 = p_image->x0;
+        stub_area.y0 = p_image->y0;
+        stub_area.x1 = p_image->x1;
+        stub_area.y1 = p_image->y1;
+        stub_area_factor = (p_image->numcomps > 0 && p_image->comps) ? p_image->comps[0].factor : 0;
+        stub_next_tile = 0;
+        return OPJ_TRUE;
+    }
     return OPJ_FALSE;
 }
+OPJ_BOOL opj_set_decoded_resolution_factor(opj_codec_t *p_codec, OPJ_UINT32 res_factor) {
+    if (!stub_should_set_resolution_succeed || res_factor >= stub_num_resolutions) return OPJ_FALSE;
+    stub_last_resolution_factor = res_factor;
+    return OPJ_TRUE;
+}
+opj_codestream_info_v2_t* opj_get_cstr_info(opj_codec_t *p_codec) {
+    opj_codestream_info_v2_t* info = (opj_codestream_info_v2_t*)calloc(1, sizeof(opj_codestream_info_v2_t));
+    info->nbcomps = stub_num_comps > 0 ? (OPJ_UINT32)stub_num_comps : 0;
+    info->tx0 = 0;
+    info->ty0 = 0;
+    info->tdx = stub_tile_width > 0 ? stub_tile_width : stub_width;
+    info->tdy = stub_tile_height > 0 ? stub_tile_height : stub_height;
+    info->tw = info->tdx > 0 ? (stub_width + info->tdx - 1) / info->tdx : 0;
+    info->th = info->tdy > 0 ? (stub_height + info->tdy - 1) / info->tdy : 0;
+    info->m_default_tile_info.numlayers = stub_num_layers;
+    info->m_default_tile_info.prg = (OPJ_PROG_ORDER)stub_prog_order;
+    if (info->nbcomps > 0) {
+        info->m_default_tile_info.tccp_info = (opj_tccp_info_t*)calloc(info->nbcomps, sizeof(opj_tccp_info_t));
+        for (OPJ_UINT32 i = 0; i < info->nbcomps; i++) {
+            info->m_default_tile_info.tccp_info[i].numresolutions = stub_num_resolutions;
+            info->m_default_tile_info.tccp_info[i].cblkw = stub_code_block_exp;
+            info->m_default_tile_info.tccp_info[i].cblkh = stub_code_block_exp - 1;
+        }
+    }
+    return info;
+}
+void opj_destroy_cstr_info(opj_codestream_info_v2_t **cstr_info) {
+    if (cstr_info && *cstr_info) {
+        free((*cstr_info)->m_default_tile_info.tccp_info);
+        free(*cstr_info);
+        *cstr_info = NULL;
+    }
+}
+void opj_image_data_free(void* ptr) { free(ptr); }
 void opj_image_destroy(opj_image_t *image) {
     if (image) {
         if (image->comps) {
@@ -63,32 +202,149 @@ void opj_image_destroy(opj_image_t *image) {
         free(image);
     }
 }
-OPJ_BOOL opj_decode(opj_codec_t *p_decompressor, opj_stream_t *p_stream, opj_image_t *p_image) {
-    if (stub_should_decode_succeed) {
-        // Allocate data for comps
-        uint32_t w = p_image->x1 - p_image->x0;
-        uint32_t h = p_image->y1 - p_image->y0;
-        for (uint32_t i = 0; i < p_image->numcomps; i++) {
-             p_image->comps[i].data = (OPJ_INT32*)malloc(w * h * sizeof(OPJ_INT32));
-             if (!p_image->comps[i].data) {
-                 // Clean up on allocation failure
-                 for (uint32_t k = 0; k < i; k++) {
-                     if (p_image->comps[k].data) {
-                         free(p_image->comps[k].data);
-                         p_image->comps[k].data = NULL;
-                     }
+// Allocates component data sized like OpenJPEG does for the current area and reduction
+static OPJ_BOOL stub_fill_components(opj_image_t *p_image) {
+    for (uint32_t i = 0; i < p_image->numcomps; i++) {
+         uint32_t factor = p_image->comps[i].factor;
+         uint32_t w = stub_ceil_div_pow2(p_image->x1, factor) - stub_ceil_div_pow2(p_image->x0, factor);
+         uint32_t h = stub_ceil_div_pow2(p_image->y1, factor) - stub_ceil_div_pow2(p_image->y0, factor);
+         p_image->comps[i].w = w;
+         p_image->comps[i].h = h;
+         p_image->comps[i].data = (OPJ_INT32*)malloc(w * h * sizeof(OPJ_INT32));
+         if (!p_image->comps[i].data) {
+             // Clean up on allocation failure
+             for (uint32_t k = 0; k < i; k++) {
+                 if (p_image->comps[k].data) {
+                     free(p_image->comps[k].data);
+                     p_image->comps[k].data = NULL;
                  }
-                 return OPJ_FALSE;
              }
-             // Fill with dummy data (e.g. solid white/opaque)
-             // 255 for all channels
+             return OPJ_FALSE;
+         }
+         // Fill with dummy data (e.g. solid white/opaque)
+         // 255 for all channels
+         for (uint32_t j = 0; j < w * h; j++) {
+             p_image->comps[i].data[j] = 255;
+         }
+         if (stub_fill_pattern) {
+             uint32_t x0 = stub_ceil_div_pow2(p_image->x0, factor);
+             uint32_t y0 = stub_ceil_div_pow2(p_image->y0, factor);
              for (uint32_t j = 0; j < w * h; j++) {
-                 p_image->comps[i].data[j] = 255;
+                 p_image->comps[i].data[j] = stub_sample(i, x0 + j % w, y0 + j / w);
              }
-        }
-        return OPJ_TRUE;
+         }
+    }
+    return OPJ_TRUE;
+}
+static OPJ_BOOL stub_tile_in_area(uint32_t tile_index, opj_image_t *p_image) {
+    uint32_t tdx = stub_tile_width > 0 ? stub_tile_width : stub_width;
+    uint32_t tdy = stub_tile_height > 0 ? stub_tile_height : stub_height;
+    uint32_t tw = (stub_width + tdx - 1) / tdx;
+    uint32_t x0 = (tile_index % tw) * tdx;
+    uint32_t y0 = (tile_index / tw) * tdy;
+    return x0 < p_image->x1 && x0 + tdx > p_image->x0 && y0 < p_image->y1 && y0 + tdy > p_image->y0;
+}
+// Reads the tile-parts intersecting the decode area and skips the others, stopping after the last
+// tile needed, like OpenJPEG does when it decodes an area.
+static OPJ_BOOL stub_read_tile_parts(opj_stream_t *p_stream, opj_image_t *p_image) {
+    uint32_t tdx = stub_tile_width > 0 ? stub_tile_width : stub_width;
+    uint32_t tdy = stub_tile_height > 0 ? stub_tile_height : stub_height;
+    uint32_t num_tiles = ((stub_width + tdx - 1) / tdx) * ((stub_height + tdy - 1) / tdy);
+    uint32_t last = 0;
+    for (uint32_t t = 0; t < num_tiles; t++) {
+        if (stub_tile_in_area(t, p_image)) last = t + 1;
+    }
+    for (uint32_t t = 0; t < last; t++) {
+        OPJ_BOOL ok = stub_tile_in_area(t, p_image)
+                ? stub_stream_read(p_stream, stub_tile_part_size)
+                : stub_stream_skip(p_stream, stub_tile_part_size);
+        if (!ok) return OPJ_FALSE;
+    }
+    return OPJ_TRUE;
+}
+OPJ_BOOL opj_decode(opj_codec_t *p_decompressor, opj_stream_t *p_stream, opj_image_t *p_image) {
+    if (stub_main_header_size > 0 && !stub_read_tile_parts(p_stream, p_image)) return OPJ_FALSE;
+    if (stub_should_decode_succeed) {
+        return stub_fill_components(p_image);
     }
     return OPJ_FALSE;
 }
+OPJ_BOOL opj_get_decoded_tile(opj_codec_t *p_codec, opj_stream_t *p_stream, opj_image_t *p_image, OPJ_UINT32 tile_index) {
+    if (!stub_should_decode_succeed) return OPJ_FALSE;
+    if (stub_main_header_size > 0) {
+        OPJ_OFF_T offset = (OPJ_OFF_T)stub_main_header_size + (OPJ_OFF_T)tile_index * stub_tile_part_size;
+        if (!stub_stream_seek(p_stream, offset) || !stub_stream_read(p_stream, stub_tile_part_size)) return OPJ_FALSE;
+    }
+
+    uint32_t tdx = stub_tile_width > 0 ? stub_tile_width : stub_width;
+    uint32_t tdy = stub_tile_height > 0 ? stub_tile_height : stub_height;
+    uint32_t tw = (stub_width + tdx - 1) / tdx;
+    uint32_t x0 = (tile_index % tw) * tdx;
+    uint32_t y0 = (tile_index / tw) * tdy;
+    p_image->x0 = x0;
+    p_image->y0 = y0;
+    p_image->x1 = x0 + tdx < stub_width ? x0 + tdx : stub_width;
+    p_image->y1 = y0 + tdy < stub_height ? y0 + tdy : stub_height;
+    stub_last_decoded_tile = (int)tile_index;
+    return stub_fill_components(p_image);
+}
+// Reduced bounds of a tile, clipped to the image
+static void stub_tile_bounds(uint32_t tile_index, uint32_t factor, uint32_t* x0, uint32_t* y0, uint32_t* x1, uint32_t* y1) {
+    uint32_t tdx = stub_tile_width > 0 ? stub_tile_width : stub_width;
+    uint32_t tdy = stub_tile_height > 0 ? stub_tile_height : stub_height;
+    uint32_t tw = (stub_width + tdx - 1) / tdx;
+    uint32_t tx0 = (tile_index % tw) * tdx;
+    uint32_t ty0 = (tile_index / tw) * tdy;
+    uint32_t tx1 = tx0 + tdx < stub_width ? tx0 + tdx : stub_width;
+    uint32_t ty1 = ty0 + tdy < stub_height ? ty0 + tdy : stub_height;
+    *x0 = stub_ceil_div_pow2(tx0, factor);
+    *y0 = stub_ceil_div_pow2(ty0, factor);
+    *x1 = stub_ceil_div_pow2(tx1, factor);
+    *y1 = stub_ceil_div_pow2(ty1, factor);
+}
+// Visits the tiles intersecting the decode area in raster order. Samples are 8-bit (one byte each).
+OPJ_BOOL opj_read_tile_header(opj_codec_t *p_codec, opj_stream_t *p_stream, OPJ_UINT32 *p_tile_index, OPJ_UINT32 *p_data_size,
+                              OPJ_INT32 *p_tile_x0, OPJ_INT32 *p_tile_y0, OPJ_INT32 *p_tile_x1, OPJ_INT32 *p_tile_y1,
+                              OPJ_UINT32 *p_nb_comps, OPJ_BOOL *p_should_go_on) {
+    stub_read_tile_header_count++;
+    uint32_t tdx = stub_tile_width > 0 ? stub_tile_width : stub_width;
+    uint32_t tdy = stub_tile_height > 0 ? stub_tile_height : stub_height;
+    uint32_t num_tiles = ((stub_width + tdx - 1) / tdx) * ((stub_height + tdy - 1) / tdy);
+    while (stub_next_tile < num_tiles && !stub_tile_in_area(stub_next_tile, &stub_area)) stub_next_tile++;
+
+    *p_should_go_on = stub_next_tile < num_tiles ? OPJ_TRUE : OPJ_FALSE;
+    if (!*p_should_go_on) return OPJ_TRUE;
+
+    uint32_t x0, y0, x1, y1;
+    stub_tile_bounds(stub_next_tile, 0, &x0, &y0, &x1, &y1);
+    *p_tile_x0 = (OPJ_INT32)x0;
+    *p_tile_y0 = (OPJ_INT32)y0;
+    *p_tile_x1 = (OPJ_INT32)x1;
+    *p_tile_y1 = (OPJ_INT32)y1;
+    stub_tile_bounds(stub_next_tile, stub_area_factor, &x0, &y0, &x1, &y1);
+    *p_tile_index = stub_next_tile;
+    *p_data_size = (x1 - x0) * (y1 - y0) * (OPJ_UINT32)stub_num_comps;
+    *p_nb_comps = (OPJ_UINT32)stub_num_comps;
+    return OPJ_TRUE;
+}
+OPJ_BOOL opj_decode_tile_data(opj_codec_t *p_codec, OPJ_UINT32 p_tile_index, OPJ_BYTE *p_data, OPJ_UINT32 p_data_size, opj_stream_t *p_stream) {
+    if (!stub_should_decode_succeed || p_tile_index != stub_next_tile) return OPJ_FALSE;
+
+    uint32_t x0, y0, x1, y1;
+    stub_tile_bounds(p_tile_index, stub_area_factor, &x0, &y0, &x1, &y1);
+    if (p_data_size < (x1 - x0) * (y1 - y0) * (OPJ_UINT32)stub_num_comps) return OPJ_FALSE;
+
+    for (int c = 0; c < stub_num_comps; c++) {
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                *p_data++ = stub_fill_pattern ? (OPJ_BYTE)stub_sample((uint32_t)c, x, y) : 255;
+            }
+        }
+    }
+    stub_last_decoded_tile = (int)p_tile_index;
+    stub_next_tile++;
+    if (stub_cancel_after_tiles > 0 && --stub_cancel_after_tiles == 0) requestCancel();
+    return OPJ_TRUE;
+}
 void opj_stream_destroy(opj_stream_t* p_stream) { if(p_stream) free(p_stream); }
 void opj_destroy_codec(opj_codec_t * p_codec) { if(p_codec) free(p_codec); }
@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "emscripten.h"
 
 int stub_malloc_should_fail = 0;
+int stub_malloc_count = 0;
 void* my_malloc(size_t size) {
     if (stub_malloc_should_fail) return NULL;
+    stub_malloc_count++;
     return malloc(size);
 }
 #define malloc my_malloc
@@ -14,6 +18,15 @@ void* my_malloc(size_t size) {
 // This is a bit hacky but effective for unit testing static functions
 #include "../wrapper.c"
 
+// Shorthands for the converters the decode exports reach through encode_output
+static uint8_t* convert_image_to_bmp(opj_image_t* image, int color_format) {
+    return convert_image(image, OUTPUT_FORMAT_BMP, color_format);
+}
+
+static uint8_t* convert_image_to_raw(opj_image_t* image, int color_format) {
+    return convert_image(image, OUTPUT_FORMAT_RAW, color_format);
+}
+
 // Helper to create a mock opj_image_t
 opj_image_t* create_mock_image(uint32_t width, uint32_t height, int numcomps, int with_alpha) {
     opj_image_t* image = (opj_image_t*)calloc(1, sizeof(opj_image_t));
@@ -25,6 +38,8 @@ opj_image_t* create_mock_image(uint32_t width, uint32_t height, int numcomps, in
     image->comps = (opj_image_comp_t*)calloc(numcomps, sizeof(opj_image_comp_t));
 
     for (int i = 0; i < numcomps; i++) {
+        image->comps[i].w = width;
+        image->comps[i].h = height;
         image->comps[i].data = (int32_t*)malloc(width * height * sizeof(int32_t));
         // Initialize with 0
         memset(image->comps[i].data, 0, width * height * sizeof(int32_t));
@@ -281,7 +296,7 @@ void test_multichannel() {
     image->comps[2].data[0] = 0;
     // Comp 3 (A): 128 (treated as alpha if flag set, or index 3 if not)
     // In create_mock_image, we didn't set alpha flag for index 3 unless called with with_alpha=1
-    // But get_alpha_component returns comps[3].data if no alpha flag is found and numcomps > 3
+    // But get_alpha_index returns 3 if no alpha flag is found and numcomps > 3
     image->comps[3].data[0] = 128;
     // Comp 4 (Ignored): 100
     image->comps[4].data[0] = 100;
@@ -357,6 +372,25 @@ extern int stub_should_setup_succeed;
 extern int stub_should_decode_succeed;
 extern int stub_should_set_decode_area_succeed;
 extern int stub_num_comps;
+extern uint32_t stub_num_resolutions;
+extern int stub_should_set_resolution_succeed;
+extern uint32_t stub_last_resolution_factor;
+extern uint32_t stub_tile_width;
+extern uint32_t stub_tile_height;
+extern int stub_last_decoded_tile;
+extern int stub_read_header_count;
+extern int stub_has_thread_support;
+extern int stub_last_codec_threads;
+extern uint32_t stub_num_layers;
+extern uint32_t stub_last_cp_layer;
+extern uint32_t stub_main_header_size;
+extern uint32_t stub_tile_part_size;
+extern int stub_fill_pattern;
+extern int stub_read_tile_header_count;
+extern int stub_prog_order;
+extern uint32_t stub_code_block_exp;
+extern uint32_t stub_precision;
+extern int stub_cancel_after_tiles;
 
 void test_opj_read_from_buffer() {
     printf("Testing opj_read_from_buffer...\n");
@@ -392,6 +426,40 @@ void test_opj_read_from_buffer() {
     printf("opj_read_from_buffer Passed.\n");
 }
 
+void test_opj_skip_and_seek_in_buffer() {
+    printf("Testing opj_skip_in_buffer / opj_seek_in_buffer...\n");
+    uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    opj_buffer_info_t info = {data, 10, 0};
+    uint8_t buffer[4];
+
+    // 1. Forward skip, then read from the new offset
+    assert(opj_skip_in_buffer(3, &info) == 3);
+    assert(info.offset == 3);
+    assert(opj_read_from_buffer(buffer, 2, &info) == 2);
+    assert(buffer[0] == 4 && buffer[1] == 5);
+
+    // 2. Skips are clamped to the data, and fail once at the boundary
+    assert(opj_skip_in_buffer(100, &info) == 5);
+    assert(info.offset == 10);
+    assert(opj_skip_in_buffer(1, &info) == (OPJ_OFF_T)-1);
+    assert(opj_skip_in_buffer(-4, &info) == -4);
+    assert(info.offset == 6);
+    assert(opj_skip_in_buffer(-100, &info) == -6);
+    assert(info.offset == 0);
+    assert(opj_skip_in_buffer(-1, &info) == (OPJ_OFF_T)-1);
+
+    // 3. Seek to an absolute offset
+    assert(opj_seek_in_buffer(8, &info) == OPJ_TRUE);
+    assert(opj_read_from_buffer(buffer, 4, &info) == 2);
+    assert(buffer[0] == 9 && buffer[1] == 10);
+    assert(opj_seek_in_buffer(10, &info) == OPJ_TRUE);
+    assert(opj_seek_in_buffer(11, &info) == OPJ_FALSE);
+    assert(opj_seek_in_buffer(-1, &info) == OPJ_FALSE);
+    assert(info.offset == 10);
+
+    printf("opj_skip_in_buffer / opj_seek_in_buffer Passed.\n");
+}
+
 void test_set_decode_area_failure() {
     printf("Testing opj_set_decode_area Failure...\n");
     uint8_t dummy_data[20] = {0};
@@ -788,6 +856,818 @@ void test_ratio_decode() {
     stub_should_header_succeed = 0;
 }
 
+void check_bmp_size(uint8_t* bmp, uint32_t expected_width, uint32_t expected_height) {
+    uint32_t width;
+    int32_t height;
+    memcpy(&width, &bmp[18], 4);
+    memcpy(&height, &bmp[22], 4);
+    assert(width == expected_width);
+    assert(height == -(int32_t)expected_height);
+}
+
+void test_reduced_decode() {
+    printf("Testing Reduced Decode...\n");
+    uint8_t dummy_data[20] = {0};
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 100;
+    stub_height = 100;
+    stub_num_resolutions = 6;
+
+    // 1. Full image, reduce 1 -> 50x50
+    uint8_t* result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 1);
+    assert(result != NULL);
+    assert(stub_last_resolution_factor == 1);
+    check_bmp_size(result, 50, 50);
+    free(result);
+
+    // 2. Odd sizes round up on the reduced grid: 101x99 at reduce 2 -> 26x25
+    stub_width = 101;
+    stub_height = 99;
+    result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_RGB565, 0, 0, 0, 0, 2);
+    assert(result != NULL);
+    check_bmp_size(result, 26, 25);
+    free(result);
+    stub_width = 100;
+    stub_height = 100;
+
+    // 3. Levels beyond the codestream are clamped: 3 resolutions -> at most reduce 2
+    stub_num_resolutions = 3;
+    result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 10);
+    assert(result != NULL);
+    assert(stub_last_resolution_factor == 2);
+    check_bmp_size(result, 25, 25);
+    free(result);
+
+    // 4. A single resolution level cannot be reduced at all
+    stub_num_resolutions = 1;
+    stub_last_resolution_factor = 0;
+    result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 3);
+    assert(result != NULL);
+    assert(stub_last_resolution_factor == 0);
+    check_bmp_size(result, 100, 100);
+    free(result);
+    stub_num_resolutions = 6;
+
+    // 5. Pixel region is given on the full resolution grid: (10,20)-(60,80) at reduce 1 -> 25x30
+    result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 10, 20, 60, 80, 1);
+    assert(result != NULL);
+    check_bmp_size(result, 25, 30);
+    free(result);
+
+    // 6. Ratio region: (0.5,0.0)-(1.0,0.5) -> (50,0)-(100,50) at reduce 2 -> 12x13
+    result = decodeToBmpWithRatioReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0.5, 0.0, 1.0, 0.5, 2);
+    assert(result != NULL);
+    check_bmp_size(result, 12, 13);
+    free(result);
+
+    // 7. Region checks still use the full resolution bounds
+    result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 101, 50, 1);
+    assert(result == NULL);
+    assert(last_error == ERR_REGION_OUT_OF_BOUNDS);
+
+    // 8. Pixel limit applies to the reduced output size
+    // 100x100 = 10000 pixels > 2500, but reduce 1 -> 50x50 = 2500 pixels
+    result = decodeToBmpReduced(dummy_data, 20, 2500, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_PIXEL_DATA_SIZE);
+    result = decodeToBmpReduced(dummy_data, 20, 2500, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 1);
+    assert(result != NULL);
+    check_bmp_size(result, 50, 50);
+    free(result);
+    result = decodeToBmpReduced(dummy_data, 20, 2499, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 1);
+    assert(result == NULL);
+    assert(last_error == ERR_PIXEL_DATA_SIZE);
+
+    // 9. Resolution factor rejected by the decoder
+    stub_should_set_resolution_succeed = 0;
+    result = decodeToBmpReduced(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 1);
+    assert(result == NULL);
+    assert(last_error == ERR_DECODER_SETUP);
+    stub_should_set_resolution_succeed = 1;
+
+    printf("Reduced Decode Passed.\n");
+    stub_should_header_succeed = 0;
+    stub_should_decode_succeed = 0;
+    stub_last_resolution_factor = 0;
+}
+
+void test_tile_info() {
+    printf("Testing Tile Info...\n");
+    uint8_t dummy_data[20] = {0};
+
+    // 1. Input validation and header failure
+    uint32_t* info = getTileInfo(NULL, 20);
+    assert(info == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+
+    stub_should_header_succeed = 0;
+    info = getTileInfo(dummy_data, 20);
+    assert(info == NULL);
+    assert(last_error == ERR_HEADER);
+
+    // 2. 250x130 image with 100x100 tiles -> 3x2 grid
+    stub_should_header_succeed = 1;
+    stub_width = 250;
+    stub_height = 130;
+    stub_tile_width = 100;
+    stub_tile_height = 100;
+    info = getTileInfo(dummy_data, 20);
+    assert(info != NULL);
+    assert(info[TILE_INFO_IMAGE_X0] == 0);
+    assert(info[TILE_INFO_IMAGE_Y0] == 0);
+    assert(info[TILE_INFO_IMAGE_X1] == 250);
+    assert(info[TILE_INFO_IMAGE_Y1] == 130);
+    assert(info[TILE_INFO_TILE_X0] == 0);
+    assert(info[TILE_INFO_TILE_Y0] == 0);
+    assert(info[TILE_INFO_TILE_WIDTH] == 100);
+    assert(info[TILE_INFO_TILE_HEIGHT] == 100);
+    assert(info[TILE_INFO_NUM_TILES_X] == 3);
+    assert(info[TILE_INFO_NUM_TILES_Y] == 2);
+    free(info);
+
+    // 3. Malloc failure
+    stub_malloc_should_fail = 1;
+    info = getTileInfo(dummy_data, 20);
+    stub_malloc_should_fail = 0;
+    assert(info == NULL);
+    assert(last_error == ERR_DECODE);
+
+    printf("Tile Info Passed.\n");
+    stub_should_header_succeed = 0;
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+}
+
+void test_decode_tile() {
+    printf("Testing Decode Tile...\n");
+    uint8_t dummy_data[20] = {0};
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 250;
+    stub_height = 130;
+    stub_tile_width = 100;
+    stub_tile_height = 100;
+
+    // 1. Interior tile (0) is a full 100x100 tile
+    uint8_t* result = decodeTileToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0);
+    assert(result != NULL);
+    assert(stub_last_decoded_tile == 0);
+    check_bmp_size(result, 100, 100);
+    free(result);
+
+    // 2. Edge tile (5 = column 2, row 1) is clipped to the image: 50x30
+    result = decodeTileToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_RGB565, 5, 0);
+    assert(result != NULL);
+    assert(stub_last_decoded_tile == 5);
+    check_bmp_size(result, 50, 30);
+    free(result);
+
+    // 3. Reduced tile: tile 4 (100..200, 100..130) at reduce 1 -> 50x15
+    result = decodeTileToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 4, 1);
+    assert(result != NULL);
+    check_bmp_size(result, 50, 15);
+    free(result);
+
+    // 4. Tile index out of range
+    result = decodeTileToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 6, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_REGION_OUT_OF_BOUNDS);
+
+    // 5. Pixel limit is checked against the tile, not the image
+    result = decodeTileToBmp(dummy_data, 20, 1500, 100000, COLOR_FORMAT_ARGB8888, 5, 0);
+    assert(result != NULL);
+    free(result);
+    result = decodeTileToBmp(dummy_data, 20, 1499, 100000, COLOR_FORMAT_ARGB8888, 5, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_PIXEL_DATA_SIZE);
+
+    // 6. Input size and decode failures
+    result = decodeTileToBmp(dummy_data, 5, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+
+    stub_should_decode_succeed = 0;
+    result = decodeTileToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_DECODE);
+
+    stub_should_header_succeed = 0;
+    result = decodeTileToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_HEADER);
+
+    printf("Decode Tile Passed.\n");
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_last_decoded_tile = -1;
+}
+
+// Lays out a codestream of one page per tile-part after a one page main header, and removes read
+// access from every tile-part the decode must not need. Touching any of them crashes the test.
+void test_stream_reads_only_needed_tile_parts() {
+    printf("Testing Stream Reads Only Needed Tile-Parts...\n");
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len = page * 10;
+    uint8_t* data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(data != MAP_FAILED);
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 12;
+    stub_height = 12;
+    stub_tile_width = 4;
+    stub_tile_height = 4;
+    stub_main_header_size = (uint32_t)page;
+    stub_tile_part_size = (uint32_t)page;
+
+    // 1. Tile 4 (centre of the 3x3 grid) is reached with a seek
+    for (int t = 0; t < 9; t++) {
+        if (t != 4) assert(mprotect(data + page * (1 + t), page, PROT_NONE) == 0);
+    }
+    uint8_t* result = decodeTileToBmp(data, (uint32_t)len, 0, 1 << 20, COLOR_FORMAT_ARGB8888, 4, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 4, 4);
+    free(result);
+
+    // 2. A region inside tile 4 skips tiles 0-3 and stops before tiles 5-8
+    result = decodeToBmp(data, (uint32_t)len, 0, 1 << 20, COLOR_FORMAT_ARGB8888, 5, 5, 7, 7);
+    assert(result != NULL);
+    check_bmp_size(result, 2, 2);
+    free(result);
+
+    // 3. A region over tiles 4 and 5 also reads tile 5 only
+    assert(mprotect(data + page * 6, page, PROT_READ) == 0);
+    result = decodeToBmp(data, (uint32_t)len, 0, 1 << 20, COLOR_FORMAT_ARGB8888, 5, 5, 10, 7);
+    assert(result != NULL);
+    check_bmp_size(result, 5, 2);
+    free(result);
+
+    munmap(data, len);
+    stub_main_header_size = 0;
+    stub_tile_part_size = 0;
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_last_decoded_tile = -1;
+    printf("Stream Reads Only Needed Tile-Parts Passed.\n");
+}
+
+// J2K codestream with a TLM marker in the main header and a PLT marker in the second tile-part
+static const uint8_t image_info_codestream[] = {
+    0xFF, 0x4F,                                                 // SOC
+    0xFF, 0x52, 0x00, 0x04, 0x00, 0x00,                         // COD (truncated)
+    0xFF, 0x55, 0x00, 0x04, 0x00, 0x00,                         // TLM
+    0xFF, 0x90, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x01, // SOT, Psot 16
+    0xFF, 0x93, 0x00, 0x00,                                     // SOD + body
+    0xFF, 0x90, 0x00, 0x0A, 0x00, 0x01, 0x00, 0x00, 0x00, 0x15, 0x00, 0x01, // SOT, Psot 21
+    0xFF, 0x58, 0x00, 0x03, 0x00,                               // PLT
+    0xFF, 0x93, 0x00, 0x00,                                     // SOD + body
+    0xFF, 0xD9,                                                 // EOC
+};
+
+void test_image_info() {
+    printf("Testing Image Info...\n");
+    uint8_t dummy_data[20] = {0};
+
+    // 1. Input validation and header failure
+    uint32_t* info = getImageInfo(NULL, 20);
+    assert(info == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+
+    stub_should_header_succeed = 0;
+    info = getImageInfo(dummy_data, 20);
+    assert(info == NULL);
+    assert(last_error == ERR_HEADER);
+
+    // 2. Header fields of a 250x130 image with 100x100 tiles and 3 components
+    stub_should_header_succeed = 1;
+    stub_width = 250;
+    stub_height = 130;
+    stub_tile_width = 100;
+    stub_tile_height = 100;
+    stub_num_comps = 3;
+    stub_num_layers = 5;
+    stub_prog_order = OPJ_RPCL;
+    stub_precision = 12;
+    info = getImageInfo(dummy_data, 20);
+    assert(info != NULL);
+    assert(info[IMAGE_INFO_IMAGE_X1] == 250);
+    assert(info[IMAGE_INFO_IMAGE_Y1] == 130);
+    assert(info[IMAGE_INFO_TILE_WIDTH] == 100);
+    assert(info[IMAGE_INFO_NUM_TILES_X] == 3);
+    assert(info[IMAGE_INFO_NUM_TILES_Y] == 2);
+    assert(info[IMAGE_INFO_NUM_RESOLUTIONS] == 6);
+    assert(info[IMAGE_INFO_NUM_LAYERS] == 5);
+    assert(info[IMAGE_INFO_PROGRESSION_ORDER] == OPJ_RPCL);
+    assert(info[IMAGE_INFO_CODE_BLOCK_WIDTH] == 64);
+    assert(info[IMAGE_INFO_CODE_BLOCK_HEIGHT] == 32);
+    assert(info[IMAGE_INFO_MARKERS] == 0);
+    assert(info[IMAGE_INFO_NUM_COMPONENTS] == 3);
+    uint32_t* component = info + IMAGE_INFO_HEADER_COUNT + 2 * IMAGE_INFO_COMPONENT_COUNT;
+    assert(component[IMAGE_INFO_COMPONENT_PRECISION] == 12);
+    assert(component[IMAGE_INFO_COMPONENT_SIGNED] == 0);
+    assert(component[IMAGE_INFO_COMPONENT_DX] == 1);
+    assert(component[IMAGE_INFO_COMPONENT_DY] == 2);
+    free(info);
+
+    // 3. TLM and PLT markers, in a raw codestream and inside a jp2c box
+    info = getImageInfo((uint8_t*)image_info_codestream, sizeof(image_info_codestream));
+    assert(info != NULL);
+    assert(info[IMAGE_INFO_MARKERS] == (IMAGE_INFO_MARKER_TLM | IMAGE_INFO_MARKER_PLT));
+    free(info);
+
+    uint8_t jp2[12 + 8 + sizeof(image_info_codestream)] = {
+        0x00, 0x00, 0x00, 0x0C, 0x6A, 0x50, 0x20, 0x20, 0x0D, 0x0A, 0x87, 0x0A,
+        0x00, 0x00, 0x00, 0x00, 0x6A, 0x70, 0x32, 0x63,  // jp2c extending to the end
+    };
+    memcpy(jp2 + 20, image_info_codestream, sizeof(image_info_codestream));
+    assert(scan_index_markers(jp2, sizeof(jp2)) == (IMAGE_INFO_MARKER_TLM | IMAGE_INFO_MARKER_PLT));
+    assert(scan_index_markers(jp2, 20) == 0);
+
+    // Tile-part walk stops at Psot 0 and at a truncated segment
+    uint8_t truncated[sizeof(image_info_codestream)];
+    memcpy(truncated, image_info_codestream, sizeof(truncated));
+    truncated[23] = 0x00;  // Psot of the first tile-part
+    assert(scan_index_markers(truncated, sizeof(truncated)) == IMAGE_INFO_MARKER_TLM);
+    assert(scan_index_markers(image_info_codestream, 14) == IMAGE_INFO_MARKER_TLM);
+
+    // 4. Malloc failure
+    stub_malloc_should_fail = 1;
+    info = getImageInfo(dummy_data, 20);
+    stub_malloc_should_fail = 0;
+    assert(info == NULL);
+    assert(last_error == ERR_DECODE);
+
+    // 5. Session reports the header image area
+    uint8_t* data = (uint8_t*)malloc(20);
+    memset(data, 0, 20);
+    decode_session_t* session = openSession(data, 20);
+    assert(session != NULL);
+    stub_should_decode_succeed = 1;
+    uint8_t* result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 10, 10, 20, 20, 0);
+    assert(result != NULL);
+    free(result);
+    info = sessionGetImageInfo(session);
+    assert(info != NULL);
+    assert(info[IMAGE_INFO_IMAGE_X1] == 250);
+    assert(info[IMAGE_INFO_NUM_LAYERS] == 5);
+    assert(info[IMAGE_INFO_NUM_COMPONENTS] == 3);
+    free(info);
+    closeSession(session);
+    assert(sessionGetImageInfo(NULL) == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+
+    printf("Image Info Passed.\n");
+    stub_should_header_succeed = 0;
+    stub_should_decode_succeed = 0;
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_num_comps = 4;
+    stub_num_layers = 1;
+    stub_prog_order = 0;
+    stub_precision = 0;
+}
+
+void test_session() {
+    printf("Testing Session...\n");
+
+    // 1. Open failures leave the buffer with the caller
+    uint8_t small_data[5] = {0};
+    assert(openSession(small_data, 5) == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+
+    uint8_t* data = (uint8_t*)malloc(20);
+    memset(data, 0, 20);
+    stub_should_header_succeed = 0;
+    assert(openSession(data, 20) == NULL);
+    assert(last_error == ERR_HEADER);
+
+    // 2. Single-tile image: the header is read once for all requests
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 100;
+    stub_height = 80;
+    stub_read_header_count = 0;
+    decode_session_t* session = openSession(data, 20);
+    assert(session != NULL);
+    assert(stub_read_header_count == 1);
+
+    uint32_t* size = sessionGetSize(session);
+    assert(size != NULL && size[0] == 100 && size[1] == 80);
+    free(size);
+
+    uint8_t* result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 10, 10, 30, 20, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 20, 10);
+    free(result);
+
+    // A full decode after a region decode restores the whole area
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 100, 80);
+    free(result);
+
+    result = sessionDecodeToBmpWithRatio(session, 0, 100000, COLOR_FORMAT_RGB565, 0.5, 0.5, 1.0, 1.0, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 50, 40);
+    free(result);
+
+    // Reduction can be changed and reverted between requests
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 1);
+    assert(result != NULL);
+    assert(stub_last_resolution_factor == 1);
+    check_bmp_size(result, 50, 40);
+    free(result);
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result != NULL);
+    assert(stub_last_resolution_factor == 0);
+    check_bmp_size(result, 100, 80);
+    free(result);
+    assert(stub_read_header_count == 1);
+
+    // 3. Request validation does not invalidate the session
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 50, 50, 200, 200, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_REGION_OUT_OF_BOUNDS);
+    result = sessionDecodeToBmp(session, 100, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_PIXEL_DATA_SIZE);
+    result = sessionDecodeToBmp(session, 0, 40, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+    assert(stub_read_header_count == 1);
+
+    // 4. A failed decode re-reads the header on the next request
+    stub_should_decode_succeed = 0;
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result == NULL);
+    assert(last_error == ERR_DECODE);
+    stub_should_decode_succeed = 1;
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 10, 10, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 10, 10);
+    free(result);
+    assert(stub_read_header_count == 2);
+
+    closeSession(session);
+
+    // 5. Multi-tile image: every decode after the first re-reads the header
+    stub_width = 250;
+    stub_height = 130;
+    stub_tile_width = 100;
+    stub_tile_height = 100;
+    data = (uint8_t*)malloc(20);
+    memset(data, 0, 20);
+    stub_read_header_count = 0;
+    session = openSession(data, 20);
+    assert(session != NULL);
+
+    uint32_t* info = sessionGetTileInfo(session);
+    assert(info != NULL);
+    assert(info[TILE_INFO_NUM_TILES_X] == 3);
+    assert(info[TILE_INFO_NUM_TILES_Y] == 2);
+    free(info);
+
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result != NULL);
+    free(result);
+    assert(stub_read_header_count == 1);
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 250, 130);
+    free(result);
+    assert(stub_read_header_count == 2);
+
+    result = sessionDecodeTileToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 5, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 50, 30);
+    free(result);
+
+    closeSession(session);
+    closeSession(NULL);
+
+    // 6. NULL session
+    assert(sessionDecodeToBmp(NULL, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0) == NULL);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+    assert(sessionGetSize(NULL) == NULL);
+    assert(sessionGetTileInfo(NULL) == NULL);
+    assert(sessionDecodeTileToBmp(NULL, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0) == NULL);
+
+    printf("Session Passed.\n");
+    stub_should_header_succeed = 0;
+    stub_should_decode_succeed = 0;
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_last_decoded_tile = -1;
+}
+
+void test_session_quality_layers() {
+    printf("Testing Session Quality Layers...\n");
+    uint8_t* data = (uint8_t*)calloc(1, 20);
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 64;
+    stub_height = 64;
+    stub_num_layers = 5;
+    stub_num_resolutions = 4;
+    stub_read_header_count = 0;
+
+    decode_session_t* session = openSession(data, 20);
+    assert(session != NULL);
+    assert(stub_last_cp_layer == 0);
+    assert(sessionGetQualityLayers(session) == 5);
+    assert(sessionGetMaxReduce(session) == 3);
+
+    // 1. A layer limit re-opens the codec with cp_layer before the next decode
+    assert(sessionSetQualityLayers(session, 1) == 1);
+    assert(stub_read_header_count == 1);
+    uint8_t* result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 2);
+    assert(result != NULL);
+    check_bmp_size(result, 16, 16);
+    free(result);
+    assert(stub_last_cp_layer == 1);
+    assert(stub_read_header_count == 2);
+
+    // 2. The same limit keeps the parsed header
+    assert(sessionSetQualityLayers(session, 1) == 1);
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result != NULL);
+    check_bmp_size(result, 64, 64);
+    free(result);
+    assert(stub_read_header_count == 2);
+
+    // 3. 0 or more layers than available decodes all of them
+    assert(sessionSetQualityLayers(session, 9) == 5);
+    result = sessionDecodeToBmp(session, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(result != NULL);
+    free(result);
+    assert(stub_last_cp_layer == 0);
+    assert(stub_read_header_count == 3);
+    assert(sessionSetQualityLayers(session, 0) == 5);
+
+    // 4. NULL session
+    assert(sessionSetQualityLayers(NULL, 1) == 0);
+    assert(last_error == ERR_INPUT_DATA_SIZE);
+    assert(sessionGetQualityLayers(NULL) == 0);
+    assert(sessionGetMaxReduce(NULL) == 0);
+
+    closeSession(session);
+    stub_num_layers = 1;
+    stub_num_resolutions = 6;
+    printf("Session Quality Layers Passed.\n");
+}
+
+void test_decode_threads() {
+    printf("Testing Decode Threads...\n");
+    uint8_t dummy_data[20] = {0};
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 10;
+    stub_height = 10;
+
+    // 1. Default is single-threaded: the codec is left untouched
+    stub_last_codec_threads = 0;
+    uint8_t* result = decodeToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    free(result);
+    assert(stub_last_codec_threads == 0);
+
+    // 2. Requested thread count is applied to every new codec
+    assert(setDecodeThreads(4) == 4);
+    result = decodeToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    free(result);
+    assert(stub_last_codec_threads == 4);
+
+    stub_last_codec_threads = 0;
+    uint32_t* size = getSize(dummy_data, 20);
+    assert(size != NULL);
+    free(size);
+    assert(stub_last_codec_threads == 4);
+
+    // 3. Invalid counts and missing thread support fall back to one thread
+    assert(setDecodeThreads(0) == 1);
+    assert(setDecodeThreads(-3) == 1);
+    stub_has_thread_support = 0;
+    assert(setDecodeThreads(8) == 1);
+    stub_last_codec_threads = 0;
+    result = decodeToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    free(result);
+    assert(stub_last_codec_threads == 0);
+
+    printf("Decode Threads Passed.\n");
+    stub_has_thread_support = 1;
+    setDecodeThreads(1);
+    stub_should_header_succeed = 0;
+    stub_should_decode_succeed = 0;
+}
+
+void test_raw_output() {
+    printf("Testing Raw Output...\n");
+
+    assert(setOutputFormat(42) == OUTPUT_FORMAT_BMP);
+    assert(setOutputFormat(OUTPUT_FORMAT_RAW) == OUTPUT_FORMAT_RAW);
+
+    // 1. ARGB8888: premultiplied RGBA bytes after the header
+    opj_image_t* image = create_mock_image(3, 2, 4, 1);
+    for (int i = 0; i < 6; i++) {
+        image->comps[0].data[i] = 200;
+        image->comps[1].data[i] = 100;
+        image->comps[2].data[i] = 50;
+        image->comps[3].data[i] = (i == 0) ? 128 : 255;
+    }
+    uint8_t* raw = encode_output(image, COLOR_FORMAT_ARGB8888);
+    assert(raw != NULL);
+    uint32_t header[4];
+    memcpy(header, raw, sizeof(header));
+    assert(header[RAW_HEADER_WIDTH] == 3);
+    assert(header[RAW_HEADER_HEIGHT] == 2);
+    assert(header[RAW_HEADER_STRIDE] == 12);
+    assert(header[RAW_HEADER_COLOR_FORMAT] == COLOR_FORMAT_ARGB8888);
+    uint8_t* px = raw + RAW_HEADER_SIZE;
+    assert(px[0] == 100 && px[1] == 50 && px[2] == 25 && px[3] == 128);
+    assert(px[4] == 200 && px[5] == 100 && px[6] == 50 && px[7] == 255);
+    free(raw);
+
+    // 2. RGB565: tightly packed rows
+    raw = encode_output(image, COLOR_FORMAT_RGB565);
+    assert(raw != NULL);
+    memcpy(header, raw, sizeof(header));
+    assert(header[RAW_HEADER_STRIDE] == 6);
+    assert(header[RAW_HEADER_COLOR_FORMAT] == COLOR_FORMAT_RGB565);
+    uint16_t px565;
+    memcpy(&px565, raw + RAW_HEADER_SIZE + 2, 2);
+    assert(px565 == (((200 >> 3) << 11) | ((100 >> 2) << 5) | (50 >> 3)));
+    free(raw);
+
+    // 3. Malloc failure
+    stub_malloc_should_fail = 1;
+    raw = encode_output(image, COLOR_FORMAT_ARGB8888);
+    stub_malloc_should_fail = 0;
+    assert(raw == NULL);
+    assert(last_error == ERR_DECODE);
+    opj_image_destroy(image);
+
+    // 4. Decode exports honour the output format
+    uint8_t dummy_data[20] = {0};
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 10;
+    stub_height = 8;
+    raw = decodeToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 2, 2, 6, 4);
+    assert(raw != NULL);
+    memcpy(header, raw, sizeof(header));
+    assert(header[RAW_HEADER_WIDTH] == 4 && header[RAW_HEADER_HEIGHT] == 2);
+    free(raw);
+
+    setOutputFormat(OUTPUT_FORMAT_BMP);
+    raw = decodeToBmp(dummy_data, 20, 0, 100000, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(raw != NULL && raw[0] == 'B' && raw[1] == 'M');
+    free(raw);
+
+    printf("Raw Output Passed.\n");
+    stub_should_header_succeed = 0;
+    stub_should_decode_succeed = 0;
+}
+
+static void assert_near(int actual, double expected) {
+    if (expected < 0) expected = 0;
+    if (expected > 255) expected = 255;
+    double diff = actual - expected;
+    if (diff < -1.0 || diff > 1.0) {
+        printf("Expected %.2f, got %d\n", expected, actual);
+        assert(0);
+    }
+}
+
+void test_component_conversion() {
+    printf("Testing Component Conversion...\n");
+
+    // 1. 12-bit samples are scaled to 8 bits
+    opj_image_t* image = create_mock_image(3, 1, 3, 0);
+    for (int c = 0; c < 3; c++) image->comps[c].prec = 12;
+    image->comps[0].data[0] = 4095; image->comps[1].data[0] = 2048; image->comps[2].data[0] = 0;
+    image->comps[0].data[1] = 16;   image->comps[1].data[1] = 7;    image->comps[2].data[1] = 4088;
+    uint8_t* bmp = convert_image_to_bmp(image, COLOR_FORMAT_ARGB8888);
+    assert(bmp != NULL);
+    uint8_t* px = bmp + 54;
+    assert(px[0] == 0 && px[1] == 128 && px[2] == 255 && px[3] == 255);
+    assert(px[4] == 255 && px[5] == 0 && px[6] == 1);
+    free(bmp);
+    opj_image_destroy(image);
+
+    // 2. Signed samples are shifted to unsigned, low precisions are stretched to 8 bits
+    image = create_mock_image(3, 1, 1, 0);
+    image->comps[0].sgnd = 1;
+    image->comps[0].data[0] = -128; image->comps[0].data[1] = 0; image->comps[0].data[2] = 127;
+    bmp = convert_image_to_bmp(image, COLOR_FORMAT_ARGB8888);
+    assert(bmp != NULL);
+    px = bmp + 54;
+    assert(px[0] == 0 && px[4] == 128 && px[8] == 255);
+    free(bmp);
+    image->comps[0].sgnd = 0;
+    image->comps[0].prec = 4;
+    image->comps[0].data[0] = 15; image->comps[0].data[1] = 5; image->comps[0].data[2] = 0;
+    bmp = convert_image_to_bmp(image, COLOR_FORMAT_ARGB8888);
+    assert(bmp != NULL);
+    px = bmp + 54;
+    assert(px[0] == 255 && px[4] == 85 && px[8] == 0);
+    free(bmp);
+    opj_image_destroy(image);
+
+    // 3. 4:2:0 sYCC: chroma is upsampled and converted to RGB
+    image = create_mock_image(4, 4, 3, 0);
+    image->color_space = OPJ_CLRSPC_SYCC;
+    for (int c = 1; c < 3; c++) {
+        image->comps[c].dx = 2;
+        image->comps[c].dy = 2;
+        image->comps[c].w = 2;
+        image->comps[c].h = 2;
+    }
+    for (int i = 0; i < 16; i++) image->comps[0].data[i] = 128;
+    int32_t cb[4] = {128, 128, 60, 128};
+    int32_t cr[4] = {128, 200, 128, 40};
+    for (int i = 0; i < 4; i++) {
+        image->comps[1].data[i] = cb[i];
+        image->comps[2].data[i] = cr[i];
+    }
+    uint8_t* raw = convert_image_to_raw(image, COLOR_FORMAT_ARGB8888);
+    assert(raw != NULL);
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+            int block = (y / 2) * 2 + x / 2;
+            double u = cb[block] - 128.0;
+            double v = cr[block] - 128.0;
+            uint8_t* p = raw + RAW_HEADER_SIZE + (y * 4 + x) * 4;
+            assert_near(p[0], 128 + 1.402 * v);
+            assert_near(p[1], 128 - 0.344136 * u - 0.714136 * v);
+            assert_near(p[2], 128 + 1.772 * u);
+            assert(p[3] == 255);
+        }
+    }
+    free(raw);
+
+    // 4. An odd origin shifts which chroma sample each column uses
+    image->comps[0].x0 = 1;
+    image->comps[1].x0 = 1;
+    image->comps[2].x0 = 1;
+    plane_sampler_t sampler;
+    uint32_t x_map[4];
+    plane_sampler_init(&sampler, &image->comps[2], &image->comps[0], 4, x_map, 8);
+    assert(x_map[0] == 0 && x_map[1] == 0 && x_map[2] == 0 && x_map[3] == 1);
+    opj_image_destroy(image);
+
+    // 5. The per-row path matches the direct path, including the SIMD tails of every row
+    uint32_t width = 13, height = 3;
+    opj_image_t* direct = create_mock_image(width, height, 4, 1);
+    opj_image_t* wide = create_mock_image(width, height, 4, 1);
+    for (int c = 0; c < 4; c++) {
+        wide->comps[c].prec = 16;
+        for (uint32_t i = 0; i < width * height; i++) {
+            int32_t v = (int32_t)((i * 37 + c * 91) % 256);
+            direct->comps[c].data[i] = v;
+            wide->comps[c].data[i] = v << 8;
+        }
+    }
+    int formats[2] = {COLOR_FORMAT_ARGB8888, COLOR_FORMAT_RGB565};
+    for (int f = 0; f < 2; f++) {
+        // Row padding is not initialized, compare the pixels only
+        uint8_t* expected = convert_image_to_bmp(direct, formats[f]);
+        uint8_t* actual = convert_image_to_bmp(wide, formats[f]);
+        uint32_t offset = *(uint32_t*)(expected + 10);
+        uint32_t pixel_bytes = formats[f] == COLOR_FORMAT_RGB565 ? width * 2 : width * 4;
+        uint32_t row_bytes = (pixel_bytes + 3) & ~3u;
+        assert(*(uint32_t*)(expected + 2) == *(uint32_t*)(actual + 2));
+        for (uint32_t y = 0; y < height; y++) {
+            assert(memcmp(expected + offset + y * row_bytes, actual + offset + y * row_bytes, pixel_bytes) == 0);
+        }
+        free(expected);
+        free(actual);
+
+        expected = convert_image_to_raw(direct, formats[f]);
+        actual = convert_image_to_raw(wide, formats[f]);
+        uint32_t size = RAW_HEADER_SIZE + ((uint32_t*)expected)[RAW_HEADER_STRIDE] * height;
+        assert(memcmp(expected, actual, size) == 0);
+        free(expected);
+        free(actual);
+    }
+    opj_image_destroy(direct);
+
+    // 6. Scratch allocation failure
+    stub_malloc_should_fail = 1;
+    assert(convert_image_to_bmp(wide, COLOR_FORMAT_ARGB8888) == NULL);
+    assert(last_error == ERR_DECODE);
+    stub_malloc_should_fail = 0;
+    opj_image_destroy(wide);
+
+    printf("Component Conversion Passed.\n");
+}
+
 void check_decode_boundary(const char* test_name, uint8_t* data, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, int expected_error) {
     uint8_t* result = decodeToBmp(data, 20, 0, 1000, COLOR_FORMAT_ARGB8888, x0, y0, x1, y1);
     assert(result == NULL);
@@ -859,6 +1739,681 @@ void test_detailed_boundaries() {
     stub_should_header_succeed = 0;
 }
 
+// Reference per-pixel packing used to check the (possibly SIMD) kernels bit-exactly.
+static uint8_t ref_clamp(int32_t v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : (uint8_t)v);
+}
+
+static void ref_pack_bgra(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i * 4 + 0] = ref_clamp(b[i]);
+        dst[i * 4 + 1] = ref_clamp(g[i]);
+        dst[i * 4 + 2] = ref_clamp(r[i]);
+        dst[i * 4 + 3] = a ? ref_clamp(a[i]) : 0xFF;
+    }
+}
+
+static void ref_pack_rgba_premul(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t alpha = a ? ref_clamp(a[i]) : 0xFF;
+        dst[i * 4 + 0] = (uint8_t)((ref_clamp(r[i]) * alpha + 127) / 255);
+        dst[i * 4 + 1] = (uint8_t)((ref_clamp(g[i]) * alpha + 127) / 255);
+        dst[i * 4 + 2] = (uint8_t)((ref_clamp(b[i]) * alpha + 127) / 255);
+        dst[i * 4 + 3] = (uint8_t)alpha;
+    }
+}
+
+static void ref_pack_rgb565(const int32_t* r, const int32_t* g, const int32_t* b, uint16_t* dst, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = (uint16_t)(((ref_clamp(r[i]) >> 3) << 11) | ((ref_clamp(g[i]) >> 2) << 5) | (ref_clamp(b[i]) >> 3));
+    }
+}
+
+void test_pack_kernels_equivalence() {
+    printf("Testing Pack Kernels Equivalence (SIMD=%d)...\n", WRAPPER_USE_SIMD);
+    enum { MAX_COUNT = 67 };
+    int32_t planes[4][MAX_COUNT];
+    uint8_t expected[MAX_COUNT * 4];
+    uint8_t actual[MAX_COUNT * 4];
+
+    srand(1234);
+    for (int round = 0; round < 20; round++) {
+        // Include out-of-range samples so the clamping paths are exercised
+        for (int c = 0; c < 4; c++) {
+            for (int i = 0; i < MAX_COUNT; i++) {
+                planes[c][i] = (rand() % 1200) - 400;
+            }
+        }
+        planes[0][0] = INT32_MIN;
+        planes[1][1] = INT32_MAX;
+        planes[2][2] = 65536;
+
+        // Every length up to MAX_COUNT covers full vectors and all tail sizes
+        for (uint32_t count = 0; count <= MAX_COUNT; count++) {
+            const int32_t* layouts[4][4] = {
+                {planes[0], planes[0], planes[0], NULL},      // Gray
+                {planes[0], planes[0], planes[0], planes[1]}, // Gray + Alpha
+                {planes[0], planes[1], planes[2], NULL},      // RGB
+                {planes[0], planes[1], planes[2], planes[3]}, // RGBA
+            };
+            for (int l = 0; l < 4; l++) {
+                const int32_t** p = layouts[l];
+
+                memset(expected, 0xAA, sizeof(expected));
+                memset(actual, 0xAA, sizeof(actual));
+                ref_pack_bgra(p[0], p[1], p[2], p[3], expected, count);
+                pack_bgra(p[0], p[1], p[2], p[3], actual, count);
+                assert(memcmp(expected, actual, sizeof(actual)) == 0);
+
+                memset(expected, 0xAA, sizeof(expected));
+                memset(actual, 0xAA, sizeof(actual));
+                ref_pack_rgba_premul(p[0], p[1], p[2], p[3], expected, count);
+                pack_rgba_premul(p[0], p[1], p[2], p[3], actual, count);
+                assert(memcmp(expected, actual, sizeof(actual)) == 0);
+
+                memset(expected, 0xAA, sizeof(expected));
+                memset(actual, 0xAA, sizeof(actual));
+                ref_pack_rgb565(p[0], p[1], p[2], (uint16_t*)expected, count);
+                pack_rgb565(p[0], p[1], p[2], (uint16_t*)actual, count);
+                assert(memcmp(expected, actual, sizeof(actual)) == 0);
+            }
+        }
+    }
+
+    // Clamping: below zero saturates to 0, above 255 saturates to 255
+    int32_t low[1] = {-1};
+    int32_t high[1] = {256};
+    uint8_t px[4];
+    pack_bgra(high, low, high, NULL, px, 1);
+    assert(px[0] == 255 && px[1] == 0 && px[2] == 255 && px[3] == 255);
+    uint16_t px565;
+    pack_rgb565(high, low, high, &px565, 1);
+    assert(px565 == 0xF81F);
+
+    // Premultiplication rounds c * a / 255 to nearest for every color and alpha
+    for (uint32_t c = 0; c < 256; c++) {
+        for (uint32_t a = 0; a < 256; a++) {
+            assert(premultiply((uint8_t)c, (uint8_t)a) == (c * a + 127) / 255);
+        }
+    }
+
+    printf("Pack Kernels Equivalence Passed.\n");
+}
+
+void test_scratch_arena() {
+    printf("Testing Scratch Arena...\n");
+    uint8_t dummy_data[20] = {0};
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 64;
+    stub_height = 32;
+    stub_num_comps = 3;
+
+    assert(setScratchArena(1) == 1);
+
+    // 1. The first decode grows the arena
+    uint8_t* input = acquireInputBuffer(20);
+    assert(input != NULL);
+    memcpy(input, dummy_data, 20);
+    uint8_t* bmp = decodeToBmp(input, 20, 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    check_bmp_size(bmp, 64, 32);
+    releaseBuffer(bmp);
+    releaseBuffer(input);
+    uint32_t high_water = getScratchHighWaterMark();
+    assert(high_water == 2 * SCRATCH_MIN_CAPACITY);
+
+    // 2. Same-sized decodes reuse the buffers without allocating in the wrapper
+    stub_malloc_count = 0;
+    uint8_t* input2 = acquireInputBuffer(20);
+    uint8_t* bmp2 = decodeToBmp(input2, 20, 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(input2 == input);
+    assert(bmp2 == bmp);
+    assert(stub_malloc_count == 0);
+    releaseBuffer(bmp2);
+    releaseBuffer(input2);
+    assert(getScratchHighWaterMark() == high_water);
+
+    // 3. The conversion rows of non 8-bit images come from the arena as well
+    opj_image_t* image = create_mock_image(64, 32, 3, 0);
+    for (int c = 0; c < 3; c++) image->comps[c].prec = 12;
+    uint8_t* out = convert_image_to_bmp(image, COLOR_FORMAT_ARGB8888);
+    assert(out != NULL);
+    releaseBuffer(out);
+    stub_malloc_count = 0;
+    out = convert_image_to_bmp(image, COLOR_FORMAT_ARGB8888);
+    assert(out != NULL);
+    assert(stub_malloc_count == 0);
+    releaseBuffer(out);
+    opj_image_destroy(image);
+
+    // 4. Larger outputs grow the slot geometrically
+    stub_width = 1024;
+    stub_height = 256;
+    bmp = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    check_bmp_size(bmp, 1024, 256);
+    assert(scratch_slots[SCRATCH_SLOT_OUTPUT].capacity == 2 * 1024 * 1024);
+    assert(getScratchHighWaterMark() > high_water);
+
+    // 5. An output requested while the previous one is still held is a plain malloc block
+    bmp2 = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp2 != NULL && bmp2 != bmp);
+    check_bmp_size(bmp2, 1024, 256);
+    releaseBuffer(bmp2);
+    releaseBuffer(bmp);
+
+    // 6. Reset frees the idle buffers and keeps the held ones
+    uint8_t* held = acquireInputBuffer(20);
+    resetScratchArena();
+    assert(scratch_slots[SCRATCH_SLOT_OUTPUT].data == NULL);
+    assert(scratch_slots[SCRATCH_SLOT_ROWS].data == NULL);
+    assert(scratch_slots[SCRATCH_SLOT_INPUT].data == held);
+    assert(getScratchHighWaterMark() == SCRATCH_MIN_CAPACITY);
+    releaseBuffer(held);
+
+    // 7. Disabling frees the buffers, including the ones released afterwards
+    held = acquireInputBuffer(20);
+    assert(setScratchArena(0) == 0);
+    releaseBuffer(held);
+    assert(scratch_capacity() == 0);
+    stub_malloc_count = 0;
+    bmp = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    assert(stub_malloc_count == 1);
+    free(bmp);
+
+    stub_width = 0;
+    stub_height = 0;
+    stub_num_comps = 4;
+    stub_should_decode_succeed = 0;
+    stub_should_header_succeed = 0;
+    printf("Scratch Arena Passed.\n");
+}
+
+// Size of a decode result in the current output format
+static size_t output_size(const uint8_t* buffer) {
+    uint32_t header[RAW_HEADER_SIZE / 4];
+    if (output_format == OUTPUT_FORMAT_RAW) {
+        memcpy(header, buffer, RAW_HEADER_SIZE);
+        return RAW_HEADER_SIZE + (size_t)header[RAW_HEADER_STRIDE] * header[RAW_HEADER_HEIGHT];
+    }
+    memcpy(header, buffer + 2, 4);
+    return header[0];
+}
+
+// Decodes with and without tile streaming and checks that the outputs are identical.
+static void check_streamed_decode(uint8_t* data, uint32_t data_len, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t reduce, int expect_streamed) {
+    setTileStreaming(0);
+    uint8_t* expected = decodeToBmpReduced(data, data_len, 0, 1 << 24, color_format, x0, y0, x1, y1, reduce);
+    assert(expected != NULL);
+
+    setTileStreaming(1);
+    stub_read_tile_header_count = 0;
+    uint8_t* actual = decodeToBmpReduced(data, data_len, 0, 1 << 24, color_format, x0, y0, x1, y1, reduce);
+    assert(actual != NULL);
+    assert((stub_read_tile_header_count > 0) == expect_streamed);
+    assert(output_size(actual) == output_size(expected));
+    assert(memcmp(actual, expected, output_size(expected)) == 0);
+
+    free(expected);
+    free(actual);
+    setTileStreaming(0);
+}
+
+void test_tile_streaming() {
+    printf("Testing Tile Streaming...\n");
+    uint8_t dummy_data[20] = {0};
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_fill_pattern = 1;
+    stub_width = 50;
+    stub_height = 30;
+    stub_tile_width = 16;
+    stub_tile_height = 16;
+
+    assert(setTileStreaming(5) == 1);
+    assert(setTileStreaming(0) == 0);
+
+    // 1. Full image, regions over several tiles and reductions match the regular path
+    int formats[] = {COLOR_FORMAT_ARGB8888, COLOR_FORMAT_RGB565};
+    int comps[] = {1, 3, 4};
+    for (int o = 0; o < 2; o++) {
+        setOutputFormat(o == 0 ? OUTPUT_FORMAT_BMP : OUTPUT_FORMAT_RAW);
+        for (int c = 0; c < 3; c++) {
+            stub_num_comps = comps[c];
+            for (int f = 0; f < 2; f++) {
+                check_streamed_decode(dummy_data, 20, formats[f], 0, 0, 0, 0, 0, 1);
+                check_streamed_decode(dummy_data, 20, formats[f], 5, 3, 41, 29, 0, 1);
+                check_streamed_decode(dummy_data, 20, formats[f], 17, 0, 33, 30, 0, 1);
+                check_streamed_decode(dummy_data, 20, formats[f], 0, 0, 0, 0, 1, 1);
+                check_streamed_decode(dummy_data, 20, formats[f], 5, 3, 41, 29, 2, 1);
+            }
+        }
+    }
+    setOutputFormat(OUTPUT_FORMAT_BMP);
+    stub_num_comps = 3;
+
+    // 2. An area inside one tile keeps the regular path
+    check_streamed_decode(dummy_data, 20, COLOR_FORMAT_ARGB8888, 2, 2, 10, 10, 0, 0);
+
+    // 3. Decode failures are reported and nothing is returned
+    setTileStreaming(1);
+    stub_should_decode_succeed = 0;
+    assert(decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0) == NULL);
+    assert(last_error == ERR_DECODE);
+    stub_should_decode_succeed = 1;
+
+    // 4. The pixel limit applies to the requested area, not the tiles around it
+    assert(decodeToBmp(dummy_data, 20, 36 * 26 - 1, 1 << 24, COLOR_FORMAT_ARGB8888, 5, 3, 41, 29) == NULL);
+    assert(last_error == ERR_PIXEL_DATA_SIZE);
+    uint8_t* bmp = decodeToBmp(dummy_data, 20, 36 * 26, 1 << 24, COLOR_FORMAT_ARGB8888, 5, 3, 41, 29);
+    assert(bmp != NULL);
+    check_bmp_size(bmp, 36, 26);
+    free(bmp);
+
+    // 5. JP2 palettes and channel definitions are only applied by opj_decode()
+    uint8_t jp2[] = {
+        0x00, 0x00, 0x00, 0x0C, 'j', 'P', ' ', ' ', 0x0D, 0x0A, 0x87, 0x0A,
+        0x00, 0x00, 0x00, 0x14, 'f', 't', 'y', 'p', 'j', 'p', '2', ' ', 0, 0, 0, 0, 'j', 'p', '2', ' ',
+        0x00, 0x00, 0x00, 0x2E, 'j', 'p', '2', 'h',
+        0x00, 0x00, 0x00, 0x16, 'i', 'h', 'd', 'r', 0, 0, 0, 30, 0, 0, 0, 50, 0, 3, 7, 7, 0, 0,
+        0x00, 0x00, 0x00, 0x10, 'c', 'd', 'e', 'f', 0, 1, 0, 0, 0, 0, 0, 0,
+        0x00, 0x00, 0x00, 0x00, 'j', 'p', '2', 'c', 0, 0,
+    };
+    check_streamed_decode(jp2, sizeof(jp2), COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0, 0);
+    memcpy(&jp2[66], "colr", 4);
+    check_streamed_decode(jp2, sizeof(jp2), COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0, 1);
+    // A truncated box is left to the regular path
+    jp2[35] = 0xFF;
+    check_streamed_decode(jp2, sizeof(jp2), COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0, 0);
+
+    // 6. Sessions stream as well and re-read the header for the next request
+    setTileStreaming(1);
+    uint8_t* data = (uint8_t*)malloc(20);
+    memset(data, 0, 20);
+    decode_session_t* session = openSession(data, 20);
+    assert(session != NULL);
+    uint8_t* expected = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 5, 3, 41, 29);
+    assert(expected != NULL);
+    for (int i = 0; i < 2; i++) {
+        stub_read_header_count = 0;
+        stub_read_tile_header_count = 0;
+        uint8_t* result = sessionDecodeToBmp(session, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 5, 3, 41, 29, 0);
+        assert(result != NULL);
+        assert(stub_read_header_count == (i == 0 ? 0 : 1));
+        assert(stub_read_tile_header_count > 0);
+        assert(memcmp(result, expected, output_size(expected)) == 0);
+        free(result);
+    }
+    free(expected);
+    closeSession(session);
+
+    // 7. The tile data comes from the arena
+    assert(setScratchArena(1) == 1);
+    bmp = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    assert(scratch_slots[SCRATCH_SLOT_TILE].capacity > 0);
+    assert(!scratch_slots[SCRATCH_SLOT_TILE].in_use);
+    releaseBuffer(bmp);
+    setScratchArena(0);
+
+    setTileStreaming(0);
+    stub_fill_pattern = 0;
+    stub_width = 0;
+    stub_height = 0;
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_num_comps = 4;
+    stub_last_decoded_tile = -1;
+    stub_should_decode_succeed = 0;
+    stub_should_header_succeed = 0;
+    printf("Tile Streaming Passed.\n");
+}
+
+void test_cancellation() {
+    printf("Testing Cancellation...\n");
+    uint8_t dummy_data[20] = {0};
+
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 50;
+    stub_height = 30;
+    stub_num_comps = 3;
+
+    // 1. A cancelled request stops before the entropy decoding and stays cancelled until reset
+    resetCancellation(0);
+    assert(*getCancelFlagPtr() == 0);
+    requestCancel();
+    assert(*getCancelFlagPtr() != 0);
+    for (int i = 0; i < 2; i++) {
+        assert(decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0) == NULL);
+        assert(getLastError() == ERR_CANCELLED);
+    }
+    assert(decodeTileToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0) == NULL);
+    assert(getLastError() == ERR_CANCELLED);
+    resetCancellation(0);
+    uint8_t* bmp = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    free(bmp);
+
+    // 2. The conversion checks between strips of rows
+    opj_image_t* image = create_mock_image(4, CANCEL_CHECK_ROWS * 2, 3, 0);
+    requestCancel();
+    assert(convert_image(image, OUTPUT_FORMAT_BMP, COLOR_FORMAT_ARGB8888) == NULL);
+    assert(last_error == ERR_CANCELLED);
+    resetCancellation(0);
+    last_error = ERR_NONE;
+    bmp = convert_image(image, OUTPUT_FORMAT_BMP, COLOR_FORMAT_ARGB8888);
+    assert(bmp != NULL);
+    free(bmp);
+    opj_image_destroy(image);
+
+    // 3. A streamed decode stops at the next tile and releases its output from the arena
+    stub_tile_width = 16;
+    stub_tile_height = 16;
+    setTileStreaming(1);
+    assert(setScratchArena(1) == 1);
+    stub_cancel_after_tiles = 2;
+    stub_last_decoded_tile = -1;
+    assert(decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0) == NULL);
+    assert(getLastError() == ERR_CANCELLED);
+    assert(stub_last_decoded_tile == 1);
+    assert(!scratch_slots[SCRATCH_SLOT_OUTPUT].in_use);
+    setScratchArena(0);
+    setTileStreaming(0);
+
+    // 4. Sessions check before decoding
+    uint8_t* data = (uint8_t*)malloc(20);
+    memset(data, 0, 20);
+    decode_session_t* session = openSession(data, 20);
+    assert(session != NULL);
+    assert(sessionDecodeToBmp(session, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0) == NULL);
+    assert(getLastError() == ERR_CANCELLED);
+    resetCancellation(0);
+    bmp = sessionDecodeToBmp(session, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    free(bmp);
+    closeSession(session);
+
+    // 5. Deadline
+    resetCancellation(1);
+    usleep(5000);
+    assert(decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0) == NULL);
+    assert(getLastError() == ERR_DEADLINE_EXCEEDED);
+    resetCancellation(60000);
+    bmp = decodeToBmp(dummy_data, 20, 0, 1 << 24, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(bmp != NULL);
+    free(bmp);
+    resetCancellation(0);
+
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_width = 0;
+    stub_height = 0;
+    stub_num_comps = 4;
+    stub_last_decoded_tile = -1;
+    stub_should_decode_succeed = 0;
+    stub_should_header_succeed = 0;
+    printf("Cancellation Passed.\n");
+}
+
+void test_decode_stats() {
+    printf("Testing Decode Stats...\n");
+#if WRAPPER_USE_STATS
+    uint8_t data[64 * 10] = {0};
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 12;
+    stub_height = 12;
+    stub_tile_width = 4;
+    stub_tile_height = 4;
+    stub_main_header_size = 64;
+    stub_tile_part_size = 64;
+
+    // 1. A tile decode reads the main header and the tile-part of that tile only
+    uint8_t* result = decodeTileToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 4, 0);
+    assert(result != NULL);
+    const uint32_t* stats = getLastStats();
+    assert(stats != NULL);
+    assert(stats[STATS_TILES] == 1);
+    assert(stats[STATS_BYTES_READ] == 128);
+    assert(stats[STATS_ALLOCATIONS] >= 1);
+    assert(stats[STATS_ALLOCATED_BYTES] >= output_size(result));
+    free(result);
+
+    // 2. Regular path: the tiles of the decode area
+    result = decodeToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 5, 5, 10, 7);
+    assert(result != NULL);
+    assert(stats[STATS_TILES] == 2);
+    assert(stats[STATS_BYTES_READ] == 64 * 3);
+    free(result);
+
+    // 3. Streamed path: every tile decoded, including the ones outside the area that are skipped over
+    setTileStreaming(1);
+    result = decodeToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    assert(stats[STATS_TILES] == 9);
+    free(result);
+    setTileStreaming(0);
+
+    // 4. Reset by each call that reads an input; the arena reuses its buffers without allocating
+    assert(setScratchArena(1) == 1);
+    result = decodeToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    releaseBuffer(result);
+    result = decodeToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(stats[STATS_ALLOCATIONS] == 0);
+    assert(stats[STATS_ALLOCATED_BYTES] == 0);
+    releaseBuffer(result);
+    setScratchArena(0);
+    uint32_t* size = getSize(data, sizeof(data));
+    free(size);
+    assert(stats[STATS_TILES] == 0);
+    assert(stats[STATS_DECODE_US] == 0);
+    assert(stats[STATS_CONVERT_US] == 0);
+
+    stub_main_header_size = 0;
+    stub_tile_part_size = 0;
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_width = 0;
+    stub_height = 0;
+    stub_last_decoded_tile = -1;
+    stub_should_decode_succeed = 0;
+    stub_should_header_succeed = 0;
+#else
+    assert(getLastStats() == NULL);
+#endif
+    printf("Decode Stats Passed.\n");
+}
+
+void test_memory_tracking() {
+    printf("Testing Memory Tracking...\n");
+    uint8_t data[64 * 10] = {0};
+    stub_should_header_succeed = 1;
+    stub_should_decode_succeed = 1;
+    stub_width = 12;
+    stub_height = 12;
+    stub_tile_width = 4;
+    stub_tile_height = 4;
+
+    // 1. 4 components of 12x12 samples and one 4x4 tile of them, a 64x32 code-block, a ninth of the input
+    //    (9 tiles), a 12-pixel row for 4 planes and a 12x12 BMP
+    uint8_t* result = decodeToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    const uint32_t* stats = getLastMemoryStats();
+    uint32_t regular = (4 * 144 + 4 * 16) * 4 + 64 * 32 * 2 * 4 + 72 + 12 * 4 * 8 + output_size(result);
+    assert(stats[MEM_STATS_ESTIMATE] == regular);
+    // The allocator reuses freed blocks, so only the order of the samples is certain
+    assert(stats[MEM_STATS_PEAK] >= stats[MEM_STATS_START]);
+    assert(stats[MEM_STATS_PEAK] >= stats[MEM_STATS_CURRENT]);
+    free(result);
+
+    // 2. Streamed: no component planes for the area, three tiles' worth for OpenJPEG and the wrapper
+    setTileStreaming(1);
+    result = decodeToBmp(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    assert(stats[MEM_STATS_ESTIMATE] == regular - (4 * 144 + 4 * 16) * 4 + 4 * 16 * 3 * 4);
+    free(result);
+    setTileStreaming(0);
+
+    // 3. Reduced region: the estimate follows the decoded size
+    result = decodeToBmpReduced(data, sizeof(data), 0, 1 << 20, COLOR_FORMAT_RGB565, 0, 0, 8, 8, 1);
+    assert(result != NULL);
+    assert(stats[MEM_STATS_ESTIMATE] == (4 * 16 + 4 * 4) * 4 + 64 * 32 * 2 * 4 + 72 + 4 * 4 * 8 + output_size(result));
+    free(result);
+
+    // 4. Only the decode exports reset the statistics, and a rejected request has no estimate
+    uint32_t* size = getSize(data, sizeof(data));
+    free(size);
+    assert(stats[MEM_STATS_ESTIMATE] != 0);
+    assert(decodeToBmp(data, sizeof(data), 1, 1 << 20, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0) == NULL);
+    assert(getLastError() == ERR_PIXEL_DATA_SIZE);
+    assert(stats[MEM_STATS_ESTIMATE] == 0);
+
+    // 5. Single tile: OpenJPEG moves the tile buffer into the image, so the samples are counted once. A
+    //    decode whose estimate does not fit in max_heap_size still runs; only a failed grow rejects it.
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_width = 512;
+    stub_height = 512;
+    uint32_t max_heap_size = 1 << 20;
+#if defined(__wasm__)
+    // No room to grow at all
+    max_heap_size = (uint32_t)(__builtin_wasm_memory_size(0) * WASM_PAGE_SIZE);
+#endif
+    result = decodeToBmp(data, sizeof(data), 0, max_heap_size, COLOR_FORMAT_ARGB8888, 0, 0, 0, 0);
+    assert(result != NULL);
+    assert(stats[MEM_STATS_ESTIMATE] == 4 * 512 * 512 * 4 + 64 * 32 * 2 * 4 + sizeof(data) + 512 * 4 * 8 + output_size(result));
+    assert(stats[MEM_STATS_ESTIMATE] > (1 << 20));
+    free(result);
+
+    stub_tile_width = 0;
+    stub_tile_height = 0;
+    stub_width = 0;
+    stub_height = 0;
+    stub_should_decode_succeed = 0;
+    stub_should_header_succeed = 0;
+    printf("Memory Tracking Passed.\n");
+}
+
+// Checks a Base64 encode against the expected text and decodes it back.
+static void check_base64(const char* data, int alphabet, const char* expected) {
+    uint32_t size = (uint32_t)strlen(data);
+    char* text = base64Encode((const uint8_t*)data, size, alphabet);
+    assert(text != NULL);
+    assert(base64EncodedSize(size) == strlen(expected));
+    assert(memcmp(text, expected, strlen(expected)) == 0);
+
+    uint8_t decoded[64];
+    assert(base64Decode((const uint8_t*)text, base64EncodedSize(size), decoded) == (int32_t)size);
+    assert(memcmp(decoded, data, size) == 0);
+    releaseBuffer(text);
+}
+
+void test_base64() {
+    printf("Testing Base64...\n");
+
+    // 1. RFC 4648 test vectors and padding
+    check_base64("", 0, "");
+    check_base64("f", 0, "Zg==");
+    check_base64("fo", 0, "Zm8=");
+    check_base64("foo", 0, "Zm9v");
+    check_base64("foob", 0, "Zm9vYg==");
+    check_base64("fooba", 0, "Zm9vYmE=");
+    check_base64("foobar", 0, "Zm9vYmFy");
+
+    // 2. The alphabets differ only in the last two characters
+    check_base64("\xfb\xff\xfe", 0, "+//+");
+    check_base64("\xfb\xff\xfe", 1, "-__-");
+
+    // 3. Round trip of every length across the vector block sizes, both alphabets
+    uint8_t data[256];
+    for (int i = 0; i < 256; i++) data[i] = (uint8_t)(i * 167 + 13);
+    uint8_t decoded[256];
+    for (int alphabet = 0; alphabet <= 1; alphabet++) {
+        for (uint32_t size = 0; size <= 256; size++) {
+            char* text = base64Encode(data, size, alphabet);
+            assert(text != NULL);
+            uint32_t length = base64EncodedSize(size);
+            char expected[344];
+            assert(base64_encode_scalar(data, size, expected, base64_chars[alphabet]) == length);
+            assert(memcmp(text, expected, length) == 0);
+            assert(base64Decode((const uint8_t*)text, length, decoded) == (int32_t)size);
+            assert(memcmp(decoded, data, size) == 0);
+            releaseBuffer(text);
+        }
+    }
+
+    // 4. Decoding matches the scalar decoder on every length, also when the alphabets are mixed
+    uint8_t expected_bytes[256];
+    for (int alphabet = 0; alphabet <= 1; alphabet++) {
+        for (uint32_t size = 0; size <= 256; size++) {
+            char text[344];
+            uint32_t length = base64_encode_scalar(data, size, text, base64_chars[alphabet]);
+            for (uint32_t i = 0; i < length; i += 3) {
+                if (text[i] == '+' || text[i] == '-') text[i] = "+-"[i % 2];
+                if (text[i] == '/' || text[i] == '_') text[i] = "/_"[i % 2];
+            }
+            int64_t written = base64_decode_scalar((const uint8_t*)text, length, expected_bytes);
+            assert(written == (int64_t)size);
+            assert(base64Decode((const uint8_t*)text, length, decoded) == (int32_t)written);
+            assert(memcmp(decoded, expected_bytes, size) == 0);
+        }
+    }
+
+    // 5. A character outside both alphabets anywhere in a vector block is rejected, as by the scalar
+    //    decoder, for sizes of every remainder mod 3
+    const uint8_t bad_chars[] = { '*', '=', ' ', '.', 0x80, 0xFF, 0 };
+    for (int alphabet = 0; alphabet <= 1; alphabet++) {
+        for (uint32_t size = 60; size <= 62; size++) {
+            char text[84];
+            uint32_t length = base64_encode_scalar(data, size, text, base64_chars[alphabet]);
+            for (uint32_t pos = 0; pos < length; pos++) {
+                for (size_t b = 0; b < sizeof(bad_chars); b++) {
+                    // Padding is valid at the end of the text
+                    if (bad_chars[b] == '=' && pos >= length - 2) continue;
+                    char saved = text[pos];
+                    text[pos] = (char)bad_chars[b];
+                    assert(base64_decode_scalar((const uint8_t*)text, length, decoded) == -1);
+                    assert(base64Decode((const uint8_t*)text, length, decoded) == -1);
+                    assert(getLastError() == ERR_INPUT_DATA_SIZE);
+                    text[pos] = saved;
+                }
+            }
+        }
+    }
+
+    // 6. Unpadded text and mixed alphabets are accepted
+    assert(base64Decode((const uint8_t*)"Zm8", 3, decoded) == 2);
+    assert(memcmp(decoded, "fo", 2) == 0);
+    assert(base64Decode((const uint8_t*)"+/-_", 4, decoded) == 3);
+    assert(memcmp(decoded, "\xfb\xff\xbf", 3) == 0);
+
+    // 7. Malformed text
+    const char* invalid[] = { "Z", "Zm9vY", "Zm9v=", "Zg=v", "Zm9*", "Zg===", "Zm9vYmFyZm9vYmFyZm9vYmF!Zm9v" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        assert(base64Decode((const uint8_t*)invalid[i], (uint32_t)strlen(invalid[i]), decoded) == -1);
+        assert(getLastError() == ERR_INPUT_DATA_SIZE);
+    }
+
+    // 8. The text comes from its own arena slot and is reused
+    assert(setScratchArena(1) == 1);
+    char* text = base64Encode(data, 100, 0);
+    releaseBuffer(text);
+    stub_malloc_count = 0;
+    assert(base64Encode(data, 90, 0) == text);
+    assert(stub_malloc_count == 0);
+    releaseBuffer(text);
+    assert(acquireTextBuffer(40) == (uint8_t*)text);
+    releaseBuffer(text);
+    setScratchArena(0);
+
+    printf("Base64 Passed.\n");
+}
+
 int main() {
     test_argb8888();
     test_rgb565();
@@ -876,11 +2431,29 @@ int main() {
     test_full_decode_success();
     test_detailed_boundaries();
     test_opj_read_from_buffer();
+    test_opj_skip_and_seek_in_buffer();
     test_set_decode_area_failure();
     test_partial_pixel_limit();
     test_numcomps_zero();
     test_malloc_failure();
     test_alpha_by_flag();
     test_argb_no_alpha();
+    test_pack_kernels_equivalence();
+    test_reduced_decode();
+    test_tile_info();
+    test_decode_tile();
+    test_stream_reads_only_needed_tile_parts();
+    test_image_info();
+    test_session();
+    test_session_quality_layers();
+    test_decode_threads();
+    test_raw_output();
+    test_component_conversion();
+    test_scratch_arena();
+    test_tile_streaming();
+    test_cancellation();
+    test_decode_stats();
+    test_memory_tracking();
+    test_base64();
     return 0;
 }
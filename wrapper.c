@@ -2,7 +2,31 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#if defined(__EMSCRIPTEN__) || defined(__GLIBC__)
+#include <malloc.h>
+#endif
 #include <emscripten.h>
+#if defined(__wasm__)
+#include <unistd.h>
+#endif
+
+// SIMD pixel packing is used when building with -msimd128.
+// Define WRAPPER_DISABLE_SIMD to force the scalar kernels.
+#if defined(__wasm_simd128__) && !defined(WRAPPER_DISABLE_SIMD)
+#include <wasm_simd128.h>
+#define WRAPPER_USE_SIMD 1
+#else
+#define WRAPPER_USE_SIMD 0
+#endif
+
+// Per-stage decode statistics are recorded for getLastStats().
+// Define WRAPPER_DISABLE_STATS to compile the instrumentation out.
+#if !defined(WRAPPER_DISABLE_STATS)
+#define WRAPPER_USE_STATS 1
+#else
+#define WRAPPER_USE_STATS 0
+#endif
 
 // Error Codes
 #define ERR_NONE 0
@@ -12,20 +36,341 @@
 #define ERR_DECODE -4
 #define ERR_DECODER_SETUP -5
 #define ERR_REGION_OUT_OF_BOUNDS -6
+#define ERR_CANCELLED -7
+#define ERR_DEADLINE_EXCEEDED -8
+#define ERR_MEMORY_LIMIT -9
 
 #define MIN_INPUT_SIZE 12
 
+// Internal buffer of the memory stream. The data is already in memory, so the buffer only needs to
+// batch the small marker reads; tile-part reads larger than this go straight into OpenJPEG's buffers
+// and OpenJPEG never reads ahead into tile-parts it skips or seeks past.
+#define MEM_STREAM_BUFFER_SIZE 4096
+
 // Color Formats
 #define COLOR_FORMAT_RGB565 565
 #define COLOR_FORMAT_ARGB8888 8888
 
+// Output Formats
+#define OUTPUT_FORMAT_BMP 0
+// Pixels in Android Bitmap memory layout (premultiplied RGBA / RGB565) after a RAW_HEADER_SIZE header
+#define OUTPUT_FORMAT_RAW 1
+
+// Raw output header (uint32 each)
+#define RAW_HEADER_WIDTH 0
+#define RAW_HEADER_HEIGHT 1
+#define RAW_HEADER_STRIDE 2
+#define RAW_HEADER_COLOR_FORMAT 3
+#define RAW_HEADER_SIZE 16
+
 int last_error = ERR_NONE;
 
+// Number of threads OpenJPEG uses to decode code-blocks. Only effective when OpenJPEG is built
+// with thread support (native builds with pthreads, or a WASM threads build).
+static int decode_threads = 1;
+
+static int output_format = OUTPUT_FORMAT_BMP;
+
 EMSCRIPTEN_KEEPALIVE
 int getLastError() {
     return last_error;
 }
 
+// Selects the layout produced by the decode exports and returns the effective format.
+// Unknown formats fall back to BMP.
+EMSCRIPTEN_KEEPALIVE
+int setOutputFormat(int format) {
+    output_format = (format == OUTPUT_FORMAT_RAW) ? OUTPUT_FORMAT_RAW : OUTPUT_FORMAT_BMP;
+    return output_format;
+}
+
+// Sets the decode thread count used by subsequent decodes and returns the effective count.
+// Falls back to 1 when OpenJPEG has no thread support.
+EMSCRIPTEN_KEEPALIVE
+int setDecodeThreads(int thread_count) {
+    if (thread_count < 1 || !opj_has_thread_support()) thread_count = 1;
+    decode_threads = thread_count;
+    return decode_threads;
+}
+
+// Multi-tile areas are decoded and converted one tile at a time (see "Tile streaming").
+static int tile_streaming = 0;
+
+// Enables or disables tile streaming and returns the effective state.
+EMSCRIPTEN_KEEPALIVE
+int setTileStreaming(int enabled) {
+    tile_streaming = enabled ? 1 : 0;
+    return tile_streaming;
+}
+
+// Cancellation
+// A decode stops with ERR_CANCELLED once the flag is set, and with ERR_DEADLINE_EXCEEDED once the
+// monotonic clock passes the deadline. Both are checked before the entropy decoding, between the
+// tiles of a streamed decode and between the strips of the conversion, so a decode ends at the next
+// check point rather than immediately. The flag stays set until resetCancellation(), which callers
+// run before each request. The flag lives in linear memory, so an embedder on shared memory can set
+// it through getCancelFlagPtr() while a decode runs. The Android library runs one evaluation at a time
+// and cannot reach the flag mid-decode, so it only uses the deadline.
+#define CANCEL_CHECK_ROWS 64
+
+static volatile uint32_t cancel_flag = 0;
+// Absolute deadline in milliseconds of the monotonic clock, 0 for none
+static uint64_t deadline_ms = 0;
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static uint64_t monotonic_ms() {
+    return monotonic_us() / 1000;
+}
+
+// Returns 1 and sets last_error when the current request was cancelled or ran out of time.
+static int should_abort() {
+    if (cancel_flag) {
+        last_error = ERR_CANCELLED;
+        return 1;
+    }
+    if (deadline_ms > 0 && monotonic_ms() >= deadline_ms) {
+        last_error = ERR_DEADLINE_EXCEEDED;
+        return 1;
+    }
+    return 0;
+}
+
+// Asks the running or next decode to stop at its next check point.
+EMSCRIPTEN_KEEPALIVE
+void requestCancel() {
+    cancel_flag = 1;
+}
+
+// Returns the address of the cancellation flag (uint32, non-zero when cancelled).
+EMSCRIPTEN_KEEPALIVE
+volatile uint32_t* getCancelFlagPtr() {
+    return &cancel_flag;
+}
+
+// Clears the cancellation flag and starts a request that may run for timeout_ms milliseconds
+// (0 for no deadline).
+EMSCRIPTEN_KEEPALIVE
+void resetCancellation(uint32_t timeout_ms) {
+    cancel_flag = 0;
+    deadline_ms = timeout_ms > 0 ? monotonic_ms() + timeout_ms : 0;
+}
+
+// Decode statistics
+// Each decode export resets the statistics and records, in this layout (uint32 each):
+// the time spent reading the main header, in the OpenJPEG decode (tier-1, inverse DWT and MCT, which
+// OpenJPEG runs as one call) and in the conversion to the output, in microseconds; the tiles decoded;
+// the bytes read from the input stream; and the number and size of the buffers the wrapper allocated.
+// Session requests reuse the parsed header, so their header time is 0 unless the header is re-read.
+#define STATS_HEADER_US 0
+#define STATS_DECODE_US 1
+#define STATS_CONVERT_US 2
+#define STATS_TILES 3
+#define STATS_BYTES_READ 4
+#define STATS_ALLOCATIONS 5
+#define STATS_ALLOCATED_BYTES 6
+#define STATS_COUNT 7
+
+#if WRAPPER_USE_STATS
+static uint32_t decode_stats[STATS_COUNT];
+
+#define STATS_RESET() memset(decode_stats, 0, sizeof(decode_stats))
+#define STATS_ADD(field, value) (decode_stats[field] += (uint32_t)(value))
+#define STATS_TIMER_START(name) uint64_t name = monotonic_us()
+#define STATS_TIMER_STOP(field, name) STATS_ADD(field, monotonic_us() - (name))
+#else
+#define STATS_RESET() ((void)0)
+#define STATS_ADD(field, value) ((void)0)
+#define STATS_TIMER_START(name) ((void)0)
+#define STATS_TIMER_STOP(field, name) ((void)0)
+#endif
+
+// Returns the statistics of the last decode (STATS_COUNT uint32s), or NULL when the instrumentation
+// is compiled out. The buffer is overwritten by the next decode.
+EMSCRIPTEN_KEEPALIVE
+const uint32_t* getLastStats() {
+#if WRAPPER_USE_STATS
+    return decode_stats;
+#else
+    return NULL;
+#endif
+}
+
+// Memory tracking
+// OpenJPEG allocates with plain malloc, so instead of counting each allocation the decode exports sample
+// the bytes the allocator has in use: when they start, after the main header, after the OpenJPEG decode,
+// after the first streamed tile, once the output is written and when they return. Peaks that only last
+// inside opj_decode() are not seen. getLastMemoryStats() returns, in this layout (uint32 each): the bytes
+// in use when the last decode started, the largest sample, the bytes in use when it returned (the output
+// included), and the peak estimate_decode_peak() predicted from the main header (0 if the decode did
+// not get that far). Only the decode exports reset them.
+#define MEM_STATS_START 0
+#define MEM_STATS_PEAK 1
+#define MEM_STATS_CURRENT 2
+#define MEM_STATS_ESTIMATE 3
+#define MEM_STATS_COUNT 4
+
+static uint32_t mem_stats[MEM_STATS_COUNT];
+
+static size_t heap_in_use() {
+#if defined(__EMSCRIPTEN__)
+    return mallinfo().uordblks;
+#elif defined(__GLIBC__)
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static void mem_sample() {
+    size_t used = heap_in_use();
+    uint32_t value = used > UINT32_MAX ? UINT32_MAX : (uint32_t)used;
+    if (value > mem_stats[MEM_STATS_PEAK]) mem_stats[MEM_STATS_PEAK] = value;
+    mem_stats[MEM_STATS_CURRENT] = value;
+}
+
+static void mem_reset() {
+    memset(mem_stats, 0, sizeof(mem_stats));
+    mem_sample();
+    mem_stats[MEM_STATS_START] = mem_stats[MEM_STATS_CURRENT];
+}
+
+// Returns the memory statistics of the last decode (MEM_STATS_COUNT uint32s). The buffer is
+// overwritten by the next decode.
+EMSCRIPTEN_KEEPALIVE
+const uint32_t* getLastMemoryStats() {
+    return mem_stats;
+}
+
+// Scratch arena
+// Persistent buffers for the input copy, the output, the conversion rows, the streamed tile data and
+// the Base64 text, grown geometrically and reused by the following calls, so that decoding same-sized images does not
+// allocate in the wrapper and the heap is not fragmented by large short-lived blocks. Disabled by
+// default: the buffers returned by the decode exports are then plain malloc blocks. When enabled, they
+// must be released with releaseBuffer(). A slot that is still in use falls back to malloc.
+#define SCRATCH_SLOT_INPUT 0
+#define SCRATCH_SLOT_OUTPUT 1
+#define SCRATCH_SLOT_ROWS 2
+#define SCRATCH_SLOT_TILE 3
+#define SCRATCH_SLOT_TEXT 4
+#define SCRATCH_SLOT_COUNT 5
+
+#define SCRATCH_MIN_CAPACITY 65536
+
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+    int in_use;
+} scratch_slot_t;
+
+static int scratch_enabled = 0;
+static scratch_slot_t scratch_slots[SCRATCH_SLOT_COUNT];
+static size_t scratch_high_water = 0;
+
+static size_t scratch_capacity() {
+    size_t total = 0;
+    for (int i = 0; i < SCRATCH_SLOT_COUNT; i++) total += scratch_slots[i].capacity;
+    return total;
+}
+
+static void* scratch_alloc(int slot, size_t size) {
+    scratch_slot_t* s = &scratch_slots[slot];
+    if (!scratch_enabled || s->in_use) {
+        STATS_ADD(STATS_ALLOCATIONS, 1);
+        STATS_ADD(STATS_ALLOCATED_BYTES, size);
+        return malloc(size);
+    }
+
+    if (s->capacity < size) {
+        size_t capacity = s->capacity ? s->capacity : SCRATCH_MIN_CAPACITY;
+        while (capacity < size && capacity <= SIZE_MAX / 2) capacity *= 2;
+        if (capacity < size) capacity = size;
+
+        // The contents are not kept, so free first and let the allocator reuse the block
+        free(s->data);
+        STATS_ADD(STATS_ALLOCATIONS, 1);
+        STATS_ADD(STATS_ALLOCATED_BYTES, capacity);
+        s->data = (uint8_t*)malloc(capacity);
+        s->capacity = s->data ? capacity : 0;
+        if (!s->data) return NULL;
+
+        size_t total = scratch_capacity();
+        if (total > scratch_high_water) scratch_high_water = total;
+    }
+    s->in_use = 1;
+    return s->data;
+}
+
+static void scratch_free(void* ptr) {
+    if (!ptr) return;
+    for (int i = 0; i < SCRATCH_SLOT_COUNT; i++) {
+        scratch_slot_t* s = &scratch_slots[i];
+        if (s->data == ptr) {
+            s->in_use = 0;
+            // Released after the arena was disabled
+            if (!scratch_enabled) {
+                free(s->data);
+                s->data = NULL;
+                s->capacity = 0;
+            }
+            return;
+        }
+    }
+    free(ptr);
+}
+
+// Returns a buffer for the input of the decode exports, to be released with releaseBuffer().
+EMSCRIPTEN_KEEPALIVE
+uint8_t* acquireInputBuffer(uint32_t size) {
+    return (uint8_t*)scratch_alloc(SCRATCH_SLOT_INPUT, size > 0 ? size : 1);
+}
+
+// Returns a buffer for the Base64 text passed to base64Decode(), to be released with releaseBuffer().
+EMSCRIPTEN_KEEPALIVE
+uint8_t* acquireTextBuffer(uint32_t size) {
+    return (uint8_t*)scratch_alloc(SCRATCH_SLOT_TEXT, size > 0 ? size : 1);
+}
+
+// Releases a buffer from acquireInputBuffer(), acquireTextBuffer(), base64Encode() or a decode export:
+// arena buffers are kept for reuse, anything else is freed.
+EMSCRIPTEN_KEEPALIVE
+void releaseBuffer(void* ptr) {
+    scratch_free(ptr);
+}
+
+// Largest total capacity the arena held since the last reset, in bytes.
+EMSCRIPTEN_KEEPALIVE
+uint32_t getScratchHighWaterMark() {
+    return scratch_high_water > UINT32_MAX ? UINT32_MAX : (uint32_t)scratch_high_water;
+}
+
+// Frees the arena buffers that are not in use and restarts the high-water mark from what is left.
+EMSCRIPTEN_KEEPALIVE
+void resetScratchArena() {
+    for (int i = 0; i < SCRATCH_SLOT_COUNT; i++) {
+        scratch_slot_t* s = &scratch_slots[i];
+        if (s->in_use) continue;
+        free(s->data);
+        s->data = NULL;
+        s->capacity = 0;
+    }
+    scratch_high_water = scratch_capacity();
+}
+
+// Enables or disables the scratch arena and returns the effective state. Disabling it also releases
+// the idle buffers.
+EMSCRIPTEN_KEEPALIVE
+int setScratchArena(int enabled) {
+    scratch_enabled = enabled ? 1 : 0;
+    if (!scratch_enabled) resetScratchArena();
+    return scratch_enabled;
+}
+
 typedef struct {
     OPJ_BYTE* data;
     OPJ_SIZE_T size;
@@ -39,9 +384,33 @@ static OPJ_SIZE_T opj_read_from_buffer(void* p_buffer, OPJ_SIZE_T p_nb_bytes, vo
     if (p_info->offset + p_nb_bytes > p_info->size) l_nb_read = p_info->size - p_info->offset;
     memcpy(p_buffer, p_info->data + p_info->offset, l_nb_read);
     p_info->offset += l_nb_read;
+    STATS_ADD(STATS_BYTES_READ, l_nb_read);
     return l_nb_read;
 }
 
+// Moves the offset without touching the data. Returns the number of bytes skipped, or -1 when
+// already at the boundary in the direction of the skip.
+static OPJ_OFF_T opj_skip_in_buffer(OPJ_OFF_T p_nb_bytes, void* p_user_data) {
+    opj_buffer_info_t* p_info = (opj_buffer_info_t*)p_user_data;
+    if (p_nb_bytes < 0) {
+        if (p_info->offset == 0) return (OPJ_OFF_T)-1;
+        if ((OPJ_SIZE_T)-p_nb_bytes > p_info->offset) p_nb_bytes = -(OPJ_OFF_T)p_info->offset;
+    } else {
+        if (p_info->offset >= p_info->size) return (OPJ_OFF_T)-1;
+        if ((OPJ_SIZE_T)p_nb_bytes > p_info->size - p_info->offset) p_nb_bytes = (OPJ_OFF_T)(p_info->size - p_info->offset);
+    }
+    p_info->offset = (OPJ_SIZE_T)((OPJ_OFF_T)p_info->offset + p_nb_bytes);
+    return p_nb_bytes;
+}
+
+// Jumps to an absolute offset, used by OpenJPEG to go straight to a tile-part (TLM / SOT index).
+static OPJ_BOOL opj_seek_in_buffer(OPJ_OFF_T p_nb_bytes, void* p_user_data) {
+    opj_buffer_info_t* p_info = (opj_buffer_info_t*)p_user_data;
+    if (p_nb_bytes < 0 || (OPJ_SIZE_T)p_nb_bytes > p_info->size) return OPJ_FALSE;
+    p_info->offset = (OPJ_SIZE_T)p_nb_bytes;
+    return OPJ_TRUE;
+}
+
 static OPJ_CODEC_FORMAT get_codec_format(uint8_t* data, uint32_t data_len) {
     if (data_len >= 4 &&
         data[0] == 0x00 &&
@@ -53,138 +422,322 @@ static OPJ_CODEC_FORMAT get_codec_format(uint8_t* data, uint32_t data_len) {
     return OPJ_CODEC_J2K;
 }
 
-static opj_codec_t* create_decoder(OPJ_CODEC_FORMAT format) {
+// `layers` limits the number of quality layers decoded, 0 decodes all of them. OpenJPEG only takes
+// it before the header is read.
+static opj_codec_t* create_decoder(OPJ_CODEC_FORMAT format, uint32_t layers) {
     opj_codec_t* l_codec = opj_create_decompress(format);
     if (!l_codec) return NULL;
 
     opj_dparameters_t l_params;
     opj_set_default_decoder_parameters(&l_params);
+    l_params.cp_layer = layers;
     if (!opj_setup_decoder(l_codec, &l_params)) {
         opj_destroy_codec(l_codec);
         return NULL;
     }
+    // A failure leaves the codec single-threaded, which still decodes correctly.
+    if (decode_threads > 1) {
+        opj_codec_set_threads(l_codec, decode_threads);
+    }
     return l_codec;
 }
 
+static uint32_t ceil_div_pow2(uint32_t a, uint32_t b) {
+    return (uint32_t)(((uint64_t)a + ((uint64_t)1 << b) - 1) >> b);
+}
+
+static uint32_t ceil_div(uint32_t a, uint32_t b) {
+    return (uint32_t)(((uint64_t)a + b - 1) / b);
+}
+
+// Returns the largest resolution reduction the main header allows (numresolutions - 1 of the
+// component with the fewest levels).
+static uint32_t get_max_reduce(opj_codec_t* codec) {
+    opj_codestream_info_v2_t* info = opj_get_cstr_info(codec);
+    if (!info) return 0;
+
+    uint32_t max_reduce = 0;
+    if (info->m_default_tile_info.tccp_info && info->nbcomps > 0) {
+        uint32_t min_resolutions = UINT32_MAX;
+        for (uint32_t i = 0; i < info->nbcomps; i++) {
+            uint32_t resolutions = info->m_default_tile_info.tccp_info[i].numresolutions;
+            if (resolutions < min_resolutions) min_resolutions = resolutions;
+        }
+        if (min_resolutions > 0) max_reduce = min_resolutions - 1;
+    }
+    opj_destroy_cstr_info(&info);
+    return max_reduce;
+}
+
+// Discards the `reduce` highest resolution levels. Levels beyond max_reduce are clamped to the
+// smallest available resolution. Nothing is changed when the image already uses that factor.
+static int set_reduce(opj_codec_t* codec, opj_image_t* image, uint32_t reduce, uint32_t max_reduce) {
+    if (reduce > max_reduce) reduce = max_reduce;
+
+    uint32_t current = image->numcomps > 0 ? image->comps[0].factor : 0;
+    if (reduce == current) return 1;
+
+    if (!opj_set_decoded_resolution_factor(codec, reduce)) return 0;
+
+    // opj_set_decode_area() sizes the output components from their factor, which is only
+    // propagated to the image returned by opj_read_header() when cp_reduce is set up front.
+    for (uint32_t i = 0; i < image->numcomps; i++) {
+        image->comps[i].factor = reduce;
+    }
+    return 1;
+}
+
+static int apply_reduce(opj_codec_t* codec, opj_image_t* image, uint32_t reduce) {
+    if (reduce == 0) return 1;
+    return set_reduce(codec, image, reduce, get_max_reduce(codec));
+}
+
+// Resolves the requested region against the image area [ix0, ix1) x [iy0, iy1).
+// A region of all zeros means the whole image (*is_partial = 0).
+// Returns 0 when a partial region does not fit in the image area.
+static int resolve_region(uint32_t ix0, uint32_t iy0, uint32_t ix1, uint32_t iy1, double x0, double y0, double x1, double y1, int use_ratio,
+                          uint32_t* ux0, uint32_t* uy0, uint32_t* ux1, uint32_t* uy1, int* is_partial) {
+    uint32_t width = ix1 - ix0;
+    uint32_t height = iy1 - iy0;
+
+    if (use_ratio) {
+        *ux0 = (uint32_t)(width * x0);
+        *uy0 = (uint32_t)(height * y0);
+        *ux1 = (uint32_t)(width * x1);
+        *uy1 = (uint32_t)(height * y1);
+        if (*ux1 > width) *ux1 = width;
+        if (*uy1 > height) *uy1 = height;
+    } else {
+        *ux0 = (uint32_t)x0;
+        *uy0 = (uint32_t)y0;
+        *ux1 = (uint32_t)x1;
+        *uy1 = (uint32_t)y1;
+    }
+
+    // If x1 and y1 are 0, we assume full decode (no crop).
+    // For ratio, 0,0,0,0 resolves to the same thing, and 0.0,0.0,1.0,1.0 is an explicit full region.
+    *is_partial = (*ux1 != 0 || *uy1 != 0);
+    if (!*is_partial) return 1;
+
+    return !(*ux0 < ix0 || *uy0 < iy0 || *ux1 > ix1 || *uy1 > iy1 || *ux0 >= *ux1 || *uy0 >= *uy1);
+}
+
+// Number of output pixels of an area on the reference grid after discarding `factor` levels.
+static uint64_t reduced_pixel_count(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t factor) {
+    uint64_t w = ceil_div_pow2(x1, factor) - ceil_div_pow2(x0, factor);
+    uint64_t h = ceil_div_pow2(y1, factor) - ceil_div_pow2(y0, factor);
+    return w * h;
+}
+
 static opj_stream_t* create_mem_stream(opj_buffer_info_t* buffer_info, uint32_t data_len) {
-    opj_stream_t* l_stream = opj_stream_default_create(OPJ_TRUE);
+    opj_stream_t* l_stream = opj_stream_create(MEM_STREAM_BUFFER_SIZE, OPJ_TRUE);
     opj_stream_set_read_function(l_stream, opj_read_from_buffer);
+    opj_stream_set_skip_function(l_stream, opj_skip_in_buffer);
+    opj_stream_set_seek_function(l_stream, opj_seek_in_buffer);
     opj_stream_set_user_data(l_stream, buffer_info, NULL);
     opj_stream_set_user_data_length(l_stream, data_len);
     return l_stream;
 }
 
-static opj_image_t* decode_internal(uint8_t* data, uint32_t data_len, OPJ_CODEC_FORMAT format, uint32_t max_pixels, double x0, double y0, double x1, double y1, int use_ratio) {
-    last_error = ERR_NONE;
+// opj_read_header() recorded in the decode statistics
+static OPJ_BOOL read_header_timed(opj_stream_t* stream, opj_codec_t* codec, opj_image_t** image) {
+    STATS_TIMER_START(header_start);
+    OPJ_BOOL ok = opj_read_header(stream, codec, image);
+    STATS_TIMER_STOP(STATS_HEADER_US, header_start);
+    mem_sample();
+    return ok;
+}
 
-    opj_buffer_info_t buffer_info = {data, data_len, 0};
+// Index of the alpha component of a color image, or -1 if there is none.
+static int get_alpha_index(opj_image_t* image) {
+    if (image->numcomps <= 3) return -1;
+    for (uint32_t i = 0; i < image->numcomps; i++) {
+        if (image->comps[i].alpha != 0) return (int)i;
+    }
+    return 3;
+}
 
-    opj_codec_t* l_codec = create_decoder(format);
-    if (!l_codec) {
-        last_error = ERR_DECODER_SETUP;
-        return NULL;
+// Pixel packing kernels
+// Convert planar int32 components into interleaved output pixels.
+// Samples are clamped to [0, 255]; the SIMD and scalar paths produce identical output.
+// Grayscale is expressed by passing the same plane for r, g and b.
+// A NULL alpha plane means fully opaque.
+
+static inline uint8_t clamp_to_u8(int32_t v) {
+    if (v < 0) return 0;
+    if (v > 255) return 255;
+    return (uint8_t)v;
+}
+
+static void pack_bgra_scalar(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    if (a) {
+        for (uint32_t i = 0; i < count; i++) {
+            *dst++ = clamp_to_u8(b[i]);
+            *dst++ = clamp_to_u8(g[i]);
+            *dst++ = clamp_to_u8(r[i]);
+            *dst++ = clamp_to_u8(a[i]);
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            *dst++ = clamp_to_u8(b[i]);
+            *dst++ = clamp_to_u8(g[i]);
+            *dst++ = clamp_to_u8(r[i]);
+            *dst++ = 0xFF;
+        }
     }
+}
 
-    opj_stream_t* l_stream = create_mem_stream(&buffer_info, data_len);
+// Rounds c * a / 255 without a division.
+static inline uint8_t premultiply(uint8_t c, uint8_t a) {
+    uint32_t t = (uint32_t)c * a + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
 
-    opj_image_t* l_image = NULL;
-    if (!opj_read_header(l_stream, l_codec, &l_image)) {
-        last_error = ERR_HEADER;
+// Android ARGB_8888 memory layout: R, G, B, A bytes with premultiplied color.
+static void pack_rgba_premul_scalar(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    if (a) {
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t alpha = clamp_to_u8(a[i]);
+            *dst++ = premultiply(clamp_to_u8(r[i]), alpha);
+            *dst++ = premultiply(clamp_to_u8(g[i]), alpha);
+            *dst++ = premultiply(clamp_to_u8(b[i]), alpha);
+            *dst++ = alpha;
+        }
     } else {
-        uint32_t width = l_image->x1 - l_image->x0;
-        uint32_t height = l_image->y1 - l_image->y0;
+        for (uint32_t i = 0; i < count; i++) {
+            *dst++ = clamp_to_u8(r[i]);
+            *dst++ = clamp_to_u8(g[i]);
+            *dst++ = clamp_to_u8(b[i]);
+            *dst++ = 0xFF;
+        }
+    }
+}
 
-        uint32_t ux0, uy0, ux1, uy1;
-        if (use_ratio) {
-            ux0 = (uint32_t)(width * x0);
-            uy0 = (uint32_t)(height * y0);
-            ux1 = (uint32_t)(width * x1);
-            uy1 = (uint32_t)(height * y1);
-            if (ux1 > width) ux1 = width;
-            if (uy1 > height) uy1 = height;
-        } else {
-            ux0 = (uint32_t)x0;
-            uy0 = (uint32_t)y0;
-            ux1 = (uint32_t)x1;
-            uy1 = (uint32_t)y1;
-        }
-
-        // Check bounds if partial decoding is requested (x1 > 0 or y1 > 0)
-        // If x1 and y1 are 0, we assume full decode (no crop)
-        // Note: For ratio, x1/y1 will be > 0 if valid ratio passed.
-        // We need to handle 0,0,0,0 ratio as full decode too?
-        // Usually ratio 0.0 to 1.0 means 0 to width.
-        // If user passes 0,0,0,0 as ratio, it means empty region?
-        // But the previous API used 0,0,0,0 as 'full decode'.
-        // If use_ratio is true, we expect valid ratios.
-        // However, if we want full decode via ratio, we'd pass 0.0, 0.0, 1.0, 1.0.
-        // Let's stick to: if use_ratio is false, 0,0,0,0 means full.
-        // If use_ratio is true, 0,0,0,0 -> ux0=0, uy0=0, ux1=0, uy1=0 -> is_partial=0 -> full decode.
-        // So it works out.
-
-        int is_partial = (ux1 != 0 || uy1 != 0);
-        int bounds_ok = 1;
-
-        if (is_partial) {
-             if (ux0 < l_image->x0 || uy0 < l_image->y0 || ux1 > l_image->x1 || uy1 > l_image->y1 || ux0 >= ux1 || uy0 >= uy1) {
-                 bounds_ok = 0;
-             } else {
-                 if (!opj_set_decode_area(l_codec, l_image, ux0, uy0, ux1, uy1)) {
-                     // Should not happen if bounds are ok, but safety check
-                     bounds_ok = 0;
-                 }
-             }
-        }
-        
-        if (!bounds_ok) {
-            last_error = ERR_REGION_OUT_OF_BOUNDS;
-            opj_image_destroy(l_image);
-            l_image = NULL;
-        } else if (max_pixels > 0 && ((uint64_t)width * height) > max_pixels) {
-            uint32_t output_width = is_partial ? (ux1 - ux0) : width;
-            uint32_t output_height = is_partial ? (uy1 - uy0) : height;
+static void pack_rgb565_scalar(const int32_t* r, const int32_t* g, const int32_t* b, uint16_t* dst, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t r5 = clamp_to_u8(r[i]) >> 3;
+        uint16_t g6 = clamp_to_u8(g[i]) >> 2;
+        uint16_t b5 = clamp_to_u8(b[i]) >> 3;
+        dst[i] = (r5 << 11) | (g6 << 5) | b5;
+    }
+}
 
-            if (((uint64_t)output_width * output_height) > max_pixels) {
-                last_error = ERR_PIXEL_DATA_SIZE;
-                opj_image_destroy(l_image);
-                l_image = NULL;
-            } else if (!opj_decode(l_codec, l_stream, l_image)) {
-                last_error = ERR_DECODE;
-                opj_image_destroy(l_image);
-                l_image = NULL;
+#if WRAPPER_USE_SIMD
+// Loads 8 int32 samples and narrows them to i16 with signed saturation.
+static inline v128_t load_narrow_i16x8(const int32_t* src) {
+    return wasm_i16x8_narrow_i32x4(wasm_v128_load(src), wasm_v128_load(src + 4));
+}
+
+// Interleaves 8 pixels of B, G, R, A (i16 lanes) into 32 bytes of BGRA.
+// The unsigned narrow saturates to [0, 255], which completes the clamp.
+static inline void store_bgra_x8(uint8_t* dst, v128_t b16, v128_t g16, v128_t r16, v128_t a16) {
+    v128_t bg = wasm_u8x16_narrow_i16x8(b16, g16);
+    v128_t ra = wasm_u8x16_narrow_i16x8(r16, a16);
+    wasm_v128_store(dst, wasm_i8x16_shuffle(bg, ra, 0, 8, 16, 24, 1, 9, 17, 25, 2, 10, 18, 26, 3, 11, 19, 27));
+    wasm_v128_store(dst + 16, wasm_i8x16_shuffle(bg, ra, 4, 12, 20, 28, 5, 13, 21, 29, 6, 14, 22, 30, 7, 15, 23, 31));
+}
+
+static void pack_bgra(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    const v128_t opaque = wasm_i16x8_splat(0xFF);
+    uint32_t i = 0;
+
+    if (r == g && g == b) {
+        if (a) {
+            for (; i + 8 <= count; i += 8, dst += 32) {
+                v128_t v = load_narrow_i16x8(r + i);
+                store_bgra_x8(dst, v, v, v, load_narrow_i16x8(a + i));
             }
-        } else if (!opj_decode(l_codec, l_stream, l_image)) {
-            last_error = ERR_DECODE;
-            opj_image_destroy(l_image);
-            l_image = NULL;
+        } else {
+            for (; i + 8 <= count; i += 8, dst += 32) {
+                v128_t v = load_narrow_i16x8(r + i);
+                store_bgra_x8(dst, v, v, v, opaque);
+            }
+        }
+    } else if (a) {
+        for (; i + 8 <= count; i += 8, dst += 32) {
+            store_bgra_x8(dst, load_narrow_i16x8(b + i), load_narrow_i16x8(g + i), load_narrow_i16x8(r + i), load_narrow_i16x8(a + i));
+        }
+    } else {
+        for (; i + 8 <= count; i += 8, dst += 32) {
+            store_bgra_x8(dst, load_narrow_i16x8(b + i), load_narrow_i16x8(g + i), load_narrow_i16x8(r + i), opaque);
         }
     }
-    opj_stream_destroy(l_stream);
-    opj_destroy_codec(l_codec);
-    
-    return l_image;
+
+    pack_bgra_scalar(r + i, g + i, b + i, a ? a + i : NULL, dst, count - i);
 }
 
-static opj_image_t* decode_opj_common(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, int use_ratio) {
-    uint32_t divider = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
-    uint32_t max_input_size = max_heap_size / divider;
+static inline v128_t clamp_u8_i16x8(v128_t v) {
+    return wasm_i16x8_min(wasm_i16x8_max(v, wasm_i16x8_splat(0)), wasm_i16x8_splat(0xFF));
+}
 
-    if (!data || data_len < MIN_INPUT_SIZE || data_len > max_input_size) {
-        last_error = ERR_INPUT_DATA_SIZE;
-        return NULL;
+// Same rounding as premultiply(). Lanes hold [0, 255], so c * a + 128 fits in u16.
+static inline v128_t premultiply_x8(v128_t c16, v128_t a16) {
+    v128_t t = wasm_i16x8_add(wasm_i16x8_mul(c16, a16), wasm_i16x8_splat(128));
+    return wasm_u16x8_shr(wasm_i16x8_add(t, wasm_u16x8_shr(t, 8)), 8);
+}
+
+static void pack_rgba_premul(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    uint32_t i = 0;
+
+    if (a) {
+        for (; i + 8 <= count; i += 8, dst += 32) {
+            v128_t a16 = clamp_u8_i16x8(load_narrow_i16x8(a + i));
+            v128_t r16 = premultiply_x8(clamp_u8_i16x8(load_narrow_i16x8(r + i)), a16);
+            v128_t g16 = premultiply_x8(clamp_u8_i16x8(load_narrow_i16x8(g + i)), a16);
+            v128_t b16 = premultiply_x8(clamp_u8_i16x8(load_narrow_i16x8(b + i)), a16);
+            store_bgra_x8(dst, r16, g16, b16, a16);
+        }
+    } else {
+        // Opaque pixels need no premultiplication, only the channel order differs from BMP.
+        const v128_t opaque = wasm_i16x8_splat(0xFF);
+        for (; i + 8 <= count; i += 8, dst += 32) {
+            store_bgra_x8(dst, load_narrow_i16x8(r + i), load_narrow_i16x8(g + i), load_narrow_i16x8(b + i), opaque);
+        }
     }
 
-    OPJ_CODEC_FORMAT format = get_codec_format(data, data_len);
-    return decode_internal(data, data_len, format, max_pixels, x0, y0, x1, y1, use_ratio);
+    pack_rgba_premul_scalar(r + i, g + i, b + i, a ? a + i : NULL, dst, count - i);
 }
 
-static int32_t* get_alpha_component(opj_image_t* image) {
-    if (image->numcomps <= 3) return NULL;
-    for (uint32_t i = 0; i < image->numcomps; i++) {
-        if (image->comps[i].alpha != 0) return image->comps[i].data;
+// Packs 8 pixels (i16 lanes) into RGB565.
+static inline v128_t pack_rgb565_x8(v128_t r16, v128_t g16, v128_t b16) {
+    r16 = clamp_u8_i16x8(r16);
+    g16 = clamp_u8_i16x8(g16);
+    b16 = clamp_u8_i16x8(b16);
+    v128_t r = wasm_i16x8_shl(wasm_v128_and(r16, wasm_i16x8_splat(0xF8)), 8);
+    v128_t g = wasm_i16x8_shl(wasm_v128_and(g16, wasm_i16x8_splat(0xFC)), 3);
+    v128_t b = wasm_u16x8_shr(b16, 3);
+    return wasm_v128_or(wasm_v128_or(r, g), b);
+}
+
+static void pack_rgb565(const int32_t* r, const int32_t* g, const int32_t* b, uint16_t* dst, uint32_t count) {
+    uint32_t i = 0;
+
+    if (r == g && g == b) {
+        for (; i + 8 <= count; i += 8) {
+            v128_t v = load_narrow_i16x8(r + i);
+            wasm_v128_store(dst + i, pack_rgb565_x8(v, v, v));
+        }
+    } else {
+        for (; i + 8 <= count; i += 8) {
+            wasm_v128_store(dst + i, pack_rgb565_x8(load_narrow_i16x8(r + i), load_narrow_i16x8(g + i), load_narrow_i16x8(b + i)));
+        }
     }
-    return image->comps[3].data;
+
+    pack_rgb565_scalar(r + i, g + i, b + i, dst + i, count - i);
+}
+#else
+static void pack_bgra(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    pack_bgra_scalar(r, g, b, a, dst, count);
+}
+
+static void pack_rgb565(const int32_t* r, const int32_t* g, const int32_t* b, uint16_t* dst, uint32_t count) {
+    pack_rgb565_scalar(r, g, b, dst, count);
+}
+
+static void pack_rgba_premul(const int32_t* r, const int32_t* g, const int32_t* b, const int32_t* a, uint8_t* dst, uint32_t count) {
+    pack_rgba_premul_scalar(r, g, b, a, dst, count);
 }
+#endif
 
 static void write_headers_argb8888(uint8_t* buffer, uint32_t file_size, uint32_t width, uint32_t height) {
     uint32_t bmp_header_size = 14;
@@ -265,128 +818,908 @@ static void write_headers_rgb565(uint8_t* buffer, uint32_t file_size, uint32_t w
     memcpy(&buffer[62], &b_mask, 4);
 }
 
-static uint8_t* convert_image_to_bmp(opj_image_t* image, int color_format) {
-    uint32_t width = image->x1 - image->x0;
-    uint32_t height = image->y1 - image->y0;
+// Pixel source
+// Feeds the packing kernels one output row at a time. Images whose components are all 8-bit
+// unsigned at full resolution are read in place. Anything else (subsampled components, other
+// precisions, signed samples, sYCC) goes through a single pass per row that upsamples, converts
+// YCC to RGB and scales to 8 bits into a small scratch row, which the kernels then pack while it
+// is still in cache.
 
-    if (image->numcomps < 1) {
-        last_error = ERR_DECODE;
-        return NULL;
-    }
+// Fixed point (16 bit) ITU-R BT.601 YCbCr to RGB factors, as used by OpenJPEG's sycc_to_rgb.
+#define YCC_CR_TO_R 91881   // 1.402
+#define YCC_CB_TO_G 22554   // 0.344136
+#define YCC_CR_TO_G 46802   // 0.714136
+#define YCC_CB_TO_B 116130  // 1.772
 
-    int32_t* r_data = NULL;
-    int32_t* g_data = NULL;
-    int32_t* b_data = NULL;
-    int32_t* a_data = NULL;
+#define PIXEL_SOURCE_MAX_PLANES 4
 
-    if (image->numcomps == 1) {
-        r_data = image->comps[0].data;
-        g_data = image->comps[0].data;
-        b_data = image->comps[0].data;
-    } else if (image->numcomps == 2) {
-        r_data = image->comps[0].data;
-        g_data = image->comps[0].data;
-        b_data = image->comps[0].data;
-        if (image->comps[1].alpha != 0) {
-            a_data = image->comps[1].data;
-        }
-    } else {
-        r_data = image->comps[0].data;
-        g_data = image->comps[1].data;
-        b_data = image->comps[2].data;
-        a_data = get_alpha_component(image);
-    }
+// Maps one component onto the output grid (the resolution of component 0) and into 8 bits.
+typedef struct {
+    const int32_t* data;
+    uint32_t w;
+    uint32_t h;
+    uint32_t* x_map;       // Source column of each output column
+    uint64_t origin_y;     // Output grid origin, in units of the output row spacing
+    uint32_t dy_out;
+    uint32_t dy;
+    uint32_t comp_y0;      // Component origin at the decoded resolution
+    int32_t sign_offset;   // Makes signed samples unsigned
+    int32_t half;          // Zero level of a chroma sample
+    int64_t scale_mul;     // out = (v * scale_mul + scale_round) >> scale_shift
+    int64_t scale_round;
+    uint32_t scale_shift;
+} plane_sampler_t;
 
-    uint8_t* bmp_buffer = NULL;
+typedef struct {
+    int direct;
+    int ycc;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_color_planes;  // 1 for gray, 3 for color
+    int has_alpha;
+    int32_t* planes[PIXEL_SOURCE_MAX_PLANES];  // Direct mode: R, G, B, A planes
+    plane_sampler_t samplers[PIXEL_SOURCE_MAX_PLANES];
+    int32_t* rows;         // Scratch: one row per plane
+    uint32_t* x_maps;
+} pixel_source_t;
 
-    if (color_format == COLOR_FORMAT_RGB565) {
-        // RGB565: 2 bytes per pixel. Rows padded to 4 bytes.
-        uint32_t row_bytes = (width * 2 + 3) & ~3;
-        uint32_t pixel_data_size = row_bytes * height;
-        uint32_t header_size = 14 + 40 + 12; // Header + DIB + Masks
-        uint32_t file_size = header_size + pixel_data_size;
+// OpenJPEG always sets these; a zero means the image was built without them (e.g. tests), in
+// which case 8-bit full resolution is assumed.
+static inline uint32_t comp_prec(const opj_image_comp_t* comp) {
+    return comp->prec ? comp->prec : 8;
+}
 
-        bmp_buffer = (uint8_t*)malloc(file_size);
-        if (!bmp_buffer) {
-            last_error = ERR_DECODE;
-            return NULL;
-        }
+static inline uint32_t comp_dx(const opj_image_comp_t* comp) {
+    return comp->dx ? comp->dx : 1;
+}
 
-        write_headers_rgb565(bmp_buffer, file_size, width, height);
+static inline uint32_t comp_dy(const opj_image_comp_t* comp) {
+    return comp->dy ? comp->dy : 1;
+}
 
-        uint8_t* ptr = bmp_buffer + header_size;
-        for (uint32_t y = 0; y < height; y++) {
-            uint16_t* row_ptr = (uint16_t*)ptr;
-            for (uint32_t x = 0; x < width; x++) {
-                uint32_t idx = y * width + x;
-                uint16_t r = ((uint16_t)r_data[idx] >> 3) & 0x1F;
-                uint16_t g = ((uint16_t)g_data[idx] >> 2) & 0x3F;
-                uint16_t b = ((uint16_t)b_data[idx] >> 3) & 0x1F;
-                row_ptr[x] = (r << 11) | (g << 5) | b;
-            }
-            ptr += row_bytes;
-        }
+// Maps the image components to R, G, B and optional alpha. Gray images use the same component for
+// R, G and B. Returns the number of components used and -1 in alpha_index when there is no alpha.
+static uint32_t select_components(opj_image_t* image, uint32_t comp_index[3], int* alpha_index) {
+    *alpha_index = -1;
+    if (image->numcomps <= 2) {
+        comp_index[0] = comp_index[1] = comp_index[2] = 0;
+        if (image->numcomps == 2 && image->comps[1].alpha != 0) *alpha_index = 1;
+        return 1;
+    }
+    comp_index[0] = 0;
+    comp_index[1] = 1;
+    comp_index[2] = 2;
+    *alpha_index = get_alpha_index(image);
+    return 3;
+}
 
-    } else {
-        // ARGB8888: 4 bytes per pixel. Rows always aligned to 4.
-        uint32_t row_bytes = width * 4;
-        uint32_t pixel_data_size = row_bytes * height;
-        uint32_t header_size = 14 + 40;
-        uint32_t file_size = header_size + pixel_data_size;
-
-        bmp_buffer = (uint8_t*)malloc(file_size);
-        if (!bmp_buffer) {
-            last_error = ERR_DECODE;
-            return NULL;
-        }
+static int is_direct_component(const opj_image_comp_t* comp, const opj_image_comp_t* ref) {
+    return comp->w == ref->w && comp->h == ref->h &&
+           comp_dx(comp) == comp_dx(ref) && comp_dy(comp) == comp_dy(ref) &&
+           comp_prec(comp) == 8 && !comp->sgnd;
+}
 
-        write_headers_argb8888(bmp_buffer, file_size, width, height);
+static void plane_sampler_init(plane_sampler_t* sampler, const opj_image_comp_t* comp, const opj_image_comp_t* ref,
+                               uint32_t width, uint32_t* x_map, uint32_t prec) {
+    uint32_t dx = comp_dx(comp);
+    uint64_t origin_x = ceil_div_pow2(ref->x0, ref->factor);
+    uint32_t comp_x0 = ceil_div_pow2(comp->x0, comp->factor);
+    for (uint32_t i = 0; i < width; i++) {
+        uint64_t sx = (origin_x + i) * comp_dx(ref) / dx;
+        sx = sx > comp_x0 ? sx - comp_x0 : 0;
+        x_map[i] = sx < comp->w ? (uint32_t)sx : comp->w - 1;
+    }
 
-        uint8_t* ptr = bmp_buffer + header_size;
-        if (a_data) {
-            for (uint32_t i = 0; i < width * height; i++) {
-                *ptr++ = (uint8_t)b_data[i];
-                *ptr++ = (uint8_t)g_data[i];
-                *ptr++ = (uint8_t)r_data[i];
-                *ptr++ = (uint8_t)a_data[i];
-            }
-        } else {
-            for (uint32_t i = 0; i < width * height; i++) {
-                *ptr++ = (uint8_t)b_data[i];
-                *ptr++ = (uint8_t)g_data[i];
-                *ptr++ = (uint8_t)r_data[i];
-                *ptr++ = 0xFF;
-            }
-        }
+    sampler->data = comp->data;
+    sampler->w = comp->w;
+    sampler->h = comp->h;
+    sampler->x_map = x_map;
+    sampler->origin_y = ceil_div_pow2(ref->y0, ref->factor);
+    sampler->dy_out = comp_dy(ref);
+    sampler->dy = comp_dy(comp);
+    sampler->comp_y0 = ceil_div_pow2(comp->y0, comp->factor);
+
+    uint32_t comp_bits = comp_prec(comp);
+    sampler->sign_offset = comp->sgnd ? (int32_t)(1u << (comp_bits - 1)) : 0;
+    sampler->half = (int32_t)(1u << (comp_bits - 1));
+
+    // prec is the precision of the output channel, which is the luma precision for YCC
+    if (prec > 8) {
+        sampler->scale_mul = 1;
+        sampler->scale_shift = prec - 8;
+        sampler->scale_round = (int64_t)1 << (sampler->scale_shift - 1);
+    } else if (prec < 8) {
+        sampler->scale_mul = ((int64_t)255 << 16) / ((1 << prec) - 1);
+        sampler->scale_shift = 16;
+        sampler->scale_round = (int64_t)1 << 15;
+    } else {
+        sampler->scale_mul = 1;
+        sampler->scale_shift = 0;
+        sampler->scale_round = 0;
     }
-    return bmp_buffer;
 }
 
-EMSCRIPTEN_KEEPALIVE
-uint8_t* decodeToBmp(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
-    opj_image_t* image = decode_opj_common(data, data_len, max_pixels, max_heap_size, color_format, (double)x0, (double)y0, (double)x1, (double)y1, 0);
-    if (!image) return NULL;
-
-    uint8_t* bmp_buffer = convert_image_to_bmp(image, color_format);
+static inline const int32_t* plane_sampler_row(const plane_sampler_t* sampler, uint32_t y) {
+    uint64_t sy = (sampler->origin_y + y) * sampler->dy_out / sampler->dy;
+    sy = sy > sampler->comp_y0 ? sy - sampler->comp_y0 : 0;
+    if (sy >= sampler->h) sy = sampler->h - 1;
+    return sampler->data + (size_t)sy * sampler->w;
+}
 
-    opj_image_destroy(image);
-    return bmp_buffer;
+static inline int32_t plane_sampler_scale(const plane_sampler_t* sampler, int64_t v) {
+    return (int32_t)((v * sampler->scale_mul + sampler->scale_round) >> sampler->scale_shift);
 }
 
-EMSCRIPTEN_KEEPALIVE
-uint8_t* decodeToBmpWithRatio(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1) {
-    opj_image_t* image = decode_opj_common(data, data_len, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, 1);
-    if (!image) return NULL;
+// Returns 0 on allocation failure or when a component has no samples.
+static int pixel_source_init(pixel_source_t* source, opj_image_t* image) {
+    memset(source, 0, sizeof(*source));
 
-    uint8_t* bmp_buffer = convert_image_to_bmp(image, color_format);
+    const opj_image_comp_t* ref = &image->comps[0];
+    uint32_t comp_index[3];
+    int alpha_index;
+    source->num_color_planes = select_components(image, comp_index, &alpha_index);
+    source->has_alpha = alpha_index >= 0;
+    source->width = ref->w;
+    source->height = ref->h;
+    source->ycc = source->num_color_planes == 3 && image->color_space == OPJ_CLRSPC_SYCC;
 
-    opj_image_destroy(image);
-    return bmp_buffer;
-}
+    const opj_image_comp_t* comps[PIXEL_SOURCE_MAX_PLANES];
+    uint32_t num_planes = source->num_color_planes;
+    for (uint32_t p = 0; p < num_planes; p++) comps[p] = &image->comps[comp_index[p]];
+    if (source->has_alpha) comps[num_planes++] = &image->comps[alpha_index];
 
-EMSCRIPTEN_KEEPALIVE
+    source->direct = !source->ycc;
+    for (uint32_t p = 0; p < num_planes; p++) {
+        if (!comps[p]->data || comps[p]->w == 0 || comps[p]->h == 0) return 0;
+        if (!is_direct_component(comps[p], ref)) source->direct = 0;
+    }
+
+    if (source->direct) {
+        for (uint32_t p = 0; p < 3; p++) source->planes[p] = comps[source->num_color_planes == 1 ? 0 : p]->data;
+        source->planes[3] = source->has_alpha ? comps[num_planes - 1]->data : NULL;
+        return 1;
+    }
+
+    // Rows and column maps share one scratch block
+    size_t plane_samples = (size_t)source->width * num_planes;
+    source->rows = (int32_t*)scratch_alloc(SCRATCH_SLOT_ROWS, plane_samples * (sizeof(int32_t) + sizeof(uint32_t)));
+    if (!source->rows) return 0;
+    source->x_maps = (uint32_t*)(source->rows + plane_samples);
+
+    for (uint32_t p = 0; p < num_planes; p++) {
+        int is_color = p < source->num_color_planes;
+        uint32_t prec = (source->ycc && is_color) ? comp_prec(comps[0]) : comp_prec(comps[p]);
+        plane_sampler_init(&source->samplers[p], comps[p], ref, source->width, source->x_maps + (size_t)p * source->width, prec);
+    }
+    return 1;
+}
+
+static void pixel_source_free(pixel_source_t* source) {
+    scratch_free(source->rows);
+    source->rows = NULL;
+    source->x_maps = NULL;
+}
+
+// Returns output row y as int32 R, G, B and A (NULL when opaque) samples for the packing kernels.
+// Gray rows return the same pointer for R, G and B.
+static void pixel_source_row(pixel_source_t* source, uint32_t y, const int32_t** r, const int32_t** g, const int32_t** b, const int32_t** a) {
+    uint32_t width = source->width;
+
+    if (source->direct) {
+        size_t offset = (size_t)y * width;
+        *r = source->planes[0] + offset;
+        *g = source->planes[1] + offset;
+        *b = source->planes[2] + offset;
+        *a = source->planes[3] ? source->planes[3] + offset : NULL;
+        return;
+    }
+
+    int32_t* out0 = source->rows;
+    if (source->num_color_planes == 1) {
+        const plane_sampler_t* s0 = &source->samplers[0];
+        const int32_t* row0 = plane_sampler_row(s0, y);
+        for (uint32_t i = 0; i < width; i++) {
+            out0[i] = plane_sampler_scale(s0, (int64_t)row0[s0->x_map[i]] + s0->sign_offset);
+        }
+        *r = *g = *b = out0;
+    } else {
+        int32_t* out1 = out0 + width;
+        int32_t* out2 = out1 + width;
+        const plane_sampler_t* s0 = &source->samplers[0];
+        const plane_sampler_t* s1 = &source->samplers[1];
+        const plane_sampler_t* s2 = &source->samplers[2];
+        const int32_t* row0 = plane_sampler_row(s0, y);
+        const int32_t* row1 = plane_sampler_row(s1, y);
+        const int32_t* row2 = plane_sampler_row(s2, y);
+
+        if (source->ycc) {
+            for (uint32_t i = 0; i < width; i++) {
+                int64_t luma = (int64_t)row0[s0->x_map[i]] + s0->sign_offset;
+                int64_t cb = (int64_t)row1[s1->x_map[i]] + s1->sign_offset - s1->half;
+                int64_t cr = (int64_t)row2[s2->x_map[i]] + s2->sign_offset - s2->half;
+                out0[i] = plane_sampler_scale(s0, luma + ((cr * YCC_CR_TO_R + 32768) >> 16));
+                out1[i] = plane_sampler_scale(s1, luma - ((cb * YCC_CB_TO_G + cr * YCC_CR_TO_G + 32768) >> 16));
+                out2[i] = plane_sampler_scale(s2, luma + ((cb * YCC_CB_TO_B + 32768) >> 16));
+            }
+        } else {
+            for (uint32_t i = 0; i < width; i++) {
+                out0[i] = plane_sampler_scale(s0, (int64_t)row0[s0->x_map[i]] + s0->sign_offset);
+                out1[i] = plane_sampler_scale(s1, (int64_t)row1[s1->x_map[i]] + s1->sign_offset);
+                out2[i] = plane_sampler_scale(s2, (int64_t)row2[s2->x_map[i]] + s2->sign_offset);
+            }
+        }
+        *r = out0;
+        *g = out1;
+        *b = out2;
+    }
+
+    if (source->has_alpha) {
+        const plane_sampler_t* sa = &source->samplers[source->num_color_planes];
+        int32_t* out_a = out0 + (size_t)source->num_color_planes * width;
+        const int32_t* row_a = plane_sampler_row(sa, y);
+        for (uint32_t i = 0; i < width; i++) {
+            out_a[i] = plane_sampler_scale(sa, (int64_t)row_a[sa->x_map[i]] + sa->sign_offset);
+        }
+        *a = out_a;
+    } else {
+        *a = NULL;
+    }
+}
+
+// Size of the output for a width x height image in the given output format, header included. The
+// distance between rows is returned in *stride: BMP rows are padded to 4 bytes, raw rows are not,
+// matching Bitmap.getRowBytes().
+static size_t output_buffer_size(int format, int color_format, uint32_t width, uint32_t height, size_t* stride) {
+    uint32_t bytes_per_pixel = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+    uint32_t header_size;
+    if (format == OUTPUT_FORMAT_RAW) {
+        *stride = (size_t)width * bytes_per_pixel;
+        header_size = RAW_HEADER_SIZE;
+    } else {
+        *stride = ((size_t)width * bytes_per_pixel + 3) & ~(size_t)3;
+        header_size = (color_format == COLOR_FORMAT_RGB565) ? 14 + 40 + 12 : 14 + 40; // Header + DIB (+ Masks)
+    }
+    return header_size + *stride * height;
+}
+
+// Allocates the output for a width x height image in the given output format and writes its header.
+// Returns the first pixel row in *pixels and the distance between rows in *stride.
+static uint8_t* alloc_output(int format, int color_format, uint32_t width, uint32_t height, uint8_t** pixels, size_t* stride) {
+    uint32_t bytes_per_pixel = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+    size_t size = output_buffer_size(format, color_format, width, height, stride);
+    size_t header_size = size - *stride * height;
+
+    uint8_t* buffer = (uint8_t*)scratch_alloc(SCRATCH_SLOT_OUTPUT, size);
+    if (!buffer) return NULL;
+
+    if (format == OUTPUT_FORMAT_RAW) {
+        uint32_t header[RAW_HEADER_SIZE / 4];
+        header[RAW_HEADER_WIDTH] = width;
+        header[RAW_HEADER_HEIGHT] = height;
+        header[RAW_HEADER_STRIDE] = (uint32_t)*stride;
+        header[RAW_HEADER_COLOR_FORMAT] = (color_format == COLOR_FORMAT_RGB565) ? COLOR_FORMAT_RGB565 : COLOR_FORMAT_ARGB8888;
+        memcpy(buffer, header, RAW_HEADER_SIZE);
+    } else if (color_format == COLOR_FORMAT_RGB565) {
+        write_headers_rgb565(buffer, (uint32_t)size, width, height);
+    } else {
+        write_headers_argb8888(buffer, (uint32_t)size, width, height);
+    }
+    *pixels = buffer + header_size;
+
+    // The packing does not write the row padding
+    size_t row_bytes = (size_t)width * bytes_per_pixel;
+    if (*stride > row_bytes) {
+        for (uint32_t y = 0; y < height; y++) memset(*pixels + y * *stride + row_bytes, 0, *stride - row_bytes);
+    }
+    return buffer;
+}
+
+// Packs every row of the source into dst, `stride` bytes apart. Direct sources whose rows are not
+// padded are packed as one run. BMP uses BGRA, raw uses premultiplied RGBA; RGB565 is the same for both.
+// Returns 0 when the request is aborted between two strips of rows.
+static int pack_source_rows(pixel_source_t* source, int format, int color_format, uint8_t* dst, size_t stride) {
+    uint32_t bytes_per_pixel = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+    int one_run = source->direct && stride == (size_t)source->width * bytes_per_pixel;
+    uint32_t rows = one_run ? 1 : source->height;
+    uint32_t run = one_run ? source->width * source->height : source->width;
+
+    const int32_t *r_row, *g_row, *b_row, *a_row;
+    for (uint32_t y = 0; y < rows; y++) {
+        if (y % CANCEL_CHECK_ROWS == 0 && should_abort()) return 0;
+        pixel_source_row(source, y, &r_row, &g_row, &b_row, &a_row);
+        if (color_format == COLOR_FORMAT_RGB565) {
+            pack_rgb565(r_row, g_row, b_row, (uint16_t*)dst, run);
+        } else if (format == OUTPUT_FORMAT_RAW) {
+            pack_rgba_premul(r_row, g_row, b_row, a_row, dst, run);
+        } else {
+            pack_bgra(r_row, g_row, b_row, a_row, dst, run);
+        }
+        dst += stride;
+    }
+    return 1;
+}
+
+// Converts the image to a BMP, or for OUTPUT_FORMAT_RAW to pixels in Android Bitmap memory layout so
+// the caller can copy them into a Bitmap without parsing.
+static uint8_t* convert_image(opj_image_t* image, int format, int color_format) {
+    if (image->numcomps < 1) {
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+
+    // The decoded component size accounts for the region and the resolution reduction,
+    // whereas the image bounds stay on the full resolution reference grid.
+    pixel_source_t source;
+    if (!pixel_source_init(&source, image)) {
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+
+    uint8_t* pixels;
+    size_t stride;
+    uint8_t* buffer = alloc_output(format, color_format, source.width, source.height, &pixels, &stride);
+    if (!buffer) {
+        pixel_source_free(&source);
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+
+    int packed = pack_source_rows(&source, format, color_format, pixels, stride);
+    pixel_source_free(&source);
+    if (!packed) {
+        scratch_free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+static uint8_t* encode_output(opj_image_t* image, int color_format) {
+    STATS_TIMER_START(convert_start);
+    uint8_t* output = convert_image(image, output_format, color_format);
+    STATS_TIMER_STOP(STATS_CONVERT_US, convert_start);
+    // The decoded components and the output are both alive here
+    mem_sample();
+    return output;
+}
+
+// Tile streaming
+// opj_decode() holds the int32 samples of every component of the whole area (16 bytes per RGBA pixel)
+// until the conversion, next to the output. When the area spans several tiles it is instead decoded
+// with opj_read_tile_header() / opj_decode_tile_data() and each tile is converted straight into the
+// output, so only one tile of component data is alive at a time and the peak heap stays close to the
+// output size.
+//
+// The decode area is widened to whole tiles, so that opj_decode_tile_data() always returns the full
+// tile at the decoded resolution: the components one after the other, each sample in 1, 2 or 4 bytes
+// (3-byte precisions use 4) and signed like the component. The parts outside the requested area are
+// dropped by the conversion. Palettes (pclr) and channel definitions (cdef) of JP2 files are only
+// applied by opj_decode(), so such files keep the regular path.
+
+#define JP2_BOX_JP2H 0x6A703268  // 'jp2h'
+#define JP2_BOX_PCLR 0x70636C72  // 'pclr'
+#define JP2_BOX_CDEF 0x63646566  // 'cdef'
+
+static uint32_t read_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Looks for a box of the given type among the boxes in [offset, end). Returns 1 with its contents in
+// [*content, *content_end), 0 when there is none and -1 when a box length is invalid.
+static int find_jp2_box(const uint8_t* data, uint64_t offset, uint64_t end, uint32_t type, uint64_t* content, uint64_t* content_end) {
+    while (offset + 8 <= end) {
+        uint64_t box_len = read_be32(data + offset);
+        uint32_t box_type = read_be32(data + offset + 4);
+        uint64_t header_len = 8;
+        if (box_len == 1) {
+            if (offset + 16 > end) return -1;
+            box_len = ((uint64_t)read_be32(data + offset + 8) << 32) | read_be32(data + offset + 12);
+            header_len = 16;
+        } else if (box_len == 0) {
+            // Extends to the end
+            box_len = end - offset;
+        }
+        if (box_len < header_len || box_len > end - offset) return -1;
+
+        if (box_type == type) {
+            *content = offset + header_len;
+            *content_end = offset + box_len;
+            return 1;
+        }
+        offset += box_len;
+    }
+    return 0;
+}
+
+// Whether the JP2 header has a palette or a channel definition. A malformed header counts as one, which
+// leaves the error handling to the regular path.
+static int jp2_has_channel_boxes(const uint8_t* data, uint32_t data_len) {
+    uint64_t start, end, box_start, box_end;
+    int found = find_jp2_box(data, 0, data_len, JP2_BOX_JP2H, &start, &end);
+    if (found <= 0) return found < 0;
+    return find_jp2_box(data, start, end, JP2_BOX_PCLR, &box_start, &box_end) != 0 ||
+           find_jp2_box(data, start, end, JP2_BOX_CDEF, &box_start, &box_end) != 0;
+}
+
+static int can_stream_tiles(uint8_t* data, uint32_t data_len, opj_image_t* image) {
+    if (!tile_streaming || image->numcomps < 1) return 0;
+    return get_codec_format(data, data_len) != OPJ_CODEC_JP2 || !jp2_has_channel_boxes(data, data_len);
+}
+
+// Widens [*x0, *x1) x [*y0, *y1) to the tiles it intersects, clipped to the image area, and returns the
+// number of those tiles (0 without a tile grid).
+static uint64_t snap_area_to_tiles(opj_codec_t* codec, uint32_t ix0, uint32_t iy0, uint32_t ix1, uint32_t iy1,
+                                   uint32_t* x0, uint32_t* y0, uint32_t* x1, uint32_t* y1) {
+    opj_codestream_info_v2_t* info = opj_get_cstr_info(codec);
+    if (!info) return 0;
+
+    uint64_t count = 0;
+    if (info->tdx > 0 && info->tdy > 0 && *x0 >= info->tx0 && *y0 >= info->ty0 && *x1 > *x0 && *y1 > *y0) {
+        uint64_t first_x = (*x0 - info->tx0) / info->tdx;
+        uint64_t first_y = (*y0 - info->ty0) / info->tdy;
+        uint64_t last_x = (*x1 - 1 - info->tx0) / info->tdx;
+        uint64_t last_y = (*y1 - 1 - info->ty0) / info->tdy;
+        count = (last_x - first_x + 1) * (last_y - first_y + 1);
+
+        uint64_t sx0 = info->tx0 + first_x * info->tdx;
+        uint64_t sy0 = info->ty0 + first_y * info->tdy;
+        uint64_t sx1 = info->tx0 + (last_x + 1) * info->tdx;
+        uint64_t sy1 = info->ty0 + (last_y + 1) * info->tdy;
+        *x0 = sx0 > ix0 ? (uint32_t)sx0 : ix0;
+        *y0 = sy0 > iy0 ? (uint32_t)sy0 : iy0;
+        *x1 = sx1 < ix1 ? (uint32_t)sx1 : ix1;
+        *y1 = sy1 < iy1 ? (uint32_t)sy1 : iy1;
+    }
+    opj_destroy_cstr_info(&info);
+    return count;
+}
+
+// opj_decode() recorded in the decode statistics, with the tiles of the decode area
+static OPJ_BOOL decode_timed(opj_codec_t* codec, opj_stream_t* stream, opj_image_t* image) {
+#if WRAPPER_USE_STATS
+    uint32_t x0 = image->x0, y0 = image->y0, x1 = image->x1, y1 = image->y1;
+    STATS_ADD(STATS_TILES, snap_area_to_tiles(codec, x0, y0, x1, y1, &x0, &y0, &x1, &y1));
+#endif
+    STATS_TIMER_START(decode_start);
+    OPJ_BOOL ok = opj_decode(codec, stream, image);
+    STATS_TIMER_STOP(STATS_DECODE_US, decode_start);
+    mem_sample();
+    return ok;
+}
+
+// Where a component sits in the data of the current tile, and the part of it that is converted.
+typedef struct {
+    size_t offset;
+    uint32_t bytes;                 // Bytes per sample
+    uint32_t x0, y0, w, h;          // Tile at the decoded resolution
+    uint32_t win_x0, win_y0, win_w, win_h;
+    int used;
+} tile_comp_t;
+
+typedef struct {
+    opj_image_t* image;             // Header image, for the component parameters
+    opj_image_t tile_image;         // Same parameters, components pointed at the window of the tile
+    tile_comp_t* comps;
+    uint32_t x0, y0, x1, y1;        // Requested area on the reference grid
+    uint32_t out_x0, out_y0;        // Output origin at the decoded resolution of component 0
+    int color_format;
+    uint8_t* pixels;
+    size_t stride;
+    int sampled;                    // Heap in use sampled with the first tile
+} tile_stream_t;
+
+// Copies the window of a component out of the tile data as int32 samples.
+static void expand_tile_component(const uint8_t* src, const tile_comp_t* tc, int sgnd, int32_t* dst) {
+    for (uint32_t j = 0; j < tc->win_h; j++) {
+        const uint8_t* row = src + ((size_t)(tc->win_y0 - tc->y0 + j) * tc->w + (tc->win_x0 - tc->x0)) * tc->bytes;
+        int32_t* out = dst + (size_t)j * tc->win_w;
+        if (tc->bytes == 1) {
+            if (sgnd) {
+                for (uint32_t i = 0; i < tc->win_w; i++) out[i] = (int8_t)row[i];
+            } else {
+                for (uint32_t i = 0; i < tc->win_w; i++) out[i] = row[i];
+            }
+        } else if (tc->bytes == 2) {
+            for (uint32_t i = 0; i < tc->win_w; i++) {
+                uint16_t v;
+                memcpy(&v, row + (size_t)i * 2, 2);
+                out[i] = sgnd ? (int16_t)v : v;
+            }
+        } else {
+            memcpy(out, row, (size_t)tc->win_w * 4);
+        }
+    }
+}
+
+// Decodes the tile read by opj_read_tile_header() and converts its part of the area into the output.
+static int tile_stream_decode(tile_stream_t* ts, opj_codec_t* codec, opj_stream_t* stream, uint32_t tile_index, uint32_t data_size,
+                              uint32_t tx0, uint32_t ty0, uint32_t tx1, uint32_t ty1) {
+    opj_image_t* image = ts->image;
+
+    // Layout of the tile data, and the window of the area in each component that is converted
+    size_t data_end = 0;
+    size_t plane_samples = 0;
+    int outside = 0;
+    for (uint32_t c = 0; c < image->numcomps; c++) {
+        const opj_image_comp_t* comp = &image->comps[c];
+        tile_comp_t* tc = &ts->comps[c];
+        uint32_t dx = comp_dx(comp);
+        uint32_t dy = comp_dy(comp);
+
+        tc->offset = data_end;
+        tc->bytes = (comp_prec(comp) + 7) / 8;
+        if (tc->bytes == 3) tc->bytes = 4;
+        tc->x0 = ceil_div_pow2(ceil_div(tx0, dx), comp->factor);
+        tc->y0 = ceil_div_pow2(ceil_div(ty0, dy), comp->factor);
+        tc->w = ceil_div_pow2(ceil_div(tx1, dx), comp->factor) - tc->x0;
+        tc->h = ceil_div_pow2(ceil_div(ty1, dy), comp->factor) - tc->y0;
+        data_end += (size_t)tc->w * tc->h * tc->bytes;
+        if (!tc->used) continue;
+
+        uint32_t ax0 = ceil_div_pow2(ceil_div(ts->x0, dx), comp->factor);
+        uint32_t ay0 = ceil_div_pow2(ceil_div(ts->y0, dy), comp->factor);
+        uint32_t ax1 = ceil_div_pow2(ceil_div(ts->x1, dx), comp->factor);
+        uint32_t ay1 = ceil_div_pow2(ceil_div(ts->y1, dy), comp->factor);
+        tc->win_x0 = ax0 > tc->x0 ? ax0 : tc->x0;
+        tc->win_y0 = ay0 > tc->y0 ? ay0 : tc->y0;
+        uint32_t win_x1 = ax1 < tc->x0 + tc->w ? ax1 : tc->x0 + tc->w;
+        uint32_t win_y1 = ay1 < tc->y0 + tc->h ? ay1 : tc->y0 + tc->h;
+        if (win_x1 <= tc->win_x0 || win_y1 <= tc->win_y0) {
+            if (c == 0) outside = 1;
+            // A subsampled component can miss a thin edge of the area, the samplers then clamp into the tile
+            tc->win_x0 = tc->x0;
+            tc->win_y0 = tc->y0;
+            win_x1 = tc->x0 + tc->w;
+            win_y1 = tc->y0 + tc->h;
+        }
+        tc->win_w = win_x1 - tc->win_x0;
+        tc->win_h = win_y1 - tc->win_y0;
+        plane_samples += (size_t)tc->win_w * tc->win_h;
+    }
+    if (data_end > data_size) return 0;
+
+    // Tile data followed by the int32 planes of the windows
+    size_t planes_offset = ((size_t)data_size + 15) & ~(size_t)15;
+    uint8_t* block = (uint8_t*)scratch_alloc(SCRATCH_SLOT_TILE, planes_offset + plane_samples * sizeof(int32_t));
+    if (!block) return 0;
+
+    STATS_TIMER_START(decode_start);
+    OPJ_BOOL decoded = opj_decode_tile_data(codec, tile_index, block, data_size, stream);
+    STATS_TIMER_STOP(STATS_DECODE_US, decode_start);
+    STATS_ADD(STATS_TILES, 1);
+    if (!decoded) {
+        scratch_free(block);
+        return 0;
+    }
+
+    // Tiles outside the area are decoded to move on, but have nothing to convert
+    if (outside) {
+        scratch_free(block);
+        return 1;
+    }
+
+    STATS_TIMER_START(convert_start);
+    int32_t* plane = (int32_t*)(block + planes_offset);
+    for (uint32_t c = 0; c < image->numcomps; c++) {
+        const tile_comp_t* tc = &ts->comps[c];
+        opj_image_comp_t* comp = &ts->tile_image.comps[c];
+        *comp = image->comps[c];
+        comp->data = NULL;
+        if (!tc->used) continue;
+
+        expand_tile_component(block + tc->offset, tc, comp->sgnd, plane);
+        comp->x0 = tc->win_x0;
+        comp->y0 = tc->win_y0;
+        comp->w = tc->win_w;
+        comp->h = tc->win_h;
+        comp->factor = 0;
+        comp->data = plane;
+        plane += (size_t)tc->win_w * tc->win_h;
+    }
+    // Tiles are alike, so the heap is only sampled while the first one and the output are alive
+    if (!ts->sampled) {
+        mem_sample();
+        ts->sampled = 1;
+    }
+
+    pixel_source_t source;
+    int ok = pixel_source_init(&source, &ts->tile_image);
+    if (ok) {
+        uint32_t bytes_per_pixel = (ts->color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+        const tile_comp_t* ref = &ts->comps[0];
+        uint8_t* dst = ts->pixels + (size_t)(ref->win_y0 - ts->out_y0) * ts->stride + (size_t)(ref->win_x0 - ts->out_x0) * bytes_per_pixel;
+        ok = pack_source_rows(&source, output_format, ts->color_format, dst, ts->stride);
+        pixel_source_free(&source);
+    }
+    STATS_TIMER_STOP(STATS_CONVERT_US, convert_start);
+    scratch_free(block);
+    return ok;
+}
+
+// Decodes the area [x0, x1) x [y0, y1) tile by tile into a new output. The decode area must already be
+// set to the tiles it intersects (snap_area_to_tiles()). The codec cannot decode again afterwards.
+static uint8_t* decode_tiles_to_output(opj_codec_t* codec, opj_stream_t* stream, opj_image_t* image, int color_format,
+                                       uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    tile_stream_t ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.image = image;
+    ts.tile_image = *image;
+    ts.x0 = x0;
+    ts.y0 = y0;
+    ts.x1 = x1;
+    ts.y1 = y1;
+    ts.color_format = color_format;
+
+    const opj_image_comp_t* ref = &image->comps[0];
+    ts.out_x0 = ceil_div_pow2(ceil_div(x0, comp_dx(ref)), ref->factor);
+    ts.out_y0 = ceil_div_pow2(ceil_div(y0, comp_dy(ref)), ref->factor);
+    uint32_t width = ceil_div_pow2(ceil_div(x1, comp_dx(ref)), ref->factor) - ts.out_x0;
+    uint32_t height = ceil_div_pow2(ceil_div(y1, comp_dy(ref)), ref->factor) - ts.out_y0;
+
+    ts.comps = (tile_comp_t*)calloc(image->numcomps, sizeof(tile_comp_t));
+    ts.tile_image.comps = (opj_image_comp_t*)calloc(image->numcomps, sizeof(opj_image_comp_t));
+    uint8_t* output = NULL;
+    if (ts.comps && ts.tile_image.comps) {
+        output = alloc_output(output_format, color_format, width, height, &ts.pixels, &ts.stride);
+    }
+    if (!output) {
+        free(ts.comps);
+        free(ts.tile_image.comps);
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+
+    // Only the components the conversion reads are expanded
+    uint32_t comp_index[3];
+    int alpha_index;
+    uint32_t num_color = select_components(image, comp_index, &alpha_index);
+    for (uint32_t p = 0; p < num_color; p++) ts.comps[comp_index[p]].used = 1;
+    if (alpha_index >= 0) ts.comps[alpha_index].used = 1;
+
+    int ok = 1;
+    for (;;) {
+        OPJ_UINT32 tile_index, data_size, num_comps;
+        OPJ_INT32 tx0, ty0, tx1, ty1;
+        OPJ_BOOL go_on = OPJ_FALSE;
+        if (!opj_read_tile_header(codec, stream, &tile_index, &data_size, &tx0, &ty0, &tx1, &ty1, &num_comps, &go_on)) {
+            ok = 0;
+            break;
+        }
+        if (!go_on) break;
+        if (should_abort()) {
+            ok = 0;
+            break;
+        }
+        if (num_comps != image->numcomps ||
+            !tile_stream_decode(&ts, codec, stream, tile_index, data_size, (uint32_t)tx0, (uint32_t)ty0, (uint32_t)tx1, (uint32_t)ty1)) {
+            ok = 0;
+            break;
+        }
+    }
+
+    free(ts.comps);
+    free(ts.tile_image.comps);
+    if (!ok) {
+        scratch_free(output);
+        if (last_error == ERR_NONE) last_error = ERR_DECODE;
+        return NULL;
+    }
+    return output;
+}
+
+// Peak memory estimate
+// Predicts from the main header the heap a decode allocates: the int32 samples OpenJPEG keeps for the
+// whole decode area, one tile of OpenJPEG's tile buffers, the samples and flags of one code-block, the
+// compressed data of one tile, the conversion rows and the output. When the area lies in a single tile,
+// OpenJPEG moves the tile buffer into the image instead of copying it, so the samples are counted once.
+// A streamed decode does not keep the area, but the wrapper holds a copy of the tile next to OpenJPEG's.
+// The model follows OpenJPEG 2.5 and errs on the high side, so it only sizes the memory growth.
+static uint64_t estimate_decode_peak(opj_codec_t* codec, const opj_image_t* image, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+                                     int streamed, uint32_t data_len, int color_format) {
+    if (image->numcomps == 0 || x1 <= x0 || y1 <= y0) return 0;
+
+    opj_codestream_info_v2_t* info = opj_get_cstr_info(codec);
+
+    // One tile of the area, or the whole area when the header has no tile grid
+    uint32_t tile_w = x1 - x0;
+    uint32_t tile_h = y1 - y0;
+    uint64_t num_tiles = 1;
+    int single_tile = 1;
+    if (info && info->tdx > 0 && info->tdy > 0) {
+        if (info->tdx < tile_w) tile_w = info->tdx;
+        if (info->tdy < tile_h) tile_h = info->tdy;
+        if (info->tw > 0 && info->th > 0) num_tiles = (uint64_t)info->tw * info->th;
+        single_tile = num_tiles == 1 ||
+                      (x0 >= info->tx0 && y0 >= info->ty0 &&
+                       (x0 - info->tx0) / info->tdx == (x1 - 1 - info->tx0) / info->tdx &&
+                       (y0 - info->ty0) / info->tdy == (y1 - 1 - info->ty0) / info->tdy);
+    }
+
+    uint64_t area_samples = 0;
+    uint64_t tile_samples = 0;
+    uint64_t code_block_samples = 0;
+    for (uint32_t c = 0; c < image->numcomps; c++) {
+        const opj_image_comp_t* comp = &image->comps[c];
+        uint32_t dx = comp_dx(comp);
+        uint32_t dy = comp_dy(comp);
+        uint64_t w = ceil_div_pow2(ceil_div(x1, dx), comp->factor) - ceil_div_pow2(ceil_div(x0, dx), comp->factor);
+        uint64_t h = ceil_div_pow2(ceil_div(y1, dy), comp->factor) - ceil_div_pow2(ceil_div(y0, dy), comp->factor);
+        area_samples += w * h;
+        tile_samples += (uint64_t)ceil_div_pow2(ceil_div(tile_w, dx), comp->factor) * ceil_div_pow2(ceil_div(tile_h, dy), comp->factor);
+
+        if (info && info->m_default_tile_info.tccp_info && c < info->nbcomps) {
+            const opj_tccp_info_t* tccp = &info->m_default_tile_info.tccp_info[c];
+            if (tccp->cblkw + tccp->cblkh < 32) {
+                uint64_t samples = (uint64_t)1 << (tccp->cblkw + tccp->cblkh);
+                if (samples > code_block_samples) code_block_samples = samples;
+            }
+        }
+    }
+    if (info) opj_destroy_cstr_info(&info);
+
+    const opj_image_comp_t* ref = &image->comps[0];
+    uint32_t width = ceil_div_pow2(ceil_div(x1, comp_dx(ref)), ref->factor) - ceil_div_pow2(ceil_div(x0, comp_dx(ref)), ref->factor);
+    uint32_t height = ceil_div_pow2(ceil_div(y1, comp_dy(ref)), ref->factor) - ceil_div_pow2(ceil_div(y0, comp_dy(ref)), ref->factor);
+    size_t stride;
+    uint64_t bytes = output_buffer_size(output_format, color_format, width, height, &stride);
+    // Rows and column maps of up to four planes
+    bytes += (uint64_t)width * 4 * (sizeof(int32_t) + sizeof(uint32_t));
+    // Samples and flags of a code-block
+    bytes += code_block_samples * 2 * sizeof(int32_t);
+    bytes += (data_len + num_tiles - 1) / num_tiles;
+    if (streamed) {
+        // OpenJPEG's tile buffer, and the tile data and int32 windows of the wrapper
+        bytes += tile_samples * 3 * sizeof(int32_t);
+    } else if (single_tile) {
+        // The tile buffer becomes the image
+        bytes += area_samples * sizeof(int32_t);
+    } else {
+        bytes += (area_samples + tile_samples) * sizeof(int32_t);
+    }
+    return bytes;
+}
+
+#ifndef WASM_PAGE_SIZE
+#define WASM_PAGE_SIZE 65536
+#endif
+
+// Makes room for a decode predicted to allocate `bytes`. When the free blocks of the heap and the unused
+// linear memory above it fall short, the memory is grown once by the missing pages, up to max_heap_size,
+// instead of by each allocation of the decode in turn. The prediction is never a reason to reject a
+// decode: only a failed grow returns 0 with ERR_MEMORY_LIMIT, as the decode would fail partway through
+// anyway. Host builds have no linear memory to reserve.
+static int reserve_decode_memory(uint64_t bytes, uint32_t max_heap_size) {
+    mem_stats[MEM_STATS_ESTIMATE] = bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+#if defined(__wasm__)
+    uint64_t size = (uint64_t)__builtin_wasm_memory_size(0) * WASM_PAGE_SIZE;
+    uint64_t top = (uint64_t)(uintptr_t)sbrk(0);
+    uint64_t available = (size > top ? size - top : 0) + mallinfo().fordblks;
+    if (bytes <= available) return 1;
+
+    uint64_t pages = (bytes - available + WASM_PAGE_SIZE - 1) / WASM_PAGE_SIZE;
+    uint64_t max_pages = size < max_heap_size ? (max_heap_size - size) / WASM_PAGE_SIZE : 0;
+    if (pages > max_pages) pages = max_pages;
+    if (pages > 0 && __builtin_wasm_memory_grow(0, (size_t)pages) == (size_t)-1) {
+        last_error = ERR_MEMORY_LIMIT;
+        return 0;
+    }
+#else
+    (void)max_heap_size;
+#endif
+    return 1;
+}
+
+static uint8_t* decode_internal(uint8_t* data, uint32_t data_len, OPJ_CODEC_FORMAT format, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, int use_ratio, uint32_t reduce) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    mem_reset();
+
+    opj_buffer_info_t buffer_info = {data, data_len, 0};
+
+    opj_codec_t* l_codec = create_decoder(format, 0);
+    if (!l_codec) {
+        last_error = ERR_DECODER_SETUP;
+        return NULL;
+    }
+
+    opj_stream_t* l_stream = create_mem_stream(&buffer_info, data_len);
+
+    opj_image_t* l_image = NULL;
+    uint8_t* output = NULL;
+    if (!read_header_timed(l_stream, l_codec, &l_image)) {
+        last_error = ERR_HEADER;
+        l_image = NULL;
+    } else if (!apply_reduce(l_codec, l_image, reduce)) {
+        last_error = ERR_DECODER_SETUP;
+    } else {
+        uint32_t ux0, uy0, ux1, uy1;
+        int is_partial;
+        int bounds_ok = resolve_region(l_image->x0, l_image->y0, l_image->x1, l_image->y1, x0, y0, x1, y1, use_ratio,
+                                       &ux0, &uy0, &ux1, &uy1, &is_partial);
+        if (!is_partial) {
+            ux0 = l_image->x0;
+            uy0 = l_image->y0;
+            ux1 = l_image->x1;
+            uy1 = l_image->y1;
+        }
+
+        int streamed = 0;
+        if (bounds_ok) {
+            uint32_t ax0 = ux0, ay0 = uy0, ax1 = ux1, ay1 = uy1;
+            streamed = can_stream_tiles(data, data_len, l_image) &&
+                       snap_area_to_tiles(l_codec, l_image->x0, l_image->y0, l_image->x1, l_image->y1, &ax0, &ay0, &ax1, &ay1) > 1;
+            if (streamed) {
+                bounds_ok = opj_set_decode_area(l_codec, l_image, ax0, ay0, ax1, ay1);
+            } else if (is_partial) {
+                // Should not fail if bounds are ok, but safety check
+                bounds_ok = opj_set_decode_area(l_codec, l_image, ux0, uy0, ux1, uy1);
+            }
+        }
+
+        if (!bounds_ok) {
+            last_error = ERR_REGION_OUT_OF_BOUNDS;
+        } else {
+            // The pixel limit applies to the output size, i.e. after the resolution reduction.
+            uint32_t factor = l_image->numcomps > 0 ? l_image->comps[0].factor : 0;
+
+            if (max_pixels > 0 && reduced_pixel_count(ux0, uy0, ux1, uy1, factor) > max_pixels) {
+                last_error = ERR_PIXEL_DATA_SIZE;
+            } else if (!reserve_decode_memory(estimate_decode_peak(l_codec, l_image, ux0, uy0, ux1, uy1, streamed, data_len, color_format), max_heap_size)) {
+                // Predicted not to fit in the heap
+            } else if (should_abort()) {
+                // Cancelled or out of time before the entropy decoding
+            } else if (streamed) {
+                output = decode_tiles_to_output(l_codec, l_stream, l_image, color_format, ux0, uy0, ux1, uy1);
+            } else if (!decode_timed(l_codec, l_stream, l_image)) {
+                last_error = ERR_DECODE;
+            } else {
+                output = encode_output(l_image, color_format);
+            }
+        }
+    }
+    if (l_image) opj_image_destroy(l_image);
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    mem_sample();
+
+    return output;
+}
+
+static uint8_t* decode_opj_common(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, int use_ratio, uint32_t reduce) {
+    uint32_t divider = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+    uint32_t max_input_size = max_heap_size / divider;
+
+    if (!data || data_len < MIN_INPUT_SIZE || data_len > max_input_size) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    OPJ_CODEC_FORMAT format = get_codec_format(data, data_len);
+    return decode_internal(data, data_len, format, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, use_ratio, reduce);
+}
+EMSCRIPTEN_KEEPALIVE
+uint8_t* decodeToBmpReduced(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t reduce) {
+    return decode_opj_common(data, data_len, max_pixels, max_heap_size, color_format, (double)x0, (double)y0, (double)x1, (double)y1, 0, reduce);
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t* decodeToBmp(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    return decodeToBmpReduced(data, data_len, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, 0);
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t* decodeToBmpWithRatioReduced(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, uint32_t reduce) {
+    return decode_opj_common(data, data_len, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, 1, reduce);
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t* decodeToBmpWithRatio(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1) {
+    return decodeToBmpWithRatioReduced(data, data_len, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, 0);
+}
+
+EMSCRIPTEN_KEEPALIVE
 uint32_t* getSize(uint8_t* data, uint32_t data_len) {
     last_error = ERR_NONE;
+    STATS_RESET();
     if (!data || data_len < MIN_INPUT_SIZE) {
         last_error = ERR_INPUT_DATA_SIZE;
         return NULL;
@@ -396,7 +1729,7 @@ uint32_t* getSize(uint8_t* data, uint32_t data_len) {
 
     OPJ_CODEC_FORMAT format = get_codec_format(data, data_len);
 
-    opj_codec_t* l_codec = create_decoder(format);
+    opj_codec_t* l_codec = create_decoder(format, 0);
     if (!l_codec) {
         last_error = ERR_DECODER_SETUP;
         return NULL;
@@ -428,3 +1761,884 @@ uint32_t* getSize(uint8_t* data, uint32_t data_len) {
 
     return result;
 }
+
+// Tile grid layout returned by getTileInfo (uint32 each)
+#define TILE_INFO_IMAGE_X0 0
+#define TILE_INFO_IMAGE_Y0 1
+#define TILE_INFO_IMAGE_X1 2
+#define TILE_INFO_IMAGE_Y1 3
+#define TILE_INFO_TILE_X0 4
+#define TILE_INFO_TILE_Y0 5
+#define TILE_INFO_TILE_WIDTH 6
+#define TILE_INFO_TILE_HEIGHT 7
+#define TILE_INFO_NUM_TILES_X 8
+#define TILE_INFO_NUM_TILES_Y 9
+#define TILE_INFO_COUNT 10
+
+// Computes the area covered by a tile on the reference grid, clipped to the image area.
+static void get_tile_bounds(const opj_codestream_info_v2_t* info, const opj_image_t* image, uint32_t tile_index, uint32_t* x0, uint32_t* y0, uint32_t* x1, uint32_t* y1) {
+    uint64_t tx0 = (uint64_t)info->tx0 + (uint64_t)(tile_index % info->tw) * info->tdx;
+    uint64_t ty0 = (uint64_t)info->ty0 + (uint64_t)(tile_index / info->tw) * info->tdy;
+    uint64_t tx1 = tx0 + info->tdx;
+    uint64_t ty1 = ty0 + info->tdy;
+    *x0 = tx0 > image->x0 ? (uint32_t)tx0 : image->x0;
+    *y0 = ty0 > image->y0 ? (uint32_t)ty0 : image->y0;
+    *x1 = tx1 < image->x1 ? (uint32_t)tx1 : image->x1;
+    *y1 = ty1 < image->y1 ? (uint32_t)ty1 : image->y1;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t* getTileInfo(uint8_t* data, uint32_t data_len) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    if (!data || data_len < MIN_INPUT_SIZE) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    opj_buffer_info_t buffer_info = {data, data_len, 0};
+
+    OPJ_CODEC_FORMAT format = get_codec_format(data, data_len);
+
+    opj_codec_t* l_codec = create_decoder(format, 0);
+    if (!l_codec) {
+        last_error = ERR_DECODER_SETUP;
+        return NULL;
+    }
+
+    opj_stream_t* l_stream = create_mem_stream(&buffer_info, data_len);
+
+    opj_image_t* l_image = NULL;
+    uint32_t* result = NULL;
+
+    if (!opj_read_header(l_stream, l_codec, &l_image)) {
+        last_error = ERR_HEADER;
+    } else {
+        opj_codestream_info_v2_t* info = opj_get_cstr_info(l_codec);
+        if (!info) {
+            last_error = ERR_HEADER;
+        } else {
+            result = (uint32_t*)malloc(TILE_INFO_COUNT * sizeof(uint32_t));
+            if (result) {
+                result[TILE_INFO_IMAGE_X0] = l_image->x0;
+                result[TILE_INFO_IMAGE_Y0] = l_image->y0;
+                result[TILE_INFO_IMAGE_X1] = l_image->x1;
+                result[TILE_INFO_IMAGE_Y1] = l_image->y1;
+                result[TILE_INFO_TILE_X0] = info->tx0;
+                result[TILE_INFO_TILE_Y0] = info->ty0;
+                result[TILE_INFO_TILE_WIDTH] = info->tdx;
+                result[TILE_INFO_TILE_HEIGHT] = info->tdy;
+                result[TILE_INFO_NUM_TILES_X] = info->tw;
+                result[TILE_INFO_NUM_TILES_Y] = info->th;
+            } else {
+                last_error = ERR_DECODE;
+            }
+            opj_destroy_cstr_info(&info);
+        }
+        opj_image_destroy(l_image);
+    }
+
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+
+    return result;
+}
+
+// Image description returned by getImageInfo (uint32 each): IMAGE_INFO_HEADER_COUNT fields followed
+// by IMAGE_INFO_COMPONENT_COUNT fields per component. The first fields match the getTileInfo layout.
+#define IMAGE_INFO_IMAGE_X0 0
+#define IMAGE_INFO_IMAGE_Y0 1
+#define IMAGE_INFO_IMAGE_X1 2
+#define IMAGE_INFO_IMAGE_Y1 3
+#define IMAGE_INFO_TILE_X0 4
+#define IMAGE_INFO_TILE_Y0 5
+#define IMAGE_INFO_TILE_WIDTH 6
+#define IMAGE_INFO_TILE_HEIGHT 7
+#define IMAGE_INFO_NUM_TILES_X 8
+#define IMAGE_INFO_NUM_TILES_Y 9
+// Of the component with the fewest levels, as for reduce
+#define IMAGE_INFO_NUM_RESOLUTIONS 10
+#define IMAGE_INFO_NUM_LAYERS 11
+// OPJ_PROG_ORDER, 0xFFFFFFFF when unknown
+#define IMAGE_INFO_PROGRESSION_ORDER 12
+// Nominal code-block size of the first component in samples
+#define IMAGE_INFO_CODE_BLOCK_WIDTH 13
+#define IMAGE_INFO_CODE_BLOCK_HEIGHT 14
+// IMAGE_INFO_MARKER_* bits
+#define IMAGE_INFO_MARKERS 15
+#define IMAGE_INFO_NUM_COMPONENTS 16
+#define IMAGE_INFO_HEADER_COUNT 17
+
+#define IMAGE_INFO_COMPONENT_PRECISION 0
+#define IMAGE_INFO_COMPONENT_SIGNED 1
+#define IMAGE_INFO_COMPONENT_DX 2
+#define IMAGE_INFO_COMPONENT_DY 3
+#define IMAGE_INFO_COMPONENT_COUNT 4
+
+#define IMAGE_INFO_MARKER_TLM 0x1
+#define IMAGE_INFO_MARKER_PLT 0x2
+
+#define JP2_BOX_JP2C 0x6A703263  // 'jp2c'
+
+#define J2K_MARKER_SOC 0xFF4F
+#define J2K_MARKER_SOT 0xFF90
+#define J2K_MARKER_SOD 0xFF93
+#define J2K_MARKER_EOC 0xFFD9
+#define J2K_MARKER_TLM 0xFF55
+#define J2K_MARKER_PLT 0xFF58
+
+static uint32_t read_be16(const uint8_t* p) {
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+// Walks the marker segments of the main header and of every tile-part header, jumping over the
+// tile-part bodies with Psot, and returns which of the TLM and PLT markers are present. The walk stops
+// at the first malformed segment; the markers seen until then are reported.
+static uint32_t scan_index_markers(const uint8_t* data, uint32_t data_len) {
+    uint64_t pos = 0;
+    uint64_t end = data_len;
+    if (get_codec_format((uint8_t*)data, data_len) == OPJ_CODEC_JP2 &&
+        find_jp2_box(data, 0, data_len, JP2_BOX_JP2C, &pos, &end) <= 0) {
+        return 0;
+    }
+    if (pos + 2 > end || read_be16(data + pos) != J2K_MARKER_SOC) return 0;
+    pos += 2;
+
+    uint32_t markers = 0;
+    while (pos + 4 <= end && markers != (IMAGE_INFO_MARKER_TLM | IMAGE_INFO_MARKER_PLT)) {
+        uint32_t marker = read_be16(data + pos);
+        if (marker < 0xFF00 || marker == J2K_MARKER_EOC) break;
+
+        if (marker == J2K_MARKER_SOT) {
+            // SOT: Lsot(2) Isot(2) Psot(4) TPsot(1) TNsot(1)
+            if (pos + 12 > end) break;
+            uint64_t tile_part_start = pos;
+            uint64_t tile_part_len = read_be32(data + pos + 6);
+            pos += 2 + read_be16(data + pos + 2);
+            while (pos + 4 <= end) {
+                uint32_t tile_marker = read_be16(data + pos);
+                if (tile_marker < 0xFF00 || tile_marker == J2K_MARKER_SOD) break;
+                if (tile_marker == J2K_MARKER_PLT) markers |= IMAGE_INFO_MARKER_PLT;
+                pos += 2 + read_be16(data + pos + 2);
+            }
+            // Psot 0 means the tile-part extends to EOC, which leaves no further tile-part to visit
+            if (tile_part_len == 0) break;
+            pos = tile_part_start + tile_part_len;
+            continue;
+        }
+
+        if (marker == J2K_MARKER_TLM) markers |= IMAGE_INFO_MARKER_TLM;
+        pos += 2 + read_be16(data + pos + 2);
+    }
+    return markers;
+}
+
+// Builds the getImageInfo result for a codec whose header has been read. The image area is passed
+// separately because a decode session narrows image->x0..y1 to the last decode area.
+static uint32_t* build_image_info(opj_codec_t* codec, const opj_image_t* image, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, const uint8_t* data, uint32_t data_len) {
+    opj_codestream_info_v2_t* info = opj_get_cstr_info(codec);
+    if (!info) {
+        last_error = ERR_HEADER;
+        return NULL;
+    }
+
+    uint32_t* result = (uint32_t*)malloc(((uint64_t)IMAGE_INFO_HEADER_COUNT + (uint64_t)image->numcomps * IMAGE_INFO_COMPONENT_COUNT) * sizeof(uint32_t));
+    if (!result) {
+        last_error = ERR_DECODE;
+        opj_destroy_cstr_info(&info);
+        return NULL;
+    }
+
+    const opj_tile_info_v2_t* tile = &info->m_default_tile_info;
+    result[IMAGE_INFO_IMAGE_X0] = x0;
+    result[IMAGE_INFO_IMAGE_Y0] = y0;
+    result[IMAGE_INFO_IMAGE_X1] = x1;
+    result[IMAGE_INFO_IMAGE_Y1] = y1;
+    result[IMAGE_INFO_TILE_X0] = info->tx0;
+    result[IMAGE_INFO_TILE_Y0] = info->ty0;
+    result[IMAGE_INFO_TILE_WIDTH] = info->tdx;
+    result[IMAGE_INFO_TILE_HEIGHT] = info->tdy;
+    result[IMAGE_INFO_NUM_TILES_X] = info->tw;
+    result[IMAGE_INFO_NUM_TILES_Y] = info->th;
+    result[IMAGE_INFO_NUM_RESOLUTIONS] = get_max_reduce(codec) + 1;
+    result[IMAGE_INFO_NUM_LAYERS] = tile->numlayers;
+    result[IMAGE_INFO_PROGRESSION_ORDER] = (uint32_t)tile->prg;
+    // cblkw and cblkh are the exponents of the code-block size
+    int has_tccp = tile->tccp_info && info->nbcomps > 0;
+    result[IMAGE_INFO_CODE_BLOCK_WIDTH] = has_tccp && tile->tccp_info[0].cblkw < 32 ? (uint32_t)1 << tile->tccp_info[0].cblkw : 0;
+    result[IMAGE_INFO_CODE_BLOCK_HEIGHT] = has_tccp && tile->tccp_info[0].cblkh < 32 ? (uint32_t)1 << tile->tccp_info[0].cblkh : 0;
+    result[IMAGE_INFO_MARKERS] = scan_index_markers(data, data_len);
+    result[IMAGE_INFO_NUM_COMPONENTS] = image->numcomps;
+
+    for (uint32_t i = 0; i < image->numcomps; i++) {
+        uint32_t* component = result + IMAGE_INFO_HEADER_COUNT + i * IMAGE_INFO_COMPONENT_COUNT;
+        component[IMAGE_INFO_COMPONENT_PRECISION] = image->comps[i].prec;
+        component[IMAGE_INFO_COMPONENT_SIGNED] = image->comps[i].sgnd;
+        component[IMAGE_INFO_COMPONENT_DX] = image->comps[i].dx;
+        component[IMAGE_INFO_COMPONENT_DY] = image->comps[i].dy;
+    }
+
+    opj_destroy_cstr_info(&info);
+    return result;
+}
+
+// Reads only the main header, so that callers can pick a reduce level, region or tile before paying
+// for a decode. The result is IMAGE_INFO_HEADER_COUNT + numcomps * IMAGE_INFO_COMPONENT_COUNT uint32s.
+EMSCRIPTEN_KEEPALIVE
+uint32_t* getImageInfo(uint8_t* data, uint32_t data_len) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    if (!data || data_len < MIN_INPUT_SIZE) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    opj_buffer_info_t buffer_info = {data, data_len, 0};
+
+    OPJ_CODEC_FORMAT format = get_codec_format(data, data_len);
+
+    opj_codec_t* l_codec = create_decoder(format, 0);
+    if (!l_codec) {
+        last_error = ERR_DECODER_SETUP;
+        return NULL;
+    }
+
+    opj_stream_t* l_stream = create_mem_stream(&buffer_info, data_len);
+
+    opj_image_t* l_image = NULL;
+    uint32_t* result = NULL;
+
+    if (!opj_read_header(l_stream, l_codec, &l_image)) {
+        last_error = ERR_HEADER;
+    } else {
+        result = build_image_info(l_codec, l_image, l_image->x0, l_image->y0, l_image->x1, l_image->y1, data, data_len);
+        opj_image_destroy(l_image);
+    }
+
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+
+    return result;
+}
+
+// Decodes a single tile. Only the codestream of that tile is entropy decoded, so the cost is
+// proportional to the tile rather than the image.
+static opj_image_t* decode_tile_internal(uint8_t* data, uint32_t data_len, OPJ_CODEC_FORMAT format, uint32_t max_pixels, uint32_t max_heap_size,
+                                         int color_format, uint32_t tile_index, uint32_t reduce) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    mem_reset();
+    opj_buffer_info_t buffer_info = {data, data_len, 0};
+
+    opj_codec_t* l_codec = create_decoder(format, 0);
+    if (!l_codec) {
+        last_error = ERR_DECODER_SETUP;
+        return NULL;
+    }
+
+    opj_stream_t* l_stream = create_mem_stream(&buffer_info, data_len);
+
+    opj_image_t* l_image = NULL;
+    if (!read_header_timed(l_stream, l_codec, &l_image)) {
+        last_error = ERR_HEADER;
+    } else if (!apply_reduce(l_codec, l_image, reduce)) {
+        last_error = ERR_DECODER_SETUP;
+        opj_image_destroy(l_image);
+        l_image = NULL;
+    } else {
+        opj_codestream_info_v2_t* info = opj_get_cstr_info(l_codec);
+        if (!info) {
+            last_error = ERR_HEADER;
+            opj_image_destroy(l_image);
+            l_image = NULL;
+        } else if (info->tw == 0 || info->th == 0 || tile_index >= (uint64_t)info->tw * info->th) {
+            last_error = ERR_REGION_OUT_OF_BOUNDS;
+            opj_image_destroy(l_image);
+            l_image = NULL;
+        } else {
+            uint32_t tx0, ty0, tx1, ty1;
+            get_tile_bounds(info, l_image, tile_index, &tx0, &ty0, &tx1, &ty1);
+
+            uint32_t factor = l_image->numcomps > 0 ? l_image->comps[0].factor : 0;
+
+            if (max_pixels > 0 && reduced_pixel_count(tx0, ty0, tx1, ty1, factor) > max_pixels) {
+                last_error = ERR_PIXEL_DATA_SIZE;
+                opj_image_destroy(l_image);
+                l_image = NULL;
+            } else if (!reserve_decode_memory(estimate_decode_peak(l_codec, l_image, tx0, ty0, tx1, ty1, 0, data_len, color_format), max_heap_size) ||
+                       should_abort()) {
+                opj_image_destroy(l_image);
+                l_image = NULL;
+            } else {
+                STATS_TIMER_START(decode_start);
+                OPJ_BOOL decoded = opj_get_decoded_tile(l_codec, l_stream, l_image, tile_index);
+                STATS_TIMER_STOP(STATS_DECODE_US, decode_start);
+                STATS_ADD(STATS_TILES, 1);
+                if (!decoded) {
+                    last_error = ERR_DECODE;
+                    opj_image_destroy(l_image);
+                    l_image = NULL;
+                }
+            }
+        }
+        if (info) opj_destroy_cstr_info(&info);
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+
+    return l_image;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t* decodeTileToBmp(uint8_t* data, uint32_t data_len, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t tile_index, uint32_t reduce) {
+    uint32_t divider = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+    uint32_t max_input_size = max_heap_size / divider;
+
+    if (!data || data_len < MIN_INPUT_SIZE || data_len > max_input_size) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    OPJ_CODEC_FORMAT format = get_codec_format(data, data_len);
+    opj_image_t* image = decode_tile_internal(data, data_len, format, max_pixels, max_heap_size, color_format, tile_index, reduce);
+    if (!image) return NULL;
+
+    uint8_t* bmp_buffer = encode_output(image, color_format);
+
+    opj_image_destroy(image);
+    mem_sample();
+    return bmp_buffer;
+}
+
+// Decode session
+//
+// A session keeps a copy of the codestream together with its parsed main header, so repeated
+// requests on a single-tile image (e.g. panning over a cached image) only pay for
+// opj_set_decode_area() + opj_decode(). OpenJPEG can only decode a single-tile codestream several
+// times from one header read. Multi-tile codestreams re-read the main header and every tile part
+// they need on each request, like a one-shot decode; the session only saves the input copy there.
+// A failed decode also re-reads the header before the next request.
+typedef struct {
+    uint8_t* data;
+    uint32_t data_len;
+    opj_buffer_info_t buffer_info;
+    opj_codec_t* codec;
+    opj_stream_t* stream;
+    opj_image_t* image;
+    // Image area from the header. image->x0..y1 follow the last decode area.
+    uint32_t x0, y0, x1, y1;
+    uint32_t tile_info[TILE_INFO_COUNT];
+    uint32_t max_reduce;
+    uint32_t num_layers;
+    // Quality layers to decode, 0 for all
+    uint32_t layers;
+    int needs_reset;
+} decode_session_t;
+
+static void session_close_codec(decode_session_t* session) {
+    if (session->image) opj_image_destroy(session->image);
+    if (session->stream) opj_stream_destroy(session->stream);
+    if (session->codec) opj_destroy_codec(session->codec);
+    session->image = NULL;
+    session->stream = NULL;
+    session->codec = NULL;
+}
+
+static int session_open_codec(decode_session_t* session) {
+    session->buffer_info.data = session->data;
+    session->buffer_info.size = session->data_len;
+    session->buffer_info.offset = 0;
+
+    session->codec = create_decoder(get_codec_format(session->data, session->data_len), session->layers);
+    if (!session->codec) {
+        last_error = ERR_DECODER_SETUP;
+        return 0;
+    }
+
+    session->stream = create_mem_stream(&session->buffer_info, session->data_len);
+
+    if (!read_header_timed(session->stream, session->codec, &session->image)) {
+        last_error = ERR_HEADER;
+        session->image = NULL;
+        session_close_codec(session);
+        return 0;
+    }
+
+    opj_codestream_info_v2_t* info = opj_get_cstr_info(session->codec);
+    if (!info) {
+        last_error = ERR_HEADER;
+        session_close_codec(session);
+        return 0;
+    }
+
+    opj_image_t* image = session->image;
+    session->x0 = image->x0;
+    session->y0 = image->y0;
+    session->x1 = image->x1;
+    session->y1 = image->y1;
+    session->tile_info[TILE_INFO_IMAGE_X0] = image->x0;
+    session->tile_info[TILE_INFO_IMAGE_Y0] = image->y0;
+    session->tile_info[TILE_INFO_IMAGE_X1] = image->x1;
+    session->tile_info[TILE_INFO_IMAGE_Y1] = image->y1;
+    session->tile_info[TILE_INFO_TILE_X0] = info->tx0;
+    session->tile_info[TILE_INFO_TILE_Y0] = info->ty0;
+    session->tile_info[TILE_INFO_TILE_WIDTH] = info->tdx;
+    session->tile_info[TILE_INFO_TILE_HEIGHT] = info->tdy;
+    session->tile_info[TILE_INFO_NUM_TILES_X] = info->tw;
+    session->tile_info[TILE_INFO_NUM_TILES_Y] = info->th;
+    session->num_layers = info->m_default_tile_info.numlayers;
+    opj_destroy_cstr_info(&info);
+
+    session->max_reduce = get_max_reduce(session->codec);
+    session->needs_reset = 0;
+    return 1;
+}
+
+// Takes ownership of `data` on success; it must have been allocated with malloc and is freed by
+// closeSession(). On failure the caller keeps ownership.
+EMSCRIPTEN_KEEPALIVE
+decode_session_t* openSession(uint8_t* data, uint32_t data_len) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    if (!data || data_len < MIN_INPUT_SIZE) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    decode_session_t* session = (decode_session_t*)calloc(1, sizeof(decode_session_t));
+    if (!session) {
+        last_error = ERR_DECODER_SETUP;
+        return NULL;
+    }
+
+    session->data = data;
+    session->data_len = data_len;
+
+    if (!session_open_codec(session)) {
+        free(session);
+        return NULL;
+    }
+    return session;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void closeSession(decode_session_t* session) {
+    if (!session) return;
+    session_close_codec(session);
+    free(session->data);
+    free(session);
+}
+
+// Limits the quality layers decoded by the following requests, 0 (or more than the codestream has)
+// decodes all of them. Changing the limit re-reads the header before the next request, the cached
+// codestream is kept. Returns the number of layers that will be decoded.
+EMSCRIPTEN_KEEPALIVE
+uint32_t sessionSetQualityLayers(decode_session_t* session, uint32_t layers) {
+    last_error = ERR_NONE;
+    if (!session) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return 0;
+    }
+    if (layers >= session->num_layers) layers = 0;
+    if (layers != session->layers) {
+        session->layers = layers;
+        session->needs_reset = 1;
+    }
+    return layers > 0 ? layers : session->num_layers;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t sessionGetQualityLayers(decode_session_t* session) {
+    return session ? session->num_layers : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t sessionGetMaxReduce(decode_session_t* session) {
+    return session ? session->max_reduce : 0;
+}
+
+static int session_prepare(decode_session_t* session) {
+    if (!session->needs_reset) return 1;
+    session_close_codec(session);
+    return session_open_codec(session);
+}
+
+static uint8_t* session_decode(decode_session_t* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, int use_ratio, uint32_t reduce) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    mem_reset();
+
+    if (!session_prepare(session)) return NULL;
+
+    opj_image_t* image = session->image;
+    if (!set_reduce(session->codec, image, reduce, session->max_reduce)) {
+        last_error = ERR_DECODER_SETUP;
+        session->needs_reset = 1;
+        return NULL;
+    }
+
+    uint32_t ux0, uy0, ux1, uy1;
+    int is_partial;
+    if (!resolve_region(session->x0, session->y0, session->x1, session->y1, x0, y0, x1, y1, use_ratio,
+                        &ux0, &uy0, &ux1, &uy1, &is_partial)) {
+        last_error = ERR_REGION_OUT_OF_BOUNDS;
+        return NULL;
+    }
+    if (!is_partial) {
+        // The previous request may have narrowed the decode area
+        ux0 = session->x0;
+        uy0 = session->y0;
+        ux1 = session->x1;
+        uy1 = session->y1;
+    }
+
+    uint32_t factor = image->numcomps > 0 ? image->comps[0].factor : 0;
+    if (max_pixels > 0 && reduced_pixel_count(ux0, uy0, ux1, uy1, factor) > max_pixels) {
+        last_error = ERR_PIXEL_DATA_SIZE;
+        return NULL;
+    }
+
+    if (should_abort()) return NULL;
+
+    uint32_t ax0 = ux0, ay0 = uy0, ax1 = ux1, ay1 = uy1;
+    int streamed = can_stream_tiles(session->data, session->data_len, image) &&
+                   snap_area_to_tiles(session->codec, session->x0, session->y0, session->x1, session->y1, &ax0, &ay0, &ax1, &ay1) > 1;
+
+    if (!reserve_decode_memory(estimate_decode_peak(session->codec, image, ux0, uy0, ux1, uy1, streamed, session->data_len, color_format), max_heap_size)) {
+        return NULL;
+    }
+
+    if (!opj_set_decode_area(session->codec, image, ax0, ay0, ax1, ay1)) {
+        last_error = ERR_REGION_OUT_OF_BOUNDS;
+        session->needs_reset = 1;
+        return NULL;
+    }
+
+    if (streamed) {
+        session->needs_reset = 1;
+        return decode_tiles_to_output(session->codec, session->stream, image, color_format, ux0, uy0, ux1, uy1);
+    }
+
+    if (!decode_timed(session->codec, session->stream, image)) {
+        last_error = ERR_DECODE;
+        session->needs_reset = 1;
+        return NULL;
+    }
+
+    if ((uint64_t)session->tile_info[TILE_INFO_NUM_TILES_X] * session->tile_info[TILE_INFO_NUM_TILES_Y] > 1) {
+        session->needs_reset = 1;
+    }
+    return encode_output(image, color_format);
+}
+
+// The session image is reused by the next request, only its pixel data is released.
+static void session_release_pixels(decode_session_t* session) {
+    opj_image_t* image = session->image;
+    if (!image || !image->comps) return;
+    for (uint32_t i = 0; i < image->numcomps; i++) {
+        if (image->comps[i].data) {
+            opj_image_data_free(image->comps[i].data);
+            image->comps[i].data = NULL;
+        }
+    }
+}
+
+static uint8_t* session_decode_to_bmp(decode_session_t* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, int use_ratio, uint32_t reduce) {
+    uint32_t divider = (color_format == COLOR_FORMAT_RGB565) ? 2 : 4;
+    uint32_t max_input_size = max_heap_size / divider;
+
+    if (!session || session->data_len > max_input_size) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    uint8_t* bmp_buffer = session_decode(session, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, use_ratio, reduce);
+    session_release_pixels(session);
+    mem_sample();
+    return bmp_buffer;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t* sessionDecodeToBmp(decode_session_t* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint32_t reduce) {
+    return session_decode_to_bmp(session, max_pixels, max_heap_size, color_format, (double)x0, (double)y0, (double)x1, (double)y1, 0, reduce);
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t* sessionDecodeToBmpWithRatio(decode_session_t* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, double x0, double y0, double x1, double y1, uint32_t reduce) {
+    return session_decode_to_bmp(session, max_pixels, max_heap_size, color_format, x0, y0, x1, y1, 1, reduce);
+}
+
+// Tiles are decoded with opj_get_decoded_tile() on a fresh codec, the session only saves
+// copying the codestream into the heap again.
+EMSCRIPTEN_KEEPALIVE
+uint8_t* sessionDecodeTileToBmp(decode_session_t* session, uint32_t max_pixels, uint32_t max_heap_size, int color_format, uint32_t tile_index, uint32_t reduce) {
+    if (!session) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+    return decodeTileToBmp(session->data, session->data_len, max_pixels, max_heap_size, color_format, tile_index, reduce);
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t* sessionGetSize(decode_session_t* session) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    if (!session) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    uint32_t* result = (uint32_t*)malloc(2 * sizeof(uint32_t));
+    if (!result) {
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+    result[0] = session->x1 - session->x0;
+    result[1] = session->y1 - session->y0;
+    return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t* sessionGetTileInfo(decode_session_t* session) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    if (!session) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+
+    uint32_t* result = (uint32_t*)malloc(TILE_INFO_COUNT * sizeof(uint32_t));
+    if (!result) {
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+    memcpy(result, session->tile_info, TILE_INFO_COUNT * sizeof(uint32_t));
+    return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t* sessionGetImageInfo(decode_session_t* session) {
+    last_error = ERR_NONE;
+    STATS_RESET();
+    if (!session) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return NULL;
+    }
+    if (!session_prepare(session)) return NULL;
+    return build_image_info(session->codec, session->image, session->x0, session->y0, session->x1, session->y1, session->data, session->data_len);
+}
+
+// Base64
+// Encodes the decoder output and decodes the input payload inside WASM for the string data channels,
+// so that the JS glue only moves characters between strings and the heap. Both alphabets pad with '='.
+#define BASE64_ALPHABET_STANDARD 0
+#define BASE64_ALPHABET_URL 1
+
+static const char base64_chars[2][64] = {
+    { 'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z',
+      'a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z',
+      '0','1','2','3','4','5','6','7','8','9','+','/' },
+    { 'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z',
+      'a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z',
+      '0','1','2','3','4','5','6','7','8','9','-','_' },
+};
+
+// Values of the characters of both alphabets, -1 for anything else
+static const int8_t base64_values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, 62, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static uint32_t base64_encoded_size(uint32_t size) {
+    return (size / 3 + (size % 3 ? 1 : 0)) * 4;
+}
+
+// Encodes whole groups of 3 bytes and the padded tail. Returns the number of characters written.
+static uint32_t base64_encode_scalar(const uint8_t* src, uint32_t size, char* dst, const char* chars) {
+    char* out = dst;
+    uint32_t i = 0;
+    for (; i + 3 <= size; i += 3, out += 4) {
+        uint32_t v = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1] << 8) | src[i + 2];
+        out[0] = chars[v >> 18];
+        out[1] = chars[(v >> 12) & 0x3F];
+        out[2] = chars[(v >> 6) & 0x3F];
+        out[3] = chars[v & 0x3F];
+    }
+    if (i < size) {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 1 < size) v |= (uint32_t)src[i + 1] << 8;
+        out[0] = chars[v >> 18];
+        out[1] = chars[(v >> 12) & 0x3F];
+        out[2] = (i + 1 < size) ? chars[(v >> 6) & 0x3F] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+    return (uint32_t)(out - dst);
+}
+
+// Decodes groups of 4 characters, the last one may be padded or cut short. Returns the number of bytes
+// written, or -1 on a character outside both alphabets or misplaced padding.
+static int64_t base64_decode_scalar(const uint8_t* src, uint32_t length, uint8_t* dst) {
+    // Padding only ends the text
+    uint32_t padding = 0;
+    while (padding < 2 && length > 0 && src[length - 1] == '=') {
+        length--;
+        padding++;
+    }
+    if (length % 4 == 1 || (padding && (length + padding) % 4 != 0)) return -1;
+
+    uint8_t* out = dst;
+    uint32_t i = 0;
+    for (; i + 4 <= length; i += 4, out += 3) {
+        int32_t a = base64_values[src[i]], b = base64_values[src[i + 1]];
+        int32_t c = base64_values[src[i + 2]], d = base64_values[src[i + 3]];
+        if ((a | b | c | d) < 0) return -1;
+        uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+        out[0] = (uint8_t)(v >> 16);
+        out[1] = (uint8_t)(v >> 8);
+        out[2] = (uint8_t)v;
+    }
+
+    uint32_t rest = length - i;
+    if (rest > 0) {
+        int32_t a = base64_values[src[i]], b = base64_values[src[i + 1]];
+        int32_t c = rest > 2 ? base64_values[src[i + 2]] : 0;
+        if ((a | b | c) < 0) return -1;
+        uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+        *out++ = (uint8_t)(v >> 16);
+        if (rest > 2) *out++ = (uint8_t)(v >> 8);
+    }
+    return out - dst;
+}
+
+#if WRAPPER_USE_SIMD
+// 12 bytes into 16 characters per iteration. Each 32-bit lane gathers its 3 bytes as b1 b0 b2 b1, so
+// that the four 6-bit indices are shifts and masks of the lane. The indices are then mapped to
+// characters by adding the offset of their range, looked up with a swizzle.
+static uint32_t base64_encode(const uint8_t* src, uint32_t size, char* dst, int alphabet) {
+    const v128_t offsets = wasm_i8x16_make('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, base64_chars[alphabet][62] - 62,
+                                           base64_chars[alphabet][63] - 63, 'A', 0, 0);
+    uint32_t i = 0;
+    char* out = dst;
+
+    // The load reads 4 bytes past the 12 that are encoded
+    for (; i + 16 <= size; i += 12, out += 16) {
+        v128_t v = wasm_v128_load(src + i);
+        v128_t in = wasm_i8x16_shuffle(v, v, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        v128_t idx = wasm_v128_or(
+            wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(in, 10), wasm_i32x4_splat(0x3F)),
+                         wasm_v128_and(wasm_i32x4_shl(in, 4), wasm_i32x4_splat(0x3F00))),
+            wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(in, 6), wasm_i32x4_splat(0x3F0000)),
+                         wasm_v128_and(wasm_i32x4_shl(in, 8), wasm_i32x4_splat(0x3F000000))));
+
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+        v128_t range = wasm_u8x16_sub_sat(idx, wasm_i8x16_splat(51));
+        range = wasm_v128_or(range, wasm_v128_and(wasm_i8x16_lt(idx, wasm_i8x16_splat(26)), wasm_i8x16_splat(13)));
+        wasm_v128_store(out, wasm_i8x16_add(idx, wasm_i8x16_swizzle(offsets, range)));
+    }
+
+    return (uint32_t)(out - dst) + base64_encode_scalar(src + i, size - i, out, base64_chars[alphabet]);
+}
+
+static inline v128_t in_range_u8x16(v128_t v, uint8_t lo, uint8_t hi) {
+    return wasm_u8x16_le(wasm_i8x16_sub(v, wasm_i8x16_splat(lo)), wasm_i8x16_splat(hi - lo));
+}
+
+// 16 characters into 12 bytes per iteration, accepting both alphabets. A block with any other
+// character, padding included, is left to the scalar decoder, which reports it.
+static int64_t base64_decode(const uint8_t* src, uint32_t length, uint8_t* dst) {
+    uint32_t i = 0;
+    uint8_t* out = dst;
+
+    // The last group may be padded, so it always goes through the scalar decoder
+    for (; i + 20 <= length; i += 16, out += 12) {
+        v128_t c = wasm_v128_load(src + i);
+        v128_t upper = in_range_u8x16(c, 'A', 'Z');
+        v128_t lower = in_range_u8x16(c, 'a', 'z');
+        v128_t digit = in_range_u8x16(c, '0', '9');
+        v128_t plus = wasm_v128_or(wasm_i8x16_eq(c, wasm_i8x16_splat('+')), wasm_i8x16_eq(c, wasm_i8x16_splat('-')));
+        v128_t slash = wasm_v128_or(wasm_i8x16_eq(c, wasm_i8x16_splat('/')), wasm_i8x16_eq(c, wasm_i8x16_splat('_')));
+        if (!wasm_i8x16_all_true(wasm_v128_or(wasm_v128_or(upper, lower), wasm_v128_or(digit, wasm_v128_or(plus, slash))))) break;
+
+        v128_t values = wasm_v128_or(
+            wasm_v128_or(wasm_v128_and(upper, wasm_i8x16_sub(c, wasm_i8x16_splat('A'))),
+                         wasm_v128_and(lower, wasm_i8x16_sub(c, wasm_i8x16_splat('a' - 26)))),
+            wasm_v128_or(wasm_v128_and(digit, wasm_i8x16_add(c, wasm_i8x16_splat(52 - '0'))),
+                         wasm_v128_or(wasm_v128_and(plus, wasm_i8x16_splat(62)), wasm_v128_and(slash, wasm_i8x16_splat(63)))));
+
+        // Each lane holds the values a b c d of one group, merged into the 24 bits a b c d
+        v128_t bits = wasm_v128_or(
+            wasm_v128_or(wasm_v128_and(wasm_i32x4_shl(values, 18), wasm_i32x4_splat(0xFC0000)),
+                         wasm_v128_and(wasm_i32x4_shl(values, 4), wasm_i32x4_splat(0x3F000))),
+            wasm_v128_or(wasm_v128_and(wasm_u32x4_shr(values, 10), wasm_i32x4_splat(0xFC0)),
+                         wasm_u32x4_shr(values, 24)));
+        v128_t bytes = wasm_i8x16_shuffle(bits, bits, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, 0, 0, 0, 0);
+        wasm_v128_store64_lane(out, bytes, 0);
+        wasm_v128_store32_lane(out + 8, bytes, 2);
+    }
+
+    int64_t rest = base64_decode_scalar(src + i, length - i, out);
+    return rest < 0 ? -1 : (out - dst) + rest;
+}
+#else
+static uint32_t base64_encode(const uint8_t* src, uint32_t size, char* dst, int alphabet) {
+    return base64_encode_scalar(src, size, dst, base64_chars[alphabet]);
+}
+
+static int64_t base64_decode(const uint8_t* src, uint32_t length, uint8_t* dst) {
+    return base64_decode_scalar(src, length, dst);
+}
+#endif
+
+// Base64-encodes size bytes at data with the standard (0) or URL-safe (1) alphabet. Returns
+// base64EncodedSize(size) characters, not terminated, to be released with releaseBuffer().
+EMSCRIPTEN_KEEPALIVE
+char* base64Encode(const uint8_t* data, uint32_t size, int alphabet) {
+    last_error = ERR_NONE;
+    if (size > UINT32_MAX / 4 * 3) {
+        last_error = ERR_PIXEL_DATA_SIZE;
+        return NULL;
+    }
+
+    uint32_t text_size = base64_encoded_size(size);
+    char* text = (char*)scratch_alloc(SCRATCH_SLOT_TEXT, text_size > 0 ? text_size : 1);
+    if (!text) {
+        last_error = ERR_DECODE;
+        return NULL;
+    }
+    base64_encode(data, size, text, alphabet == BASE64_ALPHABET_URL ? BASE64_ALPHABET_URL : BASE64_ALPHABET_STANDARD);
+    return text;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint32_t base64EncodedSize(uint32_t size) {
+    return base64_encoded_size(size);
+}
+
+// Decodes length characters of Base64 text in either alphabet into output, which must hold
+// ceil(length * 3 / 4) bytes. Returns the number of bytes written, or -1 on malformed text.
+EMSCRIPTEN_KEEPALIVE
+int32_t base64Decode(const uint8_t* text, uint32_t length, uint8_t* output) {
+    last_error = ERR_NONE;
+    int64_t written = base64_decode(text, length, output);
+    if (written < 0 || written > INT32_MAX) {
+        last_error = ERR_INPUT_DATA_SIZE;
+        return -1;
+    }
+    return (int32_t)written;
+}